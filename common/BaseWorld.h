@@ -20,6 +20,7 @@
 #define COMMON_BASE_WORLD_H
 
 #include "globals.h"
+#include "OpHandle.h"
 
 #include <Atlas/Message/Element.h>
 #include <Atlas/Objects/ObjectsFwd.h>
@@ -218,6 +219,23 @@ class BaseWorld {
     virtual void message(const Atlas::Objects::Operation::RootOperation &,
                          LocatedEntity & obj) = 0;
 
+    /// \brief Pass an operation to the world, returning a handle which
+    /// can be used to cancel it before it's dispatched.
+    ///
+    /// Worlds which don't support cancellation return an invalid handle.
+    virtual OpHandle scheduleOperation(const Atlas::Objects::Operation::RootOperation & op,
+                                       LocatedEntity & obj) {
+        message(op, obj);
+        return OpHandle();
+    }
+
+    /// \brief Cancel an operation passed to scheduleOperation().
+    ///
+    /// The handle is released, and can't be used again.
+    virtual void cancelOperation(OpHandle & handle) {
+        handle.reset();
+    }
+
     /// \brief Find an entity of the given name.
     virtual LocatedEntity * findByName(const std::string & name) = 0;
 
@@ -0,0 +1,255 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "BinaryMessage.h"
+
+#include <cstdint>
+#include <cstring>
+
+using Atlas::Message::Element;
+using Atlas::Message::ListType;
+using Atlas::Message::MapType;
+
+/// The first byte of the encoding. It can't start an XML document, which
+/// is what the database used to contain.
+static const unsigned char MARKER = 0xcb;
+
+static const unsigned char TAG_NONE = 0;
+static const unsigned char TAG_INT = 1;
+static const unsigned char TAG_FLOAT = 2;
+static const unsigned char TAG_STRING = 3;
+static const unsigned char TAG_MAP = 4;
+static const unsigned char TAG_LIST = 5;
+
+/// Guards against malformed data nesting deep enough to exhaust the stack.
+static const int MAX_DEPTH = 64;
+
+static void writeVarint(std::uint64_t value, std::string & data)
+{
+    while (value >= 0x80) {
+        data.push_back((char)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    data.push_back((char)value);
+}
+
+static void writeString(const std::string & value, std::string & data)
+{
+    writeVarint(value.size(), data);
+    data.append(value);
+}
+
+static void writeElement(const Element & element, std::string & data);
+
+static void writeMap(const MapType & map, std::string & data)
+{
+    writeVarint(map.size(), data);
+    for (auto& entry : map) {
+        writeString(entry.first, data);
+        writeElement(entry.second, data);
+    }
+}
+
+static void writeElement(const Element & element, std::string & data)
+{
+    switch (element.getType()) {
+        case Element::TYPE_INT:
+            {
+                //Zigzag encoding keeps small negative numbers short.
+                std::int64_t value = element.Int();
+                data.push_back((char)TAG_INT);
+                writeVarint(((std::uint64_t)value << 1) ^ (std::uint64_t)(value >> 63), data);
+            }
+            break;
+        case Element::TYPE_FLOAT:
+            {
+                double value = element.Float();
+                std::uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                data.push_back((char)TAG_FLOAT);
+                for (int i = 0; i < 8; ++i) {
+                    data.push_back((char)(bits >> (i * 8)));
+                }
+            }
+            break;
+        case Element::TYPE_STRING:
+            data.push_back((char)TAG_STRING);
+            writeString(element.String(), data);
+            break;
+        case Element::TYPE_MAP:
+            data.push_back((char)TAG_MAP);
+            writeMap(element.Map(), data);
+            break;
+        case Element::TYPE_LIST:
+            {
+                const ListType & list = element.List();
+                data.push_back((char)TAG_LIST);
+                writeVarint(list.size(), data);
+                for (auto& item : list) {
+                    writeElement(item, data);
+                }
+            }
+            break;
+        default:
+            data.push_back((char)TAG_NONE);
+            break;
+    }
+}
+
+namespace {
+
+    /// \brief Reads encoded data, keeping track of the position.
+    struct Reader {
+        const unsigned char * pos;
+        const unsigned char * end;
+
+        bool readVarint(std::uint64_t & value)
+        {
+            value = 0;
+            for (unsigned int shift = 0; shift < 64; shift += 7) {
+                if (pos == end) {
+                    return false;
+                }
+                unsigned char byte = *pos++;
+                value |= (std::uint64_t)(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool readString(std::string & value)
+        {
+            std::uint64_t size;
+            if (!readVarint(size) || size > (std::uint64_t)(end - pos)) {
+                return false;
+            }
+            value.assign((const char *)pos, size);
+            pos += size;
+            return true;
+        }
+
+        bool readMap(MapType & map, int depth)
+        {
+            std::uint64_t count;
+            if (!readVarint(count)) {
+                return false;
+            }
+            std::string key;
+            for (std::uint64_t i = 0; i < count; ++i) {
+                if (!readString(key) || !readElement(map[key], depth)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool readElement(Element & element, int depth)
+        {
+            if (pos == end || depth > MAX_DEPTH) {
+                return false;
+            }
+            switch (*pos++) {
+                case TAG_NONE:
+                    element = Element();
+                    return true;
+                case TAG_INT:
+                    {
+                        std::uint64_t value;
+                        if (!readVarint(value)) {
+                            return false;
+                        }
+                        element = (Atlas::Message::IntType)((value >> 1) ^ -(std::int64_t)(value & 1));
+                    }
+                    return true;
+                case TAG_FLOAT:
+                    {
+                        if (end - pos < 8) {
+                            return false;
+                        }
+                        std::uint64_t bits = 0;
+                        for (int i = 0; i < 8; ++i) {
+                            bits |= (std::uint64_t)*pos++ << (i * 8);
+                        }
+                        double value;
+                        std::memcpy(&value, &bits, sizeof(value));
+                        element = value;
+                    }
+                    return true;
+                case TAG_STRING:
+                    element = std::string();
+                    return readString(element.asString());
+                case TAG_MAP:
+                    element = MapType();
+                    return readMap(element.asMap(), depth + 1);
+                case TAG_LIST:
+                    {
+                        std::uint64_t count;
+                        //Every element takes at least one byte.
+                        if (!readVarint(count) || count > (std::uint64_t)(end - pos)) {
+                            return false;
+                        }
+                        element = ListType(count);
+                        for (auto& item : element.asList()) {
+                            if (!readElement(item, depth + 1)) {
+                                return false;
+                            }
+                        }
+                    }
+                    return true;
+                default:
+                    return false;
+            }
+        }
+    };
+}
+
+namespace BinaryMessage {
+
+    void encode(const MapType & msg, std::string & data)
+    {
+        data.push_back((char)MARKER);
+        data.push_back((char)VERSION);
+        writeMap(msg, data);
+    }
+
+    int decode(const char * data, std::size_t size, MapType & msg)
+    {
+        if (!isEncoded(data, size)) {
+            return -1;
+        }
+        Reader reader{(const unsigned char *)data + 2,
+                      (const unsigned char *)data + size};
+        msg.clear();
+        if (!reader.readMap(msg, 0) || reader.pos != reader.end) {
+            return -1;
+        }
+        return 0;
+    }
+
+    bool isEncoded(const char * data, std::size_t size)
+    {
+        return size >= 2 && (unsigned char)data[0] == MARKER &&
+               (unsigned char)data[1] == VERSION;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef BINARYMESSAGE_H_
+#define BINARYMESSAGE_H_
+
+#include <Atlas/Message/Element.h>
+
+#include <string>
+
+/// \brief A compact binary encoding of Atlas messages, used for storing
+/// entity data in the database.
+///
+/// The encoding starts with a two byte header, a marker and a version.
+/// Each element is a one byte type tag followed by its value. Integers,
+/// lengths and counts are stored as variable length integers, floats as
+/// eight bytes and strings without any escaping. Pointer elements can't be
+/// stored, and are encoded as none.
+namespace BinaryMessage {
+
+    /// \brief The version of the encoding written by encode().
+    static const unsigned char VERSION = 1;
+
+    /**
+     * @brief Encodes a map.
+     * @param msg The map.
+     * @param data The encoded map is appended to this.
+     */
+    void encode(const Atlas::Message::MapType & msg, std::string & data);
+
+    /**
+     * @brief Decodes a map.
+     * @param data The start of the encoded data.
+     * @param size The length of the encoded data.
+     * @param msg The decoded map.
+     * @return 0 on success, -1 if the data is malformed.
+     */
+    int decode(const char * data, std::size_t size,
+               Atlas::Message::MapType & msg);
+
+    /**
+     * @brief Checks if some data starts with the header of the encoding.
+     */
+    bool isEncoded(const char * data, std::size_t size);
+}
+
+#endif /* BINARYMESSAGE_H_ */
@@ -19,6 +19,8 @@
 #ifndef COMMON_COMM_SOCKET_H
 #define COMMON_COMM_SOCKET_H
 
+#include <Atlas/Objects/ObjectsFwd.h>
+
 namespace boost {
 namespace asio {
 class io_service;
@@ -47,6 +49,18 @@ class CommSocket {
 
     /// \brief Flush the socket
     virtual int flush() = 0;
+
+    /// \brief Queue an operation to be sent
+    ///
+    /// Sockets which support it encode the operation themselves, which
+    /// lets them reuse the encoding of an operation being broadcast, and
+    /// keep track of what is waiting to be sent.
+    /// @return false if the operation wasn't queued, and has to be encoded
+    /// by the caller.
+    virtual bool sendOperation(const Atlas::Objects::Operation::RootOperation &)
+    {
+        return false;
+    }
 };
 
 #endif // COMMON_COMM_SOCKET_H
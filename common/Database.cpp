@@ -18,6 +18,7 @@
 
 #include "Database.h"
 
+#include "BinaryMessage.h"
 #include "id.h"
 #include "log.h"
 #include "debug.h"
@@ -31,8 +32,12 @@
 
 #include <varconf/config.h>
 
+#include <algorithm>
+#include <set>
 #include <sstream>
+#include <vector>
 
+#include <cstdint>
 #include <cstring>
 #include <cstdlib>
 
@@ -49,6 +54,80 @@ static const bool debug_flag = false;
 
 Database * Database::m_instance = NULL;
 
+/// Type oids of parameters sent to prepared statements.
+static const Oid BYTEA_OID = 17;
+static const Oid INT4_OID = 23;
+static const Oid TEXT_OID = 25;
+
+#ifdef LIBPQ_HAS_PIPELINING
+/// Prepared statements are sent together in pipeline mode, where the
+/// version of libpq supports it.
+static const bool STATEMENTS_BATCHED = true;
+#else
+static const bool STATEMENTS_BATCHED = false;
+#endif
+
+static void appendInt32(std::string & data, std::int32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        data.push_back((char)(value >> shift));
+    }
+}
+
+/// \brief Builds a one dimensional array parameter in the binary format,
+/// so that many rows can be written by one prepared statement.
+class ArrayParam {
+  private:
+    Oid m_type;
+    std::int32_t m_count;
+    bool m_hasNull;
+    std::string m_elements;
+  public:
+    explicit ArrayParam(Oid type) : m_type(type), m_count(0),
+                                    m_hasNull(false) { }
+
+    void add(const std::string & value) {
+        appendInt32(m_elements, value.size());
+        m_elements += value;
+        ++m_count;
+    }
+
+    void addInt(std::int32_t value) {
+        appendInt32(m_elements, 4);
+        appendInt32(m_elements, value);
+        ++m_count;
+    }
+
+    void addNull() {
+        appendInt32(m_elements, -1);
+        m_hasNull = true;
+        ++m_count;
+    }
+
+    /// \brief Add an entity id, or null if it's empty.
+    void addId(const std::string & id) {
+        if (id.empty()) {
+            addNull();
+        } else {
+            addInt(std::strtol(id.c_str(), 0, 10));
+        }
+    }
+
+    std::string get() const {
+        std::string data;
+        appendInt32(data, m_count == 0 ? 0 : 1);
+        appendInt32(data, m_hasNull ? 1 : 0);
+        appendInt32(data, m_type);
+        if (m_count != 0) {
+            appendInt32(data, m_count);
+            // Lower bound
+            appendInt32(data, 1);
+        }
+        data += m_elements;
+        return data;
+    }
+};
+
 static void databaseNotice(void *, const char * message)
 {
     log(NOTICE, "Notice from database:");
@@ -57,6 +136,19 @@ static void databaseNotice(void *, const char * message)
 
 Database::Database() : m_rule_db("rules"),
                        m_queryInProgress(false),
+                       m_queriesInFlight(0),
+                       m_resultsReceived(0),
+                       m_batchFailed(false),
+                       m_retryOnFailure(false),
+                       m_pipelined(false),
+                       m_pipelineSynced(false),
+                       m_batchLimit(64),
+                       m_batchLatency(0),
+                       m_batchSize(0),
+                       m_idBlockSize(1),
+                       m_idRequestPending(false),
+                       m_schemaVersion(SCHEMA_TEXT),
+                       m_statementsPrepared(false),
                        m_connection(NULL)
 {
 }
@@ -203,6 +295,13 @@ int Database::initConnection()
 
     PQsetNoticeProcessor(m_connection, databaseNotice, 0);
 
+    // A new connection has none of the statements prepared on the old one.
+    if (m_statementsPrepared && prepareStatements() != 0) {
+        log(ERROR, "Failed to prepare statements after reconnecting.");
+        shutdownConnection();
+        return -1;
+    }
+
     return 0;
 }
 
@@ -300,11 +399,44 @@ int Database::decodeObject(const std::string & data,
 int Database::decodeMessage(const std::string & data,
                             MapType &o)
 {
-    if (data.empty()) {
+    return decodeMessage(data.data(), data.size(), o);
+}
+
+int Database::decodeMessage(const char * data, size_t size, MapType &o)
+{
+    if (size == 0) {
         return 0;
     }
 
-    std::stringstream str(data, std::ios::in);
+    //Data from bytea columns fetched in text format arrives escaped, and
+    //libpq has terminated it. Columns migrated from text may still hold
+    //XML, so the content is checked after unescaping.
+    if (size >= 2 && data[0] == '\\' && data[1] == 'x') {
+        size_t raw_size;
+        unsigned char * raw = PQunescapeBytea((const unsigned char *)data,
+                                              &raw_size);
+        if (raw == 0) {
+            log(WARNING, "Database entry could not be unescaped");
+            return -1;
+        }
+        int ret = decodeRawMessage((const char *)raw, raw_size, o);
+        PQfreemem(raw);
+        return ret;
+    }
+    return decodeRawMessage(data, size, o);
+}
+
+int Database::decodeRawMessage(const char * data, size_t size, MapType &o)
+{
+    if (BinaryMessage::isEncoded(data, size)) {
+        if (BinaryMessage::decode(data, size, o) != 0) {
+            log(WARNING, "Database entry does not appear to be decodable");
+            return -1;
+        }
+        return 0;
+    }
+
+    std::stringstream str(std::string(data, size), std::ios::in);
 
     Serialiser codec(str, m_d);
     Atlas::Message::Encoder enc(codec);
@@ -336,20 +468,49 @@ int Database::encodeObject(const MapType & o,
     codec.streamEnd();
 
     std::string raw = str.str();
-    char safe[raw.size() * 2 + 1];
+    std::vector<char> safe(raw.size() * 2 + 1);
     int errcode;
 
-    PQescapeStringConn(m_connection, safe, raw.c_str(), raw.size(), &errcode);
+    PQescapeStringConn(m_connection, safe.data(), raw.c_str(), raw.size(),
+                       &errcode);
 
     if (errcode != 0) {
         std::cerr << "ERROR: " << errcode << std::endl << std::flush;
     }
 
-    data = safe;
+    data = safe.data();
 
     return 0;
 }
 
+int Database::encodeWorldObject(const MapType & o,
+                                std::string & data)
+{
+    data.clear();
+    if (m_schemaVersion >= SCHEMA_BINARY) {
+        BinaryMessage::encode(o, data);
+        return 0;
+    }
+
+    serialiseObject(o, data);
+
+    return 0;
+}
+
+void Database::serialiseObject(const MapType & o, std::string & data)
+{
+    std::stringstream str;
+
+    Serialiser codec(str, m_d);
+    Atlas::Message::Encoder enc(codec);
+
+    codec.streamBegin();
+    enc.streamMessageElement(o);
+    codec.streamEnd();
+
+    data = str.str();
+}
+
 int Database::getObject(const std::string & table,
                         const std::string & key,
                         MapType & o)
@@ -404,17 +565,11 @@ int Database::putObject(const std::string & table,
 {
     debug(std::cout << "Database::putObject() " << table << "." << key
                     << std::endl << std::flush;);
-    std::stringstream str;
+    std::string data;
+    serialiseObject(o, data);
 
-    Serialiser codec(str, m_d);
-    Atlas::Message::Encoder enc(codec);
-
-    codec.streamBegin();
-    enc.streamMessageElement(o);
-    codec.streamEnd();
-
-    debug(std::cout << "Encoded to: " << str.str() << " "
-               << str.str().size() << std::endl << std::flush;);
+    debug(std::cout << "Encoded to: " << data << " "
+               << data.size() << std::endl << std::flush;);
     std::string query = std::string("INSERT INTO ") + table + " VALUES ('" + key;
     StringVector::const_iterator Iend = c.end();
     for (StringVector::const_iterator I = c.begin(); I != Iend; ++I) {
@@ -422,7 +577,7 @@ int Database::putObject(const std::string & table,
         query += *I;
     }
     query += "', '";
-    query += str.str();
+    query += data;
     query +=  "')";
     return scheduleCommand(query);
 }
@@ -433,17 +588,11 @@ int Database::updateObject(const std::string & table,
 {
     debug(std::cout << "Database::updateObject() " << table << "." << key
                     << std::endl << std::flush;);
-    std::stringstream str;
-
-    Serialiser codec(str, m_d);
-    Atlas::Message::Encoder enc(codec);
-
-    codec.streamBegin();
-    enc.streamMessageElement(o);
-    codec.streamEnd();
+    std::string data;
+    serialiseObject(o, data);
 
     std::string query = std::string("UPDATE ") + table + " SET contents = '" +
-                        str.str() + "' WHERE id='" + key + "'";
+                        data + "' WHERE id='" + key + "'";
     return scheduleCommand(query);
 }
 
@@ -583,13 +732,16 @@ void Database::reportError()
     log(ERROR, msg);
 }
 
-const DatabaseResult Database::runSimpleSelectQuery(const std::string & query)
+const DatabaseResult Database::runSimpleSelectQuery(const std::string & query,
+                                                  bool binary)
 {
     assert(m_connection != 0);
 
     debug(std::cout << "QUERY: " << query << std::endl << std::flush;);
     clearPendingQuery();
-    int status = PQsendQuery(m_connection, query.c_str());
+    int status = binary ? PQsendQueryParams(m_connection, query.c_str(),
+                                            0, 0, 0, 0, 0, 1)
+                        : PQsendQuery(m_connection, query.c_str());
     if (!status) {
         log(ERROR, "runSimpleSelectQuery(): Database query error.");
         reportError();
@@ -724,6 +876,18 @@ const DatabaseResult Database::selectRelation(const std::string & name,
     return runSimpleSelectQuery(query);
 }
 
+void Database::selectRelationAsync(const std::string & name,
+                                   const std::string & id,
+                                   const ResultHandler & handler)
+{
+    std::string query = "SELECT target FROM ";
+    query += name;
+    query += " WHERE source = ";
+    query += id;
+
+    scheduleSelect(query, handler);
+}
+
 int Database::createRelationRow(const std::string & name,
                                 const std::string & id,
                                 const std::string & other)
@@ -865,6 +1029,21 @@ const DatabaseResult Database::selectSimpleRowBy(const std::string & name,
     return runSimpleSelectQuery(query);
 }
 
+void Database::selectSimpleRowByAsync(const std::string & name,
+                                      const std::string & column,
+                                      const std::string & value,
+                                      const ResultHandler & handler)
+{
+    std::string query = "SELECT * FROM ";
+    query += name;
+    query += " WHERE ";
+    query += column;
+    query += " = ";
+    query += value;
+
+    scheduleSelect(query, handler);
+}
+
 int Database::createSimpleRow(const std::string & name,
                                const std::string & id,
                                const std::string & columns,
@@ -901,6 +1080,63 @@ int Database::updateSimpleRow(const std::string & name,
     return scheduleCommand(query);
 }
 
+int Database::registerSchemaVersion()
+{
+    assert(m_connection != 0);
+
+    clearPendingQuery();
+    int status = PQsendQuery(m_connection, "SELECT * FROM schema_version");
+    if (!status) {
+        log(ERROR, "registerSchemaVersion(): Database query error.");
+        reportError();
+        return -1;
+    }
+    if (tuplesOk()) {
+        allTables.insert("schema_version");
+        DatabaseResult res = runSimpleSelectQuery("SELECT version FROM "
+                                                  "schema_version");
+        if (res.error() || res.empty()) {
+            log(ERROR, "No schema version found in database.");
+            return -1;
+        }
+        m_schemaVersion = strtol(res.field(0), 0, 10);
+        debug(std::cout << "Schema version " << m_schemaVersion
+                        << std::endl << std::flush;);
+        return 0;
+    }
+
+    //Databases which have world tables but no recorded version are from
+    //before the version was recorded, and store text until migrated.
+    int version = SCHEMA_BINARY;
+    status = PQsendQuery(m_connection, "SELECT * FROM entities LIMIT 0");
+    if (!status) {
+        log(ERROR, "registerSchemaVersion(): Database query error.");
+        reportError();
+        return -1;
+    }
+    if (tuplesOk()) {
+        version = SCHEMA_TEXT;
+    }
+
+    if (runCommandQuery("CREATE TABLE schema_version (version integer)") != 0) {
+        return -1;
+    }
+    allTables.insert("schema_version");
+    return setSchemaVersion(version);
+}
+
+int Database::setSchemaVersion(int version)
+{
+    std::string query = compose("DELETE FROM schema_version; "
+                                "INSERT INTO schema_version VALUES (%1)",
+                                version);
+    if (runCommandQuery(query) != 0) {
+        return -1;
+    }
+    m_schemaVersion = version;
+    return 0;
+}
+
 int Database::registerEntityIdGenerator()
 {
     assert(m_connection != 0);
@@ -927,9 +1163,84 @@ long Database::newId(std::string & id)
 {
     assert(m_connection != 0);
 
+    if (m_reservedIds.empty() && reserveIds() != 0) {
+        return -1;
+    }
+    long new_id = m_reservedIds.front();
+    m_reservedIds.pop_front();
+    // Ask for more well before they run out, so that the world doesn't
+    // have to wait for them.
+    if (m_idBlockSize > 1 && m_reservedIds.size() <= m_idBlockSize / 2) {
+        requestIds();
+    }
+    id = compose("%1", new_id);
+    return new_id;
+}
+
+/// \brief Queue an asynchronous request for a block of ids.
+/// \brief The query which takes a block of ids from the sequence.
+///
+/// Each value is taken from the sequence, so the ids are safe to use no
+/// matter how the sequence is used elsewhere.
+std::string Database::idRequestQuery() const
+{
+    return compose("SELECT nextval('entity_ent_id_seq')"
+                   " FROM generate_series(1, %1)", m_idBlockSize);
+}
+
+void Database::requestIds()
+{
+    if (m_idRequestPending) {
+        return;
+    }
+    m_idRequestPending = true;
+    std::string query = idRequestQuery();
+    // The request goes ahead of any queued writes, so that the ids arrive
+    // before the ones left run out, however many writes are waiting.
+    pendingQueries.insert(pendingQueries.begin() + m_queriesInFlight,
+                          DatabaseQuery{query, PGRES_TUPLES_OK, true,
+            [this](PGresult * res) {
+                m_idRequestPending = false;
+                if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+                    addReservedIds(res);
+                }
+            }});
+    if (!m_queryInProgress) {
+        launchNewQuery();
+    }
+}
+
+/// \brief Reserve a block of ids, waiting for the result.
+int Database::reserveIds()
+{
+    // Results arrive in order, so the commands in flight have to be done
+    // with before anything else can be sent. If they include a request
+    // for ids, it's all that's needed.
     clearPendingQuery();
-    int status = PQsendQuery(m_connection,
-                             "SELECT nextval('entity_ent_id_seq')");
+    if (!m_reservedIds.empty()) {
+        return 0;
+    }
+    // A request that hasn't been sent yet is replaced by one sent on its
+    // own now, leaving the queued writes where they are.
+    if (m_idRequestPending) {
+        std::string query = idRequestQuery();
+        auto I = std::find_if(pendingQueries.begin() + m_queriesInFlight,
+                              pendingQueries.end(),
+                              [&query](const DatabaseQuery & q) {
+                                  return q.query == query;
+                              });
+        if (I != pendingQueries.end()) {
+            pendingQueries.erase(I);
+            m_idRequestPending = false;
+        }
+    }
+    return fetchIds();
+}
+
+int Database::fetchIds()
+{
+    debug(std::cout << "Waiting for entity ids" << std::endl << std::flush;);
+    int status = PQsendQuery(m_connection, idRequestQuery().c_str());
     if (!status) {
         log(ERROR, "newId(): Database query error.");
         reportError();
@@ -941,18 +1252,30 @@ long Database::newId(std::string & id)
         reportError();
         return -1;
     }
-    const char * cid = PQgetvalue(res, 0, 0);
-    id = cid;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        addReservedIds(res);
+    } else {
+        reportError();
+    }
     PQclear(res);
     while ((res = PQgetResult(m_connection)) != NULL) {
         PQclear(res);
         log(ERROR, "Extra database result to simple query.");
     };
-    if (id.empty()) {
+    if (m_reservedIds.empty()) {
         log(ERROR, "Unknown error getting ID from database.");
         return -1;
     }
-    return forceIntegerId(id);
+    return 0;
+}
+
+/// \brief Add the ids in the result of a request to those reserved.
+void Database::addReservedIds(PGresult * res)
+{
+    int rows = PQntuples(res);
+    for (int row = 0; row < rows; ++row) {
+        m_reservedIds.push_back(forceIntegerId(PQgetvalue(res, row, 0)));
+    }
 }
 
 int Database::registerEntityTable(const std::map<std::string, int> & chunks)
@@ -988,7 +1311,11 @@ int Database::registerEntityTable(const std::map<std::string, int> & chunks)
     std::map<std::string, int>::const_iterator I = chunks.begin();
     std::map<std::string, int>::const_iterator Iend = chunks.end();
     for (; I != Iend; ++I) {
-        query += compose(", %1 varchar(1024)", I->first);
+        if (m_schemaVersion >= SCHEMA_BINARY) {
+            query += compose(", %1 bytea", I->first);
+        } else {
+            query += compose(", %1 varchar(1024)", I->first);
+        }
     }
     query += ")";
     if (runCommandQuery(query) != 0) {
@@ -1009,10 +1336,49 @@ int Database::insertEntity(const std::string & id,
                            int seq,
                            const std::string & value)
 {
-    std::string query = compose("INSERT INTO entities VALUES "
-                                "(%1, %2, '%3', %4, '%5')",
-                                id, loc, type, seq, value);
-    return scheduleCommand(query);
+    return insertEntities(std::vector<EntityRow>{EntityRow{id, loc, type,
+                                                           seq, value}});
+}
+
+int Database::insertEntities(const std::vector<EntityRow> & rows)
+{
+    for (size_t i = 0; i < rows.size(); i += ROWS_PER_COMMAND) {
+        size_t end = std::min(rows.size(), i + ROWS_PER_COMMAND);
+        ArrayParam ids(INT4_OID), locs(INT4_OID), types(TEXT_OID),
+                   seqs(INT4_OID), locations(worldDataOid());
+        for (size_t j = i; j < end; ++j) {
+            const EntityRow & row = rows[j];
+            ids.addId(row.id);
+            locs.addId(row.loc);
+            types.add(row.type);
+            seqs.addInt(row.seq);
+            locations.add(row.location);
+        }
+        scheduleStatement("insert_entities", {ids.get(), locs.get(),
+                                              types.get(), seqs.get(),
+                                              locations.get()});
+    }
+    return 0;
+}
+
+int Database::updateEntities(const std::vector<EntityRow> & rows)
+{
+    for (size_t i = 0; i < rows.size(); i += ROWS_PER_COMMAND) {
+        size_t end = std::min(rows.size(), i + ROWS_PER_COMMAND);
+        ArrayParam ids(INT4_OID), seqs(INT4_OID),
+                   locations(worldDataOid()), locs(INT4_OID);
+        for (size_t j = i; j < end; ++j) {
+            const EntityRow & row = rows[j];
+            ids.addId(row.id);
+            seqs.addInt(row.seq);
+            locations.add(row.location);
+            // Rows without a location keep the one they have.
+            locs.addId(row.loc);
+        }
+        scheduleStatement("update_entities", {ids.get(), seqs.get(),
+                                              locations.get(), locs.get()});
+    }
+    return 0;
 }
 
 int Database::updateEntity(const std::string & id,
@@ -1020,20 +1386,16 @@ int Database::updateEntity(const std::string & id,
                            const std::string & location_data,
                            const std::string & location_entity_id)
 {
-    std::string query = compose("UPDATE entities SET seq = %1, location = '%2',"
-                                " loc = '%3'"
-                                " WHERE id = %4", seq, location_data,
-                                location_entity_id, id);
-    return scheduleCommand(query);
+    return updateEntities(std::vector<EntityRow>{EntityRow{id,
+            location_entity_id, "", seq, location_data}});
 }
 
 int Database::updateEntityWithoutLoc(const std::string & id,
                  int seq,
                  const std::string & location_data)
 {
-    std::string query = compose("UPDATE entities SET seq = %1, location = '%2'"
-                                " WHERE id = %3", seq, location_data, id);
-    return scheduleCommand(query);
+    return updateEntities(std::vector<EntityRow>{EntityRow{id, "", "", seq,
+                                                           location_data}});
 }
 
 
@@ -1047,20 +1409,32 @@ const DatabaseResult Database::selectEntities(const std::string & loc)
     return runSimpleSelectQuery(query);
 }
 
-int Database::dropEntity(long id)
+/// \brief Select every entity, for restoring the whole world at once.
+///
+/// The result is fetched in binary format, so the location data doesn't
+/// have to be escaped and unescaped. The other columns are read as text.
+const DatabaseResult Database::selectAllEntities()
 {
-    std::string query = compose("DELETE FROM properties WHERE id = '%1'", id);
-
-    scheduleCommand(query);
-
-    query = compose("DELETE FROM entities WHERE id = %1", id);
-
-    scheduleCommand(query);
-
-    query = compose("DELETE FROM thoughts WHERE id = %1", id);
+    return runSimpleSelectQuery("SELECT id::text AS id, loc::text AS loc,"
+                                " type, seq::text AS seq, location"
+                                " FROM entities", true);
+}
 
-    scheduleCommand(query);
+int Database::dropEntity(long id)
+{
+    return dropEntities({id});
+}
 
+int Database::dropEntities(const std::vector<long> & ids)
+{
+    for (size_t i = 0; i < ids.size(); i += ROWS_PER_COMMAND) {
+        size_t end = std::min(ids.size(), i + ROWS_PER_COMMAND);
+        ArrayParam param(INT4_OID);
+        for (size_t j = i; j < end; ++j) {
+            param.addInt(ids[j]);
+        }
+        scheduleStatement("drop_entities", {param.get()});
+    }
     return 0;
 }
 
@@ -1089,7 +1463,8 @@ int Database::registerPropertyTable()
                                 "id integer REFERENCES entities "
                                 "ON DELETE CASCADE, "
                                 "name varchar(%1), "
-                                "value text)", consts::id_len);
+                                "value %2)", consts::id_len,
+                                worldDataType());
     if (runCommandQuery(query) != 0) {
         reportError();
         return -1;
@@ -1105,19 +1480,11 @@ int Database::registerPropertyTable()
 int Database::insertProperties(const std::string & id,
                                const KeyValues & tuples)
 {
-    int first = 1;
-    std::string query("INSERT INTO properties VALUES ");
-    KeyValues::const_iterator I = tuples.begin();
-    KeyValues::const_iterator Iend = tuples.end();
-    for (; I != Iend; ++I) {
-        if (first) {
-            query += compose("(%1, '%2', '%3')", id, I->first, I->second);
-            first = 0;
-        } else {
-            query += compose(", (%1, '%2', '%3')", id, I->first, I->second);
-        }
+    std::vector<PropertyRow> rows;
+    for (auto& tuple : tuples) {
+        rows.push_back(PropertyRow{id, tuple.first, tuple.second});
     }
-    return scheduleCommand(query);
+    return insertProperties(rows);
 }
 
 const DatabaseResult Database::selectProperties(const std::string & id)
@@ -1131,17 +1498,51 @@ const DatabaseResult Database::selectProperties(const std::string & id)
     return runSimpleSelectQuery(query);
 }
 
+/// \brief Select every property, for restoring the whole world at once.
+///
+/// The result is fetched in binary format, like selectAllEntities().
+const DatabaseResult Database::selectAllProperties()
+{
+    return runSimpleSelectQuery("SELECT id::text AS id, name, value"
+                                " FROM properties", true);
+}
+
 int Database::updateProperties(const std::string & id,
                                const KeyValues & tuples)
 {
-    KeyValues::const_iterator I = tuples.begin();
-    KeyValues::const_iterator Iend = tuples.end();
-    for (; I != Iend; ++I) {
-        std::string query = compose("UPDATE properties SET value = '%3' WHERE"
-                                    " id=%1 AND name='%2'",
-                                    id, I->first, I->second);
-        scheduleCommand(query);
+    std::vector<PropertyRow> rows;
+    for (auto& tuple : tuples) {
+        rows.push_back(PropertyRow{id, tuple.first, tuple.second});
+    }
+    return updateProperties(rows);
+}
+
+/// \brief Schedule a prepared statement for each chunk of property rows.
+void Database::scheduleProperties(const char * statement,
+                                  const std::vector<PropertyRow> & rows)
+{
+    for (size_t i = 0; i < rows.size(); i += ROWS_PER_COMMAND) {
+        size_t end = std::min(rows.size(), i + ROWS_PER_COMMAND);
+        ArrayParam ids(INT4_OID), names(TEXT_OID), values(worldDataOid());
+        for (size_t j = i; j < end; ++j) {
+            const PropertyRow & row = rows[j];
+            ids.addId(row.id);
+            names.add(row.name);
+            values.add(row.value);
+        }
+        scheduleStatement(statement, {ids.get(), names.get(), values.get()});
     }
+}
+
+int Database::insertProperties(const std::vector<PropertyRow> & rows)
+{
+    scheduleProperties("insert_properties", rows);
+    return 0;
+}
+
+int Database::updateProperties(const std::vector<PropertyRow> & rows)
+{
+    scheduleProperties("update_properties", rows);
     return 0;
 }
 
@@ -1163,13 +1564,27 @@ int Database::registerThoughtsTable()
     } else {
         allTables.insert("thoughts");
         debug(std::cout << "Table exists" << std::endl << std::flush;);
+        // Tables from before thoughts were stored one at a time have no
+        // thought ids. Rows without one are replaced when next stored.
+        status = PQsendQuery(m_connection, "SELECT tid FROM thoughts LIMIT 0");
+        if (!status) {
+            log(ERROR, "registerThoughtsTable(): Database query error.");
+            reportError();
+            return -1;
+        }
+        if (!tuplesOk() &&
+            runCommandQuery("ALTER TABLE thoughts ADD COLUMN tid text") != 0) {
+            reportError();
+            return -1;
+        }
         return 0;
     }
     allTables.insert("properties");
-    std::string query = "CREATE TABLE thoughts ("
-                        "id integer REFERENCES entities "
-                        "ON DELETE CASCADE, "
-                        "thought text)";
+    std::string query = compose("CREATE TABLE thoughts ("
+                                "id integer REFERENCES entities "
+                                "ON DELETE CASCADE, "
+                                "tid text, "
+                                "thought %1)", worldDataType());
     if (runCommandQuery(query) != 0) {
         reportError();
         return -1;
@@ -1179,7 +1594,7 @@ int Database::registerThoughtsTable()
 
 const DatabaseResult Database::selectThoughts(const std::string & loc)
 {
-    std::string query = compose("SELECT thought FROM thoughts"
+    std::string query = compose("SELECT tid, thought FROM thoughts"
                                 " WHERE id = %1", loc);
 
     debug(std::cout << "Selecting on id = " << loc << " ... "
@@ -1188,17 +1603,150 @@ const DatabaseResult Database::selectThoughts(const std::string & loc)
     return runSimpleSelectQuery(query);
 }
 
+/// \brief Select every thought, for restoring the whole world at once.
+///
+/// The result is fetched in binary format, like selectAllEntities().
+const DatabaseResult Database::selectAllThoughts()
+{
+    return runSimpleSelectQuery("SELECT id::text AS id, tid, thought"
+                                " FROM thoughts", true);
+}
+
+Oid Database::worldDataOid() const
+{
+    return m_schemaVersion >= SCHEMA_BINARY ? BYTEA_OID : TEXT_OID;
+}
+
+int Database::prepareStatements()
+{
+    assert(m_connection != 0);
+
+    clearPendingQuery();
+
+    const char * data_type = worldDataType();
+    const std::pair<const char *, std::string> statements[] = {
+        { "insert_entities",
+          compose("INSERT INTO entities (id, loc, type, seq, location)"
+                  " SELECT * FROM unnest($1::integer[], $2::integer[],"
+                  " $3::text[], $4::integer[], $5::%1[])", data_type) },
+        { "update_entities",
+          compose("UPDATE entities AS e SET seq = v.seq,"
+                  " location = v.location, loc = COALESCE(v.loc, e.loc)"
+                  " FROM unnest($1::integer[], $2::integer[], $3::%1[],"
+                  " $4::integer[]) AS v(id, seq, location, loc)"
+                  " WHERE e.id = v.id", data_type) },
+        { "drop_entities",
+          "WITH p AS (DELETE FROM properties WHERE id = ANY($1::integer[])),"
+          " t AS (DELETE FROM thoughts WHERE id = ANY($1::integer[]))"
+          " DELETE FROM entities WHERE id = ANY($1::integer[])" },
+        { "insert_properties",
+          compose("INSERT INTO properties (id, name, value)"
+                  " SELECT * FROM unnest($1::integer[], $2::text[],"
+                  " $3::%1[])", data_type) },
+        { "update_properties",
+          compose("UPDATE properties AS p SET value = v.value"
+                  " FROM unnest($1::integer[], $2::text[], $3::%1[])"
+                  " AS v(id, name, value)"
+                  " WHERE p.id = v.id AND p.name = v.name", data_type) },
+        // The deletes don't see the rows being inserted, as all are part
+        // of the same statement. Thoughts of entities which have been
+        // dropped are left out, rather than failing the whole statement.
+        { "write_thoughts",
+          compose("WITH r AS (DELETE FROM thoughts"
+                  " WHERE id = ANY($1::integer[])),"
+                  " d AS (DELETE FROM thoughts AS t"
+                  " USING unnest($2::integer[], $3::text[]) AS v(id, tid)"
+                  " WHERE t.id = v.id AND t.tid = v.tid)"
+                  " INSERT INTO thoughts (id, tid, thought)"
+                  " SELECT * FROM unnest($4::integer[], $5::text[], $6::%1[])"
+                  " AS v(id, tid, thought)"
+                  " WHERE EXISTS (SELECT 1 FROM entities AS e"
+                  " WHERE e.id = v.id)", data_type) },
+    };
+
+    for (auto& statement : statements) {
+        PGresult * res = PQprepare(m_connection, statement.first,
+                                   statement.second.c_str(), 0, NULL);
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            log(ERROR, compose("Failed to prepare database statement %1.",
+                               statement.first));
+            reportError();
+            PQclear(res);
+            return -1;
+        }
+        PQclear(res);
+    }
+    m_statementsPrepared = true;
+    return 0;
+}
+
 int Database::replaceThoughts(const std::string & id,
-                         const std::vector<std::string>& thoughts)
+                              const std::vector<ThoughtRow> & thoughts)
 {
+    return writeThoughts({ThoughtWrite{id, true, thoughts, {}}});
+}
 
-    std::string deleteQuery = compose("DELETE FROM thoughts WHERE id=%1", id);
-    scheduleCommand(deleteQuery);
+int Database::updateThoughts(const std::string & id,
+                             const std::vector<ThoughtRow> & thoughts,
+                             const std::vector<std::string> & deleted)
+{
+    return writeThoughts({ThoughtWrite{id, false, thoughts, deleted}});
+}
 
-    for (auto& thought : thoughts) {
-        std::string insertQuery = compose("INSERT INTO thoughts (id, thought)"
-                                          " VALUES (%1, '%2')", id, thought);
-        scheduleCommand(insertQuery);
+int Database::writeThoughts(const std::vector<ThoughtWrite> & changes)
+{
+    size_t i = 0;
+    while (i < changes.size()) {
+        ArrayParam replaced(INT4_OID), deletedIds(INT4_OID),
+                   deletedTids(TEXT_OID), ids(INT4_OID), tids(TEXT_OID),
+                   values(worldDataOid());
+        std::set<std::string> entities;
+        size_t rows = 0;
+        for (; i < changes.size() && rows < ROWS_PER_COMMAND; ++i) {
+            const ThoughtWrite & entity = changes[i];
+            if (!entity.replace && entity.thoughts.empty() &&
+                entity.deleted.empty()) {
+                continue;
+            }
+            // The deletes of a statement don't see what it inserts, so
+            // further changes to an entity go in the next one.
+            if (!entities.insert(entity.id).second) {
+                break;
+            }
+            if (entity.replace) {
+                replaced.addId(entity.id);
+            } else {
+                // Changed thoughts are deleted along with the deleted ones,
+                // and inserted anew.
+                for (auto& tid : entity.deleted) {
+                    deletedIds.addId(entity.id);
+                    deletedTids.add(tid);
+                }
+                for (auto& thought : entity.thoughts) {
+                    if (!thought.tid.empty()) {
+                        deletedIds.addId(entity.id);
+                        deletedTids.add(thought.tid);
+                    }
+                }
+            }
+            // Thoughts without an id get a null one.
+            for (auto& thought : entity.thoughts) {
+                ids.addId(entity.id);
+                if (thought.tid.empty()) {
+                    tids.addNull();
+                } else {
+                    tids.add(thought.tid);
+                }
+                values.add(thought.thought);
+                ++rows;
+            }
+        }
+        if (!entities.empty()) {
+            scheduleStatement("write_thoughts",
+                              {replaced.get(), deletedIds.get(),
+                               deletedTids.get(), ids.get(), tids.get(),
+                               values.get()});
+        }
     }
     return 0;
 }
@@ -1440,26 +1988,56 @@ int Database::removeArrayRow(const std::string & name,
 
 // General functions for handling queries at the low level.
 
-void Database::queryResult(ExecStatusType status)
+/// \brief Send a queued prepared statement, with its parameters in the
+/// binary format.
+static int sendStatement(PGconn * connection, const DatabaseQuery & q)
+{
+    std::vector<const char *> values;
+    std::vector<int> lengths;
+    std::vector<int> formats(q.params.size(), 1);
+    for (auto& param : q.params) {
+        values.push_back(param.data());
+        lengths.push_back(param.size());
+    }
+    return PQsendQueryPrepared(connection, q.statement.c_str(),
+                               q.params.size(), values.data(),
+                               lengths.data(), formats.data(), 0);
+}
+
+void Database::queryResult(PGresult * res)
 {
     if (!m_queryInProgress || pendingQueries.empty()) {
         log(ERROR, "Got database result when no query was pending.");
         return;
     }
-    DatabaseQuery & q = pendingQueries.front();
-    if (q.second == PGRES_EMPTY_QUERY) {
+    ExecStatusType status = PQresultStatus(res);
+#ifdef LIBPQ_HAS_PIPELINING
+    if (status == PGRES_PIPELINE_SYNC) {
+        m_pipelineSynced = true;
+        return;
+    }
+#endif
+    if (m_resultsReceived >= m_queriesInFlight) {
         log(ERROR, "Got database result which is already done.");
         return;
     }
-    if (q.second == status) {
+    // Commands sent together report their results in order.
+    DatabaseQuery & q = pendingQueries[m_resultsReceived++];
+    if (q.handler) {
+        q.handler(res);
+    }
+    if (q.status == status) {
         debug(std::cout << "Query status ok" << std::endl << std::flush;);
-        // Mark this query as done
-        q.second = PGRES_EMPTY_QUERY;
+#ifdef LIBPQ_HAS_PIPELINING
+    } else if (status == PGRES_PIPELINE_ABORTED) {
+        // Skipped because an earlier statement of the pipeline failed.
+        m_batchFailed = true;
+#endif
     } else {
         log(ERROR, "Database error from async query");
-        std::cerr << "Query error in : " << q.first << std::endl << std::flush;
+        std::cerr << "Query error in : " << q.query << std::endl << std::flush;
         reportError();
-        q.second = PGRES_EMPTY_QUERY;
+        m_batchFailed = true;
     }
 }
 
@@ -1469,15 +2047,71 @@ void Database::queryComplete()
         log(ERROR, "Got database query complete when no query was pending");
         return;
     }
-    DatabaseQuery & q = pendingQueries.front();
-    if (q.second != PGRES_EMPTY_QUERY) {
-        abort();
+#ifdef LIBPQ_HAS_PIPELINING
+    if (m_pipelined) {
+        // The results of each command in a pipeline end separately. The
+        // batch is only complete at the sync point which follows them.
+        if (!m_pipelineSynced) {
+            return;
+        }
+        PQexitPipelineMode(m_connection);
+        m_pipelined = false;
+        m_pipelineSynced = false;
+    }
+#endif
+    if (m_resultsReceived != m_queriesInFlight && !m_batchFailed) {
         log(ERROR, "Got database query complete when query was not done");
-        return;
+        m_batchFailed = true;
     }
     debug(std::cout << "Query complete" << std::endl << std::flush;);
-    pendingQueries.pop_front();
+    m_batchLatency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - m_batchStart).count();
+    m_batchSize = m_queriesInFlight;
+    if (m_batchFailed && m_retryOnFailure) {
+        // Commands sent together run in a single transaction, so a failure
+        // rolls back all of them. They are retried one by one, so that
+        // only the failing command is lost.
+        log(WARNING, compose("Retrying %1 database commands one by one.",
+                             m_queriesInFlight));
+        for (size_t i = 0; i < m_queriesInFlight; ++i) {
+            pendingQueries[i].standalone = true;
+        }
+    } else {
+        pendingQueries.erase(pendingQueries.begin(),
+                             pendingQueries.begin() + m_queriesInFlight);
+    }
+    m_queriesInFlight = 0;
+    m_resultsReceived = 0;
+    m_batchFailed = false;
+    m_retryOnFailure = false;
     m_queryInProgress = false;
+
+    std::vector<std::function<void()>> completed;
+    completed.swap(m_completedSelects);
+    for (auto& handler : completed) {
+        handler();
+    }
+}
+
+/// \brief Number of commands at the front of the queue to send together.
+///
+/// Prepared statements are sent together in pipeline mode, and other
+/// commands in a single query, so the two aren't mixed.
+size_t Database::nextBatchSize() const
+{
+    const DatabaseQuery & front = pendingQueries.front();
+    size_t count = 1;
+    if (front.standalone) {
+        return count;
+    }
+    while (count < pendingQueries.size() && count < m_batchLimit) {
+        const DatabaseQuery & q = pendingQueries[count];
+        if (q.standalone || q.statement.empty() != front.statement.empty()) {
+            break;
+        }
+        ++count;
+    }
+    return count;
 }
 
 int Database::launchNewQuery()
@@ -1496,24 +2130,93 @@ int Database::launchNewQuery()
     }
     debug(std::cout << pendingQueries.size() << " queries pending"
                     << std::endl << std::flush;);
-    DatabaseQuery & q = pendingQueries.front();
-    debug(std::cout << "Launching async query: " << q.first
-                    << std::endl << std::flush;);
-    int status = PQsendQuery(m_connection, q.first.c_str());
+    size_t count = nextBatchSize();
+    int status;
+    const DatabaseQuery & front = pendingQueries.front();
+    if (count == 1 && !front.statement.empty()) {
+        debug(std::cout << "Launching async prepared statement: "
+                        << front.statement << std::endl << std::flush;);
+        status = sendStatement(m_connection, front);
+    } else if (count == 1) {
+        debug(std::cout << "Launching async query: " << front.query
+                        << std::endl << std::flush;);
+        status = PQsendQuery(m_connection, front.query.c_str());
+#ifdef LIBPQ_HAS_PIPELINING
+    } else if (!front.statement.empty()) {
+        // Like commands sent in one query, the statements of a pipeline
+        // run in a single transaction.
+        debug(std::cout << "Launching " << count << " async prepared "
+                        << "statements" << std::endl << std::flush;);
+        status = PQenterPipelineMode(m_connection);
+        for (size_t i = 0; status && i < count; ++i) {
+            status = sendStatement(m_connection, pendingQueries[i]);
+        }
+        if (status) {
+            status = PQpipelineSync(m_connection);
+        }
+        if (status) {
+            m_pipelined = true;
+            m_pipelineSynced = false;
+        } else {
+            PQexitPipelineMode(m_connection);
+        }
+#endif
+    } else {
+        std::string batch;
+        for (size_t i = 0; i < count; ++i) {
+            batch += pendingQueries[i].query;
+            batch += ";\n";
+        }
+        debug(std::cout << "Launching " << count << " async queries: "
+                        << batch << std::endl << std::flush;);
+        status = PQsendQuery(m_connection, batch.c_str());
+    }
     if (!status) {
         log(ERROR, "Database query error when launching.");
         reportError();
         return -1;
     } else {
         m_queryInProgress = true;
+        m_queriesInFlight = count;
+        m_resultsReceived = 0;
+        m_batchFailed = false;
+        m_retryOnFailure = count > 1;
+        m_batchStart = std::chrono::steady_clock::now();
         PQflush(m_connection);
         return 0;
     }
 }
 
-int Database::scheduleCommand(const std::string & query)
+void Database::scheduleSelect(const std::string & query,
+                              const ResultHandler & handler)
+{
+    if (m_connection == 0) {
+        handler(DatabaseResult(0));
+        return;
+    }
+    // The result is kept until the whole command is complete, as the
+    // handler may want to use the connection.
+    pendingQueries.push_back(DatabaseQuery{query, PGRES_TUPLES_OK, true,
+            [this, handler](PGresult * res) {
+                PGresult * copy = 0;
+                if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+                    copy = PQcopyResult(res, PG_COPYRES_ATTRS |
+                                             PG_COPYRES_TUPLES);
+                }
+                DatabaseResult result(copy);
+                m_completedSelects.push_back([handler, result]() {
+                    handler(result);
+                });
+            }});
+    if (!m_queryInProgress) {
+        launchNewQuery();
+    }
+}
+
+int Database::scheduleCommand(const std::string & query, bool standalone)
 {
-    pendingQueries.push_back(std::make_pair(query, PGRES_COMMAND_OK));
+    pendingQueries.push_back(DatabaseQuery{query, PGRES_COMMAND_OK,
+                                           standalone});
     if (!m_queryInProgress) {
         debug(std::cout << "Query: " << query << " launched"
                         << std::endl << std::flush;);
@@ -1525,24 +2228,43 @@ int Database::scheduleCommand(const std::string & query)
     }
 }
 
-int Database::clearPendingQuery()
+int Database::scheduleStatement(const std::string & statement,
+                                std::vector<std::string> params)
 {
+    // Each statement writes many rows. Several are sent in one round trip
+    // if libpq supports pipeline mode.
+    pendingQueries.push_back(DatabaseQuery{"EXECUTE " + statement,
+                                           PGRES_COMMAND_OK,
+                                           !STATEMENTS_BATCHED, nullptr,
+                                           statement, std::move(params)});
     if (!m_queryInProgress) {
-        return 0;
+        return launchNewQuery();
     }
+    return 0;
+}
 
-    assert(!pendingQueries.empty());
-    debug(std::cout << "Clearing a pending query" << std::endl << std::flush;);
+int Database::clearPendingQuery()
+{
+    bool lost = false;
+    // The handlers of completed selects may launch another query.
+    while (m_queryInProgress) {
+        assert(pendingQueries.size() >= m_queriesInFlight);
+        debug(std::cout << "Clearing a pending query" << std::endl << std::flush;);
 
-    DatabaseQuery & q = pendingQueries.front();
-    if (q.second == PGRES_COMMAND_OK) {
-        m_queryInProgress = false;
-        pendingQueries.pop_front();
-        return commandOk();
-    } else {
-        log(ERROR, "Pending query wants unknown status");
-        return -1;
+        // Some of the results might already have been read by the socket.
+        PGresult * res;
+        while ((res = PQgetResult(m_connection)) != NULL) {
+            queryResult(res);
+            PQclear(res);
+        }
+        // Commands which are going to be retried are not lost.
+        if ((m_batchFailed || m_resultsReceived != m_queriesInFlight) &&
+            !m_retryOnFailure) {
+            lost = true;
+        }
+        queryComplete();
     }
+    return lost ? -1 : 0;
 }
 
 int Database::runMaintainance(int command)
@@ -1552,7 +2274,7 @@ int Database::runMaintainance(int command)
         std::string query("REINDEX TABLE ");
         TableSet::const_iterator Iend = allTables.end();
         for (TableSet::const_iterator I = allTables.begin(); I != Iend; ++I) {
-            scheduleCommand(query + *I);
+            scheduleCommand(query + *I, true);
         }
     }
     if ((command & MAINTAIN_VACUUM) == MAINTAIN_VACUUM) {
@@ -1565,7 +2287,7 @@ int Database::runMaintainance(int command)
         }
         TableSet::const_iterator Iend = allTables.end();
         for(TableSet::const_iterator I = allTables.begin(); I != Iend; ++I) {
-            scheduleCommand(query + *I);
+            scheduleCommand(query + *I, true);
         }
     }
     return 0;
@@ -27,8 +27,13 @@
 
 #include <libpq-fe.h>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <set>
 #include <memory>
+#include <vector>
 
 /// \brief Class to handle decoding Atlas encoded database records
 class Decoder : public Atlas::Message::DecoderBase {
@@ -82,7 +87,20 @@ class DatabaseResult;
 
 typedef std::vector<std::string> StringVector;
 typedef std::set<std::string> TableSet;
-typedef std::pair<std::string, ExecStatusType> DatabaseQuery;
+
+/// \brief A command queued to be run asynchronously
+struct DatabaseQuery {
+    std::string query;
+    ExecStatusType status;
+    /// \brief The command can't be sent together with other commands.
+    bool standalone;
+    /// \brief Called with the result of the command, if set.
+    std::function<void(PGresult *)> handler;
+    /// \brief Name of the prepared statement to execute, if any.
+    std::string statement;
+    /// \brief Parameters of the prepared statement, in the binary format.
+    std::vector<std::string> params;
+};
 typedef std::deque<DatabaseQuery> QueryQue;
 
 /// \brief Class to provide interface to Database connection
@@ -99,13 +117,76 @@ class Database {
     QueryQue pendingQueries;
     bool m_queryInProgress;
 
+    /// \brief Number of commands at the front of the queue which have been
+    /// sent together, and are awaiting results.
+    size_t m_queriesInFlight;
+    /// \brief Number of results received for the commands in flight.
+    size_t m_resultsReceived;
+    /// \brief One of the commands in flight has failed.
+    bool m_batchFailed;
+    /// \brief Commands in flight should be retried one by one on failure.
+    bool m_retryOnFailure;
+    /// \brief The commands in flight were sent in pipeline mode.
+    bool m_pipelined;
+    /// \brief The end of the pipeline in flight has been reached.
+    bool m_pipelineSynced;
+    /// \brief Maximum number of commands to send together.
+    size_t m_batchLimit;
+    /// \brief When the commands in flight were sent.
+    std::chrono::steady_clock::time_point m_batchStart;
+    /// \brief Round trip time of the last batch of commands, in microseconds.
+    int m_batchLatency;
+    /// \brief Number of commands in the last batch.
+    int m_batchSize;
+
+    /// \brief Entity ids reserved from the sequence, not yet handed out.
+    std::deque<long> m_reservedIds;
+    /// \brief Number of ids reserved at a time.
+    size_t m_idBlockSize;
+    /// \brief A request for more ids has been queued.
+    bool m_idRequestPending;
+
+    /// \brief Version of the schema of the entity, property and thoughts
+    /// tables, which decides how their data is encoded.
+    int m_schemaVersion;
+
+    /// \brief The write statements have been prepared, and are to be
+    /// prepared again when reconnecting.
+    bool m_statementsPrepared;
+
+    /// \brief Handlers of selects which have completed, waiting to be
+    /// called once the connection is free.
+    std::vector<std::function<void()>> m_completedSelects;
+
+    Oid worldDataOid() const;
+
+    size_t nextBatchSize() const;
+
+    std::string idRequestQuery() const;
+    void requestIds();
+    int reserveIds();
+    /// \brief Get a block of ids from the sequence, waiting for them.
+    virtual int fetchIds();
+    void addReservedIds(PGresult * res);
+
     Decoder m_d;
     ObjectDecoder m_od;
 
     PGconn * m_connection;
 
     Database();
-    ~Database();
+    virtual ~Database();
+
+    /// \brief Decode a value which isn't escaped.
+    int decodeRawMessage(const char * data, size_t size,
+                         Atlas::Message::MapType &);
+
+    /// \brief Encode a message as XML, without escaping it.
+    void serialiseObject(const Atlas::Message::MapType &, std::string &);
+
+    /// \brief Queue a select, and call a handler with its result.
+    void scheduleSelect(const std::string & query,
+                        const std::function<void(const DatabaseResult &)> & handler);
 
     // bool command(const std::string & cmd);
 
@@ -118,10 +199,20 @@ class Database {
     static const int MAINTAIN_VACUUM_ANALYZE = 0x0002;
     static const int MAINTAIN_REINDEX = 0x0200;
 
+    /// \brief The world tables store XML in text columns.
+    static const int SCHEMA_TEXT = 1;
+    /// \brief The world tables store the compact binary encoding in bytea
+    /// columns.
+    static const int SCHEMA_BINARY = 2;
+
     typedef enum { OneToMany, ManyToMany, ManyToOne, OneToOne } RelationType;
 
     typedef std::map<std::string, std::string> KeyValues;
 
+    /// \brief Called with the result of an asynchronous select, which is
+    /// in error if the select failed.
+    typedef std::function<void(const DatabaseResult &)> ResultHandler;
+
     PGconn * getConnection() const { return m_connection; }
     const std::string & rule() const { return m_rule_db; }
     bool queryInProgress() const { return m_queryInProgress; }
@@ -130,90 +221,205 @@ class Database {
         return pendingQueries.size();
     }
 
+    /// \brief Round trip time of the last batch of commands, in microseconds.
+    int batchLatency() const { return m_batchLatency; }
+
+    /// \brief Number of commands sent in the last batch.
+    int batchSize() const { return m_batchSize; }
+
+    /// \brief Set the maximum number of queued commands sent in one round
+    /// trip to the database.
+    void setBatchLimit(size_t limit) { m_batchLimit = std::max<size_t>(1, limit); }
+
     int decodeObject(const std::string & data,
                      Atlas::Objects::Root &);
 
     int decodeMessage(const std::string & data,
                       Atlas::Message::MapType &);
+    /// \brief Decode a value read from the database.
+    ///
+    /// Values fetched in binary format may contain null bytes, so the size
+    /// has to be given. Escaped bytea values are unescaped first.
+    int decodeMessage(const char * data, size_t size,
+                      Atlas::Message::MapType &);
     int encodeObject(const Atlas::Message::MapType &,
                      std::string &);
-    int putObject(const std::string & table,
-                  const std::string &,
-                  const Atlas::Message::MapType &,
-                  const StringVector & = StringVector());
+    /// \brief Encode data for the entities, properties and thoughts tables,
+    /// in the encoding used by the schema.
+    ///
+    /// The data is not escaped, as it's passed to prepared statements.
+    int encodeWorldObject(const Atlas::Message::MapType &,
+                          std::string &);
+    virtual int putObject(const std::string & table,
+                          const std::string &,
+                          const Atlas::Message::MapType &,
+                          const StringVector & = StringVector());
     int getObject(const std::string & table,
                   const std::string & key,
                   Atlas::Message::MapType &);
-    int updateObject(const std::string & table,
-                     const std::string & key,
-                     const Atlas::Message::MapType&);
+    virtual int updateObject(const std::string & table,
+                             const std::string & key,
+                             const Atlas::Message::MapType&);
     int delObject(const std::string &, const std::string & key);
-    bool hasKey(const std::string &, const std::string & key);
-    int getTable(const std::string & table,
-                  std::map<std::string, Atlas::Objects::Root> &);
-    int clearTable(const std::string & table);
+    virtual bool hasKey(const std::string &, const std::string & key);
+    virtual int getTable(const std::string & table,
+                         std::map<std::string, Atlas::Objects::Root> &);
+    virtual int clearTable(const std::string & table);
 
     void reportError();
 
-    int connect(const std::string & context, std::string & error_msg);
+    virtual int connect(const std::string & context, std::string & error_msg);
 
     static Database * instance();
     static void cleanup();
 
-    int initConnection();
-    int createInstanceDatabase();
-    int initRule(bool createTables = false);
+    virtual int initConnection();
+    virtual int createInstanceDatabase();
+    virtual int initRule(bool createTables = false);
 
-    void shutdownConnection();
+    virtual void shutdownConnection();
 
-    const DatabaseResult runSimpleSelectQuery(const std::string & query);
+    /// \brief Run a select, waiting for the result.
+    ///
+    /// @param binary Fetch the result in binary format, which leaves bytea
+    /// columns unescaped. Columns which aren't text or bytea have to be
+    /// cast to text by the query.
+    const DatabaseResult runSimpleSelectQuery(const std::string & query,
+                                              bool binary = false);
     int runCommandQuery(const std::string & query);
 
     // Interface for relations between tables.
 
-    int registerRelation(std::string & tablename,
-                         const std::string & sourcetable,
-                         const std::string & targettable,
-                         RelationType kind = OneToMany);
-    const DatabaseResult selectRelation(const std::string & name,
-                                        const std::string & id);
-    int createRelationRow(const std::string & name,
-                          const std::string & id,
-                          const std::string & other);
-    int removeRelationRow(const std::string & name,
-                          const std::string & id);
-    int removeRelationRowByOther(const std::string & name,
-                                 const std::string & other);
+    virtual int registerRelation(std::string & tablename,
+                                 const std::string & sourcetable,
+                                 const std::string & targettable,
+                                 RelationType kind = OneToMany);
+    virtual const DatabaseResult selectRelation(const std::string & name,
+                                                const std::string & id);
+    /// \brief Select the targets of a relation without waiting for the
+    /// result.
+    virtual void selectRelationAsync(const std::string & name,
+                                     const std::string & id,
+                                     const ResultHandler & handler);
+    virtual int createRelationRow(const std::string & name,
+                                  const std::string & id,
+                                  const std::string & other);
+    virtual int removeRelationRow(const std::string & name,
+                                  const std::string & id);
+    virtual int removeRelationRowByOther(const std::string & name,
+                                         const std::string & other);
 
     // Interface for simple tables that mainly just store Atlasish data.
 
-    int registerSimpleTable(const std::string & name,
-                            const Atlas::Message::MapType & row);
+    virtual int registerSimpleTable(const std::string & name,
+                                    const Atlas::Message::MapType & row);
     const DatabaseResult selectSimpleRow(const std::string & name,
                                          const std::string & id);
-    const DatabaseResult selectSimpleRowBy(const std::string & name,
-                                           const std::string & column,
-                                           const std::string & value);
-    int createSimpleRow(const std::string & name,
-                        const std::string & id,
-                        const std::string & columns,
-                        const std::string & values);
-    int updateSimpleRow(const std::string & name,
-                        const std::string & key,
-                        const std::string & value,
-                        const std::string & columns);
+    virtual const DatabaseResult selectSimpleRowBy(const std::string & name,
+                                                   const std::string & column,
+                                                   const std::string & value);
+    /// \brief Select rows of a simple table without waiting for the
+    /// result.
+    ///
+    /// The handler is called from the event loop once the result has
+    /// arrived, after the connection has been freed for other queries.
+    virtual void selectSimpleRowByAsync(const std::string & name,
+                                        const std::string & column,
+                                        const std::string & value,
+                                        const ResultHandler & handler);
+    virtual int createSimpleRow(const std::string & name,
+                                const std::string & id,
+                                const std::string & columns,
+                                const std::string & values);
+    virtual int updateSimpleRow(const std::string & name,
+                                const std::string & key,
+                                const std::string & value,
+                                const std::string & columns);
+
+    // Interface for the version of the schema.
+
+    virtual int registerSchemaVersion();
+    int setSchemaVersion(int version);
+    int schemaVersion() const { return m_schemaVersion; }
+
+    /// \brief The SQL type of columns holding encoded world data.
+    const char * worldDataType() const {
+        return m_schemaVersion >= SCHEMA_BINARY ? "bytea" : "text";
+    }
 
     // Interface for the ID generation sequence.
 
-    int registerEntityIdGenerator();
+    virtual int registerEntityIdGenerator();
 
     /// Creates a new unique id for the database.
-    /// Note that this method will access the database, so it's a fairly expensive method.
-    long newId(std::string & id);
+    /// Ids are reserved in blocks, and more are requested asynchronously
+    /// when few are left, so this only waits for the database when ids are
+    /// used faster than they are reserved.
+    virtual long newId(std::string & id);
+
+    /// \brief Set the number of ids reserved from the database at a time.
+    void setIdBlockSize(size_t size) { m_idBlockSize = std::max<size_t>(1, size); }
 
     // Interface for Entity and Property tables.
 
-    int registerEntityTable(const std::map<std::string, int> & chunks);
+    /// \brief Row of the entities table.
+    struct EntityRow {
+        std::string id;
+        /// \brief Id of the location entity. Left out of updates when empty.
+        std::string loc;
+        std::string type;
+        int seq;
+        std::string location;
+    };
+
+    /// \brief Row of the properties table.
+    struct PropertyRow {
+        std::string id;
+        std::string name;
+        std::string value;
+    };
+
+    /// \brief Row of the thoughts table.
+    struct ThoughtRow {
+        /// \brief Id of the thought, empty for thoughts without one.
+        std::string tid;
+        std::string thought;
+    };
+
+    /// \brief Changes to the stored thoughts of an entity.
+    struct ThoughtWrite {
+        std::string id;
+        /// \brief Whether all the stored thoughts are replaced, rather than
+        /// only those changed or deleted.
+        bool replace;
+        /// \brief The thoughts added or changed.
+        ///
+        /// Thoughts with an id replace any stored thought with the same id,
+        /// and thoughts without one are added.
+        std::vector<ThoughtRow> thoughts;
+        /// \brief The ids of the thoughts deleted, when not replacing.
+        std::vector<std::string> deleted;
+    };
+
+    /// \brief Maximum number of rows written by one command.
+    static const size_t ROWS_PER_COMMAND = 2048;
+
+  protected:
+    void scheduleProperties(const char * statement,
+                            const std::vector<PropertyRow> & rows);
+
+  public:
+    /// \brief Prepare the statements used to write to the entities,
+    /// properties and thoughts tables. Must be called after the tables
+    /// have been registered.
+    ///
+    /// Prepared statements only last as long as the connection, so once
+    /// this has succeeded they are prepared again on every reconnect.
+    virtual int prepareStatements();
+
+    virtual int registerEntityTable(const std::map<std::string, int> & chunks);
+    virtual int insertEntities(const std::vector<EntityRow> & rows);
+    virtual int updateEntities(const std::vector<EntityRow> & rows);
     int insertEntity(const std::string & id,
                      const std::string & loc,
                      const std::string & type,
@@ -226,28 +432,49 @@ class Database {
                      int seq,
                      const std::string & location_data,
                      const std::string & location_entity_id);
-    const DatabaseResult selectEntities(const std::string & loc);
+    virtual const DatabaseResult selectEntities(const std::string & loc);
+    virtual const DatabaseResult selectAllEntities();
     int dropEntity(long id);
+    virtual int dropEntities(const std::vector<long> & ids);
 
-    int registerPropertyTable();
+    virtual int registerPropertyTable();
     int insertProperties(const std::string & id,
                          const KeyValues & tuples);
-    const DatabaseResult selectProperties(const std::string & loc);
+    virtual const DatabaseResult selectProperties(const std::string & loc);
+    virtual const DatabaseResult selectAllProperties();
     int updateProperties(const std::string & id,
                          const KeyValues & tuples);
+    virtual int insertProperties(const std::vector<PropertyRow> & rows);
+    virtual int updateProperties(const std::vector<PropertyRow> & rows);
 
-    int registerThoughtsTable();
-    const DatabaseResult selectThoughts(const std::string & loc);
+    virtual int registerThoughtsTable();
+    virtual const DatabaseResult selectThoughts(const std::string & loc);
+    virtual const DatabaseResult selectAllThoughts();
     int replaceThoughts(const std::string & id,
-                         const std::vector<std::string>& thoughts);
+                        const std::vector<ThoughtRow> & thoughts);
+    /// \brief Store changes to the thoughts of an entity.
+    ///
+    /// Thoughts with an id replace any stored thought with the same id,
+    /// and thoughts without one are added.
+    /// @param thoughts The thoughts added or changed.
+    /// @param deleted The ids of the thoughts deleted.
+    int updateThoughts(const std::string & id,
+                       const std::vector<ThoughtRow> & thoughts,
+                       const std::vector<std::string> & deleted);
+    /// \brief Store changes to the thoughts of several entities.
+    ///
+    /// The changes are applied in order.
+    virtual int writeThoughts(const std::vector<ThoughtWrite> & changes);
 
     // Interface for CommPSQLSocket, so it can give us feedback
     
-    void queryResult(ExecStatusType);
+    void queryResult(PGresult *);
     void queryComplete();
-    int launchNewQuery();
-    int scheduleCommand(const std::string & query);
-    int clearPendingQuery();
+    virtual int launchNewQuery();
+    int scheduleCommand(const std::string & query, bool standalone = false);
+    int scheduleStatement(const std::string & statement,
+                          std::vector<std::string> params);
+    virtual int clearPendingQuery();
     int runMaintainance(int command = MAINTAIN_VACUUM);
 
 };
@@ -349,6 +576,17 @@ class DatabaseResult {
         return PQgetvalue(m_res.get(), row, column);
     }
     const char * field(const char * column, int row = 0) const;
+
+    /// \brief Get the size of a field, which is needed for bytea fields
+    /// of results in binary format.
+    int length(int column, int row = 0) const {
+        return PQgetlength(m_res.get(), row, column);
+    }
+
+    /// \brief Get the number of a column, or -1 if there is no such column.
+    int columnNumber(const char * column) const {
+        return PQfnumber(m_res.get(), column);
+    }
 };
 
 #endif // COMMON_DATABASE_H
@@ -0,0 +1,1200 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "DatabaseFile.h"
+
+#include "log.h"
+#include "debug.h"
+#include "compose.hpp"
+#include "const.h"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include <cstdint>
+#include <cstdio>
+
+#include <cassert>
+
+#ifndef _WIN32
+extern "C" {
+    #include <fcntl.h>
+    #include <unistd.h>
+}
+#endif // _WIN32
+
+using Atlas::Message::MapType;
+using Atlas::Objects::Root;
+using String::compose;
+
+static const bool debug_flag = false;
+
+static const unsigned char OP_PUT = 1;
+static const unsigned char OP_DELETE = 2;
+static const unsigned char OP_CLEAR = 3;
+
+/// The file isn't compacted until it's at least this large.
+static const size_t COMPACT_MIN_SIZE = 1 << 20;
+
+/// The file is compacted when it's this many times the size of the live
+/// data.
+static const size_t COMPACT_RATIO = 2;
+
+/// Bytes of live rows copied to the new file with each commit during a
+/// compaction, which bounds the time a commit takes.
+static const size_t COMPACT_STEP_SIZE = 256 * 1024;
+
+static const Oid TEXT_OID = 25;
+
+static const char * SEQUENCE_KEY = "entity_ent_id_seq";
+
+static void appendUint32(std::string & data, std::uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) {
+        data.push_back((char)(value >> (i * 8)));
+    }
+}
+
+static void appendString(std::string & data, const std::string & value)
+{
+    appendUint32(data, value.size());
+    data.append(value);
+}
+
+/// \brief Encode a record. It's prefixed with its length, so that a record
+/// cut short can be detected.
+static void encodeRecord(std::string & data, unsigned char op,
+                         const std::string & table, const std::string & key,
+                         const StringVector & values)
+{
+    size_t start = data.size();
+    appendUint32(data, 0);
+    data.push_back((char)op);
+    appendString(data, table);
+    appendString(data, key);
+    appendUint32(data, values.size());
+    for (auto& value : values) {
+        appendString(data, value);
+    }
+    std::uint32_t length = data.size() - start - 4;
+    for (int i = 0; i < 4; ++i) {
+        data[start + i] = (char)(length >> (i * 8));
+    }
+}
+
+static size_t recordSize(const std::string & table, const std::string & key,
+                         const StringVector & values)
+{
+    size_t size = 4 + 1 + 4 + table.size() + 4 + key.size() + 4;
+    for (auto& value : values) {
+        size += 4 + value.size();
+    }
+    return size;
+}
+
+/// \brief Write the data of a file out to the disk.
+static int syncFile(FILE * file)
+{
+    if (std::fflush(file) != 0) {
+        return -1;
+    }
+#ifndef _WIN32
+    return fsync(fileno(file));
+#else // _WIN32
+    return 0;
+#endif // _WIN32
+}
+
+/// \brief Write the directory holding a file out to the disk, so that
+/// the file being renamed into it survives a crash.
+static int syncDirectory(const std::string & path)
+{
+#ifndef _WIN32
+    std::string::size_type slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." :
+                      slash == 0 ? "/" : path.substr(0, slash);
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    int ret = fsync(fd);
+    close(fd);
+    return ret;
+#else // _WIN32
+    return 0;
+#endif // _WIN32
+}
+
+/// \brief Reads records, keeping track of the position.
+struct RecordReader {
+    const char * pos;
+    const char * end;
+
+    bool readUint32(std::uint32_t & value) {
+        if (end - pos < 4) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= (std::uint32_t)(unsigned char)*pos++ << (i * 8);
+        }
+        return true;
+    }
+
+    bool readString(std::string & value) {
+        std::uint32_t size;
+        if (!readUint32(size) || size > (std::uint32_t)(end - pos)) {
+            return false;
+        }
+        value.assign(pos, size);
+        pos += size;
+        return true;
+    }
+};
+
+/// \brief Escape data the way PostgreSQL escapes bytea values.
+static std::string escapeBytea(const std::string & data)
+{
+    static const char hex[] = "0123456789abcdef";
+    std::string escaped("\\x");
+    escaped.reserve(2 + data.size() * 2);
+    for (unsigned char c : data) {
+        escaped.push_back(hex[c >> 4]);
+        escaped.push_back(hex[c & 0xf]);
+    }
+    return escaped;
+}
+
+static std::string trim(const std::string & str)
+{
+    std::string::size_type start = str.find_first_not_of(" \t\n");
+    if (start == std::string::npos) {
+        return "";
+    }
+    return str.substr(start, str.find_last_not_of(" \t\n") - start + 1);
+}
+
+/// \brief Split an SQL list on the commas which are outside quotes.
+static StringVector splitList(const std::string & list)
+{
+    StringVector items;
+    std::string item;
+    bool quoted = false;
+    for (char c : list) {
+        if (c == '\'') {
+            quoted = !quoted;
+        } else if (c == ',' && !quoted) {
+            items.push_back(trim(item));
+            item.clear();
+            continue;
+        }
+        item.push_back(c);
+    }
+    items.push_back(trim(item));
+    return items;
+}
+
+/// \brief Get the value of an SQL literal, removing quotes if it has them.
+static std::string unquote(const std::string & literal)
+{
+    std::string value = trim(literal);
+    if (value.size() < 2 || value.front() != '\'' || value.back() != '\'') {
+        return value;
+    }
+    std::string result;
+    for (size_t i = 1; i < value.size() - 1; ++i) {
+        result.push_back(value[i]);
+        if (value[i] == '\'' && value[i + 1] == '\'') {
+            ++i;
+        }
+    }
+    return result;
+}
+
+static std::string rowKey(const std::string & id, const std::string & other)
+{
+    std::string key(id);
+    key.push_back('\0');
+    key += other;
+    return key;
+}
+
+void DatabaseFile::install(const std::string & path, bool sync)
+{
+    assert(m_instance == 0);
+    m_instance = new DatabaseFile(path, sync);
+}
+
+DatabaseFile::DatabaseFile(const std::string & path, bool sync) :
+                                                       m_path(path),
+                                                       m_log(0),
+                                                       m_sync(sync),
+                                                       m_compactFile(0),
+                                                       m_compactSize(0),
+                                                       m_compactFailed(false),
+                                                       m_compactResume(false),
+                                                       m_logSize(0),
+                                                       m_liveSize(0),
+                                                       m_lastId(0),
+                                                       m_reservedId(0)
+{
+    // Nothing has been stored in the old encodings.
+    m_schemaVersion = SCHEMA_BINARY;
+}
+
+DatabaseFile::~DatabaseFile()
+{
+    if (m_compactFile != 0) {
+        std::fclose(m_compactFile);
+        std::remove((m_path + ".tmp").c_str());
+    }
+    if (m_log != 0) {
+        std::fclose(m_log);
+    }
+}
+
+/// \brief Read the file, applying each record.
+///
+/// @return 0 on success, 1 if the file ends with an incomplete record and
+/// -1 if the file could not be read.
+int DatabaseFile::replay()
+{
+    m_tables.clear();
+    m_logSize = 0;
+    m_liveSize = 0;
+
+    std::ifstream file(m_path, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        // A new file is created when written to.
+        return 0;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+    if (file.bad()) {
+        log(ERROR, compose("Unable to read storage file \"%1\".", m_path));
+        return -1;
+    }
+
+    RecordReader reader{data.data(), data.data() + data.size()};
+    std::string table, key;
+    StringVector values;
+    while (reader.pos != reader.end) {
+        std::uint32_t length, count;
+        if (!reader.readUint32(length) ||
+            length > (std::uint32_t)(reader.end - reader.pos)) {
+            break;
+        }
+        RecordReader record{reader.pos, reader.pos + length};
+        if (record.pos == record.end) {
+            break;
+        }
+        unsigned char op = *record.pos++;
+        if (!record.readString(table) || !record.readString(key) ||
+            !record.readUint32(count)) {
+            break;
+        }
+        values.clear();
+        while (values.size() < count && record.pos != record.end) {
+            values.emplace_back();
+            if (!record.readString(values.back())) {
+                break;
+            }
+        }
+        if (values.size() != count || record.pos != record.end) {
+            break;
+        }
+        if (op == OP_PUT) {
+            applyPut(table, key, values);
+        } else if (op == OP_DELETE) {
+            applyDelete(table, key);
+        } else if (op == OP_CLEAR) {
+            applyClear(table);
+        } else {
+            break;
+        }
+        reader.pos = record.end;
+        m_logSize += 4 + length;
+    }
+
+    auto I = m_tables.find("sequence");
+    if (I != m_tables.end()) {
+        auto J = I->second.rows.find(SEQUENCE_KEY);
+        if (J != I->second.rows.end() && !J->second.empty()) {
+            m_reservedId = strtol(J->second.front().c_str(), 0, 10);
+        }
+    }
+    // Any of the ids reserved might have been used.
+    m_lastId = m_reservedId;
+
+    debug(std::cout << "Read " << m_logSize << " bytes of storage, "
+                    << m_liveSize << " live" << std::endl << std::flush;);
+
+    return m_logSize == data.size() ? 0 : 1;
+}
+
+DatabaseFile::Table & DatabaseFile::registerTable(const std::string & name,
+                                                  const StringVector & columns)
+{
+    // The table might already hold rows from the file.
+    Table & table = m_tables[name];
+    table.columns = columns;
+    table.worldData.assign(columns.size(), false);
+    allTables.insert(name);
+    return table;
+}
+
+int DatabaseFile::columnIndex(const Table & table,
+                              const std::string & column) const
+{
+    for (size_t i = 0; i < table.columns.size(); ++i) {
+        if (table.columns[i] == column) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void DatabaseFile::applyPut(const std::string & table, const std::string & key,
+                            const StringVector & values)
+{
+    auto& rows = m_tables[table].rows;
+    auto I = rows.find(key);
+    if (I != rows.end()) {
+        m_liveSize -= recordSize(table, key, I->second);
+        I->second = values;
+    } else {
+        rows.emplace(key, values);
+    }
+    m_liveSize += recordSize(table, key, values);
+}
+
+void DatabaseFile::applyDelete(const std::string & table,
+                               const std::string & key)
+{
+    Table & t = m_tables[table];
+    auto I = t.rows.find(key);
+    if (I != t.rows.end()) {
+        m_liveSize -= recordSize(table, key, I->second);
+        t.rows.erase(I);
+    }
+}
+
+void DatabaseFile::applyClear(const std::string & table)
+{
+    Table & t = m_tables[table];
+    for (auto& row : t.rows) {
+        m_liveSize -= recordSize(table, row.first, row.second);
+    }
+    t.rows.clear();
+}
+
+void DatabaseFile::writeRecord(unsigned char op, const std::string & table,
+                               const std::string & key,
+                               const StringVector & values)
+{
+    std::string data;
+    encodeRecord(data, op, table, key, values);
+    if (m_log == 0) {
+        return;
+    }
+    std::fwrite(data.data(), 1, data.size(), m_log);
+    m_logSize += data.size();
+    // The rows yet to be copied are copied as they are then, so records
+    // of changes can go to the new file in any order.
+    if (m_compactFile != 0) {
+        if (std::fwrite(data.data(), 1, data.size(), m_compactFile) !=
+            data.size()) {
+            m_compactFailed = true;
+        }
+        m_compactSize += data.size();
+    }
+}
+
+void DatabaseFile::putRow(const std::string & table, const std::string & key,
+                          const StringVector & values)
+{
+    applyPut(table, key, values);
+    writeRecord(OP_PUT, table, key, values);
+}
+
+void DatabaseFile::deleteRow(const std::string & table,
+                             const std::string & key)
+{
+    applyDelete(table, key);
+    writeRecord(OP_DELETE, table, key);
+}
+
+void DatabaseFile::deleteRows(const std::string & table,
+                              const std::string & prefix,
+                              const RowFilter & filter)
+{
+    auto I = m_tables.find(table);
+    if (I == m_tables.end()) {
+        return;
+    }
+    StringVector keys;
+    auto& rows = I->second.rows;
+    for (auto J = rows.lower_bound(prefix); J != rows.end() &&
+         J->first.compare(0, prefix.size(), prefix) == 0; ++J) {
+        if (!filter || filter(J->second)) {
+            keys.push_back(J->first);
+        }
+    }
+    for (auto& key : keys) {
+        deleteRow(table, key);
+    }
+}
+
+void DatabaseFile::commit()
+{
+    if (m_log == 0) {
+        return;
+    }
+    if (std::fflush(m_log) != 0 ||
+        (m_sync && syncFile(m_log) != 0)) {
+        log(ERROR, compose("Failed writing to storage file \"%1\".", m_path));
+        std::clearerr(m_log);
+        return;
+    }
+    if (m_compactFile != 0) {
+        if (compactStep(COMPACT_STEP_SIZE)) {
+            finishCompaction();
+        }
+    } else if (m_logSize > COMPACT_MIN_SIZE &&
+               m_logSize > m_liveSize * COMPACT_RATIO) {
+        startCompaction();
+    }
+}
+
+int DatabaseFile::openLog()
+{
+    m_log = std::fopen(m_path.c_str(), "ab");
+    if (m_log == 0) {
+        log(ERROR, compose("Unable to open storage file \"%1\".", m_path));
+        return -1;
+    }
+    return 0;
+}
+
+int DatabaseFile::compact()
+{
+    if (m_compactFile == 0 && startCompaction() != 0) {
+        return -1;
+    }
+    while (!compactStep(COMPACT_STEP_SIZE)) {
+    }
+    return finishCompaction();
+}
+
+int DatabaseFile::startCompaction()
+{
+    debug(std::cout << "Compacting storage from " << m_logSize << " to "
+                    << m_liveSize << " bytes" << std::endl << std::flush;);
+    std::string tmp_path = m_path + ".tmp";
+    m_compactFile = std::fopen(tmp_path.c_str(), "wb");
+    if (m_compactFile == 0) {
+        log(ERROR, compose("Unable to open storage file \"%1\".", tmp_path));
+        return -1;
+    }
+    m_compactSize = 0;
+    m_compactFailed = false;
+    m_compactResume = false;
+    return 0;
+}
+
+bool DatabaseFile::compactStep(size_t limit)
+{
+    size_t written = 0;
+    std::string data;
+    auto T = m_compactResume ? m_tables.lower_bound(m_compactTable)
+                             : m_tables.begin();
+    for (; T != m_tables.end(); ++T) {
+        auto& rows = T->second.rows;
+        auto R = (m_compactResume && T->first == m_compactTable) ?
+                 rows.upper_bound(m_compactKey) : rows.begin();
+        for (; R != rows.end(); ++R) {
+            if (written >= limit) {
+                return false;
+            }
+            data.clear();
+            encodeRecord(data, OP_PUT, T->first, R->first, R->second);
+            if (std::fwrite(data.data(), 1, data.size(), m_compactFile) !=
+                data.size()) {
+                m_compactFailed = true;
+            }
+            written += data.size();
+            m_compactSize += data.size();
+            m_compactTable = T->first;
+            m_compactKey = R->first;
+            m_compactResume = true;
+        }
+    }
+    return true;
+}
+
+int DatabaseFile::finishCompaction()
+{
+    std::string tmp_path = m_path + ".tmp";
+    FILE * file = m_compactFile;
+    m_compactFile = 0;
+    // The new file has to be on the disk before it replaces the old one,
+    // or a crash could leave it in place with its data missing.
+    if (syncFile(file) != 0) {
+        m_compactFailed = true;
+    }
+    if (m_compactFailed) {
+        log(ERROR, compose("Failed writing to storage file \"%1\".",
+                           tmp_path));
+        std::fclose(file);
+        std::remove(tmp_path.c_str());
+        return -1;
+    }
+
+    // Renaming replaces the old file at once, so a crash leaves either the
+    // old file or the new one.
+    std::fclose(m_log);
+    m_log = 0;
+    if (std::rename(tmp_path.c_str(), m_path.c_str()) != 0) {
+        log(ERROR, compose("Failed replacing storage file \"%1\".", m_path));
+        std::fclose(file);
+        std::remove(tmp_path.c_str());
+        openLog();
+        return -1;
+    }
+    m_log = file;
+    m_logSize = m_compactSize;
+    // The rename only survives a crash once the directory is on the
+    // disk too. If it doesn't, the old file is still complete.
+    if (syncDirectory(m_path) != 0) {
+        log(WARNING, compose("Failed syncing the directory of storage "
+                             "file \"%1\".", m_path));
+    }
+    return 0;
+}
+
+const DatabaseResult DatabaseFile::selectRows(const std::string & table,
+                                              const StringVector & columns,
+                                              const std::string & prefix,
+                                              const RowFilter & filter)
+{
+    auto I = m_tables.find(table);
+    if (I == m_tables.end()) {
+        log(ERROR, compose("Selecting from unknown table \"%1\".", table));
+        return DatabaseResult(0);
+    }
+    const Table & t = I->second;
+
+    std::vector<int> indices;
+    std::vector<PGresAttDesc> attrs(columns.size());
+    for (size_t i = 0; i < columns.size(); ++i) {
+        int index = columnIndex(t, columns[i]);
+        if (index == -1) {
+            log(ERROR, compose("Selecting unknown column \"%1\" from \"%2\".",
+                               columns[i], table));
+            return DatabaseResult(0);
+        }
+        indices.push_back(index);
+        attrs[i].name = const_cast<char *>(columns[i].c_str());
+        attrs[i].tableid = 0;
+        attrs[i].columnid = 0;
+        attrs[i].format = 0;
+        attrs[i].typid = TEXT_OID;
+        attrs[i].typlen = -1;
+        attrs[i].atttypmod = -1;
+    }
+
+    // Results are built the way libpq builds them from a server's reply.
+    PGresult * res = PQmakeEmptyPGresult(0, PGRES_TUPLES_OK);
+    if (res == 0 ||
+        !PQsetResultAttrs(res, attrs.size(), attrs.data())) {
+        log(ERROR, "Unable to create result from storage.");
+        PQclear(res);
+        return DatabaseResult(0);
+    }
+    int row = 0;
+    std::string value;
+    for (auto J = t.rows.lower_bound(prefix); J != t.rows.end() &&
+         J->first.compare(0, prefix.size(), prefix) == 0; ++J) {
+        const StringVector & values = J->second;
+        if (filter && !filter(values)) {
+            continue;
+        }
+        for (size_t col = 0; col < indices.size(); ++col) {
+            size_t index = indices[col];
+            value = index < values.size() ? values[index] : "";
+            if (t.worldData[index] && !value.empty()) {
+                value = escapeBytea(value);
+            }
+            PQsetvalue(res, row, col, const_cast<char *>(value.c_str()),
+                       value.size());
+        }
+        ++row;
+    }
+    return DatabaseResult(res);
+}
+
+int DatabaseFile::putObject(const std::string & table,
+                            const std::string & key,
+                            const MapType & o,
+                            const StringVector & c)
+{
+    StringVector values(1, key);
+    values.insert(values.end(), c.begin(), c.end());
+    values.emplace_back();
+    serialiseObject(o, values.back());
+    putRow(table, key, values);
+    commit();
+    return 0;
+}
+
+int DatabaseFile::updateObject(const std::string & table,
+                               const std::string & key,
+                               const MapType & o)
+{
+    auto I = m_tables.find(table);
+    if (I == m_tables.end()) {
+        return -1;
+    }
+    auto J = I->second.rows.find(key);
+    if (J == I->second.rows.end() || J->second.empty()) {
+        return 0;
+    }
+    StringVector values = J->second;
+    serialiseObject(o, values.back());
+    putRow(table, key, values);
+    commit();
+    return 0;
+}
+
+bool DatabaseFile::hasKey(const std::string & table, const std::string & key)
+{
+    auto I = m_tables.find(table);
+    return I != m_tables.end() && I->second.rows.count(key) != 0;
+}
+
+int DatabaseFile::getTable(const std::string & table,
+                           std::map<std::string, Root> & contents)
+{
+    auto I = m_tables.find(table);
+    if (I == m_tables.end() || I->second.rows.empty()) {
+        debug(std::cout << "No entries in " << table
+                        << " table" << std::endl << std::flush;);
+        return -1;
+    }
+    int contents_column = columnIndex(I->second, "contents");
+    if (contents_column == -1) {
+        log(ERROR, "Could not find 'contents' column in storage table");
+        return -1;
+    }
+
+    Root t;
+    for (auto& row : I->second.rows) {
+        if ((size_t)contents_column < row.second.size() &&
+            decodeObject(row.second[contents_column], t) == 0) {
+            contents[row.first] = t;
+        }
+    }
+    return 0;
+}
+
+int DatabaseFile::clearTable(const std::string & table)
+{
+    applyClear(table);
+    writeRecord(OP_CLEAR, table, "");
+    commit();
+    return 0;
+}
+
+int DatabaseFile::initConnection()
+{
+    int ret = replay();
+    if (ret < 0) {
+        return -1;
+    }
+    if (openLog() != 0) {
+        return -1;
+    }
+    if (ret > 0) {
+        // Rewriting the file drops the incomplete record, so that new
+        // records don't end up after it.
+        log(WARNING, compose("Storage file \"%1\" ends with an incomplete "
+                             "record, which has been dropped.", m_path));
+        return compact();
+    }
+    return 0;
+}
+
+int DatabaseFile::createInstanceDatabase()
+{
+    // The file is created when connecting.
+    return 0;
+}
+
+int DatabaseFile::initRule(bool createTables)
+{
+    registerTable(m_rule_db, StringVector{"id", "ruleset", "contents"});
+    return 0;
+}
+
+void DatabaseFile::shutdownConnection()
+{
+    if (m_log != 0) {
+        commit();
+        if (m_compactFile != 0) {
+            compact();
+        }
+        if (m_log != 0) {
+            std::fclose(m_log);
+            m_log = 0;
+        }
+    }
+}
+
+int DatabaseFile::registerRelation(std::string & tablename,
+                                   const std::string & sourcetable,
+                                   const std::string & targettable,
+                                   RelationType kind)
+{
+    tablename = sourcetable + "_" + targettable;
+    registerTable(tablename, StringVector{"source", "target"});
+    if (targettable == "entities") {
+        m_entityRelations.insert(tablename);
+    }
+    return 0;
+}
+
+const DatabaseResult DatabaseFile::selectRelation(const std::string & name,
+                                                  const std::string & id)
+{
+    return selectRows(name, StringVector{"target"}, rowKey(id, ""));
+}
+
+void DatabaseFile::selectRelationAsync(const std::string & name,
+                                       const std::string & id,
+                                       const ResultHandler & handler)
+{
+    // Nothing needs to be waited for.
+    handler(selectRelation(name, id));
+}
+
+int DatabaseFile::createRelationRow(const std::string & name,
+                                    const std::string & id,
+                                    const std::string & other)
+{
+    putRow(name, rowKey(id, other), StringVector{id, other});
+    commit();
+    return 0;
+}
+
+int DatabaseFile::removeRelationRow(const std::string & name,
+                                    const std::string & id)
+{
+    deleteRows(name, rowKey(id, ""));
+    commit();
+    return 0;
+}
+
+int DatabaseFile::removeRelationRowByOther(const std::string & name,
+                                           const std::string & other)
+{
+    deleteRows(name, "", [&other](const StringVector & row) {
+        return row.size() > 1 && row[1] == other;
+    });
+    commit();
+    return 0;
+}
+
+int DatabaseFile::registerSimpleTable(const std::string & name,
+                                      const MapType & row)
+{
+    if (row.empty()) {
+        log(ERROR, "Attempt to create empty database table");
+    }
+    StringVector columns(1, "id");
+    for (auto& column : row) {
+        columns.push_back(column.first);
+    }
+    registerTable(name, columns);
+    return 0;
+}
+
+const DatabaseResult DatabaseFile::selectSimpleRowBy(const std::string & name,
+                                                     const std::string & column,
+                                                     const std::string & value)
+{
+    auto I = m_tables.find(name);
+    if (I == m_tables.end()) {
+        log(ERROR, compose("Selecting from unknown table \"%1\".", name));
+        return DatabaseResult(0);
+    }
+    int index = columnIndex(I->second, column);
+    if (index == -1) {
+        log(ERROR, compose("Selecting on unknown column \"%1\" of \"%2\".",
+                           column, name));
+        return DatabaseResult(0);
+    }
+    std::string match = unquote(value);
+    return selectRows(name, I->second.columns, "",
+                      [index, &match](const StringVector & row) {
+        return (size_t)index < row.size() && row[index] == match;
+    });
+}
+
+void DatabaseFile::selectSimpleRowByAsync(const std::string & name,
+                                          const std::string & column,
+                                          const std::string & value,
+                                          const ResultHandler & handler)
+{
+    handler(selectSimpleRowBy(name, column, value));
+}
+
+int DatabaseFile::createSimpleRow(const std::string & name,
+                                  const std::string & id,
+                                  const std::string & columns,
+                                  const std::string & values)
+{
+    auto I = m_tables.find(name);
+    if (I == m_tables.end()) {
+        log(ERROR, compose("Inserting into unknown table \"%1\".", name));
+        return -1;
+    }
+    const Table & table = I->second;
+    StringVector names = splitList(columns);
+    StringVector literals = splitList(values);
+    if (names.size() != literals.size()) {
+        log(ERROR, compose("Mismatched columns and values inserting into "
+                           "\"%1\".", name));
+        return -1;
+    }
+    StringVector row(table.columns.size());
+    row[0] = id;
+    for (size_t i = 0; i < names.size(); ++i) {
+        int index = columnIndex(table, names[i]);
+        if (index == -1) {
+            log(ERROR, compose("Inserting unknown column \"%1\" into \"%2\".",
+                               names[i], name));
+            return -1;
+        }
+        row[index] = unquote(literals[i]);
+    }
+    putRow(name, id, row);
+    commit();
+    return 0;
+}
+
+int DatabaseFile::updateSimpleRow(const std::string & name,
+                                  const std::string & key,
+                                  const std::string & value,
+                                  const std::string & columns)
+{
+    auto I = m_tables.find(name);
+    if (I == m_tables.end()) {
+        log(ERROR, compose("Updating unknown table \"%1\".", name));
+        return -1;
+    }
+    const Table & table = I->second;
+    int key_index = columnIndex(table, key);
+    if (key_index == -1) {
+        log(ERROR, compose("Updating on unknown column \"%1\" of \"%2\".",
+                           key, name));
+        return -1;
+    }
+    std::vector<std::pair<int, std::string>> assignments;
+    for (auto& assignment : splitList(columns)) {
+        std::string::size_type eq = assignment.find('=');
+        int index = -1;
+        if (eq != std::string::npos) {
+            index = columnIndex(table, trim(assignment.substr(0, eq)));
+        }
+        if (index == -1) {
+            log(ERROR, compose("Invalid column update \"%1\" of \"%2\".",
+                               assignment, name));
+            return -1;
+        }
+        assignments.emplace_back(index, unquote(assignment.substr(eq + 1)));
+    }
+
+    std::vector<std::pair<std::string, StringVector>> updated;
+    for (auto& row : table.rows) {
+        if ((size_t)key_index < row.second.size() &&
+            row.second[key_index] == value) {
+            StringVector values = row.second;
+            values.resize(table.columns.size());
+            for (auto& assignment : assignments) {
+                values[assignment.first] = assignment.second;
+            }
+            updated.emplace_back(row.first, values);
+        }
+    }
+    for (auto& row : updated) {
+        putRow(name, row.first, row.second);
+    }
+    commit();
+    return 0;
+}
+
+int DatabaseFile::registerSchemaVersion()
+{
+    return 0;
+}
+
+int DatabaseFile::registerEntityIdGenerator()
+{
+    registerTable("sequence", StringVector{"value"});
+    return 0;
+}
+
+long DatabaseFile::newId(std::string & id)
+{
+    if (m_lastId >= m_reservedId) {
+        // Only the end of each block of ids is written, so that ids are
+        // never handed out twice, even after a crash.
+        m_reservedId = m_lastId + m_idBlockSize;
+        putRow("sequence", SEQUENCE_KEY,
+               StringVector(1, compose("%1", m_reservedId)));
+        commit();
+    }
+    long new_id = ++m_lastId;
+    id = compose("%1", new_id);
+    return new_id;
+}
+
+int DatabaseFile::prepareStatements()
+{
+    return 0;
+}
+
+int DatabaseFile::registerEntityTable(const std::map<std::string, int> & chunks)
+{
+    StringVector columns{"id", "loc", "type", "seq"};
+    for (auto& chunk : chunks) {
+        columns.push_back(chunk.first);
+    }
+    Table & table = registerTable("entities", columns);
+    for (size_t i = 4; i < columns.size(); ++i) {
+        table.worldData[i] = true;
+    }
+    std::string root_id = compose("%1", consts::rootWorldIntId);
+    if (table.rows.find(root_id) == table.rows.end()) {
+        StringVector root(columns.size());
+        root[0] = root_id;
+        root[2] = "world";
+        putRow("entities", root_id, root);
+        commit();
+    }
+    return 0;
+}
+
+int DatabaseFile::insertEntities(const std::vector<EntityRow> & rows)
+{
+    for (auto& row : rows) {
+        putRow("entities", row.id, StringVector{row.id, row.loc, row.type,
+                                                compose("%1", row.seq),
+                                                row.location});
+    }
+    commit();
+    return 0;
+}
+
+int DatabaseFile::updateEntities(const std::vector<EntityRow> & rows)
+{
+    auto& entities = m_tables["entities"].rows;
+    for (auto& row : rows) {
+        auto I = entities.find(row.id);
+        if (I == entities.end()) {
+            continue;
+        }
+        StringVector values = I->second;
+        values.resize(5);
+        // Rows without a location keep the one they have.
+        if (!row.loc.empty()) {
+            values[1] = row.loc;
+        }
+        values[3] = compose("%1", row.seq);
+        values[4] = row.location;
+        putRow("entities", row.id, values);
+    }
+    commit();
+    return 0;
+}
+
+const DatabaseResult DatabaseFile::selectEntities(const std::string & loc)
+{
+    return selectRows("entities",
+                      StringVector{"id", "type", "seq", "location"}, "",
+                      [&loc](const StringVector & row) {
+        return row.size() > 1 && row[1] == loc;
+    });
+}
+
+const DatabaseResult DatabaseFile::selectAllEntities()
+{
+    return selectRows("entities",
+                      StringVector{"id", "loc", "type", "seq", "location"},
+                      "");
+}
+
+int DatabaseFile::dropEntities(const std::vector<long> & ids)
+{
+    for (long id : ids) {
+        std::string key = compose("%1", id);
+        deleteRow("entities", key);
+        deleteRows("properties", rowKey(key, ""));
+        deleteRows("thoughts", rowKey(key, ""));
+        for (auto& relation : m_entityRelations) {
+            deleteRows(relation, "", [&key](const StringVector & row) {
+                return row.size() > 1 && row[1] == key;
+            });
+        }
+    }
+    commit();
+    return 0;
+}
+
+int DatabaseFile::registerPropertyTable()
+{
+    Table & table = registerTable("properties",
+                                  StringVector{"id", "name", "value"});
+    table.worldData[2] = true;
+    return 0;
+}
+
+const DatabaseResult DatabaseFile::selectProperties(const std::string & id)
+{
+    return selectRows("properties", StringVector{"name", "value"},
+                      rowKey(id, ""));
+}
+
+const DatabaseResult DatabaseFile::selectAllProperties()
+{
+    return selectRows("properties", StringVector{"id", "name", "value"}, "");
+}
+
+int DatabaseFile::insertProperties(const std::vector<PropertyRow> & rows)
+{
+    for (auto& row : rows) {
+        putRow("properties", rowKey(row.id, row.name),
+               StringVector{row.id, row.name, row.value});
+    }
+    commit();
+    return 0;
+}
+
+int DatabaseFile::updateProperties(const std::vector<PropertyRow> & rows)
+{
+    auto& properties = m_tables["properties"].rows;
+    for (auto& row : rows) {
+        std::string key = rowKey(row.id, row.name);
+        if (properties.find(key) != properties.end()) {
+            putRow("properties", key,
+                   StringVector{row.id, row.name, row.value});
+        }
+    }
+    commit();
+    return 0;
+}
+
+int DatabaseFile::registerThoughtsTable()
+{
+    // Rows written before thoughts had ids have no value for the column.
+    Table & table = registerTable("thoughts",
+                                  StringVector{"id", "thought", "tid"});
+    table.worldData[1] = true;
+    return 0;
+}
+
+const DatabaseResult DatabaseFile::selectThoughts(const std::string & id)
+{
+    return selectRows("thoughts", StringVector{"tid", "thought"},
+                      rowKey(id, ""));
+}
+
+const DatabaseResult DatabaseFile::selectAllThoughts()
+{
+    return selectRows("thoughts", StringVector{"id", "tid", "thought"}, "");
+}
+
+/// \brief Get the key of a thought with an id.
+///
+/// These sort before those of thoughts without one, which are numbered.
+static std::string thoughtKey(const std::string & id, const std::string & tid)
+{
+    return rowKey(id, "#" + tid);
+}
+
+void DatabaseFile::putThoughts(const std::string & id,
+                               const std::vector<ThoughtRow> & thoughts,
+                               size_t index)
+{
+    // The keys keep the thoughts without an id in order.
+    char number[32];
+    for (auto& thought : thoughts) {
+        if (thought.tid.empty()) {
+            snprintf(number, sizeof(number), "%06zu", index++);
+            putRow("thoughts", rowKey(id, number),
+                   StringVector{id, thought.thought, ""});
+        } else {
+            putRow("thoughts", thoughtKey(id, thought.tid),
+                   StringVector{id, thought.thought, thought.tid});
+        }
+    }
+}
+
+int DatabaseFile::writeThoughts(const std::vector<ThoughtWrite> & changes)
+{
+    for (auto& entity : changes) {
+        const std::string & id = entity.id;
+        if (entity.replace) {
+            deleteRows("thoughts", rowKey(id, ""));
+            putThoughts(id, entity.thoughts, 0);
+            continue;
+        }
+        for (auto& tid : entity.deleted) {
+            deleteRow("thoughts", thoughtKey(id, tid));
+        }
+        // Thoughts without an id are numbered after those already stored.
+        std::string prefix = rowKey(id, "");
+        auto& rows = m_tables["thoughts"].rows;
+        size_t index = 0;
+        for (auto I = rows.lower_bound(prefix); I != rows.end() &&
+             I->first.compare(0, prefix.size(), prefix) == 0; ++I) {
+            if (I->first[prefix.size()] != '#') {
+                ++index;
+            }
+        }
+        putThoughts(id, entity.thoughts, index);
+    }
+    commit();
+    return 0;
+}
+
+int DatabaseFile::launchNewQuery()
+{
+    // Everything is written as soon as it's changed, so nothing is queued.
+    return -1;
+}
+
+int DatabaseFile::clearPendingQuery()
+{
+    return 0;
+}
@@ -0,0 +1,257 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef COMMON_DATABASE_FILE_H
+#define COMMON_DATABASE_FILE_H
+
+#include "Database.h"
+
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <set>
+
+/// \brief Storage backend keeping all tables in memory, backed by a single
+/// append-only file instead of a PostgreSQL server.
+///
+/// Every change is appended to the file as a record, and the file is
+/// replayed when connecting, which is quick as nothing else needs to be
+/// started. When the file has grown to several times the size of the live
+/// data it's compacted, by writing the live rows to a new file which
+/// replaces the old one. The live rows are copied a step at a time, with
+/// each commit, and changes made meanwhile go to both files. A record cut
+/// short by a crash is ignored.
+///
+/// Results are returned in the same form as those of the PostgreSQL
+/// backend, so the rest of the server doesn't have to know which backend
+/// is in use.
+class DatabaseFile : public Database {
+  public:
+    /// \brief Makes a file backend the database instance.
+    ///
+    /// Must be called before the instance is first used.
+    /// @param path The path of the file holding the data.
+    /// @param sync Whether each commit waits for the data to be on the
+    /// disk.
+    static void install(const std::string & path, bool sync = true);
+
+    /// \brief Writes the live rows to a new file, replacing the
+    /// current one, finishing any compaction in progress.
+    /// @return 0 on success.
+    int compact();
+
+    /// \brief Checks if a compaction is in progress.
+    bool compacting() const { return m_compactFile != 0; }
+
+    /// \brief Gets the size of the file.
+    size_t logSize() const { return m_logSize; }
+
+    /// \brief Gets the size the file would have after compaction.
+    size_t liveSize() const { return m_liveSize; }
+
+    virtual int putObject(const std::string & table,
+                          const std::string & key,
+                          const Atlas::Message::MapType & o,
+                          const StringVector & c = StringVector());
+    virtual int updateObject(const std::string & table,
+                             const std::string & key,
+                             const Atlas::Message::MapType & o);
+    virtual bool hasKey(const std::string & table,
+                        const std::string & key);
+    virtual int getTable(const std::string & table,
+                         std::map<std::string, Atlas::Objects::Root> &);
+    virtual int clearTable(const std::string & table);
+
+    virtual int initConnection();
+    virtual int createInstanceDatabase();
+    virtual int initRule(bool createTables = false);
+    virtual void shutdownConnection();
+
+    virtual int registerRelation(std::string & tablename,
+                                 const std::string & sourcetable,
+                                 const std::string & targettable,
+                                 RelationType kind = OneToMany);
+    virtual const DatabaseResult selectRelation(const std::string & name,
+                                                const std::string & id);
+    virtual void selectRelationAsync(const std::string & name,
+                                     const std::string & id,
+                                     const ResultHandler & handler);
+    virtual int createRelationRow(const std::string & name,
+                                  const std::string & id,
+                                  const std::string & other);
+    virtual int removeRelationRow(const std::string & name,
+                                  const std::string & id);
+    virtual int removeRelationRowByOther(const std::string & name,
+                                         const std::string & other);
+
+    virtual int registerSimpleTable(const std::string & name,
+                                    const Atlas::Message::MapType & row);
+    virtual const DatabaseResult selectSimpleRowBy(const std::string & name,
+                                                   const std::string & column,
+                                                   const std::string & value);
+    virtual void selectSimpleRowByAsync(const std::string & name,
+                                        const std::string & column,
+                                        const std::string & value,
+                                        const ResultHandler & handler);
+    virtual int createSimpleRow(const std::string & name,
+                                const std::string & id,
+                                const std::string & columns,
+                                const std::string & values);
+    virtual int updateSimpleRow(const std::string & name,
+                                const std::string & key,
+                                const std::string & value,
+                                const std::string & columns);
+
+    virtual int registerSchemaVersion();
+    virtual int registerEntityIdGenerator();
+    virtual long newId(std::string & id);
+    virtual int prepareStatements();
+
+    virtual int registerEntityTable(const std::map<std::string, int> & chunks);
+    virtual int insertEntities(const std::vector<EntityRow> & rows);
+    virtual int updateEntities(const std::vector<EntityRow> & rows);
+    virtual const DatabaseResult selectEntities(const std::string & loc);
+    virtual const DatabaseResult selectAllEntities();
+    virtual int dropEntities(const std::vector<long> & ids);
+
+    virtual int registerPropertyTable();
+    virtual const DatabaseResult selectProperties(const std::string & id);
+    virtual const DatabaseResult selectAllProperties();
+    virtual int insertProperties(const std::vector<PropertyRow> & rows);
+    virtual int updateProperties(const std::vector<PropertyRow> & rows);
+
+    virtual int registerThoughtsTable();
+    virtual const DatabaseResult selectThoughts(const std::string & id);
+    virtual const DatabaseResult selectAllThoughts();
+    virtual int writeThoughts(const std::vector<ThoughtWrite> & changes);
+
+    virtual int launchNewQuery();
+    virtual int clearPendingQuery();
+
+  protected:
+    DatabaseFile(const std::string & path, bool sync);
+    virtual ~DatabaseFile();
+
+    /// \brief A table, with rows keyed by their primary key.
+    struct Table {
+        StringVector columns;
+        /// Whether each column holds encoded world data, which is
+        /// returned escaped the way bytea columns are.
+        std::vector<bool> worldData;
+        std::map<std::string, StringVector> rows;
+    };
+
+    typedef std::function<bool(const StringVector &)> RowFilter;
+
+    /// The path of the file.
+    std::string m_path;
+
+    std::map<std::string, Table> m_tables;
+
+    /// Relation tables whose rows go when the target entity is dropped.
+    std::set<std::string> m_entityRelations;
+
+    /// The file, opened for appending records.
+    FILE * m_log;
+
+    /// Whether each commit waits for the data to be on the disk.
+    bool m_sync;
+
+    /// The new file being written by the compaction in progress, if any.
+    FILE * m_compactFile;
+
+    /// The size of the new file.
+    size_t m_compactSize;
+
+    /// The compaction couldn't write to the new file.
+    bool m_compactFailed;
+
+    /// The table and key of the last row copied to the new file, if any
+    /// has been.
+    std::string m_compactTable;
+    std::string m_compactKey;
+    bool m_compactResume;
+
+    /// The current size of the file.
+    size_t m_logSize;
+
+    /// The size of the records of the live rows.
+    size_t m_liveSize;
+
+    /// The last entity id handed out.
+    long m_lastId;
+
+    /// The highest entity id recorded as reserved in the file.
+    long m_reservedId;
+
+    int replay();
+
+    Table & registerTable(const std::string & name,
+                          const StringVector & columns);
+    int columnIndex(const Table & table, const std::string & column) const;
+
+    void applyPut(const std::string & table, const std::string & key,
+                  const StringVector & values);
+    void applyDelete(const std::string & table, const std::string & key);
+    void applyClear(const std::string & table);
+
+    void writeRecord(unsigned char op, const std::string & table,
+                     const std::string & key,
+                     const StringVector & values = StringVector());
+
+    void putRow(const std::string & table, const std::string & key,
+                const StringVector & values);
+    void deleteRow(const std::string & table, const std::string & key);
+
+    /// \brief Delete the rows with keys starting with a prefix, and
+    /// matching a filter if one is given.
+    void deleteRows(const std::string & table, const std::string & prefix,
+                    const RowFilter & filter = RowFilter());
+
+    /// \brief Write thoughts of an entity, with thoughts without an id
+    /// numbered from an index.
+    void putThoughts(const std::string & id,
+                     const std::vector<ThoughtRow> & thoughts,
+                     size_t index);
+
+    /// \brief Flush the written records, and take a step towards
+    /// compacting the file if it has grown enough.
+    void commit();
+
+    /// \brief Open the file for appending records.
+    int openLog();
+
+    /// \brief Start writing the live rows to a new file.
+    int startCompaction();
+
+    /// \brief Copy live rows to the new file, up to a number of bytes.
+    /// @return true if all of them have been copied.
+    bool compactStep(size_t limit);
+
+    /// \brief Replace the file with the new one.
+    int finishCompaction();
+
+    /// \brief Select columns of the rows with keys starting with a
+    /// prefix, and matching a filter if one is given.
+    const DatabaseResult selectRows(const std::string & table,
+                                    const StringVector & columns,
+                                    const std::string & prefix,
+                                    const RowFilter & filter = RowFilter());
+};
+
+#endif // COMMON_DATABASE_FILE_H
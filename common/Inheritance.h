@@ -30,7 +30,6 @@ void installStandardObjects();
 void installCustomOperations();
 void installCustomEntities();
 
-typedef std::map<std::string, PropertyBase *> PropertyDict;
 typedef std::map<std::string, TypeNode *> TypeNodeDict;
 
 /// \brief Class to manage the inheritance tree for in-game entity types
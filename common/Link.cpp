@@ -39,7 +39,9 @@ Link::~Link()
 void Link::send(const Operation & op) const
 {
     if (m_encoder != 0) {
-        m_encoder->streamObjectsMessage(op);
+        if (!m_commSocket.sendOperation(op)) {
+            m_encoder->streamObjectsMessage(op);
+        }
         m_commSocket.flush();
     }
 }
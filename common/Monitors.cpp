@@ -60,6 +60,11 @@ void Monitors::insert(const std::string & key, const Element & val)
     m_pairs[key] = val;
 }
 
+void Monitors::erase(const std::string & key)
+{
+    m_pairs.erase(key);
+}
+
 void Monitors::watch(const::std::string & name, VariableBase * monitor)
 {
     m_variableMonitors[name] = monitor;
@@ -43,6 +43,7 @@ class Monitors {
     static void cleanup();
 
     void insert(const std::string &, const Atlas::Message::Element &);
+    void erase(const std::string &);
     void watch(const std::string &, VariableBase *);
     void send(std::ostream &);
     void sendNumerics(std::ostream &);
@@ -0,0 +1,106 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef MPSCQUEUE_H_
+#define MPSCQUEUE_H_
+
+#include <atomic>
+
+/// \brief A lock free queue with any number of producers and a single
+/// consumer.
+///
+/// Producers link new nodes in at the head with a single atomic exchange,
+/// and the consumer unlinks them at the tail. Between the exchange and the
+/// linking of a node the queue is briefly split, during which pop() sees
+/// the queue as ending before the node being pushed. Values are popped in
+/// the order their push() calls made the exchange, so values pushed by a
+/// single thread keep their order.
+///
+/// The value type must be default constructible.
+template<typename T>
+class MpscQueue
+{
+    public:
+        MpscQueue() : m_tail(new Node())
+        {
+            m_head.store(m_tail);
+        }
+
+        ~MpscQueue()
+        {
+            T value;
+            while (pop(value)) {
+            }
+            delete m_tail;
+        }
+
+        MpscQueue(const MpscQueue &) = delete;
+        MpscQueue & operator=(const MpscQueue &) = delete;
+
+        /**
+         * @brief Adds a value. May be called from any thread.
+         */
+        void push(T value)
+        {
+            Node * node = new Node(std::move(value));
+            Node * previous = m_head.exchange(node, std::memory_order_acq_rel);
+            previous->next.store(node, std::memory_order_release);
+        }
+
+        /**
+         * @brief Removes the oldest value. May only be called from the
+         * consuming thread.
+         * @param value Set to the value removed.
+         * @return False if there was no value to remove.
+         */
+        bool pop(T & value)
+        {
+            Node * tail = m_tail;
+            Node * next = tail->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+            //The next node becomes the new empty node at the tail.
+            value = std::move(next->value);
+            m_tail = next;
+            delete tail;
+            return true;
+        }
+
+    private:
+        struct Node {
+            Node() : next(nullptr)
+            {
+            }
+
+            explicit Node(T && v) : value(std::move(v)), next(nullptr)
+            {
+            }
+
+            T value;
+            std::atomic<Node *> next;
+        };
+
+        /// The node last pushed.
+        std::atomic<Node *> m_head;
+
+        /// A node whose value already has been popped.
+        Node * m_tail;
+};
+
+#endif /* MPSCQUEUE_H_ */
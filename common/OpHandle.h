@@ -0,0 +1,81 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef OPHANDLE_H_
+#define OPHANDLE_H_
+
+#include <memory>
+
+/// \brief A handle to an operation which has been queued for dispatch.
+///
+/// The state is shared between the handle and the queue entry, so that
+/// the operation can be cancelled without searching the queue for it. A
+/// cancelled operation is left in the queue, but is discarded instead of
+/// dispatched when its time comes.
+class OpHandle {
+    public:
+        /**
+         * @brief Checks if the handle has been attached to an operation.
+         */
+        bool isValid() const {
+            return (bool)m_queued;
+        }
+
+        /**
+         * @brief Checks if the operation is still waiting in the queue.
+         */
+        bool isPending() const {
+            return m_queued && *m_queued;
+        }
+
+        /**
+         * @brief Releases the handle, without cancelling the operation.
+         */
+        void reset() {
+            m_queued.reset();
+        }
+
+        /**
+         * @brief Creates a handle for a newly queued operation.
+         */
+        static OpHandle create() {
+            OpHandle handle;
+            handle.m_queued = std::make_shared<bool>(true);
+            return handle;
+        }
+
+        /**
+         * @brief Marks the operation as no longer being queued.
+         *
+         * This is done both when the operation is cancelled, and when it's
+         * removed from the queue for dispatch.
+         * @return True if the operation was queued before this call.
+         */
+        bool dequeue() {
+            if (!isPending()) {
+                return false;
+            }
+            *m_queued = false;
+            return true;
+        }
+
+    private:
+        std::shared_ptr<bool> m_queued;
+};
+
+#endif /* OPHANDLE_H_ */
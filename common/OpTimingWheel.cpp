@@ -0,0 +1,315 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "OpTimingWheel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+static const unsigned int WHEEL_BITS = 8;
+static const unsigned int WHEEL_SIZE = 1 << WHEEL_BITS;
+static const std::int64_t WHEEL_MASK = WHEEL_SIZE - 1;
+static const unsigned int WHEEL_LEVELS = 4;
+
+static const std::int64_t NO_TICK = std::numeric_limits<std::int64_t>::max();
+
+/// \brief Finds the first occupied slot at or after the start slot.
+/// @return The slot index, or -1 if there is none.
+static int findOccupied(const std::uint64_t (&occupied)[4], unsigned int start)
+{
+    if (start >= WHEEL_SIZE) {
+        return -1;
+    }
+    unsigned int word = start / 64;
+    std::uint64_t bits = occupied[word] & (~std::uint64_t(0) << (start % 64));
+    while (true) {
+        if (bits != 0) {
+            return word * 64 + __builtin_ctzll(bits);
+        }
+        if (++word >= 4) {
+            return -1;
+        }
+        bits = occupied[word];
+    }
+}
+
+/// \brief Gets the slot index at a certain level for a tick.
+static unsigned int slotFor(std::int64_t tick, unsigned int level)
+{
+    return (tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+}
+
+/// \brief Removes all cancelled entries from a list.
+/// @return The number of entries removed.
+static std::size_t eraseCancelled(std::vector<OpQueEntry> & entries)
+{
+    std::size_t size = entries.size();
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const OpQueEntry & entry) {
+                                     return entry.isCancelled();
+                                 }),
+                  entries.end());
+    return size - entries.size();
+}
+
+OpTimingWheel::OpTimingWheel(double resolution, double startTime) :
+    m_resolution(resolution), m_currentTick(0), m_wheelCount(0)
+{
+    m_currentTick = toTick(startTime);
+    for (auto& wheel : m_wheels) {
+        std::fill(std::begin(wheel.occupied), std::end(wheel.occupied), 0);
+    }
+}
+
+OpTimingWheel::~OpTimingWheel()
+{
+}
+
+std::int64_t OpTimingWheel::toTick(double time) const
+{
+    return (std::int64_t)std::floor(time / m_resolution);
+}
+
+void OpTimingWheel::push(OpQueEntry entry)
+{
+    std::int64_t tick = toTick(entry->getSeconds());
+    place(std::move(entry), tick);
+}
+
+void OpTimingWheel::place(OpQueEntry && entry, std::int64_t tick)
+{
+    //Anything which should already have been expired goes straight
+    //to the ready queue.
+    if (tick < m_currentTick) {
+        m_ready.push(std::move(entry));
+        return;
+    }
+    ++m_wheelCount;
+    for (unsigned int level = 0; level < WHEEL_LEVELS; ++level) {
+        unsigned int shift = WHEEL_BITS * (level + 1);
+        if ((tick >> shift) == (m_currentTick >> shift)) {
+            unsigned int slot = slotFor(tick, level);
+            Wheel & wheel = m_wheels[level];
+            wheel.slots[slot].push_back(std::move(entry));
+            wheel.occupied[slot / 64] |= std::uint64_t(1) << (slot % 64);
+            return;
+        }
+    }
+    m_overflow.push_back(std::move(entry));
+}
+
+std::int64_t OpTimingWheel::nextEventTick(int & level, unsigned int & slot) const
+{
+    if (m_wheelCount == 0) {
+        return NO_TICK;
+    }
+    for (unsigned int i = 0; i < WHEEL_LEVELS; ++i) {
+        //Slots in the higher wheels at the current index belong to the
+        //span of time currently covered by the lower wheels, and are
+        //thus always empty.
+        unsigned int start = slotFor(m_currentTick, i) + (i == 0 ? 0 : 1);
+        int found = findOccupied(m_wheels[i].occupied, start);
+        if (found != -1) {
+            level = i;
+            slot = found;
+            unsigned int shift = WHEEL_BITS * (i + 1);
+            return ((m_currentTick >> shift) << shift) +
+                   ((std::int64_t)found << (WHEEL_BITS * i));
+        }
+    }
+    level = WHEEL_LEVELS;
+    slot = 0;
+    unsigned int shift = WHEEL_BITS * WHEEL_LEVELS;
+    return ((m_currentTick >> shift) + 1) << shift;
+}
+
+void OpTimingWheel::setCurrentTick(std::int64_t tick)
+{
+    m_currentTick = tick;
+    if ((m_currentTick & WHEEL_MASK) == 0) {
+        cascade();
+    }
+}
+
+void OpTimingWheel::expire(unsigned int slot)
+{
+    Wheel & wheel = m_wheels[0];
+    auto& entries = wheel.slots[slot];
+    for (auto& entry : entries) {
+        m_ready.push(std::move(entry));
+    }
+    m_wheelCount -= entries.size();
+    //Clearing keeps the capacity, so that the slot doesn't need to
+    //allocate again the next time it's used.
+    entries.clear();
+    wheel.occupied[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+}
+
+void OpTimingWheel::cascadeEntries(std::vector<OpQueEntry> & entries)
+{
+    m_cascade.swap(entries);
+    m_wheelCount -= m_cascade.size();
+    for (auto& entry : m_cascade) {
+        std::int64_t tick = toTick(entry->getSeconds());
+        place(std::move(entry), tick);
+    }
+    m_cascade.clear();
+}
+
+void OpTimingWheel::cascade()
+{
+    //Find the highest level whose span we have just crossed into.
+    unsigned int top = 1;
+    while (top < WHEEL_LEVELS &&
+           (m_currentTick & ((std::int64_t(1) << (WHEEL_BITS * (top + 1))) - 1)) == 0) {
+        ++top;
+    }
+    //Crossing into the span above the top wheel means that some of the
+    //overflowing entries might now fit.
+    if (top == WHEEL_LEVELS) {
+        cascadeEntries(m_overflow);
+        top = WHEEL_LEVELS - 1;
+    }
+    //Cascade from the top, so that entries can trickle all the way down.
+    for (unsigned int level = top; level > 0; --level) {
+        unsigned int slot = slotFor(m_currentTick, level);
+        Wheel & wheel = m_wheels[level];
+        if (wheel.occupied[slot / 64] & (std::uint64_t(1) << (slot % 64))) {
+            wheel.occupied[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+            cascadeEntries(wheel.slots[slot]);
+        }
+    }
+}
+
+void OpTimingWheel::advance(double time)
+{
+    std::int64_t now = toTick(time);
+    while (m_currentTick <= now) {
+        int level;
+        unsigned int slot;
+        std::int64_t next = nextEventTick(level, slot);
+        if (next > now) {
+            setCurrentTick(now + 1);
+            break;
+        }
+        //Jumping straight to the next event is safe, since there's nothing
+        //stored in any slot we skip past.
+        if (next != m_currentTick) {
+            setCurrentTick(next);
+        }
+        slot = slotFor(next, 0);
+        if (m_wheels[0].occupied[slot / 64] & (std::uint64_t(1) << (slot % 64))) {
+            expire(slot);
+        }
+        setCurrentTick(next + 1);
+    }
+}
+
+bool OpTimingWheel::isDue(double time) const
+{
+    return !m_ready.empty() && m_ready.top()->getSeconds() <= time;
+}
+
+OpQueEntry OpTimingWheel::pop()
+{
+    OpQueEntry entry = m_ready.top();
+    m_ready.pop();
+    return entry;
+}
+
+double OpTimingWheel::nextOpTime() const
+{
+    if (!m_ready.empty()) {
+        return m_ready.top()->getSeconds();
+    }
+    int level;
+    unsigned int slot;
+    std::int64_t next = nextEventTick(level, slot);
+    if (next == NO_TICK) {
+        return std::numeric_limits<double>::max();
+    }
+    //In the lowest wheel we can cheaply find the exact time.
+    if (level == 0) {
+        double time = std::numeric_limits<double>::max();
+        for (auto& entry : m_wheels[0].slots[slot]) {
+            time = std::min(time, entry->getSeconds());
+        }
+        return time;
+    }
+    return next * m_resolution;
+}
+
+bool OpTimingWheel::empty() const
+{
+    return m_wheelCount == 0 && m_ready.empty();
+}
+
+std::size_t OpTimingWheel::size() const
+{
+    return m_wheelCount + m_ready.size();
+}
+
+void OpTimingWheel::clear()
+{
+    for (auto& wheel : m_wheels) {
+        for (auto& slot : wheel.slots) {
+            slot.clear();
+        }
+        std::fill(std::begin(wheel.occupied), std::end(wheel.occupied), 0);
+    }
+    m_overflow.clear();
+    m_ready = OpPriorityQueue();
+    m_wheelCount = 0;
+}
+
+std::size_t OpTimingWheel::removeCancelled()
+{
+    std::size_t removed = 0;
+    for (auto& wheel : m_wheels) {
+        for (unsigned int slot = 0; slot < WHEEL_SIZE; ++slot) {
+            if (!(wheel.occupied[slot / 64] & (std::uint64_t(1) << (slot % 64)))) {
+                continue;
+            }
+            removed += eraseCancelled(wheel.slots[slot]);
+            if (wheel.slots[slot].empty()) {
+                wheel.occupied[slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+            }
+        }
+    }
+    removed += eraseCancelled(m_overflow);
+    m_wheelCount -= removed;
+
+    std::vector<OpQueEntry> ready;
+    ready.reserve(m_ready.size());
+    while (!m_ready.empty()) {
+        if (!m_ready.top().isCancelled()) {
+            ready.push_back(m_ready.top());
+        } else {
+            ++removed;
+        }
+        m_ready.pop();
+    }
+    m_ready = OpPriorityQueue(std::greater<OpQueEntry>(), std::move(ready));
+    return removed;
+}
@@ -0,0 +1,144 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef OPTIMINGWHEEL_H_
+#define OPTIMINGWHEEL_H_
+
+#include "OperationsDispatcher.h"
+
+#include <cstdint>
+#include <vector>
+
+/// \brief A hierarchical timing wheel holding operations to be dispatched
+/// in the future.
+///
+/// Time is divided into ticks of a fixed resolution. Operations are placed
+/// in slots in one of a number of wheels, where each wheel covers a span
+/// of time 256 times larger than the one below it. Insertion is O(1), and
+/// as time advances the slots of the higher wheels are cascaded down into
+/// the lower ones. Operations whose tick has been reached are moved into a
+/// small ordered queue, so that they are still dispatched in strict
+/// chronological order.
+class OpTimingWheel
+{
+    public:
+        /**
+         * @brief Ctor.
+         * @param resolution The length of a tick, in seconds.
+         * @param startTime The time at which the wheel starts.
+         */
+        explicit OpTimingWheel(double resolution, double startTime);
+
+        ~OpTimingWheel();
+
+        /**
+         * @brief Adds an operation, which must have its seconds set.
+         * @param entry The entry to add.
+         */
+        void push(OpQueEntry entry);
+
+        /**
+         * @brief Advances the wheel, making every operation which is due at
+         * or before the supplied time available through pop().
+         * @param time The current time.
+         */
+        void advance(double time);
+
+        /**
+         * @brief Checks if there's an operation ready to be dispatched.
+         *
+         * Only operations which have been made ready through advance() are
+         * considered.
+         * @param time The current time.
+         * @return True if pop() can be called.
+         */
+        bool isDue(double time) const;
+
+        /**
+         * @brief Removes and returns the earliest ready operation.
+         */
+        OpQueEntry pop();
+
+        /**
+         * @brief Gets the time at which the next operation needs attention.
+         *
+         * For operations which are kept in the higher wheels this is the
+         * start time of their slot, which is never later than the time
+         * of the operation itself.
+         * @return Seconds, or a very large value if the wheel is empty.
+         */
+        double nextOpTime() const;
+
+        bool empty() const;
+
+        std::size_t size() const;
+
+        /**
+         * @brief Removes all operations.
+         */
+        void clear();
+
+        /**
+         * @brief Removes all operations which have been cancelled.
+         * @return The number of operations removed.
+         */
+        std::size_t removeCancelled();
+
+    private:
+
+        /// \brief A single wheel, with an occupancy bitmap for its slots.
+        struct Wheel {
+            std::vector<OpQueEntry> slots[256];
+            std::uint64_t occupied[4];
+        };
+
+        const double m_resolution;
+
+        /// The next tick which has not yet been expired.
+        std::int64_t m_currentTick;
+
+        /// Number of entries in the wheels and the overflow list.
+        std::size_t m_wheelCount;
+
+        Wheel m_wheels[4];
+
+        /// Entries too far in the future to fit in any wheel.
+        std::vector<OpQueEntry> m_overflow;
+
+        /// Entries which have been expired from the wheels.
+        OpPriorityQueue m_ready;
+
+        /// Scratch space used when cascading entries.
+        std::vector<OpQueEntry> m_cascade;
+
+        std::int64_t toTick(double time) const;
+
+        void place(OpQueEntry && entry, std::int64_t tick);
+
+        void setCurrentTick(std::int64_t tick);
+
+        void expire(unsigned int slot);
+
+        void cascade();
+
+        void cascadeEntries(std::vector<OpQueEntry> & entries);
+
+        std::int64_t nextEventTick(int & level, unsigned int & slot) const;
+};
+
+#endif /* OPTIMINGWHEEL_H_ */
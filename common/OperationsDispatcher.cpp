@@ -21,35 +21,97 @@
 #endif
 
 #include "OperationsDispatcher.h"
+#include "OpTimingWheel.h"
 #include "rulesets/LocatedEntity.h"
 #include "BaseWorld.h"
 #include "const.h"
 #include "debug.h"
 #include "Monitors.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
 static const bool debug_flag = false;
 
+/// Don't bother compacting the queues until there are at least this
+/// many cancelled operations in them.
+static const size_t COMPACTION_MIN_DEAD = 128;
+
+/// Default time spent dispatching operations before handling IO.
+static const double DEFAULT_SLICE_BUDGET = 0.005;
+
+/// In adaptive mode, a slice is never shorter than this part of the
+/// configured budget.
+static const double ADAPTIVE_MIN_FACTOR = 0.1;
+
+/// In adaptive mode, a slice is always long enough to dispatch this many
+/// operations of average cost.
+static const double ADAPTIVE_MIN_OPS = 2.0;
+
+/// Weight given to the latest measurement in the average operation cost.
+static const double OP_COST_WEIGHT = 0.05;
+
 OpQueEntry::OpQueEntry(const Operation & o, LocatedEntity & f) : op(o),
                                                                         from(&f)
 {
     from->incRef();
 }
 
-OpQueEntry::OpQueEntry(const OpQueEntry & o) : op(o.op), from(o.from)
+OpQueEntry::OpQueEntry(const OpQueEntry & o) : op(o.op), from(o.from),
+                                               handle(o.handle)
 {
     from->incRef();
 }
 
+OpQueEntry::OpQueEntry(OpQueEntry && o) : op(std::move(o.op)), from(o.from),
+                                          handle(std::move(o.handle))
+{
+    o.from = nullptr;
+}
+
 OpQueEntry::~OpQueEntry()
 {
-    from->decRef();
+    if (from) {
+        from->decRef();
+    }
+}
+
+OpQueEntry & OpQueEntry::operator=(const OpQueEntry & o)
+{
+    if (this != &o) {
+        o.from->incRef();
+        if (from) {
+            from->decRef();
+        }
+        op = o.op;
+        from = o.from;
+        handle = o.handle;
+    }
+    return *this;
+}
+
+OpQueEntry & OpQueEntry::operator=(OpQueEntry && o)
+{
+    if (this != &o) {
+        if (from) {
+            from->decRef();
+        }
+        op = std::move(o.op);
+        from = o.from;
+        handle = std::move(o.handle);
+        o.from = nullptr;
+    }
+    return *this;
 }
 
 
 OperationsDispatcher::OperationsDispatcher(const std::function<void(const Operation&, LocatedEntity&)>& operationProcessor, const std::function<double()>& timeProviderFn)
-: m_operationProcessor(operationProcessor), m_timeProviderFn(timeProviderFn), m_operation_queues_dirty(false)
+: m_operationProcessor(operationProcessor), m_timeProviderFn(timeProviderFn), m_operation_queues_dirty(false),
+  m_deadOperations(0), m_cancelledOperations(0), m_compactedOperations(0),
+  m_sliceBudget(DEFAULT_SLICE_BUDGET), m_currentSlice(DEFAULT_SLICE_BUDGET),
+  m_adaptiveSlices(false), m_averageOpCost(0.), m_ioHandlers(0),
+  m_sliceOverruns(0)
 {
 }
 
@@ -62,6 +124,104 @@ void OperationsDispatcher::clearQueues()
 {
     m_immediateQueue = OpQueue();
     m_operationQueue = OpPriorityQueue();
+    if (m_timingWheel) {
+        m_timingWheel->clear();
+    }
+    m_deadOperations = 0;
+}
+
+void OperationsDispatcher::compactQueues()
+{
+    size_t removed;
+    if (m_timingWheel) {
+        removed = m_timingWheel->removeCancelled();
+    } else {
+        std::vector<OpQueEntry> entries;
+        entries.reserve(m_operationQueue.size());
+        size_t total = m_operationQueue.size();
+        while (!m_operationQueue.empty()) {
+            if (!m_operationQueue.top().isCancelled()) {
+                entries.push_back(m_operationQueue.top());
+            }
+            m_operationQueue.pop();
+        }
+        removed = total - entries.size();
+        m_operationQueue = OpPriorityQueue(std::greater<OpQueEntry>(),
+                                           std::move(entries));
+    }
+    //Any remaining dead entries are in the immediate queue, which is
+    //drained quickly enough anyway.
+    m_deadOperations -= std::min(removed, m_deadOperations);
+    m_compactedOperations += removed;
+    debug(std::cout << "Compacted " << removed << " cancelled operations"
+                    << std::endl << std::flush;);
+}
+
+void OperationsDispatcher::useTimingWheel(double resolution)
+{
+    m_timingWheel.reset(new OpTimingWheel(resolution, getTime()));
+    while (!m_operationQueue.empty()) {
+        m_timingWheel->push(m_operationQueue.top());
+        m_operationQueue.pop();
+    }
+}
+
+size_t OperationsDispatcher::futureQueueSize() const
+{
+    if (m_timingWheel) {
+        return m_timingWheel->size();
+    }
+    return m_operationQueue.size();
+}
+
+void OperationsDispatcher::setSliceBudget(double seconds)
+{
+    m_sliceBudget = seconds;
+    m_currentSlice = seconds;
+}
+
+void OperationsDispatcher::setAdaptiveSlices(bool adaptive)
+{
+    m_adaptiveSlices = adaptive;
+    m_currentSlice = m_sliceBudget;
+}
+
+void OperationsDispatcher::reportIoHandlers(size_t handlers)
+{
+    m_ioHandlers += handlers;
+}
+
+void OperationsDispatcher::adaptSlice()
+{
+    double minimum = std::max(m_sliceBudget * ADAPTIVE_MIN_FACTOR,
+                              m_averageOpCost * ADAPTIVE_MIN_OPS);
+    minimum = std::min(minimum, m_sliceBudget);
+    if (m_ioHandlers > 0) {
+        //Clients are waiting; give them more frequent attention.
+        m_currentSlice *= 0.75;
+    } else {
+        m_currentSlice *= 1.25;
+    }
+    m_currentSlice = std::min(std::max(m_currentSlice, minimum), m_sliceBudget);
+    m_ioHandlers = 0;
+}
+
+bool OperationsDispatcher::isFutureOpDue(double time) const
+{
+    if (m_timingWheel) {
+        return m_timingWheel->isDue(time);
+    }
+    return !m_operationQueue.empty() && m_operationQueue.top()->getSeconds() <= time;
+}
+
+OpQueEntry OperationsDispatcher::popFutureOp()
+{
+    if (m_timingWheel) {
+        return m_timingWheel->pop();
+    }
+    OpQueEntry opQueueEntry = m_operationQueue.top();
+    m_operationQueue.pop();
+    return opQueueEntry;
 }
 
 void OperationsDispatcher::dispatchOperation(const OpQueEntry& oqe)
@@ -91,6 +251,28 @@ void OperationsDispatcher::dispatchOperation(const OpQueEntry& oqe)
 /// the entity that is responsible for adding the operation to the
 /// queue.
 void OperationsDispatcher::addOperationToQueue(const Operation & op, LocatedEntity & ent)
+{
+    queueOperation(op, ent, OpHandle());
+}
+
+OpHandle OperationsDispatcher::scheduleOperation(const Operation & op, LocatedEntity & ent)
+{
+    OpHandle handle = OpHandle::create();
+    queueOperation(op, ent, handle);
+    return handle;
+}
+
+void OperationsDispatcher::cancelOperation(OpHandle & handle)
+{
+    if (handle.dequeue()) {
+        ++m_deadOperations;
+        ++m_cancelledOperations;
+    }
+    handle.reset();
+}
+
+void OperationsDispatcher::queueOperation(const Operation & op, LocatedEntity & ent,
+                                          const OpHandle & handle)
 {
     assert(op.isValid());
     assert(op->getFrom() != "cheat");
@@ -99,13 +281,21 @@ void OperationsDispatcher::addOperationToQueue(const Operation & op, LocatedEnti
     op->setFrom(ent.getId());
     if (!op->hasAttrFlag(Atlas::Objects::Operation::FUTURE_SECONDS_FLAG)) {
         op->setSeconds(getTime());
-        m_immediateQueue.push(OpQueEntry(op, ent));
+        OpQueEntry entry(op, ent);
+        entry.handle = handle;
+        m_immediateQueue.push(std::move(entry));
         return;
     }
     double t = getTime() + (op->getFutureSeconds() * consts::time_multiplier);
     op->setSeconds(t);
     op->setFutureSeconds(0.);
-    m_operationQueue.push(OpQueEntry(op, ent));
+    OpQueEntry entry(op, ent);
+    entry.handle = handle;
+    if (m_timingWheel) {
+        m_timingWheel->push(std::move(entry));
+    } else {
+        m_operationQueue.push(std::move(entry));
+    }
     if (debug_flag) {
         std::cout << "WorldRouter::addOperationToQueue {" << std::endl;
         debug_dump(op, std::cout);
@@ -113,6 +303,12 @@ void OperationsDispatcher::addOperationToQueue(const Operation & op, LocatedEnti
     }
 }
 
+double OperationsDispatcher::wallTime() const
+{
+    typedef std::chrono::steady_clock clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
 bool OperationsDispatcher::idle()
 {
     unsigned int op_count = 0;
@@ -120,17 +316,39 @@ bool OperationsDispatcher::idle()
     double realtime = getTime();
     bool result = false;
 
+    if (m_adaptiveSlices) {
+        adaptSlice();
+    }
+    //The world time is only updated between calls, so the wall clock is
+    //used to measure the slice.
+    const double sliceStart = wallTime();
+    double opStart = sliceStart;
+    double sliceLength = 0.;
+
+    if (m_timingWheel) {
+        m_timingWheel->advance(realtime);
+    }
+
     while (true) {
         if (!m_immediateQueue.empty()) {
-            ++op_count;
             auto opQueueEntry = std::move(m_immediateQueue.front());
             m_immediateQueue.pop();
-            dispatchOperation(opQueueEntry);
-        } else if (!m_operationQueue.empty() && m_operationQueue.top()->getSeconds() <= realtime) {
+            if (opQueueEntry.handle.isValid() && !opQueueEntry.handle.dequeue()) {
+                //The operation has been cancelled.
+                --m_deadOperations;
+                continue;
+            }
             ++op_count;
-            auto opQueueEntry = m_operationQueue.top();
+            dispatchOperation(opQueueEntry);
+        } else if (isFutureOpDue(realtime)) {
             //Pop it before we dispatch it, since dispatching might alter the queue.
-            m_operationQueue.pop();
+            auto opQueueEntry = popFutureOp();
+            if (opQueueEntry.handle.isValid() && !opQueueEntry.handle.dequeue()) {
+                //The operation has been cancelled.
+                --m_deadOperations;
+                continue;
+            }
+            ++op_count;
             dispatchOperation(opQueueEntry);
         } else {
             //There were neither any immediate ops to dispatch, or any regular ops that were ready for dispatch.
@@ -139,15 +357,24 @@ bool OperationsDispatcher::idle()
             break;
         }
 
-        if (op_count >= 10) {
-            //we've processed 10 ops, we should return to allow for IO to interleave. Check if there are more
+        double opEnd = wallTime();
+        double opCost = opEnd - opStart;
+        m_averageOpCost += (opCost - m_averageOpCost) * OP_COST_WEIGHT;
+        if (opCost > m_currentSlice) {
+            ++m_sliceOverruns;
+        }
+        opStart = opEnd;
+        sliceLength = opEnd - sliceStart;
+
+        if (sliceLength >= m_currentSlice) {
+            //we've used up the slice, we should return to allow for IO to interleave. Check if there are more
             //ops that should be processed now.
 
             // If there are still immediate or regular ops to deliver return true
             // to tell the server not to sleep when polling clients. This ensures
             // that we keep processing ops at a the maximum rate without leaving
             // clients unattended.
-            if (!m_immediateQueue.empty() || (!m_operationQueue.empty() && m_operationQueue.top()->getSeconds() <= realtime)) {
+            if (!m_immediateQueue.empty() || isFutureOpDue(realtime)) {
                 result = true;
                 break;
             } else {
@@ -156,8 +383,23 @@ bool OperationsDispatcher::idle()
             }
         }
     }
+    //Cancelled operations are normally discarded when they are due, but
+    //if they make up a large part of the queue we remove them right away,
+    //to keep the memory use and the cost of queue operations down.
+    if (m_deadOperations >= COMPACTION_MIN_DEAD &&
+        m_deadOperations * 4 > futureQueueSize()) {
+        compactQueues();
+    }
+    if (op_count > 0) {
+        Monitors::instance()->insert("dispatch_slice_budget_us", (Atlas::Message::IntType) (m_currentSlice * 1000000));
+        Monitors::instance()->insert("dispatch_slice_length_us", (Atlas::Message::IntType) (sliceLength * 1000000));
+        Monitors::instance()->insert("dispatch_slice_ops", (Atlas::Message::IntType) op_count);
+        Monitors::instance()->insert("dispatch_slice_overruns", (Atlas::Message::IntType) m_sliceOverruns);
+    }
+    Monitors::instance()->insert("cancelled_operations", (Atlas::Message::IntType) m_cancelledOperations);
+    Monitors::instance()->insert("compacted_operations", (Atlas::Message::IntType) m_compactedOperations);
     Monitors::instance()->insert("immediate_operations_queue", (Atlas::Message::IntType) m_immediateQueue.size());
-    Monitors::instance()->insert("operations_queue", (Atlas::Message::IntType) m_operationQueue.size());
+    Monitors::instance()->insert("operations_queue", (Atlas::Message::IntType) futureQueueSize());
     return result;
 }
 
@@ -180,6 +422,12 @@ double OperationsDispatcher::getTime() const
 }
 
 double OperationsDispatcher::secondsUntilNextOp() const {
+    if (m_timingWheel) {
+        if (m_timingWheel->empty()) {
+            return 600.0;
+        }
+        return m_timingWheel->nextOpTime() - getTime();
+    }
     if (m_operationQueue.empty()) {
         //600 is a fairly large number of seconds
         return 600.0;
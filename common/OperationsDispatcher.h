@@ -20,6 +20,7 @@
 #define OPERATIONSDISPATCHER_H_
 
 #include "OperationRouter.h"
+#include "OpHandle.h"
 
 #include <Atlas/Objects/RootOperation.h>
 
@@ -27,19 +28,27 @@
 #include <set>
 #include <queue>
 #include <functional>
+#include <memory>
 
 class LocatedEntity;
+class OpTimingWheel;
 
 /// \brief Type to hold an operation and the Entity it is from for efficiency
 /// when broadcasting.
 struct OpQueEntry {
     Operation op;
     LocatedEntity* from;
+    /// Set if the operation can be cancelled.
+    OpHandle handle;
 
     explicit OpQueEntry(const Operation & o, LocatedEntity & f);
     OpQueEntry(const OpQueEntry & o);
+    OpQueEntry(OpQueEntry && o);
     ~OpQueEntry();
 
+    OpQueEntry & operator=(const OpQueEntry & o);
+    OpQueEntry & operator=(OpQueEntry && o);
+
     const Operation & operator*() const {
         return op;
     }
@@ -48,6 +57,11 @@ struct OpQueEntry {
         return op.get();
     }
 
+    /// \brief Checks if the operation has been cancelled while queued.
+    bool isCancelled() const {
+        return handle.isValid() && !handle.isPending();
+    }
+
     bool operator<(const OpQueEntry& right) const {
         return op->getSeconds() < right->getSeconds();
     }
@@ -76,9 +90,9 @@ class OperationsDispatcher
         /// \brief Main world loop function.
         /// This function is called whenever the communications code is idle.
         /// It updates the in-game time, and dispatches operations that are
-        /// now due for dispatch. The number of operations dispatched is limited
-        /// to 10 to ensure that client communications are always handled in a timely
-        /// manner. If the maximum number of operations are dispatched, the return
+        /// now due for dispatch. The time spent dispatching operations is limited
+        /// to a slice budget to ensure that client communications are always handled
+        /// in a timely manner. If the budget is used up, the return
         /// value indicates that this is the case, and the communications code
         /// will call this function again as soon as possible rather than sleeping.
         /// This ensures that the maximum possible number of operations are dispatched
@@ -119,6 +133,70 @@ class OperationsDispatcher
          */
         void addOperationToQueue(const Operation &,
                         LocatedEntity &);
+
+        /**
+         * @brief Adds an operation to the queue, returning a handle which
+         * can be used to cancel it.
+         *
+         * @param The operation to add.
+         * @param The located entity it belongs to.
+         * @return A handle to the queued operation.
+         */
+        OpHandle scheduleOperation(const Operation &,
+                        LocatedEntity &);
+
+        /**
+         * @brief Cancels an operation queued through scheduleOperation().
+         *
+         * The operation is left in the queue, but will be discarded rather
+         * than dispatched. Cancelled operations are removed from the queue
+         * in bulk once enough of them have accumulated.
+         * Nothing happens if the operation already has been dispatched.
+         * @param handle The handle to the operation. It will be reset.
+         */
+        void cancelOperation(OpHandle & handle);
+
+        /**
+         * @brief Switches to keeping future operations in a hierarchical
+         * timing wheel rather than in a priority queue.
+         *
+         * Any operations already queued are moved over to the wheel.
+         * @param resolution The length of a tick in the wheel, in seconds.
+         */
+        void useTimingWheel(double resolution);
+
+        /**
+         * @brief Gets the number of operations queued for the future.
+         */
+        size_t futureQueueSize() const;
+
+        /**
+         * @brief Sets the wall clock time idle() may spend dispatching
+         * operations before returning to allow for IO.
+         *
+         * At least one operation is always dispatched.
+         * @param seconds The budget, in seconds.
+         */
+        void setSliceBudget(double seconds);
+
+        /**
+         * @brief Enables or disables adaptive slices.
+         *
+         * In adaptive mode the slice budget is continuously adjusted. It's
+         * shrunk while there is IO waiting to be handled, and grown back
+         * towards the configured budget when there is not. It's never made
+         * shorter than what is needed to dispatch a couple of operations
+         * of average cost.
+         */
+        void setAdaptiveSlices(bool adaptive);
+
+        /**
+         * @brief Reports the number of IO handlers run since the last call
+         * to idle().
+         *
+         * This is used to size the slices in adaptive mode.
+         */
+        void reportIoHandlers(size_t handlers);
     protected:
 
         std::function<void(const Operation&, LocatedEntity&)> m_operationProcessor;
@@ -126,10 +204,48 @@ class OperationsDispatcher
 
         /// An ordered queue of operations to be dispatched in the future
         OpPriorityQueue m_operationQueue;
+        /// If set, used instead of m_operationQueue for future operations.
+        std::unique_ptr<OpTimingWheel> m_timingWheel;
         /// An ordered queue of operations to be dispatched now
         OpQueue m_immediateQueue;
         /// Keeps track of if the operation queues are dirty.
         bool m_operation_queues_dirty;
+        /// Number of cancelled operations still in the queues.
+        size_t m_deadOperations;
+        /// Total number of cancelled operations.
+        long m_cancelledOperations;
+        /// Total number of cancelled operations removed through compaction.
+        long m_compactedOperations;
+
+        /// The configured slice budget, in seconds.
+        double m_sliceBudget;
+        /// The budget of the next slice, in seconds.
+        double m_currentSlice;
+        /// If true the slice budget is adjusted by adaptSlice().
+        bool m_adaptiveSlices;
+        /// Moving average of the time taken to dispatch an operation.
+        double m_averageOpCost;
+        /// Number of IO handlers run since the last slice.
+        size_t m_ioHandlers;
+        /// Number of slices in which a single operation used up more than
+        /// the whole budget.
+        long m_sliceOverruns;
+
+        /**
+         * @brief Adjusts the budget of the next slice, in adaptive mode.
+         */
+        void adaptSlice();
+
+        /**
+         * @brief Adds an operation to the appropriate queue.
+         */
+        void queueOperation(const Operation & op, LocatedEntity & ent,
+                        const OpHandle & handle);
+
+        /**
+         * @brief Removes cancelled operations from the future queue.
+         */
+        void compactQueues();
 
         /**
          * @brief Dispatches the operation contained in the OpQueueEntry.
@@ -137,8 +253,24 @@ class OperationsDispatcher
          */
         void dispatchOperation(const OpQueEntry& opQueueEntry);
 
+        /**
+         * @brief Checks if the next future operation is due for dispatch.
+         * @param time The current time.
+         */
+        bool isFutureOpDue(double time) const;
+
+        /**
+         * @brief Removes and returns the next future operation.
+         */
+        OpQueEntry popFutureOp();
+
         double getTime() const;
 
+        /**
+         * @brief Gets the wall clock time used to measure slices, in seconds.
+         */
+        virtual double wallTime() const;
+
 };
 
 #endif /* OPERATIONSDISPATCHER_H_ */
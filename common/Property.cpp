@@ -48,6 +48,7 @@ PropertyBase::PropertyBase(unsigned int flags) : m_flags(flags)
 
 PropertyBase::~PropertyBase()
 {
+    untrack();
 }
 
 void PropertyBase::install(LocatedEntity *, const std::string & name)
@@ -20,10 +20,25 @@
 #define COMMON_PROPERTY_H
 
 #include "OperationRouter.h"
+#include "SlabPool.h"
 
 #include <Atlas/Message/Element.h>
 
+#include <algorithm>
+#include <vector>
+
 class LocatedEntity;
+class PropertyBase;
+
+/// \brief Lists of the properties of an entity which have changed, so
+/// that changes can be handled without looking at every property.
+struct PropertyChanges {
+    /// \brief Properties marked as not yet broadcast.
+    std::vector<PropertyBase *> unsent;
+    /// \brief Properties changed since they were last written to the
+    /// permanent store.
+    std::vector<PropertyBase *> unclean;
+};
 
 /// \brief Interface for Entity properties
 ///
@@ -32,19 +47,38 @@ class PropertyBase {
   protected:
     /// \brief Flags indicating how this Property should be handled
     unsigned int m_flags;
+    /// \brief Changes of the entity this is an instance property of,
+    /// which this is added to when it changes.
+    PropertyChanges * m_changes = nullptr;
+    /// \brief Name of this property on that entity.
+    const std::string * m_name = nullptr;
     explicit PropertyBase(unsigned int flags = 0);
-    PropertyBase(const PropertyBase &) = default;
+    PropertyBase(const PropertyBase &);
   public:
     virtual ~PropertyBase();
 
+    /// \brief Properties are allocated from slab pools.
+    ///
+    /// Property classes without their own are counted as PropertyBase.
+    SLAB_POOLED(properties, "PropertyBase")
+
     /// \brief Accessor for Property flags
     unsigned int flags() const { return m_flags; }
     /// \brief Accessor for Property flags
     unsigned int & flags() { return m_flags; }
 
-    void setFlags(unsigned int flags) { m_flags |= flags; }
+    void setFlags(unsigned int flags);
+
+    void resetFlags(unsigned int flags);
 
-    void resetFlags(unsigned int flags) { m_flags &= ~flags; }
+    /// \brief Name of this property on the entity tracking its changes.
+    const std::string & name() const { return *m_name; }
+
+    /// \brief Add this property to the changes of an entity whenever it
+    /// is marked as unsent or unclean.
+    void track(PropertyChanges * changes, const std::string * name);
+    /// \brief Stop adding this property to the changes of an entity.
+    void untrack();
 
     /// \brief Install this property on an entity
     ///
@@ -121,6 +155,70 @@ static const unsigned int flag_unsent = 1 << 7;
 /// be handled on a class property.
 static const unsigned int flag_instance = 1 << 8;
 
+/// \brief Flag set while a property is in the list of changes to be
+/// written to permanent store
+/// \ingroup PropertyFlags
+static const unsigned int per_changed = 1 << 9;
+
+/// \brief Copy constructor, which leaves the copy untracked.
+inline PropertyBase::PropertyBase(const PropertyBase & other) :
+    m_flags(other.m_flags & ~per_changed)
+{
+}
+
+inline void PropertyBase::setFlags(unsigned int flags)
+{
+    if (m_changes != 0 && (flags & ~m_flags & flag_unsent)) {
+        m_changes->unsent.push_back(this);
+    }
+    m_flags |= flags;
+}
+
+inline void PropertyBase::resetFlags(unsigned int flags)
+{
+    m_flags &= ~flags;
+    if (m_changes != 0 && (flags & per_clean) &&
+        !(m_flags & (per_ephem | per_changed))) {
+        m_flags |= per_changed;
+        m_changes->unclean.push_back(this);
+    }
+}
+
+inline void PropertyBase::track(PropertyChanges * changes,
+                                const std::string * name)
+{
+    if (m_changes == changes) {
+        m_name = name;
+        return;
+    }
+    untrack();
+    m_changes = changes;
+    m_name = name;
+    if (m_flags & flag_unsent) {
+        m_changes->unsent.push_back(this);
+    }
+    if (!(m_flags & (per_clean | per_ephem))) {
+        m_flags |= per_changed;
+        m_changes->unclean.push_back(this);
+    }
+}
+
+inline void PropertyBase::untrack()
+{
+    if (m_changes == 0) {
+        return;
+    }
+    auto & unsent = m_changes->unsent;
+    unsent.erase(std::remove(unsent.begin(), unsent.end(), this),
+                 unsent.end());
+    auto & unclean = m_changes->unclean;
+    unclean.erase(std::remove(unclean.begin(), unclean.end(), this),
+                  unclean.end());
+    m_flags &= ~per_changed;
+    m_changes = 0;
+    m_name = 0;
+}
+
 /// \brief Entity property template for properties with single data values
 /// \ingroup PropertyClasses
 template <typename T>
@@ -151,6 +249,8 @@ class SoftProperty : public PropertyBase {
     SoftProperty();
     explicit SoftProperty(const Atlas::Message::Element & data);
 
+    SLAB_POOLED(properties, "SoftProperty")
+
     virtual int get(Atlas::Message::Element & val) const;
     virtual void set(const Atlas::Message::Element & val);
     virtual SoftProperty * copy() const;
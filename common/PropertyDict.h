@@ -0,0 +1,263 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef COMMON_PROPERTY_DICT_H
+#define COMMON_PROPERTY_DICT_H
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class PropertyBase;
+
+/// \brief Small integer standing for a property name.
+typedef unsigned int PropertyAtom;
+
+/// \brief Table of interned property names.
+///
+/// Each name is given an atom the first time it's interned, which it keeps
+/// for the life of the process. Only the names of properties the server
+/// knows are interned, as property classes are installed and rules are
+/// loaded, so that the table can't be grown by clients setting attributes
+/// with any name they like.
+///
+/// Interning isn't thread safe, but finding the atoms of names is as long
+/// as nothing is interned at the same time.
+class PropertyAtoms {
+  protected:
+    typedef std::unordered_map<std::string, PropertyAtom> AtomDict;
+
+    static AtomDict & atoms() {
+        static AtomDict table;
+        return table;
+    }
+
+    /// \brief The names, indexed by atom. References to them stay valid.
+    static std::deque<std::string> & names() {
+        static std::deque<std::string> table;
+        return table;
+    }
+
+  public:
+    /// \brief Returned for names which have not been interned.
+    static const PropertyAtom NONE = ~0u;
+
+    /// \brief Get the atom of a name, interning it if it's new.
+    ///
+    /// Only to be called with names of properties known to the server.
+    static PropertyAtom intern(const std::string & name) {
+        auto I = atoms().insert(std::make_pair(name, (PropertyAtom)names().size()));
+        if (I.second) {
+            names().push_back(name);
+        }
+        return I.first->second;
+    }
+
+    /// \brief Get the atom of a name, or NONE if it has not been interned.
+    static PropertyAtom find(const std::string & name) {
+        auto I = atoms().find(name);
+        if (I == atoms().end()) {
+            return NONE;
+        }
+        return I->second;
+    }
+
+    /// \brief Get the name of an atom.
+    static const std::string & name(PropertyAtom atom) {
+        return names()[atom];
+    }
+};
+
+/// \brief Properties of an entity or type, keyed by the atoms of their
+/// names.
+///
+/// The entries are held in a vector sorted by atom, so looking a property
+/// up is a binary search of a few contiguous integers rather than string
+/// comparisons down a tree. It has the parts of the interface of std::map
+/// that are used for properties, though entries aren't in order of name,
+/// and inserting or erasing invalidates iterators.
+///
+/// A property whose name hasn't been interned is given an atom local to
+/// the dictionary, which sorts after the interned ones and is found by
+/// comparing names. Either kind of atom is turned back into a name by
+/// name().
+class PropertyDict {
+  public:
+    typedef std::pair<PropertyAtom, PropertyBase *> value_type;
+    typedef std::vector<value_type>::iterator iterator;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+
+    /// \brief Bit set in atoms local to the dictionary.
+    static const PropertyAtom LOCAL = 1u << 31;
+
+  protected:
+    std::vector<value_type> m_entries;
+    /// \brief Names of the entries with local atoms, indexed by the rest of
+    /// the atom. The names of erased entries are left empty for reuse.
+    /// References to them stay valid.
+    std::deque<std::string> m_localNames;
+
+    size_t lowerBound(PropertyAtom atom) const {
+        return std::lower_bound(m_entries.begin(), m_entries.end(), atom,
+                                [](const value_type & entry, PropertyAtom a) {
+                                    return entry.first < a;
+                                }) - m_entries.begin();
+    }
+
+    size_t index(PropertyAtom atom) const {
+        size_t i = lowerBound(atom);
+        return (i != m_entries.size() && m_entries[i].first == atom)
+                       ? i : m_entries.size();
+    }
+
+    /// \brief Get the index of the entry with a name, given the interned
+    /// atom of the name, or size() if there is none.
+    size_t index(const std::string & name, PropertyAtom atom) const {
+        if (atom != PropertyAtoms::NONE) {
+            size_t j = index(atom);
+            if (j != m_entries.size()) {
+                return j;
+            }
+        }
+        // The name has a local atom if it isn't interned, or if it has
+        // been interned since it was given one.
+        for (size_t i = 0; i < m_localNames.size(); ++i) {
+            if (m_localNames[i] == name) {
+                size_t j = index(LOCAL | i);
+                if (j != m_entries.size()) {
+                    return j;
+                }
+            }
+        }
+        return m_entries.size();
+    }
+
+    /// \brief Give a name a local atom.
+    PropertyAtom addLocalName(const std::string & name) {
+        for (size_t i = 0; i < m_localNames.size(); ++i) {
+            if (m_localNames[i].empty() &&
+                index(LOCAL | i) == m_entries.size()) {
+                m_localNames[i] = name;
+                return LOCAL | i;
+            }
+        }
+        m_localNames.push_back(name);
+        return LOCAL | (m_localNames.size() - 1);
+    }
+
+  public:
+    iterator begin() { return m_entries.begin(); }
+    iterator end() { return m_entries.end(); }
+    const_iterator begin() const { return m_entries.begin(); }
+    const_iterator end() const { return m_entries.end(); }
+
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+
+    iterator find(PropertyAtom atom) {
+        return m_entries.begin() + index(atom);
+    }
+
+    const_iterator find(PropertyAtom atom) const {
+        return m_entries.begin() + index(atom);
+    }
+
+    /// \brief Find an entry by name, given the interned atom of the name,
+    /// or NONE if it has none, so the name isn't looked up again.
+    const_iterator find(const std::string & name, PropertyAtom atom) const {
+        return m_entries.begin() + index(name, atom);
+    }
+
+    iterator find(const std::string & name) {
+        return m_entries.begin() + index(name, PropertyAtoms::find(name));
+    }
+
+    const_iterator find(const std::string & name) const {
+        return m_entries.begin() + index(name, PropertyAtoms::find(name));
+    }
+
+    size_t count(const std::string & name) const {
+        return find(name) == end() ? 0 : 1;
+    }
+
+    /// \brief Get the name of an atom of an entry.
+    const std::string & name(PropertyAtom atom) const {
+        return (atom & LOCAL) ? m_localNames[atom & ~LOCAL]
+                              : PropertyAtoms::name(atom);
+    }
+
+    /// \brief Insert an entry, unless there already is one with the atom.
+    std::pair<iterator, bool> insert(const value_type & entry) {
+        size_t i = lowerBound(entry.first);
+        if (i != m_entries.size() && m_entries[i].first == entry.first) {
+            return std::make_pair(m_entries.begin() + i, false);
+        }
+        return std::make_pair(m_entries.insert(m_entries.begin() + i, entry),
+                              true);
+    }
+
+    /// \brief Insert an entry, unless there already is one with the name.
+    ///
+    /// The name isn't interned, but given a local atom if it hasn't been.
+    std::pair<iterator, bool> insert(const std::string & name,
+                                     PropertyBase * prop) {
+        PropertyAtom atom = PropertyAtoms::find(name);
+        size_t i = index(name, atom);
+        if (i != m_entries.size()) {
+            return std::make_pair(m_entries.begin() + i, false);
+        }
+        if (atom == PropertyAtoms::NONE) {
+            atom = addLocalName(name);
+        }
+        return insert(value_type(atom, prop));
+    }
+
+    PropertyBase *& operator[](const std::string & name) {
+        return insert(name, nullptr).first->second;
+    }
+
+    PropertyBase *& operator[](PropertyAtom atom) {
+        return insert(value_type(atom, nullptr)).first->second;
+    }
+
+    iterator erase(const_iterator I) {
+        if (I->first & LOCAL) {
+            m_localNames[I->first & ~LOCAL].clear();
+        }
+        return m_entries.erase(m_entries.begin() + (I - m_entries.begin()));
+    }
+
+    size_t erase(const std::string & name) {
+        const_iterator I = find(name);
+        if (I == end()) {
+            return 0;
+        }
+        erase(I);
+        return 1;
+    }
+
+    void clear() {
+        m_entries.clear();
+        m_localNames.clear();
+    }
+};
+
+#endif // COMMON_PROPERTY_DICT_H
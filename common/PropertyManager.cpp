@@ -18,6 +18,7 @@
 
 #include "PropertyManager.h"
 
+#include "PropertyDict.h"
 #include "PropertyFactory.h"
 
 #include <cassert>
@@ -59,6 +60,9 @@ PropertyKit * PropertyManager::getPropertyFactory(const std::string & name) cons
 void PropertyManager::installFactory(const std::string & name,
                                      PropertyKit * factory)
 {
+    // Properties with factories are known to the server, so their names
+    // are interned.
+    PropertyAtoms::intern(name);
     m_propertyFactories.insert(std::make_pair(name, factory));
 }
 
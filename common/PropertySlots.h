@@ -0,0 +1,154 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef COMMON_PROPERTY_SLOTS_H
+#define COMMON_PROPERTY_SLOTS_H
+
+#include <atomic>
+#include <string>
+
+#include <cstdint>
+
+class BBoxProperty;
+class DomainProperty;
+class EntityProperty;
+class OutfitProperty;
+class PropertyBase;
+class StatusProperty;
+
+template <typename T>
+class Property;
+
+/// \brief Well-known properties which hot code asks entities for.
+///
+/// The property an entity has for each slot is found the first time it's
+/// asked for, and then kept until the properties of the entity or of any
+/// type change. Each slot has a tag type naming the property and the class
+/// it's installed with, so getting a property by slot needs no lookup by
+/// name and no dynamic_cast once the slot has been resolved.
+namespace PropertySlots {
+    enum {
+        MODE,
+        OUTFIT,
+        RIGHT_HAND_WIELD,
+        DOMAIN,
+        STATUS,
+        MASS,
+        BIOMASS,
+        BBOX,
+        COUNT
+    };
+
+    /// \brief Counter bumped whenever the class properties of any type
+    /// change, which invalidates the slots of every entity.
+    inline unsigned int & typeGeneration() {
+        static unsigned int generation = 0;
+        return generation;
+    }
+}
+
+/// \brief Base of the slot tags, giving the index of the slot and the
+/// class of its property.
+template <int Index, class PropertyT>
+struct PropertySlot {
+    typedef PropertyT type;
+    static const int index = Index;
+};
+
+#define PROPERTY_SLOT(_tag, _index, _class, _name) \
+struct _tag : public PropertySlot<PropertySlots::_index, _class > { \
+    static const std::string & name() { \
+        static const std::string n(_name); \
+        return n; \
+    } \
+};
+
+PROPERTY_SLOT(ModeSlot, MODE, PropertyBase, "mode")
+PROPERTY_SLOT(OutfitSlot, OUTFIT, OutfitProperty, "outfit")
+PROPERTY_SLOT(RightHandWieldSlot, RIGHT_HAND_WIELD, EntityProperty,
+              "right_hand_wield")
+PROPERTY_SLOT(DomainSlot, DOMAIN, DomainProperty, "domain")
+PROPERTY_SLOT(StatusSlot, STATUS, StatusProperty, "status")
+PROPERTY_SLOT(MassSlot, MASS, Property<double>, "mass")
+PROPERTY_SLOT(BiomassSlot, BIOMASS, Property<double>, "biomass")
+PROPERTY_SLOT(BBoxSlot, BBOX, BBoxProperty, "bbox")
+
+#undef PROPERTY_SLOT
+
+/// \brief The properties an entity has been found to have for each slot.
+///
+/// Slots are resolved from const accessors, which visibility checks call
+/// from the perception worker threads, so several threads may resolve the
+/// same slot at once. They all find the same property, and a slot is only
+/// marked as resolved once its property has been stored. Properties and
+/// types are only changed from the world thread while no checks are
+/// running.
+///
+/// The type generation the slots were resolved in is kept in the same word
+/// as the bits marking them resolved, so no thread can see the bits of one
+/// generation with another generation.
+struct PropertySlotCache {
+    std::atomic<PropertyBase *> properties[PropertySlots::COUNT];
+    /// \brief Type generation the slots were resolved in, in the high 32
+    /// bits, and a bit per slot set once it has been resolved.
+    std::atomic<std::uint64_t> resolved{0};
+    /// \brief Bit per slot set if its property is an instance property.
+    std::atomic<unsigned int> instance{0};
+
+    static std::uint64_t generationBits() {
+        return (std::uint64_t)PropertySlots::typeGeneration() << 32;
+    }
+
+    /// \brief Check whether a slot is resolved and still valid.
+    ///
+    /// Slots resolved in an earlier generation are taken as unresolved, and
+    /// are cleared when one is next resolved.
+    bool isResolved(int index) const {
+        std::uint64_t bits = resolved.load(std::memory_order_acquire);
+        return (bits >> 32) == PropertySlots::typeGeneration() &&
+               (bits & (1u << index)) != 0;
+    }
+
+    bool isInstance(int index) const {
+        return (instance.load(std::memory_order_relaxed) & (1u << index)) != 0;
+    }
+
+    PropertyBase * get(int index) const {
+        return properties[index].load(std::memory_order_relaxed);
+    }
+
+    /// \brief Store the property for a slot, and mark it as resolved.
+    void set(int index, PropertyBase * p) {
+        properties[index].store(p, std::memory_order_relaxed);
+        std::uint64_t generation = generationBits();
+        std::uint64_t bits = resolved.load(std::memory_order_relaxed);
+        std::uint64_t marked;
+        do {
+            marked = ((bits & ~0xffffffffull) == generation ? bits : generation)
+                     | (1u << index);
+        } while (!resolved.compare_exchange_weak(bits, marked,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+    }
+
+    void invalidate() {
+        resolved.store(generationBits(), std::memory_order_relaxed);
+    }
+};
+
+#endif // COMMON_PROPERTY_SLOTS_H
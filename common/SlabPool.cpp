@@ -0,0 +1,48 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "SlabPool.h"
+
+#include "Monitors.h"
+#include "Variable.h"
+#include "compose.hpp"
+
+static void watchSlabPool(const std::string & kind, SlabPool & pool)
+{
+    Monitors::instance()->watch(String::compose("slab_objects{pool=\"%1\",size=\"%2\"}",
+                                                kind, pool.size()),
+                                new Variable<std::int64_t>(pool.objects()));
+    Monitors::instance()->watch(String::compose("slab_bytes{pool=\"%1\",size=\"%2\"}",
+                                                kind, pool.size()),
+                                new Variable<std::int64_t>(pool.bytes()));
+}
+
+static void watchSlabClass(const std::string & kind, SlabClass & cls)
+{
+    Monitors::instance()->watch(String::compose("slab_class_objects{pool=\"%1\",class=\"%2\"}",
+                                                kind, cls.name()),
+                                new Variable<std::int64_t>(cls.objects()));
+    Monitors::instance()->watch(String::compose("slab_class_bytes{pool=\"%1\",class=\"%2\"}",
+                                                kind, cls.name()),
+                                new Variable<std::int64_t>(cls.bytes()));
+}
+
+void watchSlabPools()
+{
+    SlabPools::setWatcher(&watchSlabPool, &watchSlabClass);
+}
@@ -0,0 +1,302 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef COMMON_SLAB_POOL_H
+#define COMMON_SLAB_POOL_H
+
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/// \brief Pool of blocks of one size, carved out of large slabs.
+///
+/// Blocks which are freed are kept on a free list and handed out again
+/// first, so objects of the same size are packed together rather than
+/// spread around the heap. Slabs are only given back when the pool is
+/// destroyed, which the pools shared by entities and properties never are.
+///
+/// Pools aren't thread safe. Entities and properties are only created
+/// and destroyed in the world thread.
+class SlabPool {
+  protected:
+    struct Block {
+        Block * next;
+    };
+
+    /// \brief Minimum size of each slab.
+    static const std::size_t SLAB_SIZE = 64 * 1024;
+
+    const std::size_t m_size;
+    Block * m_free;
+    std::vector<char *> m_slabs;
+
+    /// \brief Number of blocks handed out.
+    std::int64_t m_objects;
+    /// \brief Number of bytes in slabs.
+    std::int64_t m_bytes;
+
+    void grow() {
+        std::size_t count = std::max<std::size_t>(SLAB_SIZE / m_size, 8);
+        char * slab = static_cast<char *>(::operator new(count * m_size));
+        m_slabs.push_back(slab);
+        // Link the blocks so they're handed out in address order.
+        for (std::size_t i = count; i-- > 0;) {
+            Block * block = reinterpret_cast<Block *>(slab + i * m_size);
+            block->next = m_free;
+            m_free = block;
+        }
+        m_bytes += count * m_size;
+    }
+
+  public:
+    explicit SlabPool(std::size_t size) : m_size(size), m_free(nullptr),
+                                          m_objects(0), m_bytes(0) { }
+
+    ~SlabPool() {
+        for (char * slab : m_slabs) {
+            ::operator delete(slab);
+        }
+    }
+
+    SlabPool(const SlabPool &) = delete;
+    SlabPool & operator=(const SlabPool &) = delete;
+
+    std::size_t size() const { return m_size; }
+
+    const std::int64_t & objects() const { return m_objects; }
+
+    const std::int64_t & bytes() const { return m_bytes; }
+
+    void * allocate() {
+        if (m_free == nullptr) {
+            grow();
+        }
+        Block * block = m_free;
+        m_free = block->next;
+        ++m_objects;
+        return block;
+    }
+
+    void deallocate(void * p) {
+        Block * block = static_cast<Block *>(p);
+        block->next = m_free;
+        m_free = block;
+        --m_objects;
+    }
+};
+
+/// \brief Count of the objects of one class allocated from slab pools.
+///
+/// Pools are shared by every class of the same size, so these are what
+/// tell such classes apart.
+class SlabClass {
+  protected:
+    const std::string m_name;
+    std::int64_t m_objects;
+    std::int64_t m_bytes;
+
+  public:
+    explicit SlabClass(const std::string & name) : m_name(name),
+                                                   m_objects(0),
+                                                   m_bytes(0) { }
+
+    SlabClass(const SlabClass &) = delete;
+    SlabClass & operator=(const SlabClass &) = delete;
+
+    const std::string & name() const { return m_name; }
+
+    const std::int64_t & objects() const { return m_objects; }
+
+    /// \brief Number of bytes in the objects, not counting the rest of the
+    /// slabs they're in.
+    const std::int64_t & bytes() const { return m_bytes; }
+
+    void added(std::size_t size) {
+        ++m_objects;
+        m_bytes += size;
+    }
+
+    void removed(std::size_t size) {
+        --m_objects;
+        m_bytes -= size;
+    }
+};
+
+/// \brief The slab pools objects of one kind are allocated from, with a
+/// pool for each size of object.
+///
+/// Classes use these from their own operator new and operator delete, which
+/// are given the size of the class actually being created or destroyed, so
+/// every subclass ends up in a pool holding objects of its own size.
+/// Objects too large to be worth pooling are left to the heap.
+class SlabPools {
+  public:
+    /// \brief Function told about each pool when it's created.
+    typedef void (*Watcher)(const std::string & kind, SlabPool & pool);
+    /// \brief Function told about each class when it's added.
+    typedef void (*ClassWatcher)(const std::string & kind, SlabClass & cls);
+
+  protected:
+    /// \brief Sizes of the pools are multiples of this, which keeps the
+    /// blocks aligned for any type.
+    static const std::size_t GRAIN = alignof(std::max_align_t);
+    static const std::size_t MAX_SIZE = 4096;
+
+    const std::string m_kind;
+    std::vector<SlabPool *> m_pools;
+    std::vector<SlabClass *> m_classes;
+
+    explicit SlabPools(const std::string & kind) :
+          m_kind(kind), m_pools(MAX_SIZE / GRAIN + 1, nullptr) { }
+
+    static Watcher & watcher() {
+        static Watcher w = nullptr;
+        return w;
+    }
+
+    static ClassWatcher & classWatcher() {
+        static ClassWatcher w = nullptr;
+        return w;
+    }
+
+    SlabPool & pool(std::size_t size) {
+        std::size_t index = (size + GRAIN - 1) / GRAIN;
+        SlabPool * p = m_pools[index];
+        if (p == nullptr) {
+            p = m_pools[index] = new SlabPool(index * GRAIN);
+            if (watcher() != nullptr) {
+                watcher()(m_kind, *p);
+            }
+        }
+        return *p;
+    }
+
+    void watchPools() {
+        for (SlabPool * p : m_pools) {
+            if (p != nullptr && watcher() != nullptr) {
+                watcher()(m_kind, *p);
+            }
+        }
+        for (SlabClass * c : m_classes) {
+            if (classWatcher() != nullptr) {
+                classWatcher()(m_kind, *c);
+            }
+        }
+    }
+
+  public:
+    SlabPools(const SlabPools &) = delete;
+    SlabPools & operator=(const SlabPools &) = delete;
+
+    /// \brief The pools entities are allocated from.
+    ///
+    /// The pools are never destroyed, so objects can still be deleted
+    /// while static objects are being destroyed.
+    static SlabPools & entities() {
+        static SlabPools * pools = new SlabPools("entities");
+        return *pools;
+    }
+
+    /// \brief The pools properties are allocated from.
+    static SlabPools & properties() {
+        static SlabPools * pools = new SlabPools("properties");
+        return *pools;
+    }
+
+    /// \brief Set the functions told about each pool and class, and tell
+    /// them about those which already exist.
+    static void setWatcher(Watcher w, ClassWatcher cw = nullptr) {
+        watcher() = w;
+        classWatcher() = cw;
+        entities().watchPools();
+        properties().watchPools();
+    }
+
+    const std::string & kind() const { return m_kind; }
+
+    /// \brief Add a class whose objects are counted on their own.
+    ///
+    /// Classes are never removed, like the pools.
+    SlabClass & addClass(const std::string & name) {
+        SlabClass * c = new SlabClass(name);
+        m_classes.push_back(c);
+        if (classWatcher() != nullptr) {
+            classWatcher()(m_kind, *c);
+        }
+        return *c;
+    }
+
+    void * allocate(std::size_t size) {
+        if (size > MAX_SIZE) {
+            return ::operator new(size);
+        }
+        return pool(size).allocate();
+    }
+
+    void deallocate(void * p, std::size_t size) {
+        if (p == nullptr) {
+            return;
+        }
+        if (size > MAX_SIZE) {
+            ::operator delete(p);
+            return;
+        }
+        pool(size).deallocate(p);
+    }
+
+    void * allocate(std::size_t size, SlabClass & cls) {
+        cls.added(size);
+        return allocate(size);
+    }
+
+    void deallocate(void * p, std::size_t size, SlabClass & cls) {
+        if (p == nullptr) {
+            return;
+        }
+        cls.removed(size);
+        deallocate(p, size);
+    }
+};
+
+/// \brief Declare operator new and delete for a class, allocating it from
+/// slab pools of a kind, and counting its objects under a name.
+///
+/// A class which doesn't declare its own is counted with the nearest base
+/// class which does, as objects are deleted through the operator delete of
+/// their own class.
+#define SLAB_POOLED(_kind, _name) \
+    static SlabClass & slabClass() { \
+        static SlabClass & c = SlabPools::_kind().addClass(_name); \
+        return c; \
+    } \
+    static void * operator new(std::size_t size) { \
+        return SlabPools::_kind().allocate(size, slabClass()); \
+    } \
+    static void operator delete(void * p, std::size_t size) { \
+        SlabPools::_kind().deallocate(p, size, slabClass()); \
+    }
+
+/// \brief Report the objects and bytes in each slab pool and class through
+/// Monitors.
+void watchSlabPools();
+
+#endif // COMMON_SLAB_POOL_H
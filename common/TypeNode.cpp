@@ -21,6 +21,7 @@
 #include "debug.h"
 #include "Property.h"
 #include "PropertyManager.h"
+#include "PropertySlots.h"
 
 #include <set>
 
@@ -51,7 +52,10 @@ TypeNode::~TypeNode()
 void TypeNode::addProperty(const std::string & name,
                            PropertyBase * p)
 {
-    m_defaults[name] = p;
+    // Class properties are only added as rules are loaded, so their names
+    // are interned.
+    m_defaults[PropertyAtoms::intern(name)] = p;
+    ++PropertySlots::typeGeneration();
 }
 
 void TypeNode::addProperties(const MapType & attributes)
@@ -65,8 +69,9 @@ void TypeNode::addProperties(const MapType & attributes)
         assert(p != 0);
         p->set(J->second);
         p->setFlags(flag_class);
-        m_defaults[J->first] = p;
+        m_defaults[PropertyAtoms::intern(J->first)] = p;
     }
+    ++PropertySlots::typeGeneration();
 }
 
 void TypeNode::updateProperties(const MapType & attributes)
@@ -78,9 +83,10 @@ void TypeNode::updateProperties(const MapType & attributes)
     PropertyDict::const_iterator Iend = m_defaults.end();
     MapType::const_iterator Jend = attributes.end();
     for (; I != Iend; ++I) {
-        if (attributes.find(I->first) == Jend) {
-            debug( std::cout << I->first << " removed" << std::endl; );
-            removed_properties.insert(I->first);
+        const std::string & name = m_defaults.name(I->first);
+        if (attributes.find(name) == Jend) {
+            debug( std::cout << name << " removed" << std::endl; );
+            removed_properties.insert(name);
         }
     }
 
@@ -100,17 +106,18 @@ void TypeNode::updateProperties(const MapType & attributes)
     PropertyBase * p;
     for (; J != Jend; ++J) {
         PropertyDict::const_iterator I = m_defaults.find(J->first);
-        if (I == Iend) {
+        if (I == m_defaults.end()) {
             p = PropertyManager::instance()->addProperty(J->first,
                                                          J->second.getType());
             assert(p != 0);
             p->setFlags(flag_class);
-            m_defaults[J->first] = p;
+            m_defaults[PropertyAtoms::intern(J->first)] = p;
         } else {
             p = I->second;
         }
         p->set(J->second);
     }
+    ++PropertySlots::typeGeneration();
 }
 
 bool TypeNode::isTypeOf(const std::string & base_type) const
@@ -19,15 +19,13 @@
 #ifndef COMMON_TYPE_NODE_H
 #define COMMON_TYPE_NODE_H
 
+#include "common/PropertyDict.h"
+
 #include <Atlas/Objects/Root.h>
 #include <Atlas/Objects/SmartPtr.h>
 
 #include <iostream>
 
-class PropertyBase;
-
-typedef std::map<std::string, PropertyBase *> PropertyDict;
-
 /// \brief Entry in the type hierarchy for in-game entity classes.
 class TypeNode {
   protected:
@@ -20,6 +20,8 @@
 
 #include <iostream>
 
+#include <cstdint>
+
 VariableBase::~VariableBase()
 {
 }
@@ -47,6 +49,12 @@ bool Variable<int>::isNumeric() const
     return true;
 }
 
+template <>
+bool Variable<std::int64_t>::isNumeric() const
+{
+    return true;
+}
+
 template <>
 bool Variable<std::string>::isNumeric() const
 {
@@ -60,6 +68,7 @@ bool Variable<const char *>::isNumeric() const
 }
 
 template class Variable<int>;
+template class Variable<std::int64_t>;
 template class Variable<std::string>;
 template class Variable<const char *>;
 
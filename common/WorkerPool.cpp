@@ -0,0 +1,114 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned int threads) :
+    m_job(nullptr), m_parts(0), m_nextPart(0), m_busyThreads(0), m_batch(0),
+    m_stopping(false)
+{
+    for (unsigned int i = 0; i < threads; ++i) {
+        m_threads.emplace_back([this]() {this->work();});
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_batchStarted.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+unsigned int WorkerPool::size() const
+{
+    return m_threads.size();
+}
+
+void WorkerPool::runParts(const std::function<void(std::size_t)> & job,
+                          std::size_t parts)
+{
+    std::size_t part;
+    while ((part = m_nextPart++) < parts) {
+        job(part);
+    }
+}
+
+void WorkerPool::run(std::size_t parts,
+                     const std::function<void(std::size_t)> & job)
+{
+    //Not worth waking up the threads for a single part.
+    if (m_threads.empty() || parts < 2) {
+        for (std::size_t i = 0; i < parts; ++i) {
+            job(i);
+        }
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_parts = parts;
+        m_nextPart = 0;
+        m_busyThreads = m_threads.size();
+        ++m_batch;
+    }
+    m_batchStarted.notify_all();
+
+    runParts(job, parts);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_batchFinished.wait(lock, [this]() {return m_busyThreads == 0;});
+    m_job = nullptr;
+}
+
+void WorkerPool::work()
+{
+    unsigned long lastBatch = 0;
+    while (true) {
+        const std::function<void(std::size_t)> * job;
+        std::size_t parts;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_batchStarted.wait(lock, [&]() {
+                return m_stopping || m_batch != lastBatch;
+            });
+            if (m_stopping) {
+                return;
+            }
+            lastBatch = m_batch;
+            job = m_job;
+            parts = m_parts;
+        }
+
+        runParts(*job, parts);
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            --m_busyThreads;
+        }
+        m_batchFinished.notify_one();
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// \brief A fixed set of threads used to split up work which can be done
+/// in parallel.
+///
+/// Work is submitted as a number of independent parts, and the caller
+/// blocks until all parts are done. The calling thread takes part in the
+/// work, so a pool with no threads simply runs everything serially.
+/// Only one batch of work can be run at a time.
+class WorkerPool
+{
+    public:
+        /**
+         * @brief Ctor.
+         * @param threads The number of threads to start, in addition to
+         * the calling thread.
+         */
+        explicit WorkerPool(unsigned int threads);
+
+        ~WorkerPool();
+
+        /**
+         * @brief Gets the number of threads in the pool.
+         */
+        unsigned int size() const;
+
+        /**
+         * @brief Runs a job for every part, and waits for them to finish.
+         *
+         * The job must not throw.
+         * @param parts The number of parts.
+         * @param job Called once for each part, with the index of the part.
+         */
+        void run(std::size_t parts, const std::function<void(std::size_t)> & job);
+
+    private:
+        std::vector<std::thread> m_threads;
+
+        std::mutex m_mutex;
+
+        /// Signalled when there's a new batch to work on.
+        std::condition_variable m_batchStarted;
+
+        /// Signalled when a thread has finished working on a batch.
+        std::condition_variable m_batchFinished;
+
+        /// The job of the current batch.
+        const std::function<void(std::size_t)> * m_job;
+
+        /// The number of parts in the current batch.
+        std::size_t m_parts;
+
+        /// The next part which hasn't been picked up yet.
+        std::atomic<std::size_t> m_nextPart;
+
+        /// Number of threads still working on the current batch.
+        unsigned int m_busyThreads;
+
+        /// Increased for each new batch.
+        unsigned long m_batch;
+
+        bool m_stopping;
+
+        void work();
+
+        void runParts(const std::function<void(std::size_t)> & job,
+                      std::size_t parts);
+};
+
+#endif /* WORKERPOOL_H_ */
@@ -21,8 +21,6 @@
 
 #include "common/Property.h"
 
-#include <set>
-
 /// \brief Class to handle Entity id property
 /// \ingroup PropertyClasses
 class IdProperty : public PropertyBase {
@@ -49,7 +47,10 @@ class NameProperty : public Property<std::string> {
 
 class LocatedEntity;
 
-typedef std::set<LocatedEntity *> LocatedEntitySet;
+template <typename EntityT>
+class ChildSet;
+
+typedef ChildSet<LocatedEntity> LocatedEntitySet;
 
 /// \brief Class to handle Entity contains property
 /// \ingroup PropertyClasses
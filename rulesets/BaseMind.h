@@ -40,6 +40,8 @@ class BaseMind : public MemEntity {
     BaseMind(const std::string &, long);
     virtual ~BaseMind();
 
+    SLAB_POOLED(entities, "BaseMind")
+
     /// \brief Accessor for the memory map of world entities
     MemMap * getMap() { return &m_map; }
     /// \brief Accessor for the world time
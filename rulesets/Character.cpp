@@ -134,7 +134,7 @@ void Character::metabolise(OpVector & res, double ammount)
         // FIXME Probably don't do enough here to set up the property.
         status_prop = new StatusProperty;
         assert(status_prop != 0);
-        m_properties[STATUS] = status_prop;
+        insertProperty(STATUS, status_prop);
         status_prop->set(1.f);
         status_changed = true;
     }
@@ -422,6 +422,22 @@ std::vector<Atlas::Objects::Root> Character::getThoughts() const
     return LocatedEntity::getThoughts();
 }
 
+ThoughtChanges Character::takeThoughtChanges()
+{
+    if (m_proxyMind) {
+        return m_proxyMind->takeThoughtChanges();
+    }
+    return LocatedEntity::takeThoughtChanges();
+}
+
+/// \brief Restore thoughts read from storage, which are already stored.
+void Character::restoreThoughts(const std::vector<Atlas::Objects::Root> & thoughts)
+{
+    if (m_proxyMind) {
+        m_proxyMind->restoreThoughts(thoughts);
+    }
+}
+
 
 void Character::ImaginaryOperation(const Operation & op, OpVector & res)
 {
@@ -117,6 +117,8 @@ class Character : public Thing, public virtual sigc::trackable {
     explicit Character(const std::string & id, long intId);
     virtual ~Character();
 
+    SLAB_POOLED(entities, "Character")
+
     int linkExternal(Link *);
     int unlinkExternal(Link *);
 
@@ -125,6 +127,8 @@ class Character : public Thing, public virtual sigc::trackable {
     void clearTask(OpVector &);
 
     virtual std::vector<Atlas::Objects::Root> getThoughts() const;
+    virtual ThoughtChanges takeThoughtChanges();
+    void restoreThoughts(const std::vector<Atlas::Objects::Root> & thoughts);
 
     virtual void operation(const Operation & op, OpVector &);
     virtual void externalOperation(const Operation & op, Link &);
@@ -0,0 +1,144 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef RULESETS_CHILD_SET_H
+#define RULESETS_CHILD_SET_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+
+/// \brief Where an entity is kept in the children of its parent.
+struct ChildPosition {
+    /// \brief The set the entity was last added to.
+    const void * set = nullptr;
+    /// \brief Index of the entity in that set.
+    std::size_t index = 0;
+};
+
+/// \brief The children of an entity, kept next to each other in memory.
+///
+/// Children are in the order they were added, except that removing one
+/// moves the last child into its place, so the order never depends on
+/// where the entities happen to be allocated. Each child keeps its index
+/// in the set it was last added to, in a ChildPosition member called
+/// m_childPosition, which makes adding, finding and removing a child take
+/// constant time.
+///
+/// The interface is the part of std::set used for children, except that
+/// adding or removing a child invalidates all iterators.
+///
+/// An entity is normally the child of one entity at a time. When an
+/// entity is destroyed its children are added to its parent while still
+/// in its own set. Only finding or removing such a child in the set it
+/// has left searches that set; adding a child never does, so a child must
+/// not be added again to a set it has since been added elsewhere from.
+template <typename EntityT>
+class ChildSet {
+  protected:
+    std::vector<EntityT *> m_children;
+
+    /// \brief Check whether an entity is where its position says in this set.
+    bool isRecorded(const EntityT * child) const {
+        const ChildPosition & pos = child->m_childPosition;
+        return pos.set == this && pos.index < m_children.size() &&
+               m_children[pos.index] == child;
+    }
+
+    /// \brief Find the index of an entity, or size() if it isn't a child.
+    std::size_t indexOf(const EntityT * child) const {
+        if (isRecorded(child)) {
+            return child->m_childPosition.index;
+        }
+        return std::find(m_children.begin(), m_children.end(), child) -
+               m_children.begin();
+    }
+
+  public:
+    typedef EntityT * value_type;
+    typedef typename std::vector<EntityT *>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+    ChildSet() = default;
+
+    ChildSet(const ChildSet &) = delete;
+    ChildSet & operator=(const ChildSet &) = delete;
+
+    const_iterator begin() const { return m_children.begin(); }
+
+    const_iterator end() const { return m_children.end(); }
+
+    std::size_t size() const { return m_children.size(); }
+
+    bool empty() const { return m_children.empty(); }
+
+    const_iterator find(const EntityT * child) const {
+        return m_children.begin() + indexOf(child);
+    }
+
+    std::size_t count(const EntityT * child) const {
+        return indexOf(child) != m_children.size() ? 1 : 0;
+    }
+
+    std::pair<const_iterator, bool> insert(EntityT * child) {
+        ChildPosition & pos = child->m_childPosition;
+        // Only the position is checked, so this takes constant time even
+        // when reparenting many children into a large set. An entity whose
+        // position is elsewhere can only be in this set if it was added
+        // elsewhere from a destroyed entity, and nothing is added to that.
+        if (isRecorded(child)) {
+            return std::make_pair(begin() + pos.index, false);
+        }
+        pos.set = this;
+        pos.index = m_children.size();
+        m_children.push_back(child);
+        return std::make_pair(end() - 1, true);
+    }
+
+    std::size_t erase(EntityT * child) {
+        std::size_t index = indexOf(child);
+        if (index == m_children.size()) {
+            return 0;
+        }
+        if (child->m_childPosition.set == this) {
+            child->m_childPosition.set = nullptr;
+        }
+        EntityT * last = m_children.back();
+        m_children.pop_back();
+        if (index != m_children.size()) {
+            m_children[index] = last;
+            if (last->m_childPosition.set == this) {
+                last->m_childPosition.index = index;
+            }
+        }
+        return 1;
+    }
+
+    /// \brief Remove all the children.
+    ///
+    /// The children aren't touched, as they may already have been deleted,
+    /// so their positions still refer to this set. That's harmless, as a
+    /// position is only trusted if the set has the entity at that index.
+    void clear() {
+        m_children.clear();
+    }
+};
+
+#endif // RULESETS_CHILD_SET_H
@@ -29,6 +29,8 @@ class Creator : public Character {
     explicit Creator(const std::string & id, long intId);
     virtual ~Creator();
 
+    SLAB_POOLED(entities, "Creator")
+
     virtual void operation(const Operation & op, OpVector &);
     virtual void externalOperation(const Operation & op, Link &);
 
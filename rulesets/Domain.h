@@ -24,7 +24,9 @@
 
 #include <wfmath/vector.h>
 
+#include <functional>
 #include <string>
+#include <vector>
 
 class LocatedEntity;
 class Location;
@@ -86,10 +88,27 @@ class Domain {
      */
     virtual bool isEntityVisibleFor(const LocatedEntity& observingEntity, const LocatedEntity& observedEntity) const = 0;
 
+    /**
+     * @brief Prepares checking which of many observers can see an entity,
+     * from several threads at once.
+     *
+     * Anything which only depends on the observed entity, such as its
+     * properties, is looked up here, in the world thread. The returned
+     * function is then called from any thread while the world thread
+     * waits, so it must only read the locations of the entities.
+     *
+     * @param observedEntity The entity being looked at.
+     * @return A function which does the same as isEntityVisibleFor() for
+     * an observer, or an empty function if the domain can't check
+     * visibility concurrently.
+     */
+    virtual std::function<bool(const LocatedEntity&)> getConcurrentVisibilityCheck(const LocatedEntity& observedEntity) const;
+
     /**
      * @brief Process visibility operation for an entity that has been moved.
      *
      * This mainly involves calculating visibility changes, generating Appear and Disappear ops.
+     * This is called for all moved entities, not only perceptive ones.
      *
      * @param moved_entity The entity that was moved.
      * @param old_loc The old location of the entity.
@@ -113,6 +132,46 @@ class Domain {
      */
     virtual float checkCollision(LocatedEntity& entity, CollisionData& collisionData) = 0;
 
+    /**
+     * @brief Registers an entity which should receive perception broadcasts.
+     *
+     * Domains which keep an index of observers use this to add the entity.
+     * @param observer The perceptive entity.
+     * @return True if the domain keeps track of the entity.
+     */
+    virtual bool addObserver(const LocatedEntity& observer);
+
+    /**
+     * @brief Unregisters an entity registered with addObserver().
+     * @param observer The perceptive entity.
+     */
+    virtual void removeObserver(const LocatedEntity& observer);
+
+    /**
+     * @brief Finds the observers which might be able to see an entity.
+     *
+     * The candidates still need to be checked with isEntityVisibleFor().
+     * @param observedEntity The entity being looked at.
+     * @param candidates Candidate observers are appended to this.
+     * @return False if the domain can't narrow down the observers, in
+     * which case all perceptive entities need to be checked.
+     */
+    virtual bool getObserverCandidates(const LocatedEntity& observedEntity,
+            std::vector<const LocatedEntity*>& candidates) const;
+
+    /**
+     * @brief Called when an entity has been added to the domain without
+     * being moved there, such as when it's created.
+     * @param entity The new entity.
+     */
+    virtual void addEntity(const LocatedEntity& entity);
+
+    /**
+     * @brief Called when an entity in the domain is about to be destroyed.
+     * @param entity The entity being destroyed.
+     */
+    virtual void removeEntity(const LocatedEntity& entity);
+
 };
 
 #endif // RULESETS_DOMAIN_H
@@ -137,7 +137,7 @@ PropertyBase * Entity::setAttr(const std::string & name, const Element & attr)
             prop->install(this, name);
         }
         assert(prop != 0);
-        m_properties[name] = prop;
+        insertProperty(name, prop);
     }
 
     prop->set(attr);
@@ -150,12 +150,15 @@ PropertyBase * Entity::setAttr(const std::string & name, const Element & attr)
 
 const PropertyBase * Entity::getProperty(const std::string & name) const
 {
-    PropertyDict::const_iterator I = m_properties.find(name);
+    // The name is only looked up once, for both the instance and the class
+    // properties. Names of class properties are all interned.
+    PropertyAtom atom = PropertyAtoms::find(name);
+    PropertyDict::const_iterator I = m_properties.find(name, atom);
     if (I != m_properties.end()) {
         return I->second;
     }
-    if (m_type != 0) {
-        I = m_type->defaults().find(name);
+    if (m_type != 0 && atom != PropertyAtoms::NONE) {
+        I = m_type->defaults().find(atom);
         if (I != m_type->defaults().end()) {
             return I->second;
         }
@@ -165,19 +168,20 @@ const PropertyBase * Entity::getProperty(const std::string & name) const
 
 PropertyBase * Entity::modProperty(const std::string & name)
 {
-    PropertyDict::const_iterator I = m_properties.find(name);
+    PropertyAtom atom = PropertyAtoms::find(name);
+    PropertyDict::const_iterator I = m_properties.find(name, atom);
     if (I != m_properties.end()) {
         return I->second;
     }
-    if (m_type != 0) {
-        I = m_type->defaults().find(name);
+    if (m_type != 0 && atom != PropertyAtoms::NONE) {
+        I = m_type->defaults().find(atom);
         if (I != m_type->defaults().end()) {
             // We have a default for this property. Create a new instance
             // property with the same value.
             PropertyBase * new_prop = I->second->copy();
             I->second->remove(this, name);
             new_prop->flags() &= ~flag_class;
-            m_properties[name] = new_prop;
+            insertProperty(name, new_prop);
             new_prop->apply(this);
             new_prop->install(this, name);
             return new_prop;
@@ -194,7 +198,7 @@ PropertyBase * Entity::modProperty(const std::string & name)
 PropertyBase * Entity::setProperty(const std::string & name,
                                    PropertyBase * prop)
 {
-    return m_properties[name] = prop;
+    return insertProperty(name, prop);
 }
 
 /// \brief Copy attributes into an Atlas element
@@ -209,7 +213,7 @@ void Entity::addToMessage(MapType & omap) const
     J = m_properties.begin();
     Jend = m_properties.end();
     for (; J != Jend; ++J) {
-        J->second->add(J->first, omap);
+        J->second->add(m_properties.name(J->first), omap);
     }
 
     omap["stamp"] = (double)m_seq;
@@ -230,7 +234,7 @@ void Entity::addToEntity(const RootEntity & ent) const
     J = m_properties.begin();
     Jend = m_properties.end();
     for (; J != Jend; ++J) {
-        J->second->add(J->first, ent);
+        J->second->add(m_properties.name(J->first), ent);
     }
 
     ent->setStamp(m_seq);
@@ -309,7 +313,7 @@ void Entity::destroy()
 Domain * Entity::getMovementDomain()
 {
     if (m_flags & entity_domain) {
-        return getPropertyClass<DomainProperty>("domain")->getDomain(this);
+        return getPropertyClass<DomainSlot>()->getDomain(this);
     }
     if (m_location.m_loc) {
         return m_location.m_loc->getMovementDomain();
@@ -538,11 +542,12 @@ HandlerResult Entity::callDelegate(const std::string & name,
                                    OpVector & res)
 {
     PropertyBase * p = 0;
-    PropertyDict::const_iterator I = m_properties.find(name);
+    PropertyAtom atom = PropertyAtoms::find(name);
+    PropertyDict::const_iterator I = m_properties.find(name, atom);
     if (I != m_properties.end()) {
         p = I->second;
-    } else if (m_type != 0) {
-        I = m_type->defaults().find(name); 
+    } else if (m_type != 0 && atom != PropertyAtoms::NONE) {
+        I = m_type->defaults().find(atom);
         if (I != m_type->defaults().end()) {
             p = I->second;
         }
@@ -51,6 +51,8 @@ class Entity : public LocatedEntity {
     explicit Entity(const std::string & id, long intId);
     virtual ~Entity();
 
+    SLAB_POOLED(entities, "Entity")
+
     /// \brief Accessor for pointer to motion object
     Motion * motion() const {
         return m_motion;
@@ -26,6 +26,8 @@ class Limbo : public Thing
         explicit Limbo(const std::string & id, long intId);
         virtual ~Limbo();
 
+        SLAB_POOLED(entities, "Limbo")
+
         virtual void addChild(LocatedEntity& childEntity);
 
 
@@ -58,7 +58,7 @@ LocatedEntity::LocatedEntity(const std::string & id, long intId) :
                m_refCount(0), m_seq(0),
                m_script(0), m_type(0), m_flags(0), m_contains(0)
 {
-    m_properties["id"] = new IdProperty(getId());
+    insertProperty("id", new IdProperty(getId()));
 }
 
 LocatedEntity::~LocatedEntity()
@@ -66,15 +66,19 @@ LocatedEntity::~LocatedEntity()
 
     if (m_type) {
         for (auto entry : m_type->defaults()) {
+            const std::string & name = m_type->defaults().name(entry.first);
             //Only remove if there's no instance specific property.
-            if (m_properties.find(entry.first) == m_properties.end()) {
-                entry.second->remove(this, entry.first);
+            if (m_properties.find(name) == m_properties.end()) {
+                entry.second->remove(this, name);
             }
         }
     }
 
+    // Nothing is left to track changes for.
+    m_propertyChanges.unsent.clear();
+    m_propertyChanges.unclean.clear();
     for (auto entry : m_properties) {
-        entry.second->remove(this, entry.first);
+        entry.second->remove(this, m_properties.name(entry.first));
         delete entry.second;
     }
     delete m_script;
@@ -86,6 +90,7 @@ LocatedEntity::~LocatedEntity()
 
 void LocatedEntity::setType(const TypeNode * t) {
     m_type = t;
+    m_slots.invalidate();
 }
 
 /// \brief Check if this entity has a property with the given name
@@ -95,12 +100,15 @@ void LocatedEntity::setType(const TypeNode * t) {
 /// false otherwise
 bool LocatedEntity::hasAttr(const std::string & name) const
 {
-    PropertyDict::const_iterator I = m_properties.find(name);
+    // The name is only looked up once, for both the instance and the class
+    // properties. Names of class properties are all interned.
+    PropertyAtom atom = PropertyAtoms::find(name);
+    PropertyDict::const_iterator I = m_properties.find(name, atom);
     if (I != m_properties.end()) {
         return true;
     }
-    if (m_type != 0) {
-        I = m_type->defaults().find(name);
+    if (m_type != 0 && atom != PropertyAtoms::NONE) {
+        I = m_type->defaults().find(atom);
         if (I != m_type->defaults().end()) {
             return true;
         }
@@ -117,12 +125,13 @@ bool LocatedEntity::hasAttr(const std::string & name) const
 int LocatedEntity::getAttr(const std::string & name,
                            Element & attr) const
 {
-    PropertyDict::const_iterator I = m_properties.find(name);
+    PropertyAtom atom = PropertyAtoms::find(name);
+    PropertyDict::const_iterator I = m_properties.find(name, atom);
     if (I != m_properties.end()) {
         return I->second->get(attr);
     }
-    if (m_type != 0) {
-        I = m_type->defaults().find(name);
+    if (m_type != 0 && atom != PropertyAtoms::NONE) {
+        I = m_type->defaults().find(atom);
         if (I != m_type->defaults().end()) {
             return I->second->get(attr);
         }
@@ -140,12 +149,13 @@ int LocatedEntity::getAttrType(const std::string & name,
                                Element & attr,
                                int type) const
 {
-    PropertyDict::const_iterator I = m_properties.find(name);
+    PropertyAtom atom = PropertyAtoms::find(name);
+    PropertyDict::const_iterator I = m_properties.find(name, atom);
     if (I != m_properties.end()) {
         return I->second->get(attr) || (attr.getType() == type ? 0 : 1);
     }
-    if (m_type != 0) {
-        I = m_type->defaults().find(name);
+    if (m_type != 0 && atom != PropertyAtoms::NONE) {
+        I = m_type->defaults().find(atom);
         if (I != m_type->defaults().end()) {
             return I->second->get(attr) || (attr.getType() == type ? 0 : 1);
         }
@@ -165,7 +175,7 @@ PropertyBase * LocatedEntity::setAttr(const std::string & name,
         I->second->set(attr);
         return I->second;
     }
-    return m_properties[name] = new SoftProperty(attr);
+    return insertProperty(name, new SoftProperty(attr));
 }
 
 /// \brief Get the property object for a given attribute
@@ -194,7 +204,7 @@ PropertyBase * LocatedEntity::modProperty(const std::string & name)
 PropertyBase * LocatedEntity::setProperty(const std::string & name,
                                           PropertyBase * prop)
 {
-    return m_properties[name] = prop;
+    return insertProperty(name, prop);
 }
 
 void LocatedEntity::installDelegate(int, const std::string &)
@@ -251,6 +261,11 @@ std::vector<Atlas::Objects::Root> LocatedEntity::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges LocatedEntity::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
 
 /// \brief Make this entity a container
 ///
@@ -260,7 +275,7 @@ void LocatedEntity::makeContainer()
 {
     if (m_contains == 0) {
         m_contains = new LocatedEntitySet;
-        m_properties["contains"] = new ContainsProperty(*m_contains);
+        insertProperty("contains", new ContainsProperty(*m_contains));
     }
 }
 
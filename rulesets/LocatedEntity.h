@@ -19,16 +19,24 @@
 #ifndef RULESETS_LOCATED_ENTITY_H
 #define RULESETS_LOCATED_ENTITY_H
 
+#include "ChildSet.h"
+
 #include "modules/Location.h"
 
 #include "common/Property.h"
+#include "common/PropertyDict.h"
+#include "common/PropertySlots.h"
+#include "common/SlabPool.h"
 #include "common/Router.h"
 #include "common/log.h"
 #include "common/compose.hpp"
 
+#include <Atlas/Objects/Root.h>
+
 #include <sigc++/signal.h>
 
 #include <set>
+#include <vector>
 
 #include <cassert>
 
@@ -41,8 +49,7 @@ class TypeNode;
 template <typename T>
 class Property;
 
-typedef std::set<LocatedEntity *> LocatedEntitySet;
-typedef std::map<std::string, PropertyBase *> PropertyDict;
+typedef ChildSet<LocatedEntity> LocatedEntitySet;
 
 /// \brief Flag indicating entity has been written to permanent store
 /// \ingroup EntityFlags
@@ -86,6 +93,19 @@ static const unsigned int entity_domain = 1 << 9;
 /// \ingroup EntityFlags
 static const unsigned int entity_dirty_thoughts = 1 << 10;
 
+/// \brief Changes to the thoughts of an entity since they were last stored.
+struct ThoughtChanges {
+    /// \brief Whether all thoughts have to be stored anew, in which case
+    /// the other members are empty.
+    bool replaceAll = true;
+    /// \brief Thoughts with an id which have been added or changed.
+    std::vector<Atlas::Objects::Root> updated;
+    /// \brief Thoughts without an id which have been added.
+    std::vector<Atlas::Objects::Root> added;
+    /// \brief Ids of thoughts which have been deleted.
+    std::vector<std::string> deleted;
+};
+
 /// \brief This is the base class from which in-game and in-memory objects
 /// inherit.
 ///
@@ -103,9 +123,15 @@ class LocatedEntity : public Router {
 
     /// Count of references held by other objects to this entity
     int m_refCount;
+    /// Position of this entity in the contains of its parent
+    ChildPosition m_childPosition;
   protected:
     /// Map of properties
     PropertyDict m_properties;
+    /// Instance properties which have changed
+    PropertyChanges m_propertyChanges;
+    /// Properties found for the well-known slots
+    mutable PropertySlotCache m_slots;
 
     /// Sequence number
     int m_seq;
@@ -117,6 +143,20 @@ class LocatedEntity : public Router {
     /// Flags indicating changes to attributes
     unsigned int m_flags;
 
+    /// \brief Store an instance property, and keep track of its changes.
+    PropertyBase * insertProperty(const std::string & name,
+                                  PropertyBase * prop) {
+        auto I = m_properties.insert(name, prop).first;
+        m_slots.invalidate();
+        if (I->second != prop) {
+            I->second->untrack();
+            I->second = prop;
+        }
+        // The name of the atom stays put when the entries move.
+        prop->track(&m_propertyChanges, &m_properties.name(I->first));
+        return prop;
+    }
+
   public:
     /// Full details of location
     Location m_location;
@@ -126,6 +166,13 @@ class LocatedEntity : public Router {
     explicit LocatedEntity(const std::string & id, long intId);
     virtual ~LocatedEntity();
 
+    /// \brief Entities are allocated from slab pools.
+    ///
+    /// Entities delete themselves when their reference count drops, and
+    /// the pool they go back to is the one for the size of their class.
+    /// Subclasses declare their own to be counted apart.
+    SLAB_POOLED(entities, "LocatedEntity")
+
     /// \brief Increment the reference count on this entity
     void incRef() {
         ++m_refCount;
@@ -170,6 +217,8 @@ class LocatedEntity : public Router {
     const TypeNode * getType() const { return m_type; }
     /// \brief Accessor for properies
     const PropertyDict & getProperties() const { return m_properties; }
+    /// \brief Accessor for instance properties which have changed
+    PropertyChanges & propertyChanges() { return m_propertyChanges; }
 
     /// \brief Set the value of the entity type property
     virtual void setType(const TypeNode * t);
@@ -211,11 +260,79 @@ class LocatedEntity : public Router {
      */
     virtual std::vector<Atlas::Objects::Root> getThoughts() const;
 
+    /**
+     * Gets the changes to the thoughts since this was last called.
+     * @return The changes, or a request to store all thoughts anew if
+     * changes aren't tracked.
+     */
+    virtual ThoughtChanges takeThoughtChanges();
+
     /// \brief Adds a child to this entity.
     virtual void addChild(LocatedEntity& childEntity);
     /// \brief Removes a child from this entity.
     virtual void removeChild(LocatedEntity& childEntity);
 
+    /// \brief Find the property for a slot, and note whether it's an
+    /// instance property.
+    PropertyBase * resolveSlot(int index, const std::string & name) const
+    {
+        PropertyBase * p = const_cast<PropertyBase *>(getProperty(name));
+        PropertyDict::const_iterator I = m_properties.find(name);
+        if (p != 0 && I != m_properties.end() && I->second == p) {
+            m_slots.instance.fetch_or(1u << index, std::memory_order_relaxed);
+        } else {
+            m_slots.instance.fetch_and(~(1u << index),
+                                       std::memory_order_relaxed);
+        }
+        return p;
+    }
+
+    /// \brief Get the property for a well-known slot.
+    ///
+    /// The property is looked up by name the first time, and afterwards
+    /// until properties are installed or removed it's a pointer load.
+    template <class SlotT>
+    const typename SlotT::type * getPropertyClass() const
+    {
+        if (m_slots.isResolved(SlotT::index)) {
+            return static_cast<const typename SlotT::type *>(
+                  m_slots.get(SlotT::index));
+        }
+        PropertyBase * p = resolveSlot(SlotT::index, SlotT::name());
+        if (p != 0 && dynamic_cast<typename SlotT::type *>(p) == 0) {
+            p = 0;
+        }
+        m_slots.set(SlotT::index, p);
+        return static_cast<const typename SlotT::type *>(p);
+    }
+
+    /// \brief Get a modifiable property for a well-known slot.
+    ///
+    /// If the property is a class default it is copied to the instance,
+    /// as modPropertyClass() does.
+    template <class SlotT>
+    typename SlotT::type * modPropertyClass()
+    {
+        const typename SlotT::type * p = getPropertyClass<SlotT>();
+        if (p != 0 && m_slots.isInstance(SlotT::index)) {
+            return const_cast<typename SlotT::type *>(p);
+        }
+        return modPropertyClass<typename SlotT::type>(SlotT::name());
+    }
+
+    /// \brief Require that the property for a well-known slot is set.
+    template <class SlotT>
+    typename SlotT::type * requirePropertyClass(
+          const Atlas::Message::Element & def_val = Atlas::Message::Element())
+    {
+        const typename SlotT::type * p = getPropertyClass<SlotT>();
+        if (p != 0 && m_slots.isInstance(SlotT::index)) {
+            return const_cast<typename SlotT::type *>(p);
+        }
+        return requirePropertyClass<typename SlotT::type>(SlotT::name(),
+                                                          def_val);
+    }
+
     /// \brief Get a property that is required to of a given type.
     template <class PropertyT>
     const PropertyT * getPropertyClass(const std::string & name) const
@@ -289,7 +406,7 @@ class LocatedEntity : public Router {
         if (sp == 0) {
             // If it is not of the right type, delete it and a new
             // one of the right type will be inserted.
-            m_properties[name] = sp = new PropertyT;
+            insertProperty(name, sp = new PropertyT);
             sp->install(this, name);
             if (p != 0) {
                 log(WARNING, String::compose("Property %1 on entity with id %2 "
@@ -325,6 +442,7 @@ class LocatedEntity : public Router {
     sigc::signal<void> destroyed;
 
     friend class LocatedEntitytest;
+    template <typename> friend class ChildSet;
 };
 
 #endif // RULESETS_LOCATED_ENTITY_H
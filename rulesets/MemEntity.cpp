@@ -96,5 +96,5 @@ PropertyBase * MemEntity::setAttr(const std::string & name, const Atlas::Message
     prop->install(this, name);
     prop->set(attr);
     prop->apply(this);
-    return m_properties[name] = prop;
+    return insertProperty(name, prop);
 }
@@ -34,6 +34,8 @@ class MemEntity : public LocatedEntity {
     explicit MemEntity(const std::string & id, long intId);
     virtual ~MemEntity();
 
+    SLAB_POOLED(entities, "MemEntity")
+
     void setVisible(bool v = true) {
         if (v) {
             m_flags |= entity_visible;
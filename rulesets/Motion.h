@@ -22,6 +22,8 @@
 #include "physics/Vector3D.h"
 #include "Domain.h"
 
+#include "common/OpHandle.h"
+
 #include <Atlas/Objects/ObjectsFwd.h>
 
 #include <wfmath/vector.h>
@@ -60,6 +62,9 @@ class Motion {
     /// Refno of next expected update op
     long m_serialno;
 
+    /// Handle to the pending update op, used to cancel it when superseded
+    OpHandle m_updateHandle;
+
     /// Collision predicted flag
     bool m_collision;
     /// Entity with which collision will occur
@@ -81,6 +86,10 @@ class Motion {
         return m_serialno;
     }
 
+    OpHandle & updateHandle() {
+        return m_updateHandle;
+    }
+
     const bool collision() const {
         return m_collision;
     }
@@ -0,0 +1,148 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "ObserverGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+/// Cell coordinates are clamped to this, so that huge positions or radii
+/// can't overflow.
+static const float MAX_CELL = 1 << 30;
+
+static std::int64_t cellKey(std::int32_t x, std::int32_t y)
+{
+    return ((std::int64_t)x << 32) | (std::uint32_t)y;
+}
+
+ObserverGrid::ObserverGrid(float cellSize) : m_cellSize(cellSize)
+{
+}
+
+std::int32_t ObserverGrid::toCell(float coord) const
+{
+    float cell = std::floor(coord / m_cellSize);
+    return (std::int32_t)std::max(-MAX_CELL, std::min(MAX_CELL, cell));
+}
+
+void ObserverGrid::removeFromCell(std::int64_t cell, std::size_t index)
+{
+    auto I = m_cells.find(cell);
+    Cell & entities = I->second;
+    //Move the last entity into the hole, so that removal is O(1).
+    if (index != entities.size() - 1) {
+        entities[index] = entities.back();
+        m_entries[entities[index].entity].index = index;
+    }
+    entities.pop_back();
+    if (entities.empty()) {
+        m_cells.erase(I);
+    }
+}
+
+void ObserverGrid::update(const LocatedEntity * entity, float x, float y)
+{
+    std::int64_t cell = cellKey(toCell(x), toCell(y));
+    auto I = m_entries.find(entity);
+    if (I != m_entries.end()) {
+        if (I->second.cell == cell) {
+            CellEntry & entry = m_cells[cell][I->second.index];
+            entry.x = x;
+            entry.y = y;
+            return;
+        }
+        removeFromCell(I->second.cell, I->second.index);
+    } else {
+        I = m_entries.emplace(entity, Entry()).first;
+    }
+    Cell & entities = m_cells[cell];
+    I->second.cell = cell;
+    I->second.index = entities.size();
+    entities.push_back(CellEntry{entity, x, y});
+}
+
+bool ObserverGrid::remove(const LocatedEntity * entity)
+{
+    auto I = m_entries.find(entity);
+    if (I == m_entries.end()) {
+        return false;
+    }
+    std::int64_t cell = I->second.cell;
+    std::size_t index = I->second.index;
+    m_entries.erase(I);
+    removeFromCell(cell, index);
+    return true;
+}
+
+bool ObserverGrid::contains(const LocatedEntity * entity) const
+{
+    return m_entries.find(entity) != m_entries.end();
+}
+
+void ObserverGrid::queryCell(const Cell & cell, float x, float y,
+                             float squareRadius,
+                             std::vector<const LocatedEntity *> & result)
+{
+    for (auto& entry : cell) {
+        float dx = entry.x - x;
+        float dy = entry.y - y;
+        if (dx * dx + dy * dy <= squareRadius) {
+            result.push_back(entry.entity);
+        }
+    }
+}
+
+void ObserverGrid::query(float x, float y, float radius,
+                         std::vector<const LocatedEntity *> & result) const
+{
+    std::int32_t minX = toCell(x - radius), maxX = toCell(x + radius);
+    std::int32_t minY = toCell(y - radius), maxY = toCell(y + radius);
+    float squareRadius = radius * radius;
+
+    //If the area covers more cells than are in use it's quicker to
+    //look at each cell in use.
+    double cellCount = ((double)maxX - minX + 1) * ((double)maxY - minY + 1);
+    if (cellCount > m_cells.size()) {
+        for (auto& entry : m_cells) {
+            queryCell(entry.second, x, y, squareRadius, result);
+        }
+        return;
+    }
+    for (std::int32_t cellX = minX; cellX <= maxX; ++cellX) {
+        for (std::int32_t cellY = minY; cellY <= maxY; ++cellY) {
+            auto I = m_cells.find(cellKey(cellX, cellY));
+            if (I != m_cells.end()) {
+                queryCell(I->second, x, y, squareRadius, result);
+            }
+        }
+    }
+}
+
+std::size_t ObserverGrid::size() const
+{
+    return m_entries.size();
+}
+
+bool ObserverGrid::empty() const
+{
+    return m_entries.empty();
+}
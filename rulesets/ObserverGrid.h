@@ -0,0 +1,108 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef OBSERVERGRID_H_
+#define OBSERVERGRID_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class LocatedEntity;
+
+/// \brief A uniform grid of entities, keyed on their horizontal position.
+///
+/// Used by domains to quickly find the perceptive entities which are near
+/// enough to possibly see another entity. Only the horizontal position is
+/// used, which makes the lookup conservative since the horizontal distance
+/// never is larger than the real distance.
+/// Cells are only allocated when there are entities in them.
+class ObserverGrid
+{
+    public:
+        /**
+         * @brief Ctor.
+         * @param cellSize The length of the side of each cell.
+         */
+        explicit ObserverGrid(float cellSize);
+
+        /**
+         * @brief Adds an entity, or moves it if it's already in the grid.
+         * @param entity The entity.
+         * @param x The x coordinate of the entity.
+         * @param y The y coordinate of the entity.
+         */
+        void update(const LocatedEntity * entity, float x, float y);
+
+        /**
+         * @brief Removes an entity.
+         * @return True if the entity was in the grid.
+         */
+        bool remove(const LocatedEntity * entity);
+
+        bool contains(const LocatedEntity * entity) const;
+
+        /**
+         * @brief Finds all entities within a horizontal distance of a point.
+         * @param x The x coordinate of the point.
+         * @param y The y coordinate of the point.
+         * @param radius The distance.
+         * @param result Entities found are appended to this.
+         */
+        void query(float x, float y, float radius,
+                   std::vector<const LocatedEntity *> & result) const;
+
+        std::size_t size() const;
+
+        bool empty() const;
+
+    private:
+
+        /// \brief An entity in a cell. The position is kept here so that
+        /// queries don't need to look up each entity.
+        struct CellEntry {
+            const LocatedEntity * entity;
+            float x;
+            float y;
+        };
+
+        /// \brief Where an entity is kept.
+        struct Entry {
+            std::int64_t cell;
+            /// Index into the list of the cell.
+            std::size_t index;
+        };
+
+        typedef std::vector<CellEntry> Cell;
+
+        const float m_cellSize;
+
+        std::unordered_map<std::int64_t, Cell> m_cells;
+
+        std::unordered_map<const LocatedEntity *, Entry> m_entries;
+
+        std::int32_t toCell(float coord) const;
+
+        void removeFromCell(std::int64_t cell, std::size_t index);
+
+        static void queryCell(const Cell & cell, float x, float y,
+                              float squareRadius,
+                              std::vector<const LocatedEntity *> & result);
+};
+
+#endif /* OBSERVERGRID_H_ */
@@ -37,6 +37,7 @@
 #include <Atlas/Objects/Anonymous.h>
 
 
+#include <cmath>
 #include <iostream>
 #include <unordered_set>
 
@@ -44,6 +45,13 @@
 
 static const bool debug_flag = false;
 
+/// Size of the cells in the observer index. Most entities can be seen
+/// from a few tens of meters away.
+static const float OBSERVER_CELL_SIZE = 64.f;
+/// Entities which can be seen from further away than this aren't kept in
+/// the observables index, but are checked by every observer.
+static const float OBSERVABLE_RADIUS = 2 * OBSERVER_CELL_SIZE;
+
 using Atlas::Message::Element;
 using Atlas::Message::MapType;
 using Atlas::Objects::Root;
@@ -56,7 +64,8 @@ using Atlas::Objects::Operation::Disappearance;
 using Atlas::Objects::Operation::Unseen;
 
 PhysicalDomain::PhysicalDomain(LocatedEntity& entity)
-: Domain(entity)
+: Domain(entity), m_observers(OBSERVER_CELL_SIZE),
+  m_observables(OBSERVER_CELL_SIZE), m_observablesBuilt(false)
 {
 }
 
@@ -122,7 +131,7 @@ void PhysicalDomain::lookAtEntity(const LocatedEntity& observingEntity, const Lo
 
         if (observedEntity.m_contains != nullptr) {
             //If the entity has any outfitted or wielded entities these should always be shown.
-            const OutfitProperty* outfitProperty = observedEntity.getPropertyClass<OutfitProperty>("outfit");
+            const OutfitProperty* outfitProperty = observedEntity.getPropertyClass<OutfitSlot>();
             std::unordered_set<std::string> outfittedEntities;
             if (outfitProperty) {
                 for (auto& entry : outfitProperty->data()) {
@@ -133,7 +142,7 @@ void PhysicalDomain::lookAtEntity(const LocatedEntity& observingEntity, const Lo
                 }
             }
 
-            const EntityProperty* rightHandWieldProperty = observedEntity.getPropertyClass<EntityProperty>("right_hand_wield");
+            const EntityProperty* rightHandWieldProperty = observedEntity.getPropertyClass<RightHandWieldSlot>();
             if (rightHandWieldProperty) {
                 auto entity = rightHandWieldProperty->data().get();
                 if (entity) {
@@ -184,9 +193,39 @@ void PhysicalDomain::lookAtEntity(const LocatedEntity& observingEntity, const Lo
 }
 
 bool PhysicalDomain::isEntityVisibleFor(const LocatedEntity& observingEntity, const LocatedEntity& observedEntity) const
+{
+    switch (getLocationSight(observingEntity, observedEntity)) {
+        case LocationSight::VISIBLE:
+            return true;
+        case LocationSight::TOO_SMALL:
+            //The entity couldn't be seen just from its size; now check if it's outfitted or wielded.
+            return isOutfittedOrWielded(observedEntity);
+        default:
+            return false;
+    }
+}
+
+std::function<bool(const LocatedEntity&)> PhysicalDomain::getConcurrentVisibilityCheck(const LocatedEntity& observedEntity) const
+{
+    //Looking up properties isn't safe from several threads, so whether the
+    //entity is outfitted or wielded is found out once, up front.
+    bool outfittedOrWielded = isOutfittedOrWielded(observedEntity);
+    return [this, &observedEntity, outfittedOrWielded](const LocatedEntity& observingEntity) {
+        switch (getLocationSight(observingEntity, observedEntity)) {
+            case LocationSight::VISIBLE:
+                return true;
+            case LocationSight::TOO_SMALL:
+                return outfittedOrWielded;
+            default:
+                return false;
+        }
+    };
+}
+
+PhysicalDomain::LocationSight PhysicalDomain::getLocationSight(const LocatedEntity& observingEntity, const LocatedEntity& observedEntity) const
 {
     if (&observedEntity == &m_entity) {
-        return true;
+        return LocationSight::VISIBLE;
     }
 
     //We need to check the distance to the entity being looked at, and make sure that both the looking entity and
@@ -198,13 +237,13 @@ bool PhysicalDomain::isEntityVisibleFor(const LocatedEntity& observingEntity, co
     float distance = squareDistanceWithAncestor(observedEntity.m_location, observingEntity.m_location, &ancestor);
     if (ancestor == nullptr) {
         //No common ancestor found
-        return false;
+        return LocationSight::HIDDEN;
     } else {
         //Make sure that the ancestor is the domain entity, or a child entity.
         while (ancestor != &m_entity.m_location) {
             if (ancestor->m_loc == nullptr) {
                 //We've reached the top of the parents chain without hitting our domain entity; the ancestor isn't a child of the domain entity.
-                return false;
+                return LocationSight::HIDDEN;
             }
             ancestor = &ancestor->m_loc->m_location;
         }
@@ -213,35 +252,304 @@ bool PhysicalDomain::isEntityVisibleFor(const LocatedEntity& observingEntity, co
     //Now we need to determine if the looking entity can see the looked at entity. The default way of doing this is by comparing the size of the looked at entity with the distance,
     //but this check can be overridden if the looked at entity is either wielded or outfitted by a parent entity.
     if ((observedEntity.m_location.squareBoxSize() / distance) > consts::square_sight_factor) {
-        return true;
+        return LocationSight::VISIBLE;
     }
-    //The entity couldn't be seen just from its size; now check if it's outfitted or wielded.
-    if (observedEntity.m_location.m_loc != nullptr) {
-        const OutfitProperty* outfitProperty =
-                observedEntity.m_location.m_loc->getPropertyClass<OutfitProperty>(
-                        "outfit");
-        if (outfitProperty) {
-            for (auto& entry : outfitProperty->data()) {
-                auto outfittedEntity = entry.second.get();
-                if (outfittedEntity && outfittedEntity == &observedEntity) {
-                    return true;
-                }
-            }
-        }
-        //If the entity isn't large enough, and isn't outfitted, perhaps it's wielded?
-        const EntityProperty* rightHandWieldProperty = observedEntity.m_location.m_loc->getPropertyClass<EntityProperty>("right_hand_wield");
-        if (rightHandWieldProperty) {
-            auto entity = rightHandWieldProperty->data().get();
-            if (entity && entity == &observedEntity) {
+    return LocationSight::TOO_SMALL;
+}
+
+bool PhysicalDomain::isOutfittedOrWielded(const LocatedEntity& entity) const
+{
+    if (entity.m_location.m_loc == nullptr) {
+        return false;
+    }
+    const OutfitProperty* outfitProperty =
+            entity.m_location.m_loc->getPropertyClass<OutfitSlot>();
+    if (outfitProperty) {
+        for (auto& entry : outfitProperty->data()) {
+            auto outfittedEntity = entry.second.get();
+            if (outfittedEntity && outfittedEntity == &entity) {
                 return true;
             }
         }
     }
+    //If the entity isn't outfitted, perhaps it's wielded?
+    const EntityProperty* rightHandWieldProperty = entity.m_location.m_loc->getPropertyClass<RightHandWieldSlot>();
+    if (rightHandWieldProperty) {
+        auto wielded = rightHandWieldProperty->data().get();
+        if (wielded && wielded == &entity) {
+            return true;
+        }
+    }
     return false;
 }
 
+/// \brief The distance from which an entity can be seen.
+static float sightRadius(const LocatedEntity& entity)
+{
+    //An entity can be seen if its square size divided by the square
+    //distance is larger than the sight factor.
+    return std::sqrt(entity.m_location.squareBoxSize() /
+                     consts::square_sight_factor);
+}
+
+void PhysicalDomain::setObserverPosition(const LocatedEntity& observer)
+{
+    const Point3D pos = relativePos(m_entity.m_location, observer.m_location);
+    m_observers.update(&observer, pos.x(), pos.y());
+}
+
+bool PhysicalDomain::addObserver(const LocatedEntity& observer)
+{
+    bool added = !m_observers.contains(&observer);
+    setObserverPosition(observer);
+    if (added) {
+        //The observables are only kept once the observer index is in use.
+        if (!m_observablesBuilt) {
+            buildObservables();
+        }
+        //Nothing has changed as far as the observer is concerned, so
+        //there's nothing to send.
+        std::vector<Root> appear, disappear;
+        refreshObserver(observer, appear, disappear, nullptr);
+    }
+    return true;
+}
+
+void PhysicalDomain::removeObserver(const LocatedEntity& observer)
+{
+    forgetObserver(observer);
+}
+
+void PhysicalDomain::addEntity(const LocatedEntity& entity)
+{
+    if (m_observablesBuilt && entity.m_location.m_loc == &m_entity) {
+        placeObservable(entity);
+        refreshObservable(entity, nullptr);
+    }
+}
+
+void PhysicalDomain::removeEntity(const LocatedEntity& entity)
+{
+    forgetObserver(entity);
+    forgetObservable(entity);
+}
+
+void PhysicalDomain::updateObservers(const LocatedEntity& entity,
+        std::vector<const LocatedEntity*>& moved)
+{
+    if (m_observers.contains(&entity)) {
+        setObserverPosition(entity);
+        moved.push_back(&entity);
+    } else if (entity.isPerceptive()) {
+        addObserver(entity);
+    }
+    //Anything contained in the entity has moved along with it.
+    if (entity.m_contains != nullptr) {
+        for (auto child : *entity.m_contains) {
+            updateObservers(*child, moved);
+        }
+    }
+}
+
+void PhysicalDomain::removeObservers(const LocatedEntity& entity)
+{
+    forgetObserver(entity);
+    forgetObservable(entity);
+    if (entity.m_contains != nullptr) {
+        for (auto child : *entity.m_contains) {
+            removeObservers(*child);
+        }
+    }
+}
+
+void PhysicalDomain::buildObservables()
+{
+    m_observablesBuilt = true;
+    if (m_entity.m_contains != nullptr) {
+        for (auto child : *m_entity.m_contains) {
+            placeObservable(*child);
+        }
+    }
+}
+
+void PhysicalDomain::placeObservable(const LocatedEntity& observable)
+{
+    m_seenBySets[&observable];
+    if (sightRadius(observable) > OBSERVABLE_RADIUS) {
+        m_observables.remove(&observable);
+        m_largeObservables.insert(&observable);
+    } else {
+        m_largeObservables.erase(&observable);
+        const Point3D& pos = observable.m_location.pos();
+        m_observables.update(&observable, pos.x(), pos.y());
+    }
+}
+
+void PhysicalDomain::forgetObservable(const LocatedEntity& observable)
+{
+    auto I = m_seenBySets.find(&observable);
+    if (I == m_seenBySets.end()) {
+        return;
+    }
+    for (auto observer : I->second.observers) {
+        m_visibleSets[observer].erase(&observable);
+    }
+    m_seenBySets.erase(I);
+    m_observables.remove(&observable);
+    m_largeObservables.erase(&observable);
+}
+
+void PhysicalDomain::forgetObserver(const LocatedEntity& observer)
+{
+    m_observers.remove(&observer);
+    auto I = m_visibleSets.find(&observer);
+    if (I == m_visibleSets.end()) {
+        return;
+    }
+    for (auto observable : I->second) {
+        m_seenBySets[observable].observers.erase(&observer);
+    }
+    m_visibleSets.erase(I);
+}
+
+void PhysicalDomain::refreshObservable(const LocatedEntity& observable,
+        OpVector* res)
+{
+    SeenBy& entry = m_seenBySets[&observable];
+    EntityPtrSet& seenBy = entry.observers;
+    entry.radius = sightRadius(observable);
+
+    std::vector<const LocatedEntity*> candidates;
+    const Point3D& pos = observable.m_location.pos();
+    m_observers.query(pos.x(), pos.y(), entry.radius, candidates);
+
+    EntityPtrSet newSeenBy;
+    for (auto observer : candidates) {
+        if (observer != &observable &&
+            isEntityVisibleFor(*observer, observable)) {
+            newSeenBy.insert(observer);
+            if (seenBy.erase(observer) == 0) {
+                //Observers gaining sight of the entity will get the
+                //broadcast of whatever it did, so nothing is sent.
+                m_visibleSets[observer].insert(&observable);
+            }
+        }
+    }
+
+    //Whatever is left are the observers which have lost sight of it.
+    for (auto observer : seenBy) {
+        m_visibleSets[observer].erase(&observable);
+    }
+    if (res && !seenBy.empty()) {
+        Anonymous this_ent;
+        this_ent->setId(observable.getId());
+        this_ent->setStamp(observable.getSeq());
+        for (auto observer : seenBy) {
+            Disappearance d;
+            d->setArgs1(this_ent);
+            d->setTo(observer->getId());
+            res->push_back(d);
+        }
+    }
+    seenBy.swap(newSeenBy);
+}
+
+void PhysicalDomain::refreshObserver(const LocatedEntity& observer,
+        std::vector<Root>& appear, std::vector<Root>& disappear,
+        std::vector<const LocatedEntity*>* kept)
+{
+    EntityPtrSet& visible = m_visibleSets[&observer];
+
+    std::vector<const LocatedEntity*> candidates;
+    const Point3D pos = relativePos(m_entity.m_location, observer.m_location);
+    m_observables.query(pos.x(), pos.y(), OBSERVABLE_RADIUS, candidates);
+    candidates.insert(candidates.end(), m_largeObservables.begin(),
+                      m_largeObservables.end());
+
+    EntityPtrSet newVisible;
+    for (auto observable : candidates) {
+        if (observable == &observer ||
+            !isEntityVisibleFor(observer, *observable)) {
+            continue;
+        }
+        newVisible.insert(observable);
+        if (visible.erase(observable) == 0) {
+            m_seenBySets[observable].observers.insert(&observer);
+            Anonymous that_ent;
+            that_ent->setId(observable->getId());
+            that_ent->setStamp(observable->getSeq());
+            appear.push_back(that_ent);
+        } else if (kept) {
+            kept->push_back(observable);
+        }
+    }
+
+    for (auto observable : visible) {
+        m_seenBySets[observable].observers.erase(&observer);
+        Anonymous that_ent;
+        that_ent->setId(observable->getId());
+        that_ent->setStamp(observable->getSeq());
+        disappear.push_back(that_ent);
+    }
+    visible.swap(newVisible);
+
+    //Entities which have grown since they were indexed are moved to
+    //where they can be found from further away.
+    for (auto observable : candidates) {
+        if (!m_largeObservables.count(observable) &&
+            sightRadius(*observable) > OBSERVABLE_RADIUS) {
+            placeObservable(*observable);
+        }
+    }
+}
+
+void PhysicalDomain::addVisibilityOps(const LocatedEntity& entity,
+        std::vector<Root>& appear, std::vector<Root>& disappear,
+        OpVector& res) const
+{
+    if (!appear.empty()) {
+        // Send an operation to ourselves with a list of entities
+        // we are gaining sight of
+        Appearance a;
+        a->setArgs(appear);
+        a->setTo(entity.getId());
+        res.push_back(a);
+    }
+    if (!disappear.empty()) {
+        // Send an operation to ourselves with a list of entities
+        // we are losing sight of
+        Disappearance d;
+        d->setArgs(disappear);
+        d->setTo(entity.getId());
+        res.push_back(d);
+    }
+}
+
+bool PhysicalDomain::getObserverCandidates(const LocatedEntity& observedEntity,
+        std::vector<const LocatedEntity*>& candidates) const
+{
+    //The domain entity, and anything outfitted or wielded, can be seen by
+    //everyone in the domain.
+    if (&observedEntity == &m_entity || isOutfittedOrWielded(observedEntity)) {
+        return false;
+    }
+    //Observables already know who sees them, unless they have grown since
+    //that was calculated.
+    float radius = sightRadius(observedEntity);
+    auto I = m_seenBySets.find(&observedEntity);
+    if (I != m_seenBySets.end() && radius <= I->second.radius) {
+        candidates.insert(candidates.end(), I->second.observers.begin(),
+                          I->second.observers.end());
+        return true;
+    }
+    const Point3D pos = relativePos(m_entity.m_location,
+                                    observedEntity.m_location);
+    m_observers.query(pos.x(), pos.y(), radius, candidates);
+    return true;
+}
+
 void PhysicalDomain::calculateVisibility(std::vector<Root>& appear, std::vector<Root>& disappear, Anonymous& this_ent, const LocatedEntity& parent,
-        const LocatedEntity& moved_entity, const Location& old_loc, OpVector & res) const {
+        const LocatedEntity& moved_entity, const Location& old_loc, OpVector & res, bool notifyObservers) const {
 
     float fromSquSize = moved_entity.m_location.squareBoxSize();
 
@@ -263,7 +571,7 @@ void PhysicalDomain::calculateVisibility(std::vector<Root>& appear, std::vector<
 
         // Build appear and disappear lists, and send disappear operations
         // to perceptive entities saying that we are disappearing
-        if (other->isPerceptive()) {
+        if (notifyObservers && other->isPerceptive()) {
             bool was_in_range = ((fromSquSize / old_dist) > consts::square_sight_factor),
                  is_in_range = ((fromSquSize / new_dist) > consts::square_sight_factor);
             if (was_in_range != is_in_range) {
@@ -301,7 +609,7 @@ void PhysicalDomain::calculateVisibility(std::vector<Root>& appear, std::vector<
         } else {
             //We've seen this entity before, and we're still seeing it. Check if there are any children that's now changing visibility.
             if (other->m_contains && !other->m_contains->empty()) {
-                calculateVisibility(appear, disappear, this_ent, *other, moved_entity, old_loc, res);
+                calculateVisibility(appear, disappear, this_ent, *other, moved_entity, old_loc, res, notifyObservers);
             }
         }
     }
@@ -316,28 +624,70 @@ void PhysicalDomain::processVisibilityForMovedEntity(const LocatedEntity& moved_
     this_ent->setId(moved_entity.getId());
     this_ent->setStamp(moved_entity.getSeq());
 
-    calculateVisibility(appear, disappear, this_ent, m_entity, moved_entity, old_loc, res);
+    //Without the observer index visibility only changes when perceptive
+    //entities move, and is calculated from scratch each time.
+    if (!m_observablesBuilt) {
+        if (moved_entity.isPerceptive()) {
+            calculateVisibility(appear, disappear, this_ent, m_entity, moved_entity, old_loc, res);
+            addVisibilityOps(moved_entity, appear, disappear, res);
+        }
+        return;
+    }
 
-    if (!appear.empty()) {
-        // Send an operation to ourselves with a list of entities
-        // we are gaining sight of
-        Appearance a;
-        a->setArgs(appear);
-        a->setTo(moved_entity.getId());
-        res.push_back(a);
+    //With the index the visible and seen-by sets are updated for every
+    //move, but ops are only sent for the same changes as above: those
+    //seen by a perceptive entity which moved itself, and the observers
+    //losing sight of it.
+    std::vector<const LocatedEntity*> movedObservers;
+    updateObservers(moved_entity, movedObservers);
+
+    if (moved_entity.m_location.m_loc == &m_entity) {
+        placeObservable(moved_entity);
+        refreshObservable(moved_entity,
+                          moved_entity.isPerceptive() ? &res : nullptr);
+    } else {
+        forgetObservable(moved_entity);
     }
-    if (!disappear.empty()) {
-        // Send an operation to ourselves with a list of entities
-        // we are losing sight of
-        Disappearance d;
-        d->setArgs(disappear);
-        d->setTo(moved_entity.getId());
-        res.push_back(d);
+
+    for (auto observer : movedObservers) {
+        std::vector<const LocatedEntity*> kept;
+        refreshObserver(*observer, appear, disappear,
+                        observer == &moved_entity ? &kept : nullptr);
+        //Check if any children of the entities which are still seen are
+        //now changing visibility.
+        for (auto observable : kept) {
+            if (observable->m_contains && !observable->m_contains->empty()) {
+                calculateVisibility(appear, disappear, this_ent, *observable, moved_entity, old_loc, res, false);
+            }
+        }
+        if (observer == &moved_entity) {
+            addVisibilityOps(*observer, appear, disappear, res);
+        }
+        appear.clear();
+        disappear.clear();
     }
 }
 
 void PhysicalDomain::processDisappearanceOfEntity(const LocatedEntity& moved_entity, const Location& old_loc, OpVector & res) {
 
+    //Everyone who saw the entity is already known.
+    auto I = m_seenBySets.find(&moved_entity);
+    if (I != m_seenBySets.end()) {
+        Anonymous this_ent;
+        this_ent->setId(moved_entity.getId());
+        this_ent->setStamp(moved_entity.getSeq());
+        for (auto observer : I->second.observers) {
+            Disappearance d;
+            d->setArgs1(this_ent);
+            d->setTo(observer->getId());
+            res.push_back(d);
+        }
+        removeObservers(moved_entity);
+        return;
+    }
+
+    removeObservers(moved_entity);
+
     float fromSquSize = old_loc.squareBoxSize();
     Anonymous this_ent;
     this_ent->setId(moved_entity.getId());
@@ -19,6 +19,10 @@
 #define PHYSICALDOMAIN_H_
 
 #include "Domain.h"
+#include "ObserverGrid.h"
+
+#include <unordered_map>
+#include <unordered_set>
 
 /**
  * @brief A regular physical domain, behaving very much like the real world.
@@ -44,6 +48,10 @@ class PhysicalDomain: public Domain
         virtual bool isEntityVisibleFor(const LocatedEntity& observingEntity,
                 const LocatedEntity& observedEntity) const;
 
+        virtual std::function<bool(const LocatedEntity&)>
+                getConcurrentVisibilityCheck(
+                const LocatedEntity& observedEntity) const;
+
         virtual void processVisibilityForMovedEntity(
                 const LocatedEntity& moved_entity, const Location& old_loc,
                 OpVector & res);
@@ -55,8 +63,164 @@ class PhysicalDomain: public Domain
         virtual float checkCollision(LocatedEntity& entity,
                 CollisionData& collisionData);
 
+        virtual bool addObserver(const LocatedEntity& observer);
+
+        virtual void removeObserver(const LocatedEntity& observer);
+
+        virtual bool getObserverCandidates(const LocatedEntity& observedEntity,
+                std::vector<const LocatedEntity*>& candidates) const;
+
+        virtual void addEntity(const LocatedEntity& entity);
+
+        virtual void removeEntity(const LocatedEntity& entity);
+
     private:
 
+        typedef std::unordered_set<const LocatedEntity*> EntityPtrSet;
+
+        /**
+         * @brief Index of the observers in the domain, keyed on their
+         * position relative to the domain entity.
+         */
+        ObserverGrid m_observers;
+
+        /**
+         * @brief Index of the children of the domain entity which can only
+         * be seen from nearby.
+         *
+         * Together with m_largeObservables this is only kept once the
+         * observer index is in use.
+         */
+        ObserverGrid m_observables;
+
+        /**
+         * @brief Children of the domain entity which can be seen from
+         * further away than the observables index is searched.
+         */
+        EntityPtrSet m_largeObservables;
+
+        bool m_observablesBuilt;
+
+        /**
+         * @brief The observables each observer currently can see.
+         */
+        std::unordered_map<const LocatedEntity*, EntityPtrSet> m_visibleSets;
+
+        /**
+         * @brief The observers which can see an observable.
+         */
+        struct SeenBy {
+            EntityPtrSet observers;
+            /// The sight radius of the observable when last calculated.
+            float radius = 0.f;
+        };
+
+        /**
+         * @brief The observers which currently can see each observable.
+         *
+         * Every observable has an entry, even if nobody sees it.
+         */
+        std::unordered_map<const LocatedEntity*, SeenBy> m_seenBySets;
+
+        /**
+         * @brief Updates the indexed position of an entity and any indexed
+         * entities it contains.
+         *
+         * Perceptive entities which aren't yet indexed are added.
+         * @param moved Observers which were already indexed are added to this.
+         */
+        void updateObservers(const LocatedEntity& entity,
+                std::vector<const LocatedEntity*>& moved);
+
+        /**
+         * @brief Removes an entity and any entities it contains from the
+         * observer and observable indices.
+         */
+        void removeObservers(const LocatedEntity& entity);
+
+        void setObserverPosition(const LocatedEntity& observer);
+
+        /**
+         * @brief Adds all children of the domain entity to the observables.
+         */
+        void buildObservables();
+
+        /**
+         * @brief Adds an observable, or updates its indexed position.
+         */
+        void placeObservable(const LocatedEntity& observable);
+
+        /**
+         * @brief Removes an observable, and removes it from the visible sets
+         * of all observers.
+         */
+        void forgetObservable(const LocatedEntity& observable);
+
+        /**
+         * @brief Removes an observer, and removes it from the seen-by sets
+         * of all observables.
+         */
+        void forgetObserver(const LocatedEntity& observer);
+
+        /**
+         * @brief Recalculates which observers can see an observable.
+         * @param observable The observable.
+         * @param res If set, Disappearance ops are added to this for the
+         * observers which lose sight of the observable.
+         */
+        void refreshObservable(const LocatedEntity& observable,
+                OpVector* res);
+
+        /**
+         * @brief Recalculates which observables an observer can see.
+         * @param observer The observer.
+         * @param appear Observables which have come into view.
+         * @param disappear Observables which have gone out of view.
+         * @param kept If set, observables which were and still are visible
+         * are added to this.
+         */
+        void refreshObserver(const LocatedEntity& observer,
+                std::vector<Atlas::Objects::Root>& appear,
+                std::vector<Atlas::Objects::Root>& disappear,
+                std::vector<const LocatedEntity*>* kept);
+
+        /**
+         * @brief Adds Appearance and Disappearance ops to an entity, as
+         * produced by the visibility calculations.
+         */
+        void addVisibilityOps(const LocatedEntity& entity,
+                std::vector<Atlas::Objects::Root>& appear,
+                std::vector<Atlas::Objects::Root>& disappear,
+                OpVector& res) const;
+
+        /**
+         * @brief Checks if an entity is outfitted or wielded by its parent,
+         * in which case it's visible regardless of size.
+         */
+        bool isOutfittedOrWielded(const LocatedEntity& entity) const;
+
+        /**
+         * @brief What the locations of two entities say about whether one
+         * can see the other.
+         */
+        enum class LocationSight {
+            /// The observed entity is close enough, or large enough.
+            VISIBLE,
+            /// The entities don't share an ancestor in the domain.
+            HIDDEN,
+            /// The observed entity is only visible if outfitted or wielded.
+            TOO_SMALL
+        };
+
+        /**
+         * @brief Checks visibility from the locations of the entities alone.
+         *
+         * This only reads the locations, so it's safe to call from several
+         * threads at once.
+         */
+        LocationSight getLocationSight(const LocatedEntity& observingEntity,
+                const LocatedEntity& observedEntity) const;
+
         /**
          * @brief Calculates visibility changes for the moved entity, processing the children of the "parent" parameter.
          * @param appear A list of appear ops, to be filled.
@@ -66,12 +230,15 @@ class PhysicalDomain: public Domain
          * @param moved_entity The entity that was moved.
          * @param old_loc The old location.
          * @param res
+         * @param notifyObservers If false, no Disappearance ops are sent to
+         * perceptive entities losing sight of the moved entity.
          */
         void calculateVisibility(std::vector<Atlas::Objects::Root>& appear,
                 std::vector<Atlas::Objects::Root>& disappear,
                 Atlas::Objects::Entity::Anonymous& this_ent,
                 const LocatedEntity& parent, const LocatedEntity& moved_entity,
-                const Location& old_loc, OpVector & res) const;
+                const Location& old_loc, OpVector & res,
+                bool notifyObservers = true) const;
 
 };
 
@@ -129,7 +129,7 @@ void Plant::TickOperation(const Operation & op, OpVector & res)
     //Only do nourishment check if we've had a chance to send an Eat op.
     //Else we'll be shrinking each time the server is restarted.
     if (m_nourishment) {
-        StatusProperty * status = requirePropertyClass<StatusProperty>("status", 1);
+        StatusProperty * status = requirePropertyClass<StatusSlot>(1);
         double & new_status = status->data();
         status->setFlags(flag_unsent);
         if (*m_nourishment <= 0) {
@@ -142,7 +142,7 @@ void Plant::TickOperation(const Operation & op, OpVector & res)
                 new_status = 1.;
             }
 
-            Property<double> * mass_prop = requirePropertyClass<Property<double> >("mass", 0.);
+            Property<double> * mass_prop = requirePropertyClass<MassSlot>(0.);
             double & mass = mass_prop->data();
             double old_mass = mass;
             mass += *m_nourishment;
@@ -152,7 +152,7 @@ void Plant::TickOperation(const Operation & op, OpVector & res)
             if (getAttrType("maxmass", maxmass_attr, Element::TYPE_FLOAT) == 0) {
                 mass = std::min(mass, maxmass_attr.Float());
             }
-            PropertyBase * biomass = modPropertyType<double>("biomass");
+            PropertyBase * biomass = modPropertyClass<BiomassSlot>();
             if (biomass != nullptr) {
                 biomass->set(mass);
                 biomass->setFlags(flag_unsent);
@@ -177,7 +177,7 @@ void Plant::TickOperation(const Operation & op, OpVector & res)
                                     bbox.highCorner().y() * height_scale,
                                     bbox.highCorner().z() * height_scale));
                 debug(std::cout << "New " << bbox << std::endl << std::flush;);
-                BBoxProperty * box_property = modPropertyClass<BBoxProperty>("bbox");
+                BBoxProperty * box_property = modPropertyClass<BBoxSlot>();
                 if (box_property != nullptr) {
                     box_property->data() = bbox;
                     box_property->apply(this);
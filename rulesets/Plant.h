@@ -75,6 +75,8 @@ class Plant : public Thing {
     explicit Plant(const std::string & id, long intId);
     virtual ~Plant();
 
+    SLAB_POOLED(entities, "Plant")
+
     virtual void NourishOperation(const Operation &, OpVector &);
     virtual void TickOperation(const Operation &, OpVector &);
     virtual void TouchOperation(const Operation &, OpVector &);
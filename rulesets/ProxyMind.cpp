@@ -36,7 +36,8 @@ using Atlas::Objects::smart_dynamic_cast;
 static const bool debug_flag = false;
 
 ProxyMind::ProxyMind(const std::string & id, long intId, LocatedEntity& ownerEntity) :
-        BaseMind(id, intId), m_ownerEntity(ownerEntity)
+        BaseMind(id, intId), m_ownerEntity(ownerEntity),
+        m_storedRandomThoughts(0), m_replaceAllThoughts(true)
 {
 
 }
@@ -45,22 +46,106 @@ ProxyMind::~ProxyMind()
 {
 }
 
-void ProxyMind::thinkSetOperation(const Operation & op, OpVector & res)
+void ProxyMind::thoughtUpdated(const std::string & id)
 {
-    //If it's a Set op named "persistthoughts" it's coming from an AI client, and is meant
-    //for persisting thoughts. We should remove all existing thoughts first.
-    if (!op->isDefaultName() && op->getName() == "persistthoughts") {
-        m_randomThoughts.clear();
-        m_thoughtsWithId.clear();
+    m_updatedThoughtIds.insert(id);
+    m_deletedThoughtIds.erase(id);
+}
+
+void ProxyMind::thoughtDeleted(const std::string & id)
+{
+    m_deletedThoughtIds.insert(id);
+    m_updatedThoughtIds.erase(id);
+}
+
+/**
+ * Replaces all thoughts, keeping track of which of them actually changed.
+ */
+void ProxyMind::replaceThoughts(const std::vector<Root> & thoughts)
+{
+    std::map<std::string, Root> thoughtsWithId;
+    std::vector<Root> randomThoughts;
+    for (const Root& thought : thoughts) {
+        if (thought->isDefaultId()) {
+            randomThoughts.push_back(thought);
+        } else {
+            thoughtsWithId[thought->getId()] = thought;
+        }
     }
-    const std::vector<Root> & args = op->getArgs();
-    for (const Root& arg : args) {
-        if (arg->isDefaultId()) {
-            m_randomThoughts.push_back(arg);
+
+    for (auto& thought : m_thoughtsWithId) {
+        if (thoughtsWithId.find(thought.first) == thoughtsWithId.end()) {
+            thoughtDeleted(thought.first);
+        }
+    }
+    for (auto& thought : thoughtsWithId) {
+        auto I = m_thoughtsWithId.find(thought.first);
+        if (I == m_thoughtsWithId.end() ||
+            I->second->asMessage() != thought.second->asMessage()) {
+            thoughtUpdated(thought.first);
+        }
+    }
+
+    //Random thoughts which have been stored can only be kept if they're unchanged; any
+    //following them are stored as added.
+    if (randomThoughts.size() < m_storedRandomThoughts) {
+        m_replaceAllThoughts = true;
+    } else {
+        for (size_t i = 0; i < m_storedRandomThoughts; ++i) {
+            if (randomThoughts[i]->asMessage() != m_randomThoughts[i]->asMessage()) {
+                m_replaceAllThoughts = true;
+                break;
+            }
+        }
+    }
+
+    m_thoughtsWithId.swap(thoughtsWithId);
+    m_randomThoughts.swap(randomThoughts);
+}
+
+/**
+ * Adds thoughts, replacing any with the same id.
+ */
+void ProxyMind::addThoughts(const std::vector<Root> & thoughts)
+{
+    for (const Root& thought : thoughts) {
+        if (thought->isDefaultId()) {
+            m_randomThoughts.push_back(thought);
         } else {
-            m_thoughtsWithId[arg->getId()] = arg;
+            m_thoughtsWithId[thought->getId()] = thought;
+            thoughtUpdated(thought->getId());
         }
     }
+}
+
+void ProxyMind::restoreThoughts(const std::vector<Root> & thoughts)
+{
+    //Thoughts the mind got before being restored haven't been stored yet.
+    bool stored = m_thoughtsWithId.empty() && m_randomThoughts.empty();
+    addThoughts(thoughts);
+    if (stored) {
+        m_updatedThoughtIds.clear();
+        m_deletedThoughtIds.clear();
+        m_storedRandomThoughts = m_randomThoughts.size();
+        m_replaceAllThoughts = false;
+        return;
+    }
+    m_ownerEntity.setFlags(entity_dirty_thoughts);
+    m_ownerEntity.onUpdated();
+}
+
+void ProxyMind::thinkSetOperation(const Operation & op, OpVector & res)
+{
+    const std::vector<Root> & args = op->getArgs();
+    //If it's a Set op named "persistthoughts" it's coming from an AI client, and is meant
+    //for persisting thoughts. The thoughts replace all existing thoughts.
+    if (!op->isDefaultName() && op->getName() == "persistthoughts") {
+        replaceThoughts(args);
+        m_ownerEntity.setFlags(entity_dirty_thoughts);
+        m_ownerEntity.onUpdated();
+        return;
+    }
+    addThoughts(args);
     m_ownerEntity.setFlags(entity_dirty_thoughts);
     m_ownerEntity.onUpdated();
 }
@@ -70,14 +155,13 @@ void ProxyMind::thinkDeleteOperation(const Operation & op, OpVector & res)
     const std::vector<Root> & args = op->getArgs();
     if (args.empty()) {
         //No args means "delete all"
-        m_thoughtsWithId.clear();
-        m_randomThoughts.clear();
+        clearThoughts();
     } else {
         for (const Root& arg : args) {
             if (arg->isDefaultId()) {
                 log(WARNING, "Thought in Delete operation had no id set, ignoring.");
-            } else {
-                m_thoughtsWithId.erase(arg->getId());
+            } else if (m_thoughtsWithId.erase(arg->getId()) != 0) {
+                thoughtDeleted(arg->getId());
             }
         }
     }
@@ -162,10 +246,36 @@ std::vector<Atlas::Objects::Root> ProxyMind::getThoughts() const
     return thoughts;
 }
 
+ThoughtChanges ProxyMind::takeThoughtChanges()
+{
+    ThoughtChanges changes;
+    changes.replaceAll = m_replaceAllThoughts;
+    if (!m_replaceAllThoughts) {
+        for (auto& id : m_updatedThoughtIds) {
+            auto I = m_thoughtsWithId.find(id);
+            if (I != m_thoughtsWithId.end()) {
+                changes.updated.push_back(I->second);
+            }
+        }
+        changes.added.assign(m_randomThoughts.begin() + m_storedRandomThoughts,
+                             m_randomThoughts.end());
+        changes.deleted.assign(m_deletedThoughtIds.begin(), m_deletedThoughtIds.end());
+    }
+    m_updatedThoughtIds.clear();
+    m_deletedThoughtIds.clear();
+    m_storedRandomThoughts = m_randomThoughts.size();
+    m_replaceAllThoughts = false;
+    return changes;
+}
+
 void ProxyMind::clearThoughts()
 {
     m_randomThoughts.clear();
     m_thoughtsWithId.clear();
+    m_updatedThoughtIds.clear();
+    m_deletedThoughtIds.clear();
+    m_storedRandomThoughts = 0;
+    m_replaceAllThoughts = true;
 }
 
 void ProxyMind::operation(const Operation & op, OpVector & res)
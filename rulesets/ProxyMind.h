@@ -23,6 +23,7 @@
 
 #include <Atlas/Objects/ObjectsFwd.h>
 
+#include <set>
 #include <vector>
 
 /**
@@ -53,6 +54,20 @@ class ProxyMind : public BaseMind
          */
         virtual std::vector<Atlas::Objects::Root> getThoughts() const;
 
+        /**
+         * Gets the changes to the thoughts since this was last called, so
+         * only those need to be stored.
+         * @return The changes to the thoughts.
+         */
+        virtual ThoughtChanges takeThoughtChanges();
+
+        /**
+         * Restores thoughts read from storage, which are already stored.
+         * If the mind already has thoughts, all of them are stored anew.
+         * @param thoughts The restored thoughts.
+         */
+        void restoreThoughts(const std::vector<Atlas::Objects::Root> & thoughts);
+
         /**
          * Clear all registered thoughts.
          */
@@ -80,6 +95,33 @@ class ProxyMind : public BaseMind
          */
         std::vector<Atlas::Objects::Root> m_randomThoughts;
 
+        /**
+         * Ids of thoughts with id which have been added or changed since the thoughts were last stored.
+         */
+        std::set<std::string> m_updatedThoughtIds;
+
+        /**
+         * Ids of thoughts with id which have been deleted since the thoughts were last stored.
+         */
+        std::set<std::string> m_deletedThoughtIds;
+
+        /**
+         * Number of random thoughts which have been stored. Random thoughts are only ever added to
+         * the end, so the ones after these are new.
+         */
+        size_t m_storedRandomThoughts;
+
+        /**
+         * Whether all thoughts have to be stored anew, as changes to them can't be expressed
+         * as changes to single thoughts.
+         */
+        bool m_replaceAllThoughts;
+
+        void thoughtUpdated(const std::string & id);
+        void thoughtDeleted(const std::string & id);
+        void replaceThoughts(const std::vector<Atlas::Objects::Root> & thoughts);
+        void addThoughts(const std::vector<Atlas::Objects::Root> & thoughts);
+
         virtual void thinkSetOperation(const Operation & op, OpVector & res);
         virtual void thinkDeleteOperation(const Operation & op, OpVector & res);
         virtual void thinkGetOperation(const Operation & op, OpVector & res);
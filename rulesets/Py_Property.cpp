@@ -25,6 +25,7 @@
 
 #include "common/log.h"
 
+#include <cstring>
 #include <iostream>
 
 PyObject * Property_asPyObject(PropertyBase * property, Entity * owner)
@@ -71,3 +72,19 @@ PyObject * Property_asPyObject(PropertyBase * property, Entity * owner)
     }
     return 0;
 }
+
+bool Property_hasPyObject(const PropertyBase * property, const char * name)
+{
+    // These classes are only installed under these names, so the class of
+    // a property under any other name needn't be checked.
+    if (strcmp(name, "statistics") == 0) {
+        return dynamic_cast<const StatisticsProperty *>(property) != 0;
+    }
+    if (strcmp(name, "terrain") == 0) {
+        return dynamic_cast<const TerrainProperty *>(property) != 0;
+    }
+    if (strcmp(name, "terrainmod") == 0) {
+        return dynamic_cast<const TerrainModProperty *>(property) != 0;
+    }
+    return false;
+}
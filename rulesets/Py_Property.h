@@ -56,6 +56,12 @@ extern PyTypeObject PyTerrainModProperty_Type;
 
 PyObject * Property_asPyObject(PropertyBase * property, Entity * owner);
 
+/// \brief Check whether a property is given to scripts as a python object
+/// rather than as its value.
+///
+/// @param name The name the property has on the entity.
+bool Property_hasPyObject(const PropertyBase * property, const char * name);
+
 PyProperty * newPyTerrainProperty();
 PyProperty * newPyTerrainModProperty();
 
@@ -43,6 +43,8 @@
 using Atlas::Message::Element;
 using Atlas::Message::MapType;
 
+int python_class_property_reads = 0;
+
 static PyObject * Entity_as_entity(PyEntity * self)
 {
 #ifndef NDEBUG
@@ -240,12 +242,21 @@ static PyObject * Entity_getattro(PyEntity *self, PyObject *oname)
         Py_RETURN_FALSE;
     }
     Entity * entity = self->m_entity.e;
-    PropertyBase * prop = entity->modProperty(name);
-    if (prop != 0) {
-        PyObject * ret = Property_asPyObject(prop, entity);
+    // Reading a class property doesn't copy it to the entity, unless it's
+    // wrapped as a python object through which it could be changed.
+    // Setting the attribute copies it.
+    const PropertyBase * prop = entity->getProperty(name);
+    if (prop != 0 && Property_hasPyObject(prop, name)) {
+        PropertyBase * mod_prop = entity->modProperty(name);
+        PyObject * ret = Property_asPyObject(mod_prop, entity);
         if (ret != 0) {
             return ret;
         }
+        prop = mod_prop;
+    } else if (prop != 0 && (prop->flags() & flag_class)) {
+        ++python_class_property_reads;
+    }
+    if (prop != 0) {
         Element attr;
         // If this property is not set with a value, return none.
         if (prop->get(attr) == 0) {
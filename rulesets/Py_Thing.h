@@ -58,6 +58,10 @@ extern PyTypeObject PyMind_Type;
 #define PyMind_Check(_o) PyObject_TypeCheck(_o, &PyMind_Type)
 #define PyMind_CheckExact(_o) (Py_TYPE(_o) == &PyMind_Type)
 
+/// \brief Count of class properties read by scripts without being copied
+/// to the entity.
+extern int python_class_property_reads;
+
 PyObject * wrapEntity(LocatedEntity * entity);
 PyEntity * newPyLocatedEntity();
 PyEntity * newPyEntity();
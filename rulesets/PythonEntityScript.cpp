@@ -37,14 +37,124 @@
 
 static const bool debug_flag = false;
 
+/// \brief PythonHandlerTable constructor
+///
+/// @param cls Python class the handlers are looked up in
+PythonHandlerTable::PythonHandlerTable(PyObject * cls) : m_class(cls),
+    m_dynamicAttributes(PyObject_HasAttrString(cls, (char *)"__getattr__"))
+{
+    Py_INCREF(m_class);
+}
+
+PythonHandlerTable::~PythonHandlerTable()
+{
+    Py_DECREF(m_class);
+}
+
+/// \brief Look up the handler for an operation type in a script.
+///
+/// @param instance Script object of the class the handler is looked up on
+/// @return The slot of the handler, or -1 if there is none.
+int PythonHandlerTable::resolve(const std::string & op_type,
+                                PyObject * instance)
+{
+    std::string op_name = op_type + "_operation";
+    if (!PyObject_HasAttrString(instance, (char *)(op_name.c_str()))) {
+        debug( std::cout << "No method to be found for " << op_name
+                         << std::endl << std::flush;);
+        return -1;
+    }
+    m_methods.push_back(op_name);
+    return m_methods.size() - 1;
+}
+
+/// \brief Find the handler for an operation.
+///
+/// @param class_no Class number of the operation
+/// @param op_type Type of the operation, or the event name it is delivered as
+/// @param instance Script object the operation is for
+/// @return The slot of the handler, or -1 if there is none.
+int PythonHandlerTable::find(int class_no, const std::string & op_type,
+                             PyObject * instance)
+{
+    if (class_no >= 0 && (std::size_t)class_no < m_classHandlers.size()) {
+        auto & entry = m_classHandlers[class_no];
+        if (entry.first == op_type) {
+            return entry.second;
+        }
+    }
+    int slot;
+    auto I = m_namedHandlers.find(op_type);
+    if (I != m_namedHandlers.end()) {
+        slot = I->second;
+    } else {
+        slot = resolve(op_type, instance);
+        if (slot == -1 && m_dynamicAttributes) {
+            // Another instance may well have a handler.
+            return slot;
+        }
+        m_namedHandlers.insert(std::make_pair(op_type, slot));
+    }
+    if (class_no >= 0) {
+        if ((std::size_t)class_no >= m_classHandlers.size()) {
+            m_classHandlers.resize(class_no + 1);
+        }
+        // The first type seen claims the class number. Others, such as
+        // the event names of minds, are found by name.
+        auto & entry = m_classHandlers[class_no];
+        if (entry.first.empty()) {
+            entry.first = op_type;
+            entry.second = slot;
+        }
+    }
+    return slot;
+}
+
 /// \brief PythonEntityScript constructor
+///
+/// The script gets a handler table of its own.
 PythonEntityScript::PythonEntityScript(PyObject * o) :
-                    PythonWrapper(o)
+                    PythonWrapper(o),
+                    m_handlerTable(new PythonHandlerTable((PyObject*)o->ob_type))
+{
+}
+
+/// \brief PythonEntityScript constructor
+///
+/// @param handlers Handler table shared with other scripts of the same class
+PythonEntityScript::PythonEntityScript(PyObject * o,
+                 const std::shared_ptr<PythonHandlerTable> & handlers) :
+                    PythonWrapper(o), m_handlerTable(handlers)
 {
 }
 
 PythonEntityScript::~PythonEntityScript()
 {
+    // The bound handlers hold references to the wrapper, which must be
+    // released before the wrapper is.
+    for (PyObject * handler : m_handlers) {
+        Py_XDECREF(handler);
+    }
+}
+
+/// \brief Get the handler in a slot, bound to this script.
+PyObject * PythonEntityScript::getHandler(int slot)
+{
+    if ((std::size_t)slot >= m_handlers.size()) {
+        m_handlers.resize(m_handlerTable->size(), 0);
+    }
+    PyObject * handler = m_handlers[slot];
+    if (handler == 0) {
+        const std::string & op_name = m_handlerTable->method(slot);
+        handler = PyObject_GetAttrString(m_wrapper,
+                                         (char *)(op_name.c_str()));
+        if (handler == 0) {
+            PyErr_Clear();
+            return 0;
+        }
+        m_handlers[slot] = handler;
+    }
+    return handler;
 }
 
 bool PythonEntityScript::operation(const std::string & op_type,
@@ -52,16 +162,18 @@ bool PythonEntityScript::operation(const std::string & op_type,
                                    OpVector & res)
 {
     assert(m_wrapper != NULL);
-    std::string op_name = op_type + "_operation";
-    debug( std::cout << "Got script object for " << op_name << std::endl
-                                                            << std::flush;);
-    // This check isn't really necessary, except it saves the conversion
-    // time.
-    if (!PyObject_HasAttrString(m_wrapper, (char *)(op_name.c_str()))) {
-        debug( std::cout << "No method to be found for " << op_name
-                         << std::endl << std::flush;);
+    int slot = m_handlerTable->find(op->getClassNo(), op_type,
+                                    m_wrapper);
+    if (slot == -1) {
+        return false;
+    }
+    PyObject * handler = getHandler(slot);
+    if (handler == 0) {
         return false;
     }
+    const std::string & op_name = m_handlerTable->method(slot);
+    debug( std::cout << "Got script object for " << op_name << std::endl
+                                                            << std::flush;);
     // Construct apropriate python object thingies from op
     PyOperation * py_op = newPyConstOperation();
     if (py_op == 0) {
@@ -69,8 +181,7 @@ bool PythonEntityScript::operation(const std::string & op_type,
     }
     py_op->operation = op;
     PyObject * ret;
-    ret = PyObject_CallMethod(m_wrapper, (char *)(op_name.c_str()),
-                                            (char *)"(O)", py_op);
+    ret = PyObject_CallFunctionObjArgs(handler, py_op, NULL);
     Py_DECREF(py_op);
     if (ret == NULL) {
         if (PyErr_Occurred() == NULL) {
@@ -21,11 +21,66 @@
 
 #include "PythonWrapper.h"
 
+#include <map>
+#include <memory>
+#include <vector>
+
+/// \brief Table of the operation handlers a Python script class defines
+///
+/// Shared by all the scripts instanced from the same class, so that each
+/// handler only is looked up once for the class, and operations with no
+/// handler never reach the interpreter. Lookups are keyed on the operation
+/// class number, falling back to the name for event names which differ
+/// from the type of the operation. Reloading the class creates a new table.
+///
+/// Each name is resolved on the first script instance it's looked up for,
+/// so handlers provided by the instance rather than the class are found
+/// too. If the class defines __getattr__, names with no handler are
+/// resolved again every time, as the answer may differ between instances.
+/// \ingroup Scripts
+class PythonHandlerTable {
+  protected:
+    /// \brief Class the handlers are looked up in.
+    struct _object * m_class;
+    /// \brief Type each class number has been resolved for, and the slot
+    /// of its handler.
+    std::vector<std::pair<std::string, int> > m_classHandlers;
+    /// \brief Slot of the handler for each name resolved.
+    std::map<std::string, int> m_namedHandlers;
+    /// \brief Method name of the handler in each slot.
+    std::vector<std::string> m_methods;
+    /// \brief Whether the class defines __getattr__.
+    bool m_dynamicAttributes;
+
+    int resolve(const std::string & op_type, struct _object * instance);
+  public:
+    explicit PythonHandlerTable(struct _object * cls);
+    ~PythonHandlerTable();
+
+    int find(int class_no, const std::string & op_type,
+             struct _object * instance);
+
+    /// \brief Number of handler slots.
+    std::size_t size() const { return m_methods.size(); }
+
+    /// \brief Method name of the handler in a slot.
+    const std::string & method(int slot) const { return m_methods[slot]; }
+};
+
 /// \brief Script class for Python scripts attached to an Entity
 /// \ingroup Scripts
 class PythonEntityScript : public PythonWrapper {
+  protected:
+    /// \brief Handlers of the class of the script.
+    std::shared_ptr<PythonHandlerTable> m_handlerTable;
+    /// \brief Handlers bound to the script, indexed by slot in the table.
+    std::vector<struct _object *> m_handlers;
+
+    struct _object * getHandler(int slot);
   public:
     explicit PythonEntityScript(PyObject *);
+    PythonEntityScript(PyObject *,
+                       const std::shared_ptr<PythonHandlerTable> & handlers);
     virtual ~PythonEntityScript();
 
     virtual bool operation(const std::string & opname,
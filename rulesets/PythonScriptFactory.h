@@ -23,10 +23,19 @@
 
 #include "common/ScriptKit.h"
 
+#include <memory>
+
+class PythonHandlerTable;
+
 /// \brief Factory implementation for creating python script objects to attach
 /// to in game objects.
 template <class T>
 class PythonScriptFactory : public ScriptKit<T>, private PythonClass {
+  protected:
+    /// \brief Handlers of the class, shared by the scripts created
+    std::shared_ptr<PythonHandlerTable> m_handlerTable;
+
+    void resetHandlerTable();
   public:
     PythonScriptFactory(const std::string & package, const std::string & type);
     ~PythonScriptFactory();
@@ -33,10 +33,24 @@ PythonScriptFactory<T>::~PythonScriptFactory()
 {
 }
 
+/// \brief Start a new handler table for the current class.
+///
+/// Scripts already created keep the table of the class they were
+/// instanced from.
+template <class T>
+void PythonScriptFactory<T>::resetHandlerTable()
+{
+    if (this->m_class != 0) {
+        m_handlerTable.reset(new PythonHandlerTable(this->m_class));
+    }
+}
+
 template <class T>
 int PythonScriptFactory<T>::setup()
 {
-    return load();
+    int ret = load();
+    resetHandlerTable();
+    return ret;
 }
 
 template <class T>
@@ -61,7 +75,8 @@ int PythonScriptFactory<T>::addScript(T * entity) const
     Py_DECREF(wrapper);
 
     if (script != NULL) {
-        entity->setScript(new PythonEntityScript(script));
+        entity->setScript(new PythonEntityScript(script,
+                                                  m_handlerTable));
 
         Py_DECREF(script);
     }
@@ -72,7 +87,11 @@ int PythonScriptFactory<T>::addScript(T * entity) const
 template <class T>
 int PythonScriptFactory<T>::refreshClass()
 {
-    return refresh();
+    int ret = refresh();
+    if (ret == 0) {
+        resetHandlerTable();
+    }
+    return ret;
 }
 
 #endif // RULESETS_PYTHON_SCRIPT_FACTORY_IMPL_H
@@ -47,6 +47,8 @@
 #include "common/const.h"
 #include "common/debug.h"
 #include "common/log.h"
+#include "common/Monitors.h"
+#include "common/Variable.h"
 
 #include <Atlas/Objects/Operation.h>
 #include <Atlas/Objects/Anonymous.h>
@@ -790,6 +792,8 @@ void init_python_api(const std::string & ruleset, bool log_stdout)
         return;
     }
     PyModule_AddObject(server, "Thing", (PyObject *)&PyEntity_Type);
+    Monitors::instance()->watch("python_class_property_reads",
+                                new Variable<int>(python_class_property_reads));
     if (PyType_Ready(&PyCharacter_Type) < 0) {
         log(CRITICAL, "Python init failed to ready Character wrapper type");
         return;
@@ -40,6 +40,8 @@ class Stackable : public Thing {
     explicit Stackable(const std::string & id, long intId);
     virtual ~Stackable();
 
+    SLAB_POOLED(entities, "Stackable")
+
     virtual void CombineOperation(const Operation &, OpVector &);
     virtual void DivideOperation(const Operation &, OpVector &);
 };
@@ -67,6 +67,7 @@ Operation Task::nextTick(double interval)
     tick->setTo(m_owner.getId());
     tick->setFutureSeconds(interval);
 
+    m_nextTick = tick;
     return tick;
 }
 
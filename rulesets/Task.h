@@ -20,6 +20,7 @@
 #define RULESETS_TASK_H
 
 #include "common/OperationRouter.h"
+#include "common/OpHandle.h"
 
 #include <Atlas/Message/Element.h>
 
@@ -66,6 +67,12 @@ class Task {
     /// \brief The language script that will handle this task
     Script * m_script;
 
+    /// \brief The most recent tick op created for this task
+    Operation m_nextTick;
+
+    /// \brief Handle to the scheduled tick op, if any
+    OpHandle m_tickHandle;
+
   private:
     /// \brief Private deleted, to make sure slicing is impossible
     Task(const Task & t) = delete;
@@ -120,6 +127,16 @@ class Task {
         return m_serialno;
     }
 
+    /// \brief Return the most recent tick op created by nextTick()
+    const Operation & nextTickOp() const {
+        return m_nextTick;
+    }
+
+    /// \brief Accessor for the handle to the scheduled tick op
+    OpHandle & tickHandle() {
+        return m_tickHandle;
+    }
+
     /// \brief Return a new tick serial number.
     int newTick() {
         return ++m_serialno;
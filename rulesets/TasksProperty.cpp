@@ -21,6 +21,7 @@
 #include "LocatedEntity.h"
 #include "Task.h"
 
+#include "common/BaseWorld.h"
 #include "common/compose.hpp"
 #include "common/debug.h"
 #include "common/log.h"
@@ -98,6 +99,42 @@ TasksProperty * TasksProperty::copy() const
     return new TasksProperty(*this);
 }
 
+/// \brief Schedule the next tick of the task so that it can be cancelled.
+///
+/// The tick op created by the task is taken out of the result, and passed
+/// to the world directly. Any previously scheduled tick is cancelled, so
+/// that it doesn't have to travel through the operation queue only to be
+/// discarded as an old tick.
+void TasksProperty::scheduleTick(LocatedEntity * owner, OpVector & res)
+{
+    const Operation & tick = m_task->nextTickOp();
+    if (!tick.isValid()) {
+        return;
+    }
+    OpVector::iterator I = res.begin();
+    OpVector::iterator Iend = res.end();
+    for (; I != Iend; ++I) {
+        if (I->get() == tick.get()) {
+            break;
+        }
+    }
+    if (I == Iend) {
+        return;
+    }
+    res.erase(I);
+    BaseWorld::instance().cancelOperation(m_task->tickHandle());
+    m_task->tickHandle() = BaseWorld::instance().scheduleOperation(tick,
+                                                                   *owner);
+}
+
+/// \brief Cancel the pending tick of the current task, if there is one.
+void TasksProperty::cancelTick()
+{
+    if (m_task->tickHandle().isPending()) {
+        BaseWorld::instance().cancelOperation(m_task->tickHandle());
+    }
+}
+
 int TasksProperty::updateTask(LocatedEntity * owner, OpVector & res)
 {
     setFlags(flag_unsent);
@@ -118,6 +155,7 @@ int TasksProperty::startTask(Task * task,
     bool update_required = false;
     if (m_task != 0) {
         update_required = true;
+        cancelTick();
         m_task->decRef();
         m_task = 0;
     }
@@ -134,6 +172,7 @@ int TasksProperty::startTask(Task * task,
         assert(!res.empty());
         m_task = task;
         m_task->incRef();
+        scheduleTick(owner, res);
         update_required = true;
     }
 
@@ -156,6 +195,7 @@ int TasksProperty::clearTask(LocatedEntity * owner, OpVector & res)
     // Thus far a task can only have one reference legally, so if we
     // have a task it's count must be 1
     assert(m_task->count() == 1);
+    cancelTick();
     m_task->decRef();
     m_task = 0;
 
@@ -171,6 +211,7 @@ void TasksProperty::stopTask(LocatedEntity * owner, OpVector & res)
     }
 
     assert(m_task->count() == 1);
+    cancelTick();
     m_task->decRef();
     m_task = 0;
 
@@ -224,6 +265,7 @@ HandlerResult TasksProperty::operation(LocatedEntity * owner,
     if (m_task->obsolete()) {
         clearTask(owner, res);
     } else {
+        scheduleTick(owner, res);
         updateTask(owner, res);
     }
     return OPERATION_HANDLED;
@@ -28,6 +28,9 @@ class Task;
 class TasksProperty : public PropertyBase {
   protected:
     Task * m_task;
+
+    void scheduleTick(LocatedEntity * owner, OpVector & res);
+    void cancelTick();
   public:
     /// \brief Constructor
     explicit TasksProperty();
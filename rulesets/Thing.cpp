@@ -207,9 +207,10 @@ void Thing::MoveOperation(const Operation & op, OpVector & res)
 
     std::string mode;
 
-    if (hasAttr("mode")) {
+    const PropertyBase * mode_prop = getPropertyClass<ModeSlot>();
+    if (mode_prop != 0) {
         Element mode_attr;
-        getAttr("mode", mode_attr);
+        mode_prop->get(mode_attr);
         if (mode_attr.isString()) {
             mode = mode_attr.String();
         } else {
@@ -329,12 +330,16 @@ void Thing::MoveOperation(const Operation & op, OpVector & res)
 
             u->setRefno(m_motion->serialno());
 
-            res.push_back(u);
+            //Any update already scheduled is now obsolete, so cancel it
+            //rather than letting it pass through the queue.
+            BaseWorld::instance().cancelOperation(m_motion->updateHandle());
+            m_motion->updateHandle() = BaseWorld::instance().scheduleOperation(u, *this);
 
         } else {
             if (m_motion) {
                 //We moved previously, but have now stopped.
 
+                BaseWorld::instance().cancelOperation(m_motion->updateHandle());
                 delete m_motion;
                 m_motion = nullptr;
             }
@@ -353,13 +358,9 @@ void Thing::MoveOperation(const Operation & op, OpVector & res)
 
         // This code handles sending Appearance and Disappearance operations
         // to this entity and others to indicate if one has gained or lost
-        // sight of the other because of this movement
-
-        // FIXME Why only for a perceptive moving entity? Surely other entities
-        // must gain/lose sight of this entity if it's moving?
-        if (isPerceptive()) {
-            checkVisibility(old_loc, res);
-        }
+        // sight of the other because of this movement. The domain decides
+        // which moves it needs to consider.
+        checkVisibility(old_loc, res);
     }
     m_seq++;
 
@@ -419,17 +420,18 @@ void Thing::updateProperties(const Operation & op, OpVector & res)
     Anonymous set_arg;
     set_arg->setId(getId());
 
-    PropertyDict::const_iterator J = m_properties.begin();
-    PropertyDict::const_iterator Jend = m_properties.end();
+    // Only the properties marked as unsent since the last update need to
+    // be looked at.
+    std::vector<PropertyBase *> unsent;
+    unsent.swap(m_propertyChanges.unsent);
 
-    for (; J != Jend; ++J) {
-        PropertyBase * prop = J->second;
+    for (PropertyBase * prop : unsent) {
         assert(prop != 0);
         if (prop->flags() & flag_unsent) {
-            debug(std::cout << "UPDATE:  " << flag_unsent << " " << J->first
+            debug(std::cout << "UPDATE:  " << flag_unsent << " " << prop->name()
                             << std::endl << std::flush;);
 
-            prop->add(J->first, set_arg);
+            prop->add(prop->name(), set_arg);
             prop->resetFlags(flag_unsent | per_clean);
             resetFlags(entity_clean);
             // FIXME Make sure we handle separately for private properties
@@ -493,9 +495,10 @@ void Thing::UpdateOperation(const Operation & op, OpVector & res)
 
     std::string mode;
 
-    if (hasAttr("mode")) {
+    const PropertyBase * mode_prop = getPropertyClass<ModeSlot>();
+    if (mode_prop != 0) {
         Element mode_attr;
-        getAttr("mode", mode_attr);
+        mode_prop->get(mode_attr);
         if (mode_attr.isString()) {
             mode = mode_attr.String();
         } else {
@@ -578,31 +581,33 @@ void Thing::UpdateOperation(const Operation & op, OpVector & res)
         u->setTo(getId());
 
         // If the update op has no serial number, we need our own
-        // ref number
+        // ref number, otherwise we should respect the serial number.
+        // The update is scheduled here rather than returned, so it
+        // doesn't pass through the core code which would set the
+        // reference number, and is given the motion serial number as in
+        // MoveOperation().
         if (op->isDefaultSerialno()) {
-            u->setRefno(++m_motion->serialno());
+            ++m_motion->serialno();
         } else {
-            // We should respect the serial number if it is present
-            // as the core code will set the reference number
-            // correctly.
             m_motion->serialno() = op->getSerialno();
         }
+        u->setRefno(m_motion->serialno());
 
-        res.push_back(u);
+        //The update being handled now has already been dequeued, so
+        //this only releases the handle.
+        BaseWorld::instance().cancelOperation(m_motion->updateHandle());
+        m_motion->updateHandle() = BaseWorld::instance().scheduleOperation(u, *this);
     } else {
+        BaseWorld::instance().cancelOperation(m_motion->updateHandle());
         delete m_motion;
         m_motion = nullptr;
     }
 
     // This code handles sending Appearance and Disappearance operations
     // to this entity and others to indicate if one has gained or lost
-    // sight of the other because of this movement
-
-    // FIXME Why only for a perceptive moving entity? Surely other entities
-    // must gain/lose sight of this entity if it's moving?
-    if (isPerceptive()) {
-        checkVisibility(old_loc, res);
-    }
+    // sight of the other because of this movement. The domain decides
+    // which moves it needs to consider.
+    checkVisibility(old_loc, res);
     onUpdated();
 }
 
@@ -37,6 +37,8 @@ class Thing : public Entity {
     explicit Thing(const std::string & id, long intId);
     virtual ~Thing();
 
+    SLAB_POOLED(entities, "Thing")
+
     virtual void DeleteOperation(const Operation & op, OpVector &);
     virtual void MoveOperation(const Operation & op, OpVector &);
     virtual void SetOperation(const Operation & op, OpVector &);
@@ -65,7 +65,7 @@ World::World(const std::string & id, long intId) : Thing(id, intId), m_serialNum
 
     CalendarProperty* calProp = new CalendarProperty();
     calProp->install(this, "calendar");
-    m_properties["calendar"] = calProp;
+    insertProperty("calendar", calProp);
 }
 
 World::~World()
@@ -172,19 +172,21 @@ void World::clearWorld(OpVector & res) {
     auto propIter = m_properties.begin();
     while(propIter != m_properties.end())
     {
-        if (propIter->first != "id") {
+        const std::string & name = m_properties.name(propIter->first);
+        if (name != "id") {
             auto prop = propIter->second;
-            prop->remove(this, propIter->first);
+            prop->remove(this, name);
             delete prop;
-            m_properties.erase(propIter++);
+            propIter = m_properties.erase(propIter);
         } else {
             ++propIter;
         }
     }
+    m_slots.invalidate();
 
     CalendarProperty* calProp = new CalendarProperty();
     calProp->install(this, "calendar");
-    m_properties["calendar"] = calProp;
+    insertProperty("calendar", calProp);
 
     delete m_contains;
     m_contains = nullptr;
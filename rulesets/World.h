@@ -51,6 +51,8 @@ public:
     explicit World(const std::string & id, long intId);
     virtual ~World();
 
+    SLAB_POOLED(entities, "World")
+
     virtual void LookOperation(const Operation &, OpVector &);
     virtual void DeleteOperation(const Operation &, OpVector &);
     virtual void MoveOperation(const Operation &, OpVector &);
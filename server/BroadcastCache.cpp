@@ -0,0 +1,181 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "BroadcastCache.h"
+
+#include <Atlas/Bridge.h>
+#include <Atlas/Codecs/Bach.h>
+#include <Atlas/Codecs/Packed.h>
+#include <Atlas/Codecs/XML.h>
+#include <Atlas/Objects/Anonymous.h>
+#include <Atlas/Objects/Encoder.h>
+#include <Atlas/Objects/Operation.h>
+
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using Atlas::Objects::Entity::Anonymous;
+using Atlas::Objects::Operation::Info;
+using Atlas::Objects::Operation::Move;
+using Atlas::Objects::Operation::RootOperation;
+using Atlas::Objects::Operation::Sight;
+
+/// Put in place of the "to" attribute when encoding a broadcast, so that
+/// its position in the encoded data can be found.
+static const char * const BROADCAST_TO_MARKER = "broadcastToMarker7f3a9c";
+
+namespace {
+    /// \brief Bridge for codecs which are only used for encoding.
+    class EncodeOnlyBridge : public Atlas::Bridge
+    {
+        public:
+            virtual void streamBegin() { }
+            virtual void streamMessage() { }
+            virtual void streamEnd() { }
+            virtual void mapMapItem(const std::string &) { }
+            virtual void mapListItem(const std::string &) { }
+            virtual void mapIntItem(const std::string &, long) { }
+            virtual void mapFloatItem(const std::string &, double) { }
+            virtual void mapStringItem(const std::string &, const std::string &) { }
+            virtual void mapEnd() { }
+            virtual void listMapItem() { }
+            virtual void listListItem() { }
+            virtual void listIntItem(long) { }
+            virtual void listFloatItem(double) { }
+            virtual void listStringItem(const std::string &) { }
+            virtual void listEnd() { }
+    };
+
+    Atlas::Codec * createCodec(const std::string & codec,
+                               std::iostream & stream,
+                               Atlas::Bridge & bridge)
+    {
+        if (codec == "Bach") {
+            return new Atlas::Codecs::Bach(stream, bridge);
+        } else if (codec == "Packed") {
+            return new Atlas::Codecs::Packed(stream, bridge);
+        }
+        return new Atlas::Codecs::XML(stream, bridge);
+    }
+
+    /// \brief Encodes a few operations the way a client would, splicing
+    /// in the shared encoding of those which are broadcast, and checks that
+    /// the result is what the codec of the client would have written.
+    bool checkSplice(const std::string & codec)
+    {
+        Anonymous arg;
+        arg->setId("2");
+        arg->setLoc("0");
+        arg->setPosAsList({1.5, 2., -3.});
+        arg->setVelocityAsList({0., 1., 0.});
+        Move move;
+        move->setFrom("2");
+        move->setArgs1(arg);
+
+        RootOperation sight = Sight();
+        sight->setFrom("2");
+        sight->setArgs1(move);
+        RootOperation info = Info();
+        info->setTo("1");
+        info->setArgs1(arg);
+
+        // A broadcast first thing in the stream, ops sent the normal way
+        // in between, and broadcasts back to back.
+        std::vector<std::pair<RootOperation, bool>> ops = {
+            {sight, true}, {info, false}, {sight, true}, {sight, true},
+            {info, false}, {sight, true}
+        };
+
+        EncodeOnlyBridge bridge;
+        std::stringstream plainStream, splicedStream;
+        std::unique_ptr<Atlas::Codec> plainCodec(
+                createCodec(codec, plainStream, bridge));
+        std::unique_ptr<Atlas::Codec> splicedCodec(
+                createCodec(codec, splicedStream, bridge));
+        Atlas::Objects::ObjectsEncoder plainEncoder(*plainCodec);
+        Atlas::Objects::ObjectsEncoder splicedEncoder(*splicedCodec);
+        plainCodec->streamBegin();
+        splicedCodec->streamBegin();
+
+        BroadcastCache::Encoding encoding{nullptr, 0, 0};
+        if (!BroadcastCache::encode(codec, sight, encoding)) {
+            return false;
+        }
+        long to = 10;
+        for (auto & entry : ops) {
+            const RootOperation & op = entry.first;
+            if (entry.second) {
+                op->setTo(std::to_string(++to));
+                splicedStream << encoding.splice(op->getTo());
+            } else {
+                splicedEncoder.streamObjectsMessage(op);
+            }
+            plainEncoder.streamObjectsMessage(op);
+        }
+        return splicedStream.str() == plainStream.str();
+    }
+}
+
+bool BroadcastCache::encode(const std::string & codec,
+                            const RootOperation & op,
+                            Encoding & encoding)
+{
+    EncodeOnlyBridge bridge;
+    std::stringstream stream;
+    std::unique_ptr<Atlas::Codec> encodeCodec(createCodec(codec, stream, bridge));
+    Atlas::Objects::ObjectsEncoder encoder(*encodeCodec);
+
+    //Encode with a marker in place of the recipient, and then find it.
+    std::string to = op->getTo();
+    op->setTo(BROADCAST_TO_MARKER);
+    encoder.streamObjectsMessage(op);
+    op->setTo(to);
+
+    std::string data = stream.str();
+    std::size_t offset = data.find(BROADCAST_TO_MARKER);
+    if (offset == std::string::npos ||
+        data.find(BROADCAST_TO_MARKER, offset + 1) != std::string::npos) {
+        return false;
+    }
+    encoding.data = std::make_shared<const std::string>(std::move(data));
+    encoding.toOffset = offset;
+    encoding.toLength = std::strlen(BROADCAST_TO_MARKER);
+    return true;
+}
+
+bool BroadcastCache::canSplice(const std::string & codec)
+{
+    //Each check runs once, even if clients negotiate in several threads.
+    if (codec == "Bach") {
+        static const bool bach = checkSplice("Bach");
+        return bach;
+    } else if (codec == "Packed") {
+        static const bool packed = checkSplice("Packed");
+        return packed;
+    } else if (codec == "XML") {
+        static const bool xml = checkSplice("XML");
+        return xml;
+    }
+    return false;
+}
@@ -0,0 +1,162 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef BROADCASTCACHE_H_
+#define BROADCASTCACHE_H_
+
+#include <Atlas/Objects/RootOperation.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+/// \brief Encodings of the operation currently being broadcast.
+///
+/// When the same operation is sent to many clients only the value of its
+/// "to" attribute differs between them. The first client using a certain
+/// codec encodes the operation and stores it here, split around the value
+/// of "to". The following clients then send the stored data with their own
+/// value spliced in, instead of encoding the whole operation again.
+class BroadcastCache
+{
+    public:
+        /// \brief An operation encoded with a certain codec.
+        struct Encoding {
+            /// The encoded data, or null if it couldn't be shared.
+            std::shared_ptr<const std::string> data;
+            /// Where the value of the "to" attribute starts.
+            std::size_t toOffset;
+            /// The length of the value of the "to" attribute.
+            std::size_t toLength;
+
+            /// \brief The data with another value of "to" spliced in, as
+            /// the segments a client queues add up to.
+            std::string splice(const std::string & to) const
+            {
+                return data->substr(0, toOffset) + to +
+                       data->substr(toOffset + toLength);
+            }
+        };
+
+        /// \brief Marks an operation as being broadcast while in scope.
+        class Scope
+        {
+            public:
+                explicit Scope(const Atlas::Objects::Operation::RootOperation & op)
+                {
+                    BroadcastCache::instance().begin(op);
+                }
+
+                ~Scope()
+                {
+                    BroadcastCache::instance().end();
+                }
+        };
+
+        static BroadcastCache & instance()
+        {
+            static BroadcastCache cache;
+            return cache;
+        }
+
+        /**
+         * @brief Marks the start of a broadcast.
+         *
+         * Broadcasts started while another one is in progress aren't cached.
+         */
+        void begin(const Atlas::Objects::Operation::RootOperation & op)
+        {
+            if (m_depth++ == 0) {
+                m_op = op.get();
+            }
+        }
+
+        /**
+         * @brief Marks the end of a broadcast, discarding the encodings.
+         */
+        void end()
+        {
+            if (--m_depth == 0) {
+                m_op = nullptr;
+                m_encodings.clear();
+            }
+        }
+
+        /**
+         * @brief Checks if an operation is the one being broadcast.
+         */
+        bool isBroadcast(const Atlas::Objects::Operation::RootOperation & op) const
+        {
+            return m_op != nullptr && op.get() == m_op;
+        }
+
+        /**
+         * @brief Gets the encoding made with a codec.
+         * @return The encoding, or null if there's none yet.
+         */
+        const Encoding * find(const std::string & codec) const
+        {
+            auto I = m_encodings.find(codec);
+            if (I == m_encodings.end()) {
+                return nullptr;
+            }
+            return &I->second;
+        }
+
+        const Encoding & insert(const std::string & codec,
+                                const Encoding & encoding)
+        {
+            return m_encodings[codec] = encoding;
+        }
+
+        /**
+         * @brief Encodes an operation with a fresh codec, split around the
+         * value of "to".
+         * @param codec The name of the codec; "Bach", "Packed" or "XML".
+         * @return false if the value of "to" couldn't be found in the data.
+         */
+        static bool encode(const std::string & codec,
+                           const Atlas::Objects::Operation::RootOperation & op,
+                           Encoding & encoding);
+
+        /**
+         * @brief Checks if encodings made with a codec can be spliced into
+         * the stream of a client.
+         *
+         * That's only the case if the codec encodes a message the same way
+         * whatever it encoded before. This is checked once for each codec,
+         * by comparing a stream with spliced operations to one in which all
+         * operations were encoded by the codec of the stream.
+         */
+        static bool canSplice(const std::string & codec);
+
+    private:
+        BroadcastCache() : m_depth(0), m_op(nullptr)
+        {
+        }
+
+        int m_depth;
+
+        /// The operation being broadcast. It's kept alive by the
+        /// broadcaster for the duration of the broadcast.
+        const void * m_op;
+
+        std::map<std::string, Encoding> m_encodings;
+};
+
+#endif /* BROADCASTCACHE_H_ */
@@ -19,6 +19,8 @@
 #ifndef COMMASIOCLIENT_H_
 #define COMMASIOCLIENT_H_
 
+#include "BroadcastCache.h"
+
 #include "common/Link.h"
 #include "common/CommSocket.h"
 
@@ -34,6 +36,10 @@
 #include <memory>
 #include <sstream>
 #include <deque>
+#include <unordered_map>
+#include <vector>
+
+class IoThreadPool;
 
 template<typename ProtocolT>
 class CommAsioClient: public Atlas::Objects::ObjectsDecoder,
@@ -43,6 +49,21 @@ class CommAsioClient: public Atlas::Objects::ObjectsDecoder,
     public:
         CommAsioClient(const std::string & name,
                 boost::asio::io_service& io_service);
+
+        /**
+         * @brief Ctor for a client whose socket is handled by network
+         * threads.
+         *
+         * Negotiation and decoding are done in the network threads. The
+         * decoded messages, and the results of writes, are handed over to
+         * the thread running the io_service, which is where everything
+         * else is done.
+         * @param io_service The io_service of the main thread.
+         * @param ioThreads The network threads.
+         */
+        CommAsioClient(const std::string & name,
+                boost::asio::io_service& io_service, IoThreadPool& ioThreads);
+
         virtual ~CommAsioClient();
 
         typename ProtocolT::socket& getSocket();
@@ -58,11 +79,47 @@ class CommAsioClient: public Atlas::Objects::ObjectsDecoder,
 
         virtual int flush();
 
+        virtual bool sendOperation(
+                const Atlas::Objects::Operation::RootOperation & op);
+
+        /**
+         * @brief Sets limits on the amount of data waiting to be sent.
+         * @param highWater Size in bytes above which movement updates which
+         * have been superseded by newer ones are dropped. 0 disables.
+         * @param hardLimit Size in bytes at which the client is
+         * disconnected. 0 disables.
+         */
+        void setSendQueueLimits(std::size_t highWater, std::size_t hardLimit);
+
     protected:
+        /// \brief A piece of data waiting to be written.
+        struct WriteSegment {
+            /// Keeps the data alive, or null if the data is in the write
+            /// buffer.
+            std::shared_ptr<const void> owner;
+            /// The data, if it's not in the write buffer.
+            const char * data;
+            /// Where the data starts, if it's in the write buffer.
+            std::size_t offset;
+            /// The length of the data. Dropped segments are empty.
+            std::size_t size;
+        };
+
+        /// \brief The segments of a queued movement update.
+        struct QueuedMove {
+            std::size_t first;
+            std::size_t count;
+        };
+
         typename ProtocolT::socket mSocket;
 
         boost::asio::streambuf mReadBuffer;
-        boost::asio::streambuf* mWriteBuffer;
+        std::shared_ptr<boost::asio::streambuf> mWriteBuffer;
+        /// \brief The buffer of the last write, kept for reuse.
+        std::shared_ptr<boost::asio::streambuf> m_spareWriteBuffer;
+        /// \brief Data read and written during negotiation. It's only used
+        /// in the thread of the socket, unlike the write buffer.
+        boost::asio::streambuf m_negotiateBuffer;
         std::iostream mStream;
         boost::asio::deadline_timer mNegotiateTimer;
 
@@ -77,6 +134,12 @@ class CommAsioClient: public Atlas::Objects::ObjectsDecoder,
         Atlas::Codec * m_codec;
         /// \brief high level encoder passes data to the codec for transmission.
         Atlas::Objects::ObjectsEncoder * m_encoder;
+        /// \brief Name of the codec, if it's one which can be used to
+        /// encode operations shared with other clients.
+        const char * m_codecName;
+        /// \brief Whether operations being broadcast are sent using the
+        /// encoding shared with other clients.
+        bool m_spliceBroadcasts;
         /// \brief Atlas negotiator for handling codec negotiation.
         Atlas::Negotiate * m_negotiate;
         /// \brief Server side object for handling connection level operations.
@@ -84,10 +147,90 @@ class CommAsioClient: public Atlas::Objects::ObjectsDecoder,
 
         const std::string mName;
 
+        /// \brief Data to be written, in order, by the next write.
+        std::vector<WriteSegment> m_writeQueue;
+        /// \brief How much of the write buffer is in the write queue.
+        std::size_t m_writeBufferQueued;
+        /// \brief The latest queued movement update for each entity.
+        std::unordered_map<std::string, QueuedMove> m_queuedMoves;
+        /// \brief Bytes in the write queue.
+        std::size_t m_queuedBytes;
+        /// \brief Bytes in the write in progress.
+        std::size_t m_writingBytes;
+        /// \brief True if a write will be done in the next turn of the
+        /// event loop.
+        bool m_writeScheduled;
+        /// \brief True if a write is in progress.
+        bool m_writing;
+        std::size_t m_sendQueueHighWater;
+        std::size_t m_sendQueueLimit;
+        /// \brief Key of the queue size of this client in Monitors.
+        std::string m_monitorKey;
+        /// \brief Network threads handling the socket, or null if it's
+        /// handled by the main thread.
+        IoThreadPool * m_ioThreads;
+        /// \brief Keeps handlers of the socket from running concurrently.
+        boost::asio::io_service::strand m_strand;
+        /// \brief Stream read by the decoding codec when decoding in the
+        /// network threads.
+        std::iostream m_readStream;
+        /// \brief Codec decoding incoming data in the network threads.
+        Atlas::Codec * m_decodeCodec;
+        /// \brief Messages decoded in the network threads, and not yet
+        /// handed over to the main thread.
+        std::vector<Atlas::Message::MapType> m_decoded;
+        /// \brief True once disconnect() has been called.
+        bool m_closing;
+        /// \brief True while negotiation data is being written.
+        bool m_negotiateWriting;
+
+        CommAsioClient(const std::string & name,
+                boost::asio::io_service& io_service,
+                boost::asio::io_service& socket_io_service,
+                IoThreadPool * ioThreads);
+
+        /// \brief Runs a function where the socket may be used.
+        template<typename FunctionT>
+        void runOnSocket(const FunctionT & function);
+
+        /// \brief Runs a function in the main thread.
+        template<typename FunctionT>
+        void runOnWorld(const FunctionT & function);
+
+        bool isOpen() const;
+
+        /// \brief Deletes the link, once the connection is closed.
+        void releaseLink();
+
+        /// \brief Called in the thread of the socket when reading has
+        /// stopped for good.
+        void readingDone();
+
+        /// \brief Starts sending operations once negotiation is done.
+        void startSession();
+
+        /// \brief Creates a codec of the same kind as the one negotiated.
+        Atlas::Codec * createCodec(std::iostream & stream);
+
         void do_read();
 
         void write();
 
+        /// \brief Moves anything written by the codec into the write queue.
+        void queueWriteBuffer();
+
+        void queueSegment(const WriteSegment & segment);
+
+        /// \brief Drops the queued segments of an operation.
+        void dropSegments(const QueuedMove & move);
+
+        void updateQueueMonitor();
+
+        /// \brief Queues an operation being broadcast, using an encoding
+        /// shared with other clients.
+        /// @return False if the operation wasn't queued.
+        bool queueBroadcast(const Atlas::Objects::Operation::RootOperation & op);
+
         void dispatch();
 
         void startNegotiation();
@@ -97,10 +240,19 @@ class CommAsioClient: public Atlas::Objects::ObjectsDecoder,
 
         void negotiate_read();
 
+        /// \brief Writes what negotiation has added to the negotiation
+        /// buffer, one write at a time, and starts the session once the
+        /// last of it has been written.
         void negotiate_write();
 
+        /// \brief Hands the client over to the main thread when
+        /// negotiation is done and all of its data has been written.
+        void finishNegotiation();
+
         int operation(const Atlas::Objects::Operation::RootOperation &);
 
+        virtual void messageArrived(const Atlas::Message::MapType & msg);
+
         virtual void objectArrived(const Atlas::Objects::Root & obj);
 };
 
@@ -25,21 +25,145 @@
 
 #include "common/log.h"
 #include "common/compose.hpp"
+#include "common/Monitors.h"
 
 #include "CommAsioClient.h"
+#include "IoThreadPool.h"
 
 #include <Atlas/Objects/Encoder.h>
+#include <Atlas/Objects/Operation.h>
 #include <Atlas/Objects/RootOperation.h>
 #include <Atlas/Objects/SmartPtr.h>
 #include <Atlas/Net/Stream.h>
+#include <Atlas/Codecs/Bach.h>
+#include <Atlas/Codecs/Packed.h>
+#include <Atlas/Codecs/XML.h>
+
+#include <cctype>
+#include <cstring>
+
+/// \brief Gets the name of the codec, if it's one we know how to recreate.
+inline const char * sharedCodecName(Atlas::Codec * codec)
+{
+    if (dynamic_cast<Atlas::Codecs::Bach *>(codec)) {
+        return "Bach";
+    } else if (dynamic_cast<Atlas::Codecs::Packed *>(codec)) {
+        return "Packed";
+    } else if (dynamic_cast<Atlas::Codecs::XML *>(codec)) {
+        return "XML";
+    }
+    return nullptr;
+}
+
+/// \brief Checks if a value of the "to" attribute can be spliced into the
+/// encoded data as it is, without any codec needing to escape it.
+inline bool isPlainValue(const std::string & value)
+{
+    for (char c : value) {
+        if (!std::isalnum((unsigned char)c) && c != '_' && c != '-' && c != '.') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// \brief Gets the entity whose movement an operation is a sight of.
+/// @return The id of the entity, or an empty string if the operation
+/// isn't a Sight of a Move.
+inline std::string movedEntityId(
+        const Atlas::Objects::Operation::RootOperation & op)
+{
+    if (op->getClassNo() != Atlas::Objects::Operation::SIGHT_NO ||
+        op->getArgs().empty()) {
+        return "";
+    }
+    Atlas::Objects::Operation::RootOperation move =
+            Atlas::Objects::smart_dynamic_cast<
+                    Atlas::Objects::Operation::RootOperation>(
+                    op->getArgs().front());
+    if (!move.isValid() ||
+        move->getClassNo() != Atlas::Objects::Operation::MOVE_NO ||
+        move->getArgs().empty()) {
+        return "";
+    }
+    return move->getArgs().front()->getId();
+}
+
+/// \brief Copies an element without sharing any data with the original.
+///
+/// Strings, maps and lists in elements are reference counted without
+/// locking, so elements handed over to another thread must not share them.
+inline Atlas::Message::Element detachedCopy(const Atlas::Message::Element & element)
+{
+    switch (element.getType()) {
+        case Atlas::Message::Element::TYPE_STRING:
+            return Atlas::Message::Element(std::string(element.String()));
+        case Atlas::Message::Element::TYPE_MAP:
+            {
+                Atlas::Message::MapType map;
+                for (auto& entry : element.Map()) {
+                    map.insert(std::make_pair(entry.first, detachedCopy(entry.second)));
+                }
+                return Atlas::Message::Element(map);
+            }
+        case Atlas::Message::Element::TYPE_LIST:
+            {
+                Atlas::Message::ListType list;
+                list.reserve(element.List().size());
+                for (auto& entry : element.List()) {
+                    list.push_back(detachedCopy(entry));
+                }
+                return Atlas::Message::Element(list);
+            }
+        default:
+            return element;
+    }
+}
+
+/// \brief Number of operations dropped from the send queues of all clients.
+inline Atlas::Message::IntType & droppedSendOps()
+{
+    static Atlas::Message::IntType count = 0;
+    return count;
+}
+
+/// \brief Number of clients disconnected because their send queue was full.
+inline Atlas::Message::IntType & sendQueueDisconnects()
+{
+    static Atlas::Message::IntType count = 0;
+    return count;
+}
 
 template<class ProtocolT>
 CommAsioClient<ProtocolT>::CommAsioClient(const std::string & name,
         boost::asio::io_service& io_service) :
-        CommSocket(io_service), mSocket(io_service), mWriteBuffer(
-                new boost::asio::streambuf()), mStream(mWriteBuffer), mNegotiateTimer(
+        CommAsioClient(name, io_service, io_service, nullptr)
+{
+}
+
+template<class ProtocolT>
+CommAsioClient<ProtocolT>::CommAsioClient(const std::string & name,
+        boost::asio::io_service& io_service, IoThreadPool& ioThreads) :
+        CommAsioClient(name, io_service, ioThreads.getIoService(), &ioThreads)
+{
+}
+
+template<class ProtocolT>
+CommAsioClient<ProtocolT>::CommAsioClient(const std::string & name,
+        boost::asio::io_service& io_service,
+        boost::asio::io_service& socket_io_service,
+        IoThreadPool * ioThreads) :
+        CommSocket(io_service), mSocket(socket_io_service), mWriteBuffer(
+                new boost::asio::streambuf()), mStream(&m_negotiateBuffer), mNegotiateTimer(
                 io_service, boost::posix_time::seconds(1)), m_codec(nullptr), m_encoder(
-                nullptr), m_negotiate(nullptr), m_link(nullptr), mName(name)
+                nullptr), m_codecName(nullptr), m_spliceBroadcasts(false),
+                m_negotiate(nullptr), m_link(nullptr), mName(name),
+                m_writeBufferQueued(0), m_queuedBytes(0),
+                m_writingBytes(0), m_writeScheduled(false), m_writing(false),
+                m_sendQueueHighWater(0), m_sendQueueLimit(0), m_ioThreads(
+                ioThreads), m_strand(socket_io_service), m_readStream(
+                &mReadBuffer), m_decodeCodec(nullptr), m_closing(false),
+                m_negotiateWriting(false)
 {
 }
 
@@ -50,7 +174,10 @@ CommAsioClient<ProtocolT>::~CommAsioClient()
     delete m_negotiate;
     delete m_encoder;
     delete m_codec;
-    delete mWriteBuffer;
+    delete m_decodeCodec;
+    if (!m_monitorKey.empty()) {
+        Monitors::instance()->erase(m_monitorKey);
+    }
     try {
         mSocket.shutdown(ProtocolT::socket::shutdown_both);
     } catch (const std::exception& e) {
@@ -67,116 +194,282 @@ typename ProtocolT::socket& CommAsioClient<ProtocolT>::getSocket()
     return mSocket;
 }
 
+template<class ProtocolT>
+template<typename FunctionT>
+void CommAsioClient<ProtocolT>::runOnSocket(const FunctionT & function)
+{
+    if (m_ioThreads) {
+        m_strand.post(function);
+    } else {
+        function();
+    }
+}
+
+template<class ProtocolT>
+template<typename FunctionT>
+void CommAsioClient<ProtocolT>::runOnWorld(const FunctionT & function)
+{
+    if (m_ioThreads) {
+        m_ioThreads->postToWorld(function);
+    } else {
+        function();
+    }
+}
+
+template<class ProtocolT>
+bool CommAsioClient<ProtocolT>::isOpen() const
+{
+    //The socket is only safe to use from the network threads.
+    if (m_ioThreads) {
+        return !m_closing;
+    }
+    return mSocket.is_open();
+}
+
+template<class ProtocolT>
+void CommAsioClient<ProtocolT>::releaseLink()
+{
+    delete m_link;
+    m_link = nullptr;
+    if (!m_monitorKey.empty()) {
+        Monitors::instance()->erase(m_monitorKey);
+        m_monitorKey.clear();
+    }
+}
+
+template<class ProtocolT>
+void CommAsioClient<ProtocolT>::readingDone()
+{
+    //The instance might be deleted in a network thread, so the link, which
+    //belongs to the main thread, has to be deleted there first.
+    if (m_ioThreads) {
+        auto self(this->shared_from_this());
+        m_ioThreads->postToWorld([this, self]() {
+            this->releaseLink();
+        });
+    }
+}
+
 template<class ProtocolT>
 void CommAsioClient<ProtocolT>::do_read()
 {
     auto self(this->shared_from_this());
     mSocket.async_read_some(mReadBuffer.prepare(read_buffer_size),
-            [this, self](boost::system::error_code ec, std::size_t length)
+            m_strand.wrap([this, self](boost::system::error_code ec, std::size_t length)
             {
                 if (!ec)
                 {
                     mReadBuffer.commit(length);
-                    mStream.rdbuf(&mReadBuffer);
-                    m_codec->poll();
-                    mStream.rdbuf(mWriteBuffer);
-                    this->dispatch();
+                    if (m_ioThreads) {
+                        //Decode into messages here, and let the main thread
+                        //turn them into operations and dispatch them.
+                        m_decodeCodec->poll();
+                        if (!m_decoded.empty()) {
+                            auto messages = std::make_shared<std::vector<Atlas::Message::MapType>>();
+                            messages->swap(m_decoded);
+                            m_ioThreads->postToWorld([this, self, messages]() {
+                                for (auto& message : *messages) {
+                                    this->Atlas::Objects::ObjectsDecoder::messageArrived(message);
+                                }
+                                this->dispatch();
+                            });
+                        }
+                    } else {
+                        mStream.rdbuf(&mReadBuffer);
+                        m_codec->poll();
+                        mStream.rdbuf(mWriteBuffer.get());
+                        this->dispatch();
+                    }
                     //By calling do_read again we make sure that the instance
                     //doesn't go out of scope ("shared_from this"). As soon as that
                     //doesn't happen, and there's no write in progress, the instance
                     //will be deleted since there's no more references to it.
                     this->do_read();
+                } else {
+                    this->readingDone();
                 }
-            });
+            }));
+}
+
+template<class ProtocolT>
+void CommAsioClient<ProtocolT>::queueSegment(const WriteSegment & segment)
+{
+    m_writeQueue.push_back(segment);
+    m_queuedBytes += segment.size;
+}
+
+template<class ProtocolT>
+void CommAsioClient<ProtocolT>::queueWriteBuffer()
+{
+    //The codec writes to the end of the write buffer, so anything after
+    //what's already queued is new. Only the offset is kept, since the data
+    //might move as the buffer grows.
+    std::size_t size = mWriteBuffer->size();
+    if (size > m_writeBufferQueued) {
+        queueSegment(WriteSegment{nullptr, nullptr, m_writeBufferQueued,
+                size - m_writeBufferQueued});
+        m_writeBufferQueued = size;
+    }
+}
+
+template<class ProtocolT>
+void CommAsioClient<ProtocolT>::dropSegments(const QueuedMove & move)
+{
+    for (std::size_t i = move.first; i < move.first + move.count; ++i) {
+        WriteSegment & segment = m_writeQueue[i];
+        m_queuedBytes -= segment.size;
+        segment.owner.reset();
+        segment.size = 0;
+    }
+}
+
+template<class ProtocolT>
+void CommAsioClient<ProtocolT>::updateQueueMonitor()
+{
+    if (!m_monitorKey.empty()) {
+        Monitors::instance()->insert(m_monitorKey,
+                (Atlas::Message::IntType)(m_queuedBytes + m_writingBytes));
+    }
 }
 
 template<class ProtocolT>
 void CommAsioClient<ProtocolT>::write()
 {
+    //Only one write is done at a time. Anything queued while it's in
+    //progress is written when it's done.
+    if (m_writing) {
+        return;
+    }
+    queueWriteBuffer();
+    if (m_writeQueue.empty()) {
+        return;
+    }
     auto self(this->shared_from_this());
 
-    //When sending data we need to make sure that nothing else writes to the streambuf (mWriteBuffer).
-    //We do this by creating a new streambuf instance. The one containing the data to be sent is
-    //then contained in a shared_ptr. When the async write operation is done the shared_ptr will
-    //be deleted. However, in order to make this a bit more efficient we'll use a custom deletor
-    //in which we'll check if the new buffer has had anything written to it. If not, we'll reuse
-    //the buffer just used for writing, as this will already have had memory allocated.
-    std::function<void(boost::asio::streambuf*)> bufferDeleter =
-            [&, self](boost::asio::streambuf* p) {
-                //Check if the existing writebuffer has had anything written to it.
-                if (this->mWriteBuffer->size() > 0) {
-                    delete p;
-                } else {
-                    //If the existing writebuffer hasn't had anything written to it we'll reuse the previous
-                    //one instead since it already have had memory allocated. This prevents unnecessary release
-                    //and re-allocation of memory.
-                    delete this->mWriteBuffer;
-                    this->mWriteBuffer = p;
-                    this->mStream.rdbuf(this->mWriteBuffer);
+    //Hand the write buffer over to the write, and let the codec continue
+    //with the spare one.
+    std::shared_ptr<boost::asio::streambuf> buffer = mWriteBuffer;
+    if (m_spareWriteBuffer) {
+        mWriteBuffer = std::move(m_spareWriteBuffer);
+    } else {
+        mWriteBuffer = std::make_shared<boost::asio::streambuf>();
+    }
+    mStream.rdbuf(mWriteBuffer.get());
+    m_writeBufferQueued = 0;
+
+    auto segments = std::make_shared<std::vector<WriteSegment>>();
+    segments->swap(m_writeQueue);
+    const char * base = boost::asio::buffer_cast<const char*>(buffer->data());
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.reserve(segments->size());
+    for (auto& segment : *segments) {
+        if (segment.size != 0) {
+            buffers.emplace_back(
+                    segment.owner ? segment.data : base + segment.offset,
+                    segment.size);
+        }
+    }
 
-                }
-            };
-    std::shared_ptr<boost::asio::streambuf> buffer(mWriteBuffer, bufferDeleter);
-    mWriteBuffer = new boost::asio::streambuf();
-    mStream.rdbuf(mWriteBuffer);
+    m_writingBytes = m_queuedBytes;
+    m_queuedBytes = 0;
+    m_queuedMoves.clear();
+    m_writing = true;
+    updateQueueMonitor();
 
-    if (buffer->size() != 0) {
-        boost::asio::async_write(mSocket, buffer->data(),
-                [this, self, buffer](boost::system::error_code ec, std::size_t length)
-                {
-                    if (!ec)
-                    {
-                        buffer->consume(length);
+    auto written = [this, self, buffer, segments](boost::system::error_code ec, std::size_t length)
+            {
+                this->runOnWorld([this, self, buffer, ec]() {
+                    m_writing = false;
+                    m_writingBytes = 0;
+                    buffer->consume(buffer->size());
+                    m_spareWriteBuffer = buffer;
+                    if (!ec) {
+                        this->write();
                     }
+                    this->updateQueueMonitor();
                 });
-    }
+            };
+    runOnSocket([this, self, buffers, written]() {
+        boost::asio::async_write(mSocket, buffers, m_strand.wrap(written));
+    });
 }
 
 template<class ProtocolT>
 void CommAsioClient<ProtocolT>::negotiate_read()
 {
     auto self(this->shared_from_this());
-    mSocket.async_read_some(mWriteBuffer->prepare(read_buffer_size),
-            [this, self](boost::system::error_code ec, std::size_t length)
+    mSocket.async_read_some(m_negotiateBuffer.prepare(read_buffer_size),
+            m_strand.wrap([this, self](boost::system::error_code ec, std::size_t length)
             {
                 if (!ec)
                 {
-                    mWriteBuffer->commit(length);
+                    m_negotiateBuffer.commit(length);
                     if (length > 0) {
                         int negotiateResult = this->negotiate();
                         if (negotiateResult < 0) {
                             //this should remove any shared references and delete this instance
+                            this->readingDone();
                             return;
                         }
                     }
 
-                    //If the m_negotiate instance is removed we're done with negotiation and should start the main loop.
-                    if (m_negotiate == nullptr) {
-                        this->write();
-                        this->do_read();
-                    } else {
-                        this->negotiate_write();
+                    //Once the m_negotiate instance is removed we're done
+                    //with negotiation, and the session is started when the
+                    //last of its data has been written.
+                    this->negotiate_write();
+                    if (m_negotiate != nullptr) {
                         this->negotiate_read();
                     }
+                } else {
+                    this->readingDone();
                 }
-            });
+            }));
 }
 
 template<class ProtocolT>
 void CommAsioClient<ProtocolT>::negotiate_write()
 {
+    if (m_negotiateWriting) {
+        //Called again when the write in progress is done.
+        return;
+    }
+    if (m_negotiateBuffer.size() == 0) {
+        if (m_negotiate == nullptr) {
+            finishNegotiation();
+        }
+        return;
+    }
     auto self(this->shared_from_this());
 
-    if (mWriteBuffer->size() != 0) {
-        boost::asio::async_write(mSocket, mWriteBuffer->data(),
-                [this, self](boost::system::error_code ec, std::size_t length)
+    //Take the data out of the buffer, so that it's written only once and
+    //the negotiator can add more while it's being written.
+    auto data = std::make_shared<std::string>(
+            boost::asio::buffers_begin(m_negotiateBuffer.data()),
+            boost::asio::buffers_end(m_negotiateBuffer.data()));
+    m_negotiateBuffer.consume(data->size());
+
+    m_negotiateWriting = true;
+    boost::asio::async_write(mSocket, boost::asio::buffer(*data),
+            m_strand.wrap([this, self, data](boost::system::error_code ec, std::size_t length)
+            {
+                m_negotiateWriting = false;
+                if (!ec)
                 {
-                    if (!ec)
-                    {
-                        mWriteBuffer->consume(length);
-                    }
-                });
-    }
+                    this->negotiate_write();
+                }
+            }));
+}
+
+template<class ProtocolT>
+void CommAsioClient<ProtocolT>::finishNegotiation()
+{
+    auto self(this->shared_from_this());
+    //Everything the codec and encoder write from now on goes through the
+    //write buffer, which belongs to the main thread.
+    this->runOnWorld([this, self]() {
+        this->startSession();
+    });
+    this->do_read();
 }
 
 template<class ProtocolT>
@@ -186,6 +479,8 @@ void CommAsioClient<ProtocolT>::startAccept(Link * connection)
     m_negotiate = new Atlas::Net::StreamAccept("cyphesis " + mName, mStream);
 
     m_link = connection;
+    m_monitorKey = String::compose("client_send_queue_bytes{client=\"%1\"}",
+            m_link->getId());
 
     startNegotiation();
 }
@@ -197,6 +492,8 @@ void CommAsioClient<ProtocolT>::startConnect(Link * connection)
     m_negotiate = new Atlas::Net::StreamConnect("cyphesis " + mName, mStream);
 
     m_link = connection;
+    m_monitorKey = String::compose("client_send_queue_bytes{client=\"%1\"}",
+            m_link->getId());
 
     startNegotiation();
 }
@@ -211,16 +508,20 @@ void CommAsioClient<ProtocolT>::startNegotiation()
     {
         //If the negotiator still exists after the deadline it means that the negotation hasn't
         //completed yet; we'll consider that a "timeout".
-            if (m_negotiate != nullptr) {
-                log(NOTICE, "Client disconnected because of negotiation timeout.");
-                mSocket.close();
-            }
+            this->runOnSocket([this, self]() {
+                if (m_negotiate != nullptr) {
+                    log(NOTICE, "Client disconnected because of negotiation timeout.");
+                    mSocket.close();
+                }
+            });
         });
 
-    m_negotiate->poll(false);
+    runOnSocket([this, self]() {
+        m_negotiate->poll(false);
 
-    negotiate_write();
-    negotiate_read();
+        this->negotiate_write();
+        this->negotiate_read();
+    });
 }
 
 template<class ProtocolT>
@@ -251,16 +552,50 @@ int CommAsioClient<ProtocolT>::negotiate()
         log(NOTICE, "Could not create codec during negotiation.");
         return -1;
     }
+    m_codecName = sharedCodecName(m_codec);
+    m_spliceBroadcasts = m_codecName != nullptr &&
+            BroadcastCache::canSplice(m_codecName);
+
+    if (m_ioThreads) {
+        //The negotiated codec is used for encoding in the main thread, so
+        //decoding needs one of its own.
+        if (m_codecName == nullptr) {
+            log(ERROR, "Negotiated codec can't be used for decoding in "
+                    "network threads.");
+            return -1;
+        }
+        m_decodeCodec = createCodec(m_readStream);
+    }
+
+    return 0;
+}
+
+template<class ProtocolT>
+void CommAsioClient<ProtocolT>::startSession()
+{
+    if (m_link == nullptr) {
+        return;
+    }
+    mStream.rdbuf(mWriteBuffer.get());
     // Create a new encoder to send high level objects to the codec
     m_encoder = new Atlas::Objects::ObjectsEncoder(*m_codec);
-
-    assert(m_link != 0);
     m_link->setEncoder(m_encoder);
 
     // This should always be sent at the beginning of a session
     m_codec->streamBegin();
 
-    return 0;
+    this->write();
+}
+
+template<class ProtocolT>
+Atlas::Codec * CommAsioClient<ProtocolT>::createCodec(std::iostream & stream)
+{
+    if (std::strcmp(m_codecName, "Bach") == 0) {
+        return new Atlas::Codecs::Bach(stream, *this);
+    } else if (std::strcmp(m_codecName, "Packed") == 0) {
+        return new Atlas::Codecs::Packed(stream, *this);
+    }
+    return new Atlas::Codecs::XML(stream, *this);
 }
 
 template<class ProtocolT>
@@ -275,6 +610,12 @@ int CommAsioClient<ProtocolT>::operation(
 template<class ProtocolT>
 void CommAsioClient<ProtocolT>::dispatch()
 {
+    //Operations might still arrive after the link is gone, if they were
+    //decoded in a network thread.
+    if (m_link == nullptr) {
+        m_opQueue.clear();
+        return;
+    }
     DispatchQueue::const_iterator Iend = m_opQueue.end();
     for (DispatchQueue::const_iterator I = m_opQueue.begin(); I != Iend; ++I) {
         if (operation(*I) != 0) {
@@ -284,6 +625,23 @@ void CommAsioClient<ProtocolT>::dispatch()
     m_opQueue.clear();
 }
 
+template<class ProtocolT>
+void CommAsioClient<ProtocolT>::messageArrived(
+        const Atlas::Message::MapType & msg)
+{
+    if (m_ioThreads) {
+        //The message is handed over to the main thread, so it can't share
+        //anything with what the decoder keeps.
+        Atlas::Message::MapType message;
+        for (auto& entry : msg) {
+            message.insert(std::make_pair(entry.first, detachedCopy(entry.second)));
+        }
+        m_decoded.push_back(std::move(message));
+    } else {
+        Atlas::Objects::ObjectsDecoder::messageArrived(msg);
+    }
+}
+
 template<class ProtocolT>
 void CommAsioClient<ProtocolT>::objectArrived(const Atlas::Objects::Root & obj)
 {
@@ -310,7 +668,7 @@ template<class ProtocolT>
 int CommAsioClient<ProtocolT>::send(
         const Atlas::Objects::Operation::RootOperation & op)
 {
-    if (!mSocket.is_open()) {
+    if (!isOpen()) {
         log(ERROR, "Writing to closed client");
         return -1;
     }
@@ -322,20 +680,132 @@ int CommAsioClient<ProtocolT>::send(
 //        log(ERROR, "Encoder not initialized");
 //        return -1;
 //    }
-    m_encoder->streamObjectsMessage(op);
+    sendOperation(op);
     return flush();
 }
 
+template<class ProtocolT>
+bool CommAsioClient<ProtocolT>::queueBroadcast(
+        const Atlas::Objects::Operation::RootOperation & op)
+{
+    BroadcastCache & cache = BroadcastCache::instance();
+    if (!m_spliceBroadcasts || !cache.isBroadcast(op)) {
+        return false;
+    }
+    const std::string & to = op->getTo();
+    if (!isPlainValue(to)) {
+        return false;
+    }
+    const BroadcastCache::Encoding * encoding = cache.find(m_codecName);
+    if (encoding == nullptr) {
+        BroadcastCache::Encoding newEncoding{nullptr, 0, 0};
+        //Remember failures too, so that the next client doesn't try again.
+        BroadcastCache::encode(m_codecName, op, newEncoding);
+        encoding = &cache.insert(m_codecName, newEncoding);
+    }
+    if (!encoding->data) {
+        return false;
+    }
+
+    const std::string & data = *encoding->data;
+    std::size_t tail = encoding->toOffset + encoding->toLength;
+    auto value = std::make_shared<const std::string>(to);
+    queueSegment(WriteSegment{encoding->data, data.data(), 0,
+            encoding->toOffset});
+    queueSegment(WriteSegment{value, value->data(), 0, value->size()});
+    queueSegment(WriteSegment{encoding->data, data.data() + tail, 0,
+            data.size() - tail});
+    return true;
+}
+
+template<class ProtocolT>
+bool CommAsioClient<ProtocolT>::sendOperation(
+        const Atlas::Objects::Operation::RootOperation & op)
+{
+    if (m_encoder == nullptr) {
+        return false;
+    }
+    if (!isOpen()) {
+        //Nothing more will be written, so don't let the queue grow.
+        return true;
+    }
+    //Anything the codec has written so far must be sent first.
+    queueWriteBuffer();
+    std::size_t first = m_writeQueue.size();
+    if (!queueBroadcast(op)) {
+        m_encoder->streamObjectsMessage(op);
+        queueWriteBuffer();
+    }
+    std::size_t count = m_writeQueue.size() - first;
+
+    //A movement update makes any earlier one of the same entity obsolete,
+    //since it contains the complete location. Only bother to drop the
+    //earlier ones when the client doesn't keep up.
+    std::string moved = movedEntityId(op);
+    if (!moved.empty()) {
+        auto I = m_queuedMoves.find(moved);
+        if (I == m_queuedMoves.end()) {
+            m_queuedMoves.emplace(moved, QueuedMove{first, count});
+        } else {
+            if (m_sendQueueHighWater != 0 &&
+                m_queuedBytes + m_writingBytes > m_sendQueueHighWater) {
+                dropSegments(I->second);
+                Monitors::instance()->insert("client_send_dropped_ops",
+                        ++droppedSendOps());
+            }
+            I->second = QueuedMove{first, count};
+        }
+    }
+
+    if (m_sendQueueLimit != 0 &&
+        m_queuedBytes + m_writingBytes > m_sendQueueLimit) {
+        log(WARNING, String::compose("Disconnecting client \"%1\" since "
+                "%2 bytes are waiting to be sent to it.",
+                m_link ? m_link->getId() : mName,
+                m_queuedBytes + m_writingBytes));
+        Monitors::instance()->insert("client_send_queue_disconnects",
+                ++sendQueueDisconnects());
+        disconnect();
+    }
+    return true;
+}
+
+template<class ProtocolT>
+void CommAsioClient<ProtocolT>::setSendQueueLimits(std::size_t highWater,
+        std::size_t hardLimit)
+{
+    m_sendQueueHighWater = highWater;
+    m_sendQueueLimit = hardLimit;
+}
+
 template<class ProtocolT>
 void CommAsioClient<ProtocolT>::disconnect()
 {
-    mSocket.close();
+    m_closing = true;
+    if (m_ioThreads) {
+        auto self(this->shared_from_this());
+        m_strand.post([this, self]() {
+            mSocket.close();
+        });
+    } else {
+        mSocket.close();
+    }
 }
 
 template<class ProtocolT>
 int CommAsioClient<ProtocolT>::flush()
 {
-    write();
+    //Everything sent during this turn of the event loop is written at
+    //once, when it's done.
+    if (!m_writeScheduled) {
+        m_writeScheduled = true;
+        auto self(this->shared_from_this());
+        m_io_service.post([this, self]()
+        {
+            m_writeScheduled = false;
+            this->write();
+        });
+    }
     return 0;
 }
 
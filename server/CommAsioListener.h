@@ -22,17 +22,26 @@
 #include <boost/asio.hpp>
 
 #include <functional>
+#include <memory>
 
 template<typename ProtocolT, typename ClientT>
 class CommAsioListener
 {
     public:
+        /**
+         * @brief Ctor.
+         * @param clientCreator Creates the client for each new connection.
+         * If empty, clients are created with the io_service of the listener.
+         */
         CommAsioListener(std::function<void(ClientT&)> clientStarter,const std::string& serverName,
                 boost::asio::io_service& ioService,
-                const typename ProtocolT::endpoint& endpoint);
+                const typename ProtocolT::endpoint& endpoint,
+                std::function<std::shared_ptr<ClientT>()> clientCreator =
+                        std::function<std::shared_ptr<ClientT>()>());
         virtual ~CommAsioListener();
     protected:
         std::function<void(ClientT&)> mClientStarter;
+        std::function<std::shared_ptr<ClientT>()> mClientCreator;
         const std::string mServerName;
 
         typename ProtocolT::acceptor mAcceptor;
@@ -26,9 +26,10 @@ template<class ProtocolT, typename ClientT>
 CommAsioListener<ProtocolT, ClientT>::CommAsioListener(
         std::function<void(ClientT&)> clientStarter,
         const std::string& serverName, boost::asio::io_service& ioService,
-        const typename ProtocolT::endpoint& endpoint) :
-        mClientStarter(clientStarter), mServerName(serverName), mAcceptor(
-                ioService, endpoint)
+        const typename ProtocolT::endpoint& endpoint,
+        std::function<std::shared_ptr<ClientT>()> clientCreator) :
+        mClientStarter(clientStarter), mClientCreator(clientCreator), mServerName(
+                serverName), mAcceptor(ioService, endpoint)
 {
     startAccept();
 }
@@ -42,7 +43,9 @@ CommAsioListener<ProtocolT, ClientT>::~CommAsioListener()
 template<class ProtocolT, typename ClientT>
 void CommAsioListener<ProtocolT, ClientT>::startAccept()
 {
-    auto client = std::make_shared < ClientT
+    //The socket of the client might belong to another io_service than the
+    //acceptor, in which case its handlers are run by that io_service.
+    auto client = mClientCreator ? mClientCreator() : std::make_shared < ClientT
             > (mServerName, mAcceptor.get_io_service());
 
     mAcceptor.async_accept(client->getSocket(),
@@ -142,11 +142,15 @@ int CommPSQLSocket::read()
     PGresult * res;
     while (PQisBusy(con) == 0) {
         if ((res = PQgetResult(con)) != 0) {
-            m_db.queryResult(PQresultStatus(res));
+            m_db.queryResult(res);
             PQclear(res);
         } else {
             m_db.queryComplete();
-            return 0;
+            // In pipeline mode the results of the next command may
+            // already have been read.
+            if (!m_db.queryInProgress()) {
+                return 0;
+            }
         }
     };
 
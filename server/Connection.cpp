@@ -317,9 +317,38 @@ void Connection::LoginOperation(const Operation & op, OpVector & res)
     }
 
     // We now have username, so can check whether we know this
-    // account, either from existing account ....
-    Account * account = m_server.getAccountByName(username);
-    // or if not, from the database
+    // account, either from existing account or from the database.
+    Account * account = 0;
+    int status = m_server.lookupAccountByName(username, account,
+            sigc::bind(sigc::mem_fun(this, &Connection::accountLookedUp), op));
+    if (status < 0) {
+        clientError(op, "Server is busy. Try logging in again later", res);
+        return;
+    }
+    if (status > 0) {
+        // Replied to once the account has been looked up.
+        return;
+    }
+    loginAccount(account, op, res);
+}
+
+void Connection::accountLookedUp(Account * account, Operation op)
+{
+    OpVector res;
+    loginAccount(account, op, res);
+    OpVector::const_iterator Iend = res.end();
+    for (OpVector::const_iterator I = res.begin(); I != Iend; ++I) {
+        if (!op->isDefaultSerialno() && (*I)->isDefaultRefno()) {
+            (*I)->setRefno(op->getSerialno());
+        }
+        send(*I);
+    }
+}
+
+void Connection::loginAccount(Account * account, const Operation & op,
+                              OpVector & res)
+{
+    const Root & arg = op->getArgs().front();
     if (account == 0 || verifyCredentials(*account, arg) != 0) {
         clientError(op, "Login is invalid", res);
         return;
@@ -348,7 +377,8 @@ void Connection::LoginOperation(const Operation & op, OpVector & res)
     res.push_back(info);
 
     logEvent(LOGIN, String::compose("%1 %2 - Login account %3 (%4)",
-                                    getId(), account->getId(), username,
+                                    getId(), account->getId(),
+                                    account->username(),
                                     account->getType()));
 }
 
@@ -71,6 +71,9 @@ class Connection : public Link, virtual public sigc::trackable {
                                  const std::string & id, long intId);
     virtual int verifyCredentials(const Account &,
                                   const Atlas::Objects::Root &) const;
+
+    void loginAccount(Account *, const Operation &, OpVector &);
+    void accountLookedUp(Account *, Operation);
   public:
     ServerRouting & m_server;
 
@@ -55,6 +55,7 @@
 
 #include "common/types.h"
 #include "common/Inheritance.h"
+#include "common/PropertyDict.h"
 #include "common/PropertyFactory_impl.h"
 
 #include "common/debug.h"
@@ -133,6 +134,13 @@ CorePropertyManager::CorePropertyManager()
     installProperty<DomainProperty>("domain", "int");
     installProperty<LimboProperty>("limbo", "int");
 
+    // Properties installed by the server itself, rather than through a
+    // factory.
+    PropertyAtoms::intern("id");
+    PropertyAtoms::intern("contains");
+    PropertyAtoms::intern("mode");
+    PropertyAtoms::intern("calendar");
+    PropertyAtoms::intern("external");
 }
 
 CorePropertyManager::~CorePropertyManager()
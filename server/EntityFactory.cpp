@@ -102,13 +102,14 @@ void EntityFactoryBase::initializeEntity(LocatedEntity& thing,
         thing.merge(attrs);
         // Then set up the default class properties
         for (auto& propIter : m_type->defaults()) {
+            const std::string & name = m_type->defaults().name(propIter.first);
             PropertyBase * prop = propIter.second;
             // If a property is in the class it won't have been installed
             // as setAttr() checks
-            prop->install(&thing, propIter.first);
+            prop->install(&thing, name);
             // The property will have been applied if it has an overriden
             // value, so we only apply it the value is still default.
-            if (attrs.find(propIter.first) == attrs.end()) {
+            if (attrs.find(name) == attrs.end()) {
                 prop->apply(&thing);
             }
         }
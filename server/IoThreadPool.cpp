@@ -0,0 +1,98 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "IoThreadPool.h"
+
+#include "common/log.h"
+#include "common/compose.hpp"
+
+IoThreadPool::IoThreadPool(unsigned int threads,
+                           boost::asio::io_service & worldIoService) :
+    m_work(new boost::asio::io_service::work(m_ioService)),
+    m_worldIoService(worldIoService), m_worldQueueSize(0)
+{
+    for (unsigned int i = 0; i < threads; ++i) {
+        m_threads.emplace_back([this]() {
+            while (true) {
+                try {
+                    m_ioService.run();
+                    break;
+                } catch (const std::exception& e) {
+                    log(ERROR, String::compose("Exception caught in network "
+                                               "thread: %1", e.what()));
+                }
+            }
+        });
+    }
+}
+
+IoThreadPool::~IoThreadPool()
+{
+    m_work.reset();
+    m_ioService.stop();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+boost::asio::io_service & IoThreadPool::getIoService()
+{
+    return m_ioService;
+}
+
+unsigned int IoThreadPool::size() const
+{
+    return m_threads.size();
+}
+
+void IoThreadPool::postToWorld(std::function<void()> handler)
+{
+    m_worldQueue.push(std::move(handler));
+    if (m_worldQueueSize.fetch_add(1) == 0) {
+        m_worldIoService.post([this]() {this->runWorldQueue();});
+    }
+}
+
+void IoThreadPool::runWorldQueue()
+{
+    std::size_t count = m_worldQueueSize.load();
+    while (count != 0) {
+        for (std::size_t i = 0; i < count; ++i) {
+            std::function<void()> handler;
+            //Every counted handler has been pushed, but one pushed before
+            //it by another thread might not be linked into the queue yet.
+            //That takes no more than a few instructions, so just wait.
+            while (!m_worldQueue.pop(handler)) {
+                std::this_thread::yield();
+            }
+            try {
+                handler();
+            } catch (const std::exception& e) {
+                log(ERROR, String::compose("Exception caught when handling "
+                                           "network data: %1", e.what()));
+            }
+        }
+        //Anything pushed meanwhile is handled here too, since the main
+        //io_service isn't woken up for it.
+        count = m_worldQueueSize.fetch_sub(count) - count;
+    }
+}
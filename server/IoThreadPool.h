@@ -0,0 +1,88 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef IOTHREADPOOL_H_
+#define IOTHREADPOOL_H_
+
+#include "common/MpscQueue.h"
+
+#include <boost/asio/io_service.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/// \brief A set of threads handling network IO, separate from the main
+/// thread in which the world is simulated.
+///
+/// Sockets created with the io_service of the pool have their handlers
+/// run in the threads of the pool. Whatever needs to be done in the main
+/// thread is handed over through postToWorld(), which puts it in a lock
+/// free queue that is emptied by the main io_service.
+class IoThreadPool
+{
+    public:
+        /**
+         * @brief Ctor.
+         * @param threads The number of threads to start.
+         * @param worldIoService The io_service run by the main thread.
+         */
+        IoThreadPool(unsigned int threads,
+                     boost::asio::io_service & worldIoService);
+
+        /**
+         * @brief Dtor.
+         *
+         * Stops the threads, and waits for them to finish.
+         */
+        ~IoThreadPool();
+
+        boost::asio::io_service & getIoService();
+
+        unsigned int size() const;
+
+        /**
+         * @brief Runs a handler in the main thread.
+         *
+         * May be called from any thread. Handlers posted from the same
+         * thread are run in the order they were posted.
+         */
+        void postToWorld(std::function<void()> handler);
+
+    private:
+        boost::asio::io_service m_ioService;
+
+        std::unique_ptr<boost::asio::io_service::work> m_work;
+
+        std::vector<std::thread> m_threads;
+
+        boost::asio::io_service & m_worldIoService;
+
+        MpscQueue<std::function<void()>> m_worldQueue;
+
+        /// The number of handlers pushed to the world queue, and not yet
+        /// run. The main io_service is only woken up when this goes up
+        /// from zero.
+        std::atomic<std::size_t> m_worldQueueSize;
+
+        void runWorldQueue();
+};
+
+#endif /* IOTHREADPOOL_H_ */
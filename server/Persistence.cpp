@@ -79,6 +79,11 @@ int Persistence::init()
         return DATABASE_TABERR;
     }
 
+    if (m_db.registerSchemaVersion() != 0) {
+        log(ERROR, "Failed to register schema version in database.");
+        return DATABASE_TABERR;
+    }
+
     std::map<std::string, int> chunks;
     chunks["location"] = 0;
 
@@ -97,6 +102,11 @@ int Persistence::init()
         return DATABASE_TABERR;
     }
 
+    if (m_db.prepareStatements() != 0) {
+        log(ERROR, "Failed to prepare database statements.");
+        return DATABASE_TABERR;
+    }
+
     bool i = (m_db.initRule(true) == 0);
 
     MapType tableDesc;
@@ -162,10 +172,9 @@ bool Persistence::findAccount(const std::string & name)
     return true;
 }
 
-Account * Persistence::getAccount(const std::string & name)
+Account * Persistence::newAccount(const std::string & name,
+                                  const DatabaseResult & dr)
 {
-    std::string namestr = "'" + name + "'";
-    DatabaseResult dr = m_db.selectSimpleRowBy("accounts", "username", namestr);
     if (dr.error()) {
         log(ERROR, "Failure while find account.");
         return 0;
@@ -208,6 +217,33 @@ Account * Persistence::getAccount(const std::string & name)
     }
 }
 
+Account * Persistence::getAccount(const std::string & name)
+{
+    std::string namestr = "'" + name + "'";
+    DatabaseResult dr = m_db.selectSimpleRowBy("accounts", "username", namestr);
+    return newAccount(name, dr);
+}
+
+void Persistence::lookupAccount(const std::string & name,
+                                const EntityDict & worldObjects,
+                                const std::function<void(Account *)> & done)
+{
+    std::string namestr = "'" + name + "'";
+    m_db.selectSimpleRowByAsync("accounts", "username", namestr,
+            [this, name, &worldObjects, done](const DatabaseResult & dr) {
+        Account * account = newAccount(name, dr);
+        if (account == 0) {
+            done(0);
+            return;
+        }
+        m_db.selectRelationAsync(m_characterRelation, account->getId(),
+                [this, account, &worldObjects, done](const DatabaseResult & characters) {
+            addCharacters(*account, characters, worldObjects);
+            done(account);
+        });
+    });
+}
+
 void Persistence::putAccount(const Account & ac)
 {
     std::string columns = "username, type, password";
@@ -226,6 +262,12 @@ void Persistence::registerCharacters(Account & ac,
 {
     DatabaseResult dr = m_db.selectRelation(m_characterRelation,
                                                     ac.getId());
+    addCharacters(ac, dr, worldObjects);
+}
+
+void Persistence::addCharacters(Account & ac, const DatabaseResult & dr,
+                                const EntityDict & worldObjects)
+{
     if (dr.error()) {
         log(ERROR, "Database query failed while looking for characters for account.");
     }
@@ -23,11 +23,13 @@
 
 #include <sigc++/signal.h>
 
+#include <functional>
 #include <string>
 #include <map>
 
 class Account;
 class Database;
+class DatabaseResult;
 class LocatedEntity;
 
 typedef std::map<long, LocatedEntity *> EntityDict;
@@ -41,6 +43,10 @@ class Persistence {
     std::string m_characterRelation;
 
     static Persistence * m_instance;
+
+    Account * newAccount(const std::string & name, const DatabaseResult &);
+    void addCharacters(Account &, const DatabaseResult &,
+                       const EntityDict & worldObjects);
   public:
 
     /// \brief Data about a character being tied to an account.
@@ -66,6 +72,14 @@ class Persistence {
 
     bool findAccount(const std::string &);
     Account * getAccount(const std::string &);
+    /// \brief Look up an account and its characters without waiting for
+    /// the database.
+    ///
+    /// The callback is given the account, or zero if there isn't one, and
+    /// takes ownership of it. It may be called before this returns.
+    void lookupAccount(const std::string & name,
+                       const EntityDict & worldObjects,
+                       const std::function<void(Account *)> & done);
     void putAccount(const Account &);
     void registerCharacters(Account &, const EntityDict & worldObjects);
     void addCharacter(const Account &, const LocatedEntity &);
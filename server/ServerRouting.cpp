@@ -43,6 +43,9 @@ using Atlas::Objects::Entity::RootEntity;
 BOOL_OPTION(restricted_flag, false, CYPHESIS, "restricted",
             "Flag to control restricted mode");
 
+INT_OPTION(max_pending_logins, 64, CYPHESIS, "maxpendinglogins",
+           "Maximum number of logins waiting for accounts to be looked up");
+
 ServerRouting * ServerRouting::m_instance = 0;
 
 /// \brief Constructor for server object.
@@ -56,7 +59,8 @@ ServerRouting::ServerRouting(BaseWorld & wrld,
                              const std::string & lId, long lIntId) :
         Router(id, intId),
         m_svrRuleset(ruleset), m_svrName(name),
-        m_numClients(0), m_world(wrld), m_lobby(*new Lobby(*this, lId, lIntId))
+        m_numClients(0), m_pendingLogins(0), m_loginLatency(0),
+        m_world(wrld), m_lobby(*new Lobby(*this, lId, lIntId))
 {
     Monitors * monitors = Monitors::instance();
     monitors->insert("server", "cyphesis");
@@ -69,6 +73,8 @@ ServerRouting::ServerRouting(BaseWorld & wrld,
     monitors->watch("version", new Variable<const char *>(consts::version));
     monitors->watch("buildid", new Variable<int>(consts::buildId));
     monitors->watch("clients", new Variable<int>(m_numClients));
+    monitors->watch("logins_pending", new Variable<int>(m_pendingLogins));
+    monitors->watch("login_latency_us", new Variable<int>(m_loginLatency));
 
     m_instance = this;
 }
@@ -144,6 +150,77 @@ Account * ServerRouting::getAccountByName(const std::string & username)
     return account;
 }
 
+/// \brief Find an account with a given username, without waiting for the
+/// database.
+///
+/// Accounts which are not in memory are looked up in the database, and
+/// the callback is called with the account, or zero if there is none,
+/// once the lookup is done. Logins for the same username share a lookup.
+/// @param account Set to the account if it's known already, or zero.
+/// @param done Called with the account if it has to be looked up.
+/// @return 0 if the lookup is done, 1 if the callback will be called
+/// later, or -1 if too many logins are waiting already.
+int ServerRouting::lookupAccountByName(const std::string & username,
+                                       Account *& account,
+                                       const sigc::slot<void, Account *> & done)
+{
+    account = 0;
+    AccountDict::const_iterator I = m_accounts.find(username);
+    if (I != m_accounts.end()) {
+        account = I->second;
+        return 0;
+    }
+    if (!database_flag) {
+        return 0;
+    }
+    if (m_pendingLogins >= max_pending_logins) {
+        return -1;
+    }
+    ++m_pendingLogins;
+    auto J = m_accountLookups.find(username);
+    if (J != m_accountLookups.end()) {
+        J->second.push_back(done);
+        return 1;
+    }
+    m_accountLookups[username].push_back(done);
+    auto start = std::chrono::steady_clock::now();
+    Persistence::instance()->lookupAccount(username, m_world.getEntities(),
+            [this, username, start](Account * found) {
+        accountLookedUp(username, found, start);
+    });
+    return 1;
+}
+
+void ServerRouting::accountLookedUp(const std::string & username,
+                                    Account * account,
+                                    std::chrono::steady_clock::time_point start)
+{
+    std::vector<sigc::slot<void, Account *>> callbacks;
+    auto I = m_accountLookups.find(username);
+    if (I != m_accountLookups.end()) {
+        callbacks.swap(I->second);
+        m_accountLookups.erase(I);
+    }
+    m_pendingLogins -= callbacks.size();
+    m_loginLatency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+    if (account != 0) {
+        // The account might have been loaded or created in the meantime.
+        AccountDict::const_iterator J = m_accounts.find(username);
+        if (J != m_accounts.end()) {
+            delete account;
+            account = J->second;
+        } else {
+            m_accounts[username] = account;
+            addObject(account);
+        }
+    }
+    for (auto& callback : callbacks) {
+        callback(account);
+    }
+}
+
 void ServerRouting::addToMessage(MapType & omap) const
 {
     omap["objtype"] = "obj";
@@ -22,6 +22,10 @@
 #include "common/Router.h"
 #include "common/Shaker.h"
 
+#include <sigc++/slot.h>
+
+#include <chrono>
+
 class Account;
 class BaseWorld;
 class Lobby;
@@ -30,6 +34,7 @@ typedef std::map<long, Router *> RouterMap;
 typedef std::map<std::string, Account *> AccountDict;
 
 extern bool restricted_flag;
+extern int max_pending_logins;
 
 /// \brief ServerRouting represents the core of the server.
 ///
@@ -50,8 +55,18 @@ class ServerRouting : public Router {
     const std::string m_svrName;
     /// The number of clients currently connected.
     int m_numClients;
+    /// Logins waiting for accounts to be looked up, by username.
+    std::map<std::string, std::vector<sigc::slot<void, Account *>>> m_accountLookups;
+    /// The number of logins waiting for accounts to be looked up.
+    int m_pendingLogins;
+    /// The time taken by the last account lookup, in microseconds.
+    int m_loginLatency;
     /// Static self object for external access
     static ServerRouting * m_instance;
+
+    void accountLookedUp(const std::string & username,
+                         Account * account,
+                         std::chrono::steady_clock::time_point start);
   public:
     /// A reference to the World management object.
     BaseWorld & m_world;
@@ -99,6 +114,9 @@ class ServerRouting : public Router {
     void delObject(Router * obj);
     Router * getObject(const std::string & id) const;
     Account * getAccountByName(const std::string & username);
+    int lookupAccountByName(const std::string & username,
+                            Account *& account,
+                            const sigc::slot<void, Account *> & done);
 
     virtual void addToMessage(Atlas::Message::MapType &) const;
     virtual void addToEntity(const Atlas::Objects::Entity::RootEntity &) const;
@@ -42,6 +42,7 @@
 #include "common/SystemTime.h"
 
 #include <Atlas/Objects/Anonymous.h>
+#include <Atlas/Objects/Factories.h>
 #include <Atlas/Objects/Operation.h>
 #include <Atlas/Objects/SmartPtr.h>
 #include <Atlas/Message/Element.h>
@@ -51,7 +52,10 @@
 #include <sigc++/adaptors/bind.h>
 #include <sigc++/functors/mem_fun.h>
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <unordered_map>
 #include <unordered_set>
 
 using Atlas::Message::MapType;
@@ -63,14 +67,66 @@ typedef Database::KeyValues KeyValues;
 
 static const bool debug_flag = false;
 
+/// Number of queued commands above which no more updates are collected.
+static const size_t MAX_QUEUED_COMMANDS = 200;
+/// Maximum number of dirty entities stored each tick.
+static const int MAX_UPDATES_PER_TICK = 2048;
+
+typedef std::unordered_map<std::string, std::vector<int> > RowIndex;
+
+struct StorageManager::BulkRestore {
+    DatabaseResult properties;
+    DatabaseResult thoughts;
+    /// Rows of the properties result for each entity.
+    RowIndex propertyRows;
+    /// Rows of the thoughts result for each entity.
+    RowIndex thoughtRows;
+};
+
+/// \brief Group the rows of a result by the value of a column.
+static void indexRows(const DatabaseResult & res, const char * column,
+                      RowIndex & index)
+{
+    int col = res.columnNumber(column);
+    if (col == -1) {
+        return;
+    }
+    for (int row = 0; row < res.size(); ++row) {
+        index[res.field(col, row)].push_back(row);
+    }
+}
+
+/// \brief Get all row numbers of a result.
+static std::vector<int> allRows(const DatabaseResult & res)
+{
+    std::vector<int> rows(res.size());
+    for (int row = 0; row < res.size(); ++row) {
+        rows[row] = row;
+    }
+    return rows;
+}
+
+/// \brief Seconds elapsed since a point in time.
+static double elapsed(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
 StorageManager:: StorageManager(WorldRouter & world) :
         m_mindInspector(nullptr),
+      m_rewriteInterval(0), m_checkpointInterval(0),
+      m_structuralPriority(true), m_checkpointing(false),
       m_insertEntityCount(0), m_updateEntityCount(0),
       m_insertPropertyCount(0), m_updatePropertyCount(0),
       m_insertQps(0), m_updateQps(0),
       m_insertQpsNow(0), m_updateQpsNow(0),
       m_insertQpsAvg(0), m_updateQpsAvg(0),
-      m_insertQpsIndex(0), m_updateQpsIndex(0)
+      m_insertQpsIndex(0), m_updateQpsIndex(0),
+      m_rowsWritten(0), m_queryQueueSize(0),
+      m_batchLatency(0), m_batchSize(0),
+      m_rowsAvoided(0), m_writesPending(0),
+      m_structuralWrites(0), m_checkpoints(0),
+      m_bulkRestore(false)
 {
     if (database_flag) {
 
@@ -99,6 +155,23 @@ StorageManager:: StorageManager(WorldRouter & world) :
         Monitors::instance()->watch("storage_qps{qtype=\"updates\",t=\"32\"}",
                                     new Variable<int>(m_updateQpsAvg));
 
+        Monitors::instance()->watch("storage_rows_written",
+                                    new Variable<int>(m_rowsWritten));
+        Monitors::instance()->watch("storage_query_queue",
+                                    new Variable<int>(m_queryQueueSize));
+        Monitors::instance()->watch("storage_batch_latency_us",
+                                    new Variable<int>(m_batchLatency));
+        Monitors::instance()->watch("storage_batch_size",
+                                    new Variable<int>(m_batchSize));
+        Monitors::instance()->watch("storage_rows_avoided",
+                                    new Variable<int>(m_rowsAvoided));
+        Monitors::instance()->watch("storage_writes_pending",
+                                    new Variable<int>(m_writesPending));
+        Monitors::instance()->watch("storage_structural_writes",
+                                    new Variable<int>(m_structuralWrites));
+        Monitors::instance()->watch("storage_checkpoints",
+                                    new Variable<int>(m_checkpoints));
+
         for (int i = 0; i < 32; ++i) {
             m_insertQpsRing[i] = 0;
             m_updateQpsRing[i] = 0;
@@ -114,6 +187,17 @@ StorageManager::~StorageManager()
     delete m_mindInspector;
 }
 
+void StorageManager::setRewriteInterval(int seconds)
+{
+    m_rewriteInterval = std::chrono::seconds(std::max(seconds, 0));
+}
+
+void StorageManager::setCheckpointInterval(int seconds)
+{
+    m_checkpointInterval = std::chrono::seconds(std::max(seconds, 0));
+    m_nextCheckpoint = std::chrono::steady_clock::now() + m_checkpointInterval;
+}
+
 /// \brief Called when a new Entity is inserted in the world
 void StorageManager::entityInserted(LocatedEntity * ent)
 {
@@ -141,23 +225,42 @@ void StorageManager::entityUpdated(LocatedEntity * ent)
 {
     if (ent->isDestroyed()) {
         m_destroyedEntities.push_back(ent->getIntId());
+        m_lastWritten.erase(ent->getIntId());
         return;
     }
-    // Is it already in the dirty Entities queue?
-    // Perhaps we need to modify the semantics of the updated signal
-    // so it is only emitted if the entity was not marked as dirty.
+    // Is it already waiting to be written? The write will include this
+    // modification as well.
     if (ent->getFlags() & entity_queued) {
-        // std::cout << "Already queued " << ent->getId() << std::endl << std::flush;
+        ++m_rowsAvoided;
         return;
     }
-    m_dirtyEntities.push_back(EntityRef(ent));
-    // std::cout << "Updated fired " << ent->getId() << std::endl << std::flush;
+    m_dirtyEntities.emplace(writeDue(ent), EntityRef(ent));
     ent->setFlags(entity_queued);
 }
 
 void StorageManager::entityContainered(const LocatedEntity *oldLocation, LocatedEntity *entity)
 {
-    entityUpdated(entity);
+    if (!m_structuralPriority || entity->isDestroyed()) {
+        entityUpdated(entity);
+        return;
+    }
+    // The entity stays in the schedule as well; whichever entry comes
+    // first writes it, and the other is skipped.
+    if (!(entity->getFlags() & entity_queued)) {
+        m_dirtyEntities.emplace(writeDue(entity), EntityRef(entity));
+        entity->setFlags(entity_queued);
+    }
+    m_structuralEntities.push_back(EntityRef(entity));
+}
+
+/// \brief Get the earliest time an entity may be written again.
+StorageManager::Timestamp StorageManager::writeDue(const LocatedEntity * ent) const
+{
+    auto I = m_lastWritten.find(ent->getIntId());
+    if (I == m_lastWritten.end()) {
+        return std::chrono::steady_clock::now();
+    }
+    return I->second + m_rewriteInterval;
 }
 
 bool StorageManager::persistance_characterAdded(const Persistence::AddCharacterData& data)
@@ -176,36 +279,91 @@ void StorageManager::encodeProperty(PropertyBase * prop, std::string & store)
 {
     Atlas::Message::MapType map;
     prop->get(map["val"]);
-    Database::instance()->encodeObject(map, store);
+    Database::instance()->encodeWorldObject(map, store);
+}
+
+void StorageManager::restorePropertiesRecursively(LocatedEntity * ent,
+                                                  const BulkRestore * bulk)
+{
+    if (bulk != nullptr) {
+        static const std::vector<int> no_rows;
+        auto I = bulk->propertyRows.find(ent->getId());
+        restoreProperties(ent, bulk->properties,
+                          I != bulk->propertyRows.end() ? I->second : no_rows);
+    } else {
+        DatabaseResult res = Database::instance()->selectProperties(ent->getId());
+        restoreProperties(ent, res, allRows(res));
+    }
+
+    //Now restore all properties of the child entities.
+    if (ent->m_contains) {
+        for (auto& childEntity : *ent->m_contains) {
+            restorePropertiesRecursively(childEntity, bulk);
+        }
+    }
+
+    //We must send a sight op to the entity informing it of itself before we send any thoughts.
+    //Else the mind won't have any information about itself.
+    {
+        Atlas::Objects::Operation::Sight sight;
+        sight->setTo(ent->getId());
+        Atlas::Objects::Entity::Anonymous args;
+        ent->addToEntity(args);
+        sight->setArgs1(args);
+        ent->sendWorld(sight);
+    }
+    //We should also send a sight op to the parent entity which owns the entity.
+    //TODO: should this really be necessary or should we rely on other Sight functionality?
+    if (ent->m_location.m_loc) {
+        Atlas::Objects::Operation::Sight sight;
+        sight->setTo(ent->m_location.m_loc->getId());
+        Atlas::Objects::Entity::Anonymous args;
+        ent->addToEntity(args);
+        sight->setArgs1(args);
+        ent->m_location.m_loc->sendWorld(sight);
+    }
+
+    if (bulk != nullptr) {
+        auto I = bulk->thoughtRows.find(ent->getId());
+        if (I != bulk->thoughtRows.end()) {
+            restoreThoughts(ent, bulk->thoughts, I->second);
+        }
+    } else {
+        restoreThoughts(ent);
+    }
 }
 
-void StorageManager::restorePropertiesRecursively(LocatedEntity * ent)
+/// \brief Restore the properties of an entity.
+///
+/// @param res Result with "name" and "value" columns
+/// @param rows The rows of the result which belong to the entity
+void StorageManager::restoreProperties(LocatedEntity * ent,
+                                       const DatabaseResult & res,
+                                       const std::vector<int> & rows)
 {
     Database * db = Database::instance();
     PropertyManager * pm = PropertyManager::instance();
-    DatabaseResult res = db->selectProperties(ent->getId());
 
     //Keep track of those properties that have been set on the instance, so we'll know what
     //type properties we should ignore.
     std::unordered_set<std::string> instanceProperties;
 
-    DatabaseResult::const_iterator I = res.begin();
-    DatabaseResult::const_iterator Iend = res.end();
-    for (; I != Iend; ++I) {
-        const std::string name = I.column("name");
+    int value_col = res.columnNumber("value");
+    for (int row : rows) {
+        const std::string name = res.field("name", row);
         if (name.empty()) {
             log(ERROR, compose("No name column in property row for %1",
                                ent->getId()));
             continue;
         }
-        const std::string val_string = I.column("value");
-        if (name.empty()) {
+        if (value_col == -1 || res.length(value_col, row) == 0) {
             log(ERROR, compose("No value column in property row for %1,%2",
                                ent->getId(), name));
             continue;
         }
         MapType prop_data;
-        db->decodeMessage(val_string, prop_data);
+        db->decodeMessage(res.field(value_col, row),
+                          res.length(value_col, row), prop_data);
         MapType::const_iterator J = prop_data.find("val");
         if (J == prop_data.end()) {
             log(ERROR, compose("No property value data for %1:%2",
@@ -240,86 +398,86 @@ void StorageManager::restorePropertiesRecursively(LocatedEntity * ent)
     }
 
     if (ent->getType()) {
-        for (auto& propIter : ent->getType()->defaults()) {
-            if (!instanceProperties.count(propIter.first)) {
+        const PropertyDict & defaults = ent->getType()->defaults();
+        for (auto& propIter : defaults) {
+            const std::string & name = defaults.name(propIter.first);
+            if (!instanceProperties.count(name)) {
                 PropertyBase * prop = propIter.second;
                 // If a property is in the class it won't have been installed
                 // as setAttr() checks
-                prop->install(ent, propIter.first);
+                prop->install(ent, name);
                 // The property will have been applied if it has an overriden
                 // value, so we only apply it the value is still default.
                 prop->apply(ent);
             }
         }
     }
-
-
-    //Now restore all properties of the child entities.
-    if (ent->m_contains) {
-        for (auto& childEntity : *ent->m_contains) {
-            restorePropertiesRecursively(childEntity);
-        }
-    }
-
-    //We must send a sight op to the entity informing it of itself before we send any thoughts.
-    //Else the mind won't have any information about itself.
-    {
-        Atlas::Objects::Operation::Sight sight;
-        sight->setTo(ent->getId());
-        Atlas::Objects::Entity::Anonymous args;
-        ent->addToEntity(args);
-        sight->setArgs1(args);
-        ent->sendWorld(sight);
-    }
-    //We should also send a sight op to the parent entity which owns the entity.
-    //TODO: should this really be necessary or should we rely on other Sight functionality?
-    if (ent->m_location.m_loc) {
-        Atlas::Objects::Operation::Sight sight;
-        sight->setTo(ent->m_location.m_loc->getId());
-        Atlas::Objects::Entity::Anonymous args;
-        ent->addToEntity(args);
-        sight->setArgs1(args);
-        ent->m_location.m_loc->sendWorld(sight);
-    }
-
-    restoreThoughts(ent);
-
 }
 
 void StorageManager::restoreThoughts(LocatedEntity * ent)
+{
+    const DatabaseResult res = Database::instance()->selectThoughts(ent->getId());
+    restoreThoughts(ent, res, allRows(res));
+}
+
+/// \brief Restore the thoughts of an entity.
+///
+/// @param res Result with a "thought" column
+/// @param rows The rows of the result which belong to the entity
+void StorageManager::restoreThoughts(LocatedEntity * ent,
+                                     const DatabaseResult & res,
+                                     const std::vector<int> & rows)
 {
     Database * db = Database::instance();
-    const DatabaseResult res = db->selectThoughts(ent->getId());
     Atlas::Message::ListType thoughts_data;
+    // Thoughts stored before they had ids in the table have to be stored
+    // anew, which happens if they're not marked as already stored.
+    bool stored = true;
 
-    DatabaseResult::const_iterator I = res.begin();
-    DatabaseResult::const_iterator Iend = res.end();
-    for (; I != Iend; ++I) {
-        const std::string thought = I.column("thought");
-        if (thought.empty()) {
+    int thought_col = res.columnNumber("thought");
+    for (int row : rows) {
+        if (thought_col == -1 || res.length(thought_col, row) == 0) {
             log(ERROR,
                     compose("No thought column in property row for %1",
                             ent->getId()));
             continue;
         }
         MapType thought_data;
-        db->decodeMessage(thought, thought_data);
+        db->decodeMessage(res.field(thought_col, row),
+                          res.length(thought_col, row), thought_data);
+        if (*res.field("tid", row) == 0 && thought_data.find("id") !=
+                                           thought_data.end()) {
+            stored = false;
+        }
         thoughts_data.push_back(thought_data);
     }
 
-    if (!thoughts_data.empty()) {
-        OpVector opRes;
-
-        Atlas::Objects::Operation::Think thoughtOp;
-        Atlas::Objects::Operation::Set setOp;
-        setOp->setArgsAsList(thoughts_data);
-        //Make the thought come from the entity itself
-        thoughtOp->setArgs1(setOp);
-        thoughtOp->setTo(ent->getId());
-        thoughtOp->setFrom(ent->getId());
+    if (thoughts_data.empty()) {
+        return;
+    }
 
-        ent->sendWorld(thoughtOp);
+    // Thoughts which are already stored are handed straight to the mind,
+    // so that no operation can mark thoughts as stored.
+    Character * character = dynamic_cast<Character *>(ent);
+    if (stored && character != 0) {
+        std::vector<Atlas::Objects::Root> thoughts;
+        for (auto& thought : thoughts_data) {
+            thoughts.push_back(Atlas::Objects::Factories::instance()->
+                               createObject(thought.asMap()));
+        }
+        character->restoreThoughts(thoughts);
+        return;
     }
+
+    Atlas::Objects::Operation::Think thoughtOp;
+    Atlas::Objects::Operation::Set setOp;
+    setOp->setArgsAsList(thoughts_data);
+    //Make the thought come from the entity itself
+    thoughtOp->setArgs1(setOp);
+    thoughtOp->setTo(ent->getId());
+    thoughtOp->setFrom(ent->getId());
+
+    ent->sendWorld(thoughtOp);
 }
 
 bool StorageManager::storeThoughts(LocatedEntity * ent)
@@ -357,15 +515,14 @@ void StorageManager::insertEntity(LocatedEntity * ent)
     if (ent->m_location.orientation().isValid()) {
         map["orientation"] = ent->m_location.orientation().toAtlas();
     }
-    Database::instance()->encodeObject(map, location);
+    Database::instance()->encodeWorldObject(map, location);
 
-    Database::instance()->insertEntity(ent->getId(),
-                                       ent->m_location.m_loc->getId(),
-                                       ent->getType()->name(),
-                                       ent->getSeq(),
-                                       location);
+    m_entityInsertRows.push_back(Database::EntityRow{ent->getId(),
+                                         ent->m_location.m_loc->getId(),
+                                         ent->getType()->name(),
+                                         ent->getSeq(),
+                                         location});
     ++m_insertEntityCount;
-    KeyValues property_tuples;
     const PropertyDict & properties = ent->getProperties();
     PropertyDict::const_iterator I = properties.begin();
     PropertyDict::const_iterator Iend = properties.end();
@@ -374,13 +531,19 @@ void StorageManager::insertEntity(LocatedEntity * ent)
         if (prop->flags() & per_ephem) {
             continue;
         }
-        encodeProperty(prop, property_tuples[I->first]);
+        m_propertyInsertRows.push_back(Database::PropertyRow{ent->getId(),
+                                                 properties.name(I->first),
+                                                 ""});
+        encodeProperty(prop, m_propertyInsertRows.back().value);
+        ++m_insertPropertyCount;
         prop->setFlags(per_clean | per_seen);
     }
-    if (!property_tuples.empty()) {
-        Database::instance()->insertProperties(ent->getId(), property_tuples);
-        ++m_insertPropertyCount;
+    // Everything has been written, so earlier changes are done with.
+    auto & changed = ent->propertyChanges().unclean;
+    for (PropertyBase * prop : changed) {
+        prop->resetFlags(per_changed);
     }
+    changed.clear();
     ent->resetFlags(entity_queued);
     ent->setFlags(entity_clean | entity_pos_clean | entity_orient_clean);
     ent->updated.connect(sigc::bind(sigc::mem_fun(this, &StorageManager::entityUpdated), ent));
@@ -388,19 +551,36 @@ void StorageManager::insertEntity(LocatedEntity * ent)
 
 }
 
-void StorageManager::updateEntityThoughts(LocatedEntity * ent)
+/// \brief Encode thoughts as rows of the thoughts table.
+static void encodeThoughts(const std::vector<Atlas::Objects::Root> & thoughts,
+                           std::vector<Database::ThoughtRow> & rows)
 {
     Database * db = Database::instance();
-    auto thoughts = ent->getThoughts();
-    std::vector<std::string> thoughtsList;
-    for (auto& thoughtOp : thoughts) {
+    for (auto& thought : thoughts) {
         Atlas::Message::MapType map;
-        thoughtOp->addToMessage(map);
-        std::string value;
-        db->encodeObject(map, value);
-        thoughtsList.push_back(value);
+        thought->addToMessage(map);
+        rows.push_back(Database::ThoughtRow{
+                thought->isDefaultId() ? "" : thought->getId(), ""});
+        db->encodeWorldObject(map, rows.back().thought);
+    }
+}
+
+void StorageManager::updateEntityThoughts(LocatedEntity * ent)
+{
+    // Only the thoughts changed since they were last stored are written,
+    // unless the changes can't be told apart.
+    ThoughtChanges changes = ent->takeThoughtChanges();
+    m_thoughtRows.push_back(Database::ThoughtWrite{ent->getId(),
+                                                   changes.replaceAll,
+                                                   {}, {}});
+    Database::ThoughtWrite & row = m_thoughtRows.back();
+    if (changes.replaceAll) {
+        encodeThoughts(ent->getThoughts(), row.thoughts);
+    } else {
+        encodeThoughts(changes.updated, row.thoughts);
+        encodeThoughts(changes.added, row.thoughts);
+        row.deleted = std::move(changes.deleted);
     }
-    db->replaceThoughts(ent->getId(), thoughtsList);
 
     ent->resetFlags(entity_dirty_thoughts);
 }
@@ -413,92 +593,214 @@ void StorageManager::updateEntity(LocatedEntity * ent)
     if (ent->m_location.orientation().isValid()) {
         map["orientation"] = ent->m_location.orientation().toAtlas();
     }
-    Database::instance()->encodeObject(map, location);
+    Database::instance()->encodeWorldObject(map, location);
 
     //Under normal circumstances only the top world won't have a location.
-    if (ent->m_location.m_loc) {
-        Database::instance()->updateEntity(ent->getId(),
-                                       ent->getSeq(),
-                                       location,
-                                       ent->m_location.m_loc->getId());
-    } else {
-        Database::instance()->updateEntityWithoutLoc(ent->getId(),
-                                       ent->getSeq(),
-                                       location);
-    }
+    //Rows without a location id leave the location untouched.
+    m_entityUpdateRows.push_back(Database::EntityRow{ent->getId(),
+                    ent->m_location.m_loc ? ent->m_location.m_loc->getId() : "",
+                    "",
+                    ent->getSeq(),
+                    location});
     ++m_updateEntityCount;
-    KeyValues new_property_tuples;
-    KeyValues upd_property_tuples;
-    const PropertyDict & properties = ent->getProperties();
-    PropertyDict::const_iterator I = properties.begin();
-    PropertyDict::const_iterator Iend = properties.end();
-    for (; I != Iend; ++I) {
-        PropertyBase * prop = I->second;
+    // Only the properties changed since they were last stored need to be
+    // looked at.
+    std::vector<PropertyBase *> changed;
+    changed.swap(ent->propertyChanges().unclean);
+    for (PropertyBase * prop : changed) {
+        prop->resetFlags(per_changed);
         if (prop->flags() & per_mask) {
             continue;
         }
         // FIXME check if this is new or just modded.
+        auto & rows = (prop->flags() & per_seen) ? m_propertyUpdateRows
+                                                 : m_propertyInsertRows;
+        rows.push_back(Database::PropertyRow{ent->getId(), prop->name(), ""});
+        encodeProperty(prop, rows.back().value);
         if (prop->flags() & per_seen) {
-            encodeProperty(prop, upd_property_tuples[I->first]);
             ++m_updatePropertyCount;
         } else {
-            encodeProperty(prop, new_property_tuples[I->first]);
             ++m_insertPropertyCount;
         }
         prop->setFlags(per_clean | per_seen);
     }
-    if (!new_property_tuples.empty()) {
-        Database::instance()->insertProperties(ent->getId(),
-                                               new_property_tuples);
+    ent->setFlags(entity_clean);
+}
+
+/// \brief Write the modifications of an entity waiting to be written.
+///
+/// @return The number of updates written.
+int StorageManager::writeModifiedEntity(LocatedEntity * ent, Timestamp now)
+{
+    int updates = 0;
+    if ((ent->getFlags() & entity_clean_mask) == 0) {
+        debug( std::cout << "updating " << ent->getId() << std::endl << std::flush; );
+        updateEntity(ent);
+        ++updates;
     }
-    if (!upd_property_tuples.empty()) {
-        Database::instance()->updateProperties(ent->getId(),
-                                               upd_property_tuples);
+    if ((ent->getFlags() & entity_dirty_thoughts) != 0) {
+        debug( std::cout << "updating thoughts " << ent->getId() << std::endl << std::flush; );
+        updateEntityThoughts(ent);
+        ++updates;
     }
-    ent->setFlags(entity_clean);
+    ent->resetFlags(entity_queued);
+    m_lastWritten[ent->getIntId()] = now;
+    return updates;
+}
+
+/// \brief Write the rows of the entities inserted this tick.
+///
+/// The entities are written before their properties, which refer to them.
+void StorageManager::writeInsertRows()
+{
+    Database * db = Database::instance();
+    db->insertEntities(m_entityInsertRows);
+    db->insertProperties(m_propertyInsertRows);
+    m_rowsWritten += m_entityInsertRows.size() + m_propertyInsertRows.size();
+    m_entityInsertRows.clear();
+    m_propertyInsertRows.clear();
+}
+
+/// \brief Write the rows of the entities updated this tick.
+void StorageManager::writeUpdateRows()
+{
+    Database * db = Database::instance();
+    db->updateEntities(m_entityUpdateRows);
+    db->insertProperties(m_propertyInsertRows);
+    db->updateProperties(m_propertyUpdateRows);
+    db->writeThoughts(m_thoughtRows);
+    m_rowsWritten += m_entityUpdateRows.size() + m_propertyInsertRows.size() +
+                     m_propertyUpdateRows.size();
+    m_entityUpdateRows.clear();
+    m_propertyInsertRows.clear();
+    m_propertyUpdateRows.clear();
+    m_thoughtRows.clear();
 }
 
 void StorageManager::restoreChildren(LocatedEntity * parent)
 {
     Database * db = Database::instance();
     DatabaseResult res = db->selectEntities(parent->getId());
-    EntityBuilder * eb = EntityBuilder::instance();
 
     // Iterate over res creating entities, and sorting out position, location
     // and orientation. Restore children, but don't restore any properties yet.
-    DatabaseResult::const_iterator I = res.begin();
-    DatabaseResult::const_iterator Iend = res.end();
-    for (; I != Iend; ++I) {
-        const std::string id = I.column("id");
-        const int int_id = forceIntegerId(id);
-        const std::string type = I.column("type");
-        //By sending an empty attributes pointer we're telling the builder not to apply any default
-        //attributes. We will instead apply all attributes ourselves when we later on restore attributes.
-        Atlas::Objects::SmartPtr<Atlas::Objects::Entity::RootEntityData> attrs(nullptr);
-        LocatedEntity * child = eb->newEntity(id, int_id, type, attrs, BaseWorld::instance());
-        if (!child) {
-            log(ERROR, compose("Could not restore entity with id %1 of type %2"
-                    ", most likely caused by this type missing.",
-                    id, type));
-            continue;
+    int id_col = res.columnNumber("id");
+    int type_col = res.columnNumber("type");
+    int location_col = res.columnNumber("location");
+    for (int row = 0; row < res.size(); ++row) {
+        LocatedEntity * child = restoreEntity(parent, res.field(id_col, row),
+                                              res.field(type_col, row),
+                                              res.field(location_col, row),
+                                              res.length(location_col, row));
+        if (child != nullptr) {
+            restoreChildren(child);
         }
-        
-        const std::string location_string = I.column("location");
-        MapType loc_data;
-        db->decodeMessage(location_string, loc_data);
-        child->m_location.readFromMessage(loc_data);
-        if (!child->m_location.pos().isValid()) {
-            std::cout << "No pos data" << std::endl << std::flush;
-            log(ERROR, compose("Entity %1 restored from database has no "
-                               "POS data. Ignored.", child->getId()));
-            delete child;
+    }
+}
+
+/// \brief Create an entity from its row in the entities table.
+///
+/// No properties are restored.
+/// @param location The encoded location, which may contain null bytes.
+/// @param location_size The size of the encoded location.
+/// @return The entity created, or null if it could not be restored.
+LocatedEntity * StorageManager::restoreEntity(LocatedEntity * parent,
+                                              const std::string & id,
+                                              const std::string & type,
+                                              const char * location,
+                                              size_t location_size)
+{
+    Database * db = Database::instance();
+    EntityBuilder * eb = EntityBuilder::instance();
+
+    const int int_id = forceIntegerId(id);
+    //By sending an empty attributes pointer we're telling the builder not to apply any default
+    //attributes. We will instead apply all attributes ourselves when we later on restore attributes.
+    Atlas::Objects::SmartPtr<Atlas::Objects::Entity::RootEntityData> attrs(nullptr);
+    LocatedEntity * child = eb->newEntity(id, int_id, type, attrs, BaseWorld::instance());
+    if (!child) {
+        log(ERROR, compose("Could not restore entity with id %1 of type %2"
+                ", most likely caused by this type missing.",
+                id, type));
+        return nullptr;
+    }
+
+    MapType loc_data;
+    db->decodeMessage(location, location_size, loc_data);
+    child->m_location.readFromMessage(loc_data);
+    if (!child->m_location.pos().isValid()) {
+        std::cout << "No pos data" << std::endl << std::flush;
+        log(ERROR, compose("Entity %1 restored from database has no "
+                           "POS data. Ignored.", child->getId()));
+        delete child;
+        return nullptr;
+    }
+    child->m_location.m_loc = parent;
+    child->setFlags(entity_clean | entity_pos_clean | entity_orient_clean);
+    BaseWorld::instance().addEntity(child);
+    return child;
+}
+
+/// \brief Restore the world by reading each table once.
+///
+/// The entities are created in breadth first order from the root, so each
+/// entity is created after its location.
+int StorageManager::restoreWorldBulk()
+{
+    Database * db = Database::instance();
+    LocatedEntity * root = &BaseWorld::instance().getRootEntity();
+
+    auto start = std::chrono::steady_clock::now();
+    DatabaseResult entities = db->selectAllEntities();
+    BulkRestore bulk{db->selectAllProperties(), db->selectAllThoughts(),
+                     RowIndex(), RowIndex()};
+    if (entities.error() || bulk.properties.error() || bulk.thoughts.error()) {
+        log(ERROR, "Could not read the world from the database.");
+        return -1;
+    }
+    log(INFO, compose("Read %1 entities, %2 properties and %3 thoughts "
+                      "from storage in %4 seconds.", entities.size(),
+                      bulk.properties.size(), bulk.thoughts.size(),
+                      elapsed(start)));
+
+    start = std::chrono::steady_clock::now();
+    RowIndex children;
+    indexRows(entities, "loc", children);
+    indexRows(bulk.properties, "id", bulk.propertyRows);
+    indexRows(bulk.thoughts, "id", bulk.thoughtRows);
+    int id_col = entities.columnNumber("id");
+    int type_col = entities.columnNumber("type");
+    int location_col = entities.columnNumber("location");
+
+    size_t restored = 0;
+    std::deque<LocatedEntity *> parents{root};
+    while (!parents.empty()) {
+        LocatedEntity * parent = parents.front();
+        parents.pop_front();
+        auto I = children.find(parent->getId());
+        if (I == children.end()) {
             continue;
         }
-        child->m_location.m_loc = parent;
-        child->setFlags(entity_clean | entity_pos_clean | entity_orient_clean);
-        BaseWorld::instance().addEntity(child);
-        restoreChildren(child);
+        for (int row : I->second) {
+            LocatedEntity * child = restoreEntity(parent,
+                                                  entities.field(id_col, row),
+                                                  entities.field(type_col, row),
+                                                  entities.field(location_col, row),
+                                                  entities.length(location_col, row));
+            if (child != nullptr) {
+                parents.push_back(child);
+                ++restored;
+            }
+        }
     }
+    log(INFO, compose("Created %1 entities in %2 seconds.", restored,
+                      elapsed(start)));
+
+    start = std::chrono::steady_clock::now();
+    restorePropertiesRecursively(root, &bulk);
+    log(INFO, compose("Restored properties and thoughts in %1 seconds.",
+                      elapsed(start)));
+    return 0;
 }
 
 void StorageManager::tick()
@@ -507,10 +809,10 @@ void StorageManager::tick()
     int old_insert_queries = m_insertEntityCount + m_insertPropertyCount;
     int old_update_queries = m_updateEntityCount + m_updatePropertyCount;
 
-    while (!m_destroyedEntities.empty()) {
-        long id = m_destroyedEntities.front();
-        Database::instance()->dropEntity(id);
-        m_destroyedEntities.pop_front();
+    if (!m_destroyedEntities.empty()) {
+        Database::instance()->dropEntities(std::vector<long>(
+                m_destroyedEntities.begin(), m_destroyedEntities.end()));
+        m_destroyedEntities.clear();
     }
 
     while (!m_unstoredEntities.empty()) {
@@ -524,6 +826,8 @@ void StorageManager::tick()
         }
         m_unstoredEntities.pop_front();
     }
+    // The characters added below refer to the entities inserted.
+    writeInsertRows();
 
     while (!m_addedCharacters.empty()) {
         auto& data = m_addedCharacters.front();
@@ -537,29 +841,62 @@ void StorageManager::tick()
         m_deletedCharacters.pop_front();
     }
 
-    while (!m_dirtyEntities.empty()) {
-        if (Database::instance()->queryQueueSize() > 200) {
-            debug(std::cout << "Too many" << std::endl << std::flush;);
+    // The updates are only written once they all have been collected, so
+    // the size of the queue is checked once, and the number of updates
+    // collected each tick is limited instead.
+    bool backedUp = Database::instance()->queryQueueSize() > MAX_QUEUED_COMMANDS;
+    if (backedUp) {
+        debug(std::cout << "Too many" << std::endl << std::flush;);
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (m_checkpointInterval.count() != 0 && now >= m_nextCheckpoint) {
+        m_checkpointing = true;
+        m_nextCheckpoint = now + m_checkpointInterval;
+    }
+    // Entities which have changed location go first, so the stored
+    // containership is kept up to date.
+    while (!backedUp && !m_structuralEntities.empty() &&
+           updates < MAX_UPDATES_PER_TICK) {
+        EntityRef ent = m_structuralEntities.front();
+        m_structuralEntities.pop_front();
+        if (ent.get() != 0 && (ent->getFlags() & entity_queued)) {
+            updates += writeModifiedEntity(ent.get(), now);
+            ++m_structuralWrites;
+        }
+    }
+    // Other entities are written once the rewrite interval has passed since
+    // they were last written, or straight away during a checkpoint.
+    while (!backedUp && !m_dirtyEntities.empty() &&
+           updates < MAX_UPDATES_PER_TICK) {
+        auto I = m_dirtyEntities.begin();
+        if (I->first > now && !m_checkpointing) {
             break;
         }
-        const EntityRef & ent = m_dirtyEntities.front();
-        if (ent.get() != 0) {
-            if ((ent->getFlags() & entity_clean_mask) == 0) {
-                debug( std::cout << "updating " << ent->getId() << std::endl << std::flush; );
-                updateEntity(ent.get());
-                ++updates;
-            }
-            if ((ent->getFlags() & entity_dirty_thoughts) != 0) {
-                debug( std::cout << "updating thoughts " << ent->getId() << std::endl << std::flush; );
-                updateEntityThoughts(ent.get());
-                ++updates;
-            }
-            ent->resetFlags(entity_queued);
-        } else {
+        EntityRef ent = I->second;
+        m_dirtyEntities.erase(I);
+        if (ent.get() == 0) {
             debug( std::cout << "deleted" << std::endl << std::flush; );
+            continue;
+        }
+        // Entries are left behind when an entity is written early, and
+        // queued again. The entry added then has the right time.
+        if ((ent->getFlags() & entity_queued) == 0 ||
+            (!m_checkpointing && writeDue(ent.get()) > now)) {
+            continue;
         }
-        m_dirtyEntities.pop_front();
+        updates += writeModifiedEntity(ent.get(), now);
+    }
+    writeUpdateRows();
+    if (m_checkpointing && m_dirtyEntities.empty() &&
+        m_structuralEntities.empty()) {
+        m_checkpointing = false;
+        ++m_checkpoints;
     }
+    m_writesPending = m_dirtyEntities.size();
+
+    m_queryQueueSize = Database::instance()->queryQueueSize();
+    m_batchLatency = Database::instance()->batchLatency();
+    m_batchSize = Database::instance()->batchSize();
 
     if (inserts > 0 || updates > 0) {
         debug(std::cout << "I: " << inserts << " U: " << updates
@@ -612,16 +949,21 @@ void StorageManager::thoughtsReceived(const std::string& entityId, const Operati
         } else {
             auto setOp = Atlas::Objects::smart_dynamic_cast<Atlas::Objects::Operation::Set>(arg);
             Database * db = Database::instance();
-            std::vector<std::string> thoughtsList;
+            // Written with the changes of the next tick.
+            m_thoughtRows.push_back(Database::ThoughtWrite{entityId, true,
+                                                           {}, {}});
+            auto& thoughtsList = m_thoughtRows.back().thoughts;
             Atlas::Message::ListType thoughts = setOp->getArgsAsList();
             for (auto& thoughtElement : thoughts) {
                 if (thoughtElement.isMap()) {
-                    std::string value;
-                    db->encodeObject(thoughtElement.asMap(), value);
-                    thoughtsList.push_back(value);
+                    const MapType & thought = thoughtElement.asMap();
+                    auto I = thought.find("id");
+                    thoughtsList.push_back(Database::ThoughtRow{
+                            I != thought.end() && I->second.isString() ?
+                                    I->second.String() : "", ""});
+                    db->encodeWorldObject(thought, thoughtsList.back().thought);
                 }
             }
-            db->replaceThoughts(entityId, thoughtsList);
         }
 
     } else if (op->getClassNo()
@@ -649,6 +991,13 @@ int StorageManager::initWorld()
 int StorageManager::restoreWorld()
 {
     log(INFO, "Starting restoring world from storage.");
+    if (m_bulkRestore) {
+        if (restoreWorldBulk() != 0) {
+            return -1;
+        }
+        log(INFO, "Completed restoring world from storage.");
+        return 0;
+    }
     LocatedEntity * ent = &BaseWorld::instance().getRootEntity();
 
     //The order here is important. We want to restore the children before we restore the properties.
@@ -666,14 +1015,18 @@ int StorageManager::restoreWorld()
 
 int StorageManager::shutdown(bool& exit_flag, const std::map<long, LocatedEntity *>& entites)
 {
+    // Everything still waiting for the rewrite interval is written now.
+    m_checkpointing = true;
     tick();
-    while (Database::instance()->queryQueueSize()) {
+    while (Database::instance()->queryQueueSize() || m_checkpointing) {
         //Allow for any user to abort the process.
         if(exit_flag) {
             log(NOTICE, "Aborted entity persisting. This might lead to lost entities.");
             return 0;
         }
-        if (!Database::instance()->queryInProgress()) {
+        if (!Database::instance()->queryQueueSize()) {
+            tick();
+        } else if (!Database::instance()->queryInProgress()) {
             Database::instance()->launchNewQuery();
         } else {
             Database::instance()->clearPendingQuery();
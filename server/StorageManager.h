@@ -21,15 +21,19 @@
 
 #include "Persistence.h"
 
+#include "common/Database.h"
 #include "common/OperationRouter.h"
 #include "modules/EntityRef.h"
 
 #include <sigc++/trackable.h>
 
+#include <chrono>
 #include <deque>
 #include <string>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <vector>
 
 class Entity;
 class WorldRouter;
@@ -42,14 +46,41 @@ class MindInspector;
 /// storage in whatever data store is being used.
 class StorageManager : public sigc::trackable {
   protected:
+    typedef std::chrono::steady_clock::time_point Timestamp;
     typedef std::deque<EntityRef> Entitystore;
+    typedef std::multimap<Timestamp, EntityRef> Entityschedule;
     typedef std::deque<long> Idstore;
 
     /// \brief Queue of references to entities yet to be stored.
     Entitystore m_unstoredEntities;
 
-    /// \brief Queue of references to entities with modifications.
-    Entitystore m_dirtyEntities;
+    /// \brief References to entities with modifications, keyed by the
+    /// earliest time they may be written.
+    Entityschedule m_dirtyEntities;
+
+    /// \brief Queue of references to entities which have changed location,
+    /// written ahead of other modifications.
+    Entitystore m_structuralEntities;
+
+    /// \brief When each entity was last written, by integer id.
+    std::unordered_map<long, Timestamp> m_lastWritten;
+
+    /// \brief Minimum time between writes of the same entity.
+    std::chrono::seconds m_rewriteInterval;
+
+    /// \brief Time between checkpoints, when all modified entities are
+    /// written regardless of when they were last written. Zero disables.
+    std::chrono::seconds m_checkpointInterval;
+
+    /// \brief Whether changes of location are written without waiting for
+    /// the rewrite interval.
+    bool m_structuralPriority;
+
+    /// \brief Whether a checkpoint is being written.
+    bool m_checkpointing;
+
+    /// \brief When the next checkpoint is due.
+    Timestamp m_nextCheckpoint;
 
     /// \brief Queue of IDs of entities that are destroyed
     Idstore m_destroyedEntities;
@@ -66,6 +97,13 @@ class StorageManager : public sigc::trackable {
 
     std::deque<std::string> m_deletedCharacters;
 
+    /// \brief Rows collected during a tick, written in batches at the end.
+    std::vector<Database::EntityRow> m_entityInsertRows;
+    std::vector<Database::EntityRow> m_entityUpdateRows;
+    std::vector<Database::PropertyRow> m_propertyInsertRows;
+    std::vector<Database::PropertyRow> m_propertyUpdateRows;
+    std::vector<Database::ThoughtWrite> m_thoughtRows;
+
     int m_insertEntityCount;
     int m_updateEntityCount;
 
@@ -87,14 +125,43 @@ class StorageManager : public sigc::trackable {
     int m_insertQpsRing[32];
     int m_updateQpsRing[32];
 
+    /// \brief Total number of rows written.
+    int m_rowsWritten;
+    /// \brief Number of commands waiting to be sent to the database.
+    int m_queryQueueSize;
+    /// \brief Round trip time of the last batch of commands, in microseconds.
+    int m_batchLatency;
+    /// \brief Number of commands in the last batch sent to the database.
+    int m_batchSize;
+    /// \brief Number of modifications merged into a write already waiting.
+    int m_rowsAvoided;
+    /// \brief Number of modified entities waiting to be written.
+    int m_writesPending;
+    /// \brief Number of entities written early because of a change of
+    /// location.
+    int m_structuralWrites;
+    /// \brief Number of checkpoints completed.
+    int m_checkpoints;
+
     void entityInserted(LocatedEntity *);
     void entityUpdated(LocatedEntity *);
     void entityContainered(const LocatedEntity *oldLocation, LocatedEntity *entity);
 
+    /// \brief Rows read by a bulk restore, indexed by entity id.
+    struct BulkRestore;
+
+    /// \brief Restore the whole world by reading each table once.
+    bool m_bulkRestore;
+
     void encodeProperty(PropertyBase *, std::string &);
-    void restorePropertiesRecursively(LocatedEntity *);
+    void restorePropertiesRecursively(LocatedEntity *,
+                                      const BulkRestore * bulk = nullptr);
+    void restoreProperties(LocatedEntity *, const DatabaseResult & res,
+                           const std::vector<int> & rows);
 
     void restoreThoughts(LocatedEntity *);
+    void restoreThoughts(LocatedEntity *, const DatabaseResult & res,
+                         const std::vector<int> & rows);
     /// \brief Requests thoughts from the entity, if it has a mind.
     ///
     /// \return True if a thoughts query was sent.
@@ -103,7 +170,17 @@ class StorageManager : public sigc::trackable {
     void insertEntity(LocatedEntity *);
     void updateEntity(LocatedEntity *);
     void updateEntityThoughts(LocatedEntity *);
+    int writeModifiedEntity(LocatedEntity *, Timestamp now);
+    Timestamp writeDue(const LocatedEntity *) const;
+    void writeInsertRows();
+    void writeUpdateRows();
     void restoreChildren(LocatedEntity *);
+    LocatedEntity * restoreEntity(LocatedEntity * parent,
+                                  const std::string & id,
+                                  const std::string & type,
+                                  const char * location,
+                                  size_t location_size);
+    int restoreWorldBulk();
 
     /// \brief Callback for m_mindInspector when thoughts arrive.
     void thoughtsReceived(const std::string& entityId, const Operation& thoughts);
@@ -119,6 +196,24 @@ class StorageManager : public sigc::trackable {
     int initWorld();
     int restoreWorld();
 
+    /// \brief Set whether the world is restored by reading each table once,
+    /// rather than with queries for each entity.
+    void setBulkRestore(bool bulk) { m_bulkRestore = bulk; }
+
+    /// \brief Set the minimum time in seconds between writes of the same
+    /// entity. Modifications made in between are written together.
+    void setRewriteInterval(int seconds);
+
+    /// \brief Set the time in seconds between checkpoints, when every
+    /// modified entity is written. Zero disables checkpoints.
+    void setCheckpointInterval(int seconds);
+
+    /// \brief Set whether changes of location are written at the next tick
+    /// rather than waiting for the rewrite interval.
+    void setStructuralPriority(bool priority) {
+        m_structuralPriority = priority;
+    }
+
     /// \brief Called when shutting down.
     ///
     /// It's expected that the storage manager attempts to persist entity state.
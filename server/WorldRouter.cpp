@@ -19,6 +19,7 @@
 #include "WorldRouter.h"
 
 #include "ArithmeticBuilder.h"
+#include "BroadcastCache.h"
 #include "EntityBuilder.h"
 #include "SpawnEntity.h"
 
@@ -40,6 +41,7 @@
 #include "common/SystemTime.h"
 #include "common/Variable.h"
 #include "common/Tick.h"
+#include "common/WorkerPool.h"
 
 #include <Atlas/Objects/Operation.h>
 #include <Atlas/Objects/Anonymous.h>
@@ -55,6 +57,9 @@ using Atlas::Objects::Entity::Anonymous;
 
 static const bool debug_flag = false;
 
+/// Number of perceptive entities checked by a worker in one go.
+static const std::size_t PERCEPTION_CHUNK = 256;
+
 /**
  * \brief Acts as a RAII scoped guard for an entity.
  */
@@ -84,6 +89,8 @@ inline EntityScopedRef::~EntityScopedRef()
 WorldRouter::WorldRouter(const SystemTime & time) :
       BaseWorld(*new World(consts::rootWorldId, consts::rootWorldIntId)),
       m_operationsDispatcher([&](const Operation & op, LocatedEntity & from){this->operation(op, from);}, [&]()->double {return getTime();}),
+      m_perceptiveListDirty(true),
+      m_perceptionIndex(false),
       m_entityCount(1)
           
 {
@@ -189,6 +196,10 @@ LocatedEntity * WorldRouter::addEntity(LocatedEntity * ent)
         // FIXME Mark the entity as dirty?
         ent->onUpdated();
     }
+    Domain * parentDomain = ent->m_location.m_loc->getMovementDomain();
+    if (parentDomain) {
+        parentDomain->addEntity(*ent);
+    }
     debug(std::cout << "Entity loc " << ent->m_location << std::endl
                     << std::flush;);
 
@@ -378,7 +389,16 @@ void WorldRouter::delEntity(LocatedEntity * ent)
         return;
     }
     assert(ent->getIntId() != 0);
-    m_perceptives.erase(ent);
+    if (m_perceptives.erase(ent) != 0) {
+        m_perceptiveListDirty = true;
+        m_unindexedPerceptives.erase(ent);
+    }
+    if (ent->m_location.m_loc != nullptr) {
+        Domain * domain = ent->m_location.m_loc->getMovementDomain();
+        if (domain) {
+            domain->removeEntity(*ent);
+        }
+    }
     m_eobjects.erase(ent->getIntId());
     --m_entityCount;
     ent->destroy();
@@ -410,6 +430,21 @@ void WorldRouter::message(const Operation & op, LocatedEntity & ent)
                     << std::flush;);
 }
 
+/// \brief Pass an operation to the World, returning a handle to it.
+///
+/// The handle can be passed to cancelOperation() to stop the operation
+/// from being dispatched.
+OpHandle WorldRouter::scheduleOperation(const Operation & op, LocatedEntity & ent)
+{
+    return m_operationsDispatcher.scheduleOperation(op, ent);
+}
+
+/// \brief Cancel an operation passed to scheduleOperation().
+void WorldRouter::cancelOperation(OpHandle & handle)
+{
+    m_operationsDispatcher.cancelOperation(handle);
+}
+
 /// \brief Determine the broadcast list to be used to broadcast an operation.
 ///
 /// Check the type of operation, and work out which list of entities
@@ -521,8 +556,17 @@ void WorldRouter::operation(const Operation & op, LocatedEntity & from)
         deliverTo(op, *to_entity);
 
     } else if (broadcastPerception(op)) {
+        // Clients seeing the op share the same encoding of it.
+        BroadcastCache::Scope broadcastScope(op);
         auto fromDomain = from.getMovementDomain();
-        if (fromDomain) {
+        if (fromDomain && m_perceptionIndex &&
+            broadcastIndexed(op, *fromDomain, from)) {
+            // The domain narrowed down the observers.
+        } else if (fromDomain && m_workerPool &&
+            m_perceptives.size() > PERCEPTION_CHUNK &&
+            broadcastParallel(op, *fromDomain, from)) {
+            // The domain checked visibility in parallel.
+        } else if (fromDomain) {
             // Where broadcasts go depends on type of op
             for (auto& entity : m_perceptives) {
                 if (fromDomain->isEntityVisibleFor(*entity, from)) {
@@ -549,7 +593,142 @@ void WorldRouter::operation(const Operation & op, LocatedEntity & from)
 void WorldRouter::addPerceptive(LocatedEntity * perceptive)
 {
     debug(std::cout << "WorldRouter::addPerceptive" << std::endl << std::flush;);
-    m_perceptives.insert(perceptive);
+    if (m_perceptives.insert(perceptive).second) {
+        m_perceptiveListDirty = true;
+    }
+    // This is called each time the entity looks at something, which keeps
+    // its position in the index fresh.
+    if (m_perceptionIndex) {
+        registerObserver(perceptive);
+    }
+}
+
+void WorldRouter::registerObserver(LocatedEntity * perceptive)
+{
+    Domain * domain = perceptive->getMovementDomain();
+    if (domain && domain->addObserver(*perceptive)) {
+        m_unindexedPerceptives.erase(perceptive);
+    } else {
+        m_unindexedPerceptives.insert(perceptive);
+    }
+}
+
+void WorldRouter::setPerceptionIndex(bool enabled)
+{
+    m_perceptionIndex = enabled;
+    m_unindexedPerceptives.clear();
+    if (enabled) {
+        for (auto perceptive : m_perceptives) {
+            registerObserver(perceptive);
+        }
+    }
+}
+
+void WorldRouter::setPerceptionThreads(unsigned int threads)
+{
+    if (threads == 0) {
+        m_workerPool.reset();
+    } else {
+        m_workerPool.reset(new WorkerPool(threads));
+    }
+}
+
+/// \brief Broadcast a perception operation, checking visibility in parallel.
+///
+/// The domain prepares a visibility check which only reads the location
+/// data of the entities involved, so it's split up between the threads of
+/// the worker pool. The operation is then delivered to those who can see
+/// it in the world thread, in the same order as a serial broadcast would.
+/// @return False if the domain can't check visibility concurrently, in
+/// which case nothing has been sent.
+bool WorldRouter::broadcastParallel(const Operation & op,
+                                    const Domain & fromDomain,
+                                    const LocatedEntity & from)
+{
+    auto isVisible = fromDomain.getConcurrentVisibilityCheck(from);
+    if (!isVisible) {
+        return false;
+    }
+    if (m_perceptiveListDirty) {
+        m_perceptiveList.assign(m_perceptives.begin(), m_perceptives.end());
+        m_perceptiveListDirty = false;
+    }
+    const std::size_t count = m_perceptiveList.size();
+    m_perceptiveVisible.assign(count, 0);
+
+    m_workerPool->run((count + PERCEPTION_CHUNK - 1) / PERCEPTION_CHUNK,
+                      [&](std::size_t chunk) {
+        std::size_t end = std::min(count, (chunk + 1) * PERCEPTION_CHUNK);
+        for (std::size_t i = chunk * PERCEPTION_CHUNK; i < end; ++i) {
+            m_perceptiveVisible[i] = isVisible(*m_perceptiveList[i]);
+        }
+    });
+
+    std::vector<LocatedEntity *> recipients;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (m_perceptiveVisible[i]) {
+            recipients.push_back(m_perceptiveList[i]);
+        }
+    }
+    deliverToRecipients(op, recipients);
+    return true;
+}
+
+/// \brief Broadcast a perception operation to the observers found through
+/// the index of the domain.
+///
+/// Only the perceptive entities which the domain reports as being near
+/// enough, and those which aren't indexed at all, are checked for
+/// visibility.
+/// @return False if the domain couldn't narrow down the observers, in which
+/// case nothing has been sent.
+bool WorldRouter::broadcastIndexed(const Operation & op,
+                                   const Domain & fromDomain,
+                                   const LocatedEntity & from)
+{
+    m_observerCandidates.clear();
+    if (!fromDomain.getObserverCandidates(from, m_observerCandidates)) {
+        return false;
+    }
+    std::vector<LocatedEntity *> recipients;
+    for (auto candidate : m_observerCandidates) {
+        // The index only holds const pointers, so look the entity up.
+        auto I = m_perceptives.find(const_cast<LocatedEntity *>(candidate));
+        if (I != m_perceptives.end() &&
+            fromDomain.isEntityVisibleFor(**I, from)) {
+            recipients.push_back(*I);
+        }
+    }
+    for (auto entity : m_unindexedPerceptives) {
+        if (fromDomain.isEntityVisibleFor(*entity, from)) {
+            recipients.push_back(entity);
+        }
+    }
+    // Deliver in the same order as a full scan of the perceptives would.
+    std::sort(recipients.begin(), recipients.end());
+    recipients.erase(std::unique(recipients.begin(), recipients.end()),
+                     recipients.end());
+    deliverToRecipients(op, recipients);
+    return true;
+}
+
+/// \brief Deliver a broadcast operation to each of a list of entities.
+///
+/// Delivering may add or remove perceptives, so the recipients are kept
+/// alive until they've all been handled.
+void WorldRouter::deliverToRecipients(const Operation & op,
+                                      const std::vector<LocatedEntity *> & recipients)
+{
+    for (auto entity : recipients) {
+        entity->incRef();
+    }
+    for (auto entity : recipients) {
+        if (!entity->isDestroyed()) {
+            op->setTo(entity->getId());
+            deliverTo(op, *entity);
+        }
+        entity->decRef();
+    }
 }
 
 /// Main world loop function.
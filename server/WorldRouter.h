@@ -25,9 +25,13 @@
 #include <list>
 #include <set>
 #include <queue>
+#include <memory>
+#include <vector>
 
 
+class Domain;
 class Spawn;
+class WorkerPool;
 
 typedef std::set<LocatedEntity *> EntitySet;
 typedef std::map<std::string, std::pair<Spawn *, std::string>> SpawnDict;
@@ -46,6 +50,20 @@ class WorldRouter : public BaseWorld {
     OpQueue m_suspendedQueue;
     /// List of perceptive entities.
     EntitySet m_perceptives;
+    /// Copy of m_perceptives which can be indexed by worker threads.
+    std::vector<LocatedEntity *> m_perceptiveList;
+    /// Set when m_perceptiveList needs to be rebuilt.
+    bool m_perceptiveListDirty;
+    /// Visibility of each entry in m_perceptiveList during a broadcast.
+    std::vector<char> m_perceptiveVisible;
+    /// If set, used to check visibility for broadcasts in parallel.
+    std::unique_ptr<WorkerPool> m_workerPool;
+    /// If true, the domains are asked for the observers of a broadcast.
+    bool m_perceptionIndex;
+    /// Perceptive entities which no domain keeps an index of.
+    EntitySet m_unindexedPerceptives;
+    /// Scratch space for observers found through the domain index.
+    std::vector<const LocatedEntity *> m_observerCandidates;
     /// Count of in world entities
     int m_entityCount;
     /// Map of spawns
@@ -54,6 +72,13 @@ class WorldRouter : public BaseWorld {
     bool broadcastPerception(const Atlas::Objects::Operation::RootOperation &) const;
     void deliverTo(const Atlas::Objects::Operation::RootOperation &,
                    LocatedEntity &);
+    bool broadcastParallel(const Atlas::Objects::Operation::RootOperation &,
+                           const Domain &, const LocatedEntity &);
+    bool broadcastIndexed(const Atlas::Objects::Operation::RootOperation &,
+                          const Domain &, const LocatedEntity &);
+    void deliverToRecipients(const Atlas::Objects::Operation::RootOperation &,
+                             const std::vector<LocatedEntity *> &);
+    void registerObserver(LocatedEntity * perceptive);
     void resumeWorld();
   public:
     explicit WorldRouter(const SystemTime &);
@@ -92,6 +117,9 @@ class WorldRouter : public BaseWorld {
     virtual void addPerceptive(LocatedEntity *);
     virtual void message(const Atlas::Objects::Operation::RootOperation &,
                          LocatedEntity &);
+    virtual OpHandle scheduleOperation(const Atlas::Objects::Operation::RootOperation &,
+                                       LocatedEntity &);
+    virtual void cancelOperation(OpHandle & handle);
     virtual LocatedEntity * findByName(const std::string & name);
     virtual LocatedEntity * findByType(const std::string & type);
 
@@ -108,6 +136,31 @@ class WorldRouter : public BaseWorld {
      */
     void markQueueAsClean();
 
+    /**
+     * @brief Sets the number of threads used to check visibility when
+     * broadcasting perception operations.
+     *
+     * @param threads The number of extra threads, or 0 to do all the work
+     * in the world thread.
+     */
+    void setPerceptionThreads(unsigned int threads);
+
+    /**
+     * @brief Enables or disables using the domains' observer indices when
+     * broadcasting perception operations.
+     *
+     * With the index enabled only observers near the broadcasting entity
+     * need to be checked for visibility.
+     */
+    void setPerceptionIndex(bool enabled);
+
+    /**
+     * @brief Gets the dispatcher which handles the operation queues.
+     */
+    OperationsDispatcher & getOperationsDispatcher() {
+        return m_operationsDispatcher;
+    }
+
     /// \brief Signal that a new Entity has been inserted.
     sigc::signal<void, LocatedEntity *> inserted;
 
@@ -39,6 +39,7 @@
 #include "PossessionAuthenticator.h"
 #include "TrustedConnection.h"
 #include "HttpCache.h"
+#include "IoThreadPool.h"
 
 #include "rulesets/Python_API.h"
 #include "rulesets/LocatedEntity.h"
@@ -50,6 +51,7 @@
 #include "common/globals.h"
 #include "common/Inheritance.h"
 #include "common/compose.hpp"
+#include "common/DatabaseFile.h"
 #include "common/system.h"
 #include "common/nls.h"
 #include "common/sockets.h"
@@ -57,6 +59,7 @@
 #include "common/serialno.h"
 #include "common/SystemTime.h"
 #include "common/Monitors.h"
+#include "common/SlabPool.h"
 
 #include <varconf/config.h>
 
@@ -70,6 +73,7 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/deadline_timer.hpp>
 
+#include <algorithm>
 #include <thread>
 #include <cstdlib>
 #include <fstream>
@@ -98,6 +102,97 @@ INT_OPTION(ai_clients, 1, CYPHESIS, "aiclients",
         "Number of AI clients to spawn.")
 ;
 
+STRING_OPTION(op_scheduler, "heap", CYPHESIS, "opscheduler",
+        "Scheduler for future operations, either \"heap\" or \"wheel\"")
+;
+
+INT_OPTION(op_wheel_resolution, 10, CYPHESIS, "opwheelresolution",
+        "Tick length in milliseconds of the \"wheel\" operation scheduler")
+;
+
+INT_OPTION(dispatch_slice, 5000, CYPHESIS, "dispatchslice",
+        "Time in microseconds to spend dispatching operations before "
+        "handling network IO")
+;
+
+BOOL_OPTION(dispatch_adaptive, false, CYPHESIS, "dispatchadaptive",
+        "Flag to adjust the dispatch slice length to the cost of operations "
+        "and the amount of waiting network IO")
+;
+
+BOOL_OPTION(perception_index, false, CYPHESIS, "perceptionindex",
+        "Flag to use a spatial index of observers when broadcasting "
+        "perception operations")
+;
+
+INT_OPTION(perception_threads, 0, CYPHESIS, "perceptionthreads",
+        "Number of extra threads used to check visibility when broadcasting "
+        "perception operations. 0 disables.")
+;
+
+INT_OPTION(network_threads, 0, CYPHESIS, "networkthreads",
+        "Number of threads handling network IO, negotiation and decoding for "
+        "remote clients. 0 handles them in the main thread.")
+;
+
+INT_OPTION(client_queue_high_water, 256, CYPHESIS, "clientqueuehighwater",
+        "Size in kilobytes of the data waiting to be sent to a client above "
+        "which outdated movement updates are dropped. 0 disables.")
+;
+
+INT_OPTION(client_queue_limit, 4096, CYPHESIS, "clientqueuelimit",
+        "Size in kilobytes of the data waiting to be sent to a client at "
+        "which it is disconnected. 0 disables.")
+;
+
+BOOL_OPTION(bulk_restore, true, CYPHESIS, "bulkrestore",
+        "Restore the world at startup by reading each database table once, "
+        "rather than with queries for each entity.")
+;
+
+INT_OPTION(id_block_size, 64, CYPHESIS, "idblocksize",
+        "Number of entity ids reserved from the database at a time.")
+;
+
+INT_OPTION(db_batch_commands, 64, CYPHESIS, "dbbatchcommands",
+        "Maximum number of queued database commands sent to the database "
+        "in one round trip.")
+;
+
+INT_OPTION(storage_rewrite_interval, 0, CYPHESIS, "storagerewriteinterval",
+        "Minimum time in seconds between writes of the same entity to "
+        "storage. Modifications made in between are written together. "
+        "0 writes every modification as it's made.")
+;
+
+INT_OPTION(storage_checkpoint_interval, 600, CYPHESIS,
+        "storagecheckpointinterval",
+        "Time in seconds between writes of all modified entities, regardless "
+        "of the rewrite interval. 0 disables.")
+;
+
+BOOL_OPTION(storage_structural_priority, true, CYPHESIS,
+        "storagestructuralpriority",
+        "Flag to write entities which have changed location without waiting "
+        "for the rewrite interval.")
+;
+
+STRING_OPTION(storage_backend, "postgres", CYPHESIS, "storagebackend",
+        "Where the world is stored. Either \"postgres\", for a PostgreSQL "
+        "database, or \"file\", for a single file read into memory at "
+        "startup.")
+;
+
+STRING_OPTION(storage_file, "", CYPHESIS, "storagefile",
+        "Path of the file used by the file storage backend, which has to "
+        "be set when using it.")
+;
+
+BOOL_OPTION(storage_file_sync, true, CYPHESIS, "storagefilesync",
+        "Flag to wait for the storage file to be written to the disk on "
+        "each commit, so that a crash loses nothing already committed.")
+;
+
 void interactiveSignalsHandler(boost::asio::signal_set& this_, boost::system::error_code error, int signal_number) {
     if (!error) {
         switch (signal_number) {
@@ -210,7 +305,22 @@ int main(int argc, char ** argv)
     // database support, this will open the various databases used to
     // store server data.
     if (database_flag) {
+        if (storage_backend == "file") {
+            std::string path = storage_file;
+            if (path.empty()) {
+                log(ERROR, "The file storage backend requires storagefile "
+                           "to be set.");
+                return EXIT_CONFIG_ERROR;
+            }
+            log(INFO, compose("Storing the world in \"%1\".", path));
+            DatabaseFile::install(path, storage_file_sync);
+        } else if (storage_backend != "postgres") {
+            log(ERROR, compose("Unknown storage backend \"%1\".",
+                    storage_backend));
+            return EXIT_CONFIG_ERROR;
+        }
         Persistence * p = Persistence::instance();
+        p->m_db.setIdBlockSize(std::max(id_block_size, 1));
         int dbstatus = p->init();
         if (dbstatus < 0) {
             database_flag = false;
@@ -270,6 +380,9 @@ int main(int argc, char ** argv)
         signalSet.async_wait(std::bind(daemonSignalsHandler, std::ref(signalSet), std::placeholders::_1, std::placeholders::_2));
     }
 
+    // Report the pools entities and properties are allocated from.
+    watchSlabPools();
+
     // Start up the Python subsystem.
     init_python_api(ruleset_name);
 
@@ -280,6 +393,44 @@ int main(int argc, char ** argv)
 
     WorldRouter * world = new WorldRouter(time);
 
+    if (op_scheduler == "wheel") {
+        if (op_wheel_resolution <= 0) {
+            log(ERROR, "The operation scheduler resolution must be positive.");
+            return EXIT_CONFIG_ERROR;
+        }
+        log(INFO, compose("Using timing wheel operation scheduler with "
+                "a resolution of %1 ms.", op_wheel_resolution));
+        world->getOperationsDispatcher().useTimingWheel(
+                op_wheel_resolution / 1000.0);
+    } else if (op_scheduler != "heap") {
+        log(ERROR, compose("Unknown operation scheduler \"%1\".",
+                op_scheduler));
+        return EXIT_CONFIG_ERROR;
+    }
+
+    if (dispatch_slice <= 0) {
+        log(ERROR, "The operation dispatch slice must be positive.");
+        return EXIT_CONFIG_ERROR;
+    }
+    world->getOperationsDispatcher().setSliceBudget(dispatch_slice / 1000000.0);
+    world->getOperationsDispatcher().setAdaptiveSlices(dispatch_adaptive);
+
+    if (perception_threads < 0) {
+        log(ERROR, "The number of perception threads can't be negative.");
+        return EXIT_CONFIG_ERROR;
+    }
+    world->setPerceptionIndex(perception_index);
+    if (perception_threads > 0) {
+        log(INFO, compose("Using %1 extra threads for perception broadcasts.",
+                perception_threads));
+        world->setPerceptionThreads(perception_threads);
+    }
+
+    if (network_threads < 0) {
+        log(ERROR, "The number of network threads can't be negative.");
+        return EXIT_CONFIG_ERROR;
+    }
+
     Ruleset::init(ruleset_name);
 
     PossessionAuthenticator::init();
@@ -314,6 +465,10 @@ int main(int argc, char ** argv)
     if (database_flag) {
         // log(INFO, _("Restoring world from database..."));
 
+        store->setBulkRestore(bulk_restore);
+        store->setRewriteInterval(storage_rewrite_interval);
+        store->setCheckpointInterval(storage_checkpoint_interval);
+        store->setStructuralPriority(storage_structural_priority);
         store->restoreWorld();
         // FIXME Do the following steps.
         // Read the world entity if any from the database, or set it up.
@@ -323,8 +478,13 @@ int main(int argc, char ** argv)
 
         // log(INFO, _("Restored world."));
 
-        dbsocket = new CommPSQLSocket(*io_service,
-                Persistence::instance()->m_db);
+        Persistence::instance()->m_db.setBatchLimit(std::max(db_batch_commands, 1));
+        // The file backend writes as soon as anything changes, so it has
+        // no connection to poll.
+        if (Persistence::instance()->m_db.getConnection() != 0) {
+            dbsocket = new CommPSQLSocket(*io_service,
+                    Persistence::instance()->m_db);
+        }
 
         storage_idle = new IdleConnector(*io_service);
         storage_idle->idling.connect(
@@ -345,10 +505,27 @@ int main(int argc, char ** argv)
                 long c_iid = newId(connection_id);
                 //Turn off Nagle's algorithm to increase responsiveness.
                 client.getSocket().set_option(ip::tcp::no_delay(true));
+                client.setSendQueueLimits(
+                        std::max(client_queue_high_water, 0) * 1024,
+                        std::max(client_queue_limit, 0) * 1024);
                 client.startAccept(
                         new Connection(client, *server, "", connection_id, c_iid));
             };
 
+    //With network threads the sockets of remote clients are handled by
+    //those, while the clients themselves are still used from here.
+    IoThreadPool * ioThreads = nullptr;
+    std::function<std::shared_ptr<CommAsioClient<ip::tcp>>()> tcpAtlasCreator;
+    if (network_threads > 0) {
+        log(INFO, compose("Using %1 threads for client network IO.",
+                network_threads));
+        ioThreads = new IoThreadPool(network_threads, *io_service);
+        tcpAtlasCreator = [&]() {
+            return std::make_shared<CommAsioClient<ip::tcp>>(
+                    server->getName(), *io_service, *ioThreads);
+        };
+    }
+
     std::list<
             CommAsioListener<ip::tcp,
                     CommAsioClient<ip::tcp>> > tcp_atlas_clients;
@@ -360,7 +537,8 @@ int main(int argc, char ** argv)
                 tcp_atlas_clients.emplace_back(tcpAtlasStarter,
                         server->getName(), *io_service,
                         ip::tcp::endpoint(
-                                ip::tcp::v4(), client_port_num));
+                                ip::tcp::v4(), client_port_num),
+                        tcpAtlasCreator);
             } catch (const std::exception& e) {
                 break;
             }
@@ -388,7 +566,8 @@ int main(int argc, char ** argv)
             tcp_atlas_clients.emplace_back(tcpAtlasStarter, server->getName(),
                     *io_service,
                     ip::tcp::endpoint(ip::tcp::v4(),
-                            client_port_num));
+                            client_port_num),
+                    tcpAtlasCreator);
         } catch (const std::exception& e) {
             log(ERROR, String::compose("Could not create client listen socket "
                     "on port %1. Init failed. The most common reason for this "
@@ -545,7 +724,8 @@ int main(int argc, char ** argv)
             world->markQueueAsClean();
             //If the world is busy we should just poll.
             if (busy) {
-                io_service->poll();
+                size_t handlers = io_service->poll();
+                world->getOperationsDispatcher().reportIoHandlers(handlers);
             } else {
                 //If it's not busy however we should run until we get a task.
                 //We will either get an io task, or we will be triggered by the timer
@@ -655,6 +835,8 @@ int main(int argc, char ** argv)
 
     tcp_atlas_clients.clear();
 
+    delete ioThreads;
+
     delete storage_idle;
 
     delete io_service;
@@ -301,6 +301,7 @@ bool restricted_flag;
 #include "stubs/server/stubExternalMindsManager.h"
 #include "stubs/server/stubExternalMindsConnection.h"
 #include "stubs/common/stubOperationsDispatcher.h"
+#include "stubs/common/stubOpTimingWheel.h"
 #include "stubs/modules/stubWorldTime.h"
 #include "stubs/modules/stubDateTime.h"
 
@@ -465,6 +466,14 @@ Account * ServerRouting::getAccountByName(const std::string & username)
     return 0;
 }
 
+int ServerRouting::lookupAccountByName(const std::string & username,
+                                       Account *& account,
+                                       const sigc::slot<void, Account *> & done)
+{
+    account = 0;
+    return 0;
+}
+
 void ServerRouting::addAccount(Account * a)
 {
 }
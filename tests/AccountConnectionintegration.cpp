@@ -480,6 +480,13 @@ Account * Persistence::getAccount(const std::string & name)
     return 0;
 }
 
+void Persistence::lookupAccount(const std::string & name,
+                                const EntityDict & worldObjects,
+                                const std::function<void(Account *)> & done)
+{
+    done(0);
+}
+
 void Persistence::putAccount(const Account & ac)
 {
 }
@@ -511,6 +518,7 @@ void logEvent(LogEvent lev, const std::string & msg)
 #include "stubs/server/stubExternalMindsManager.h"
 #include "stubs/server/stubExternalMindsConnection.h"
 #include "stubs/common/stubOperationsDispatcher.h"
+#include "stubs/common/stubOpTimingWheel.h"
 
 PropertyManager * PropertyManager::m_instance = 0;
 
@@ -551,6 +559,13 @@ int check_password(const std::string & pwd, const std::string & hash)
     return 0;
 }
 
+int_config_register::int_config_register(int & var,
+                                         const char * section,
+                                         const char * setting,
+                                         const char * help)
+{
+}
+
 bool_config_register::bool_config_register(bool & var,
                                            const char * section,
                                            const char * setting,
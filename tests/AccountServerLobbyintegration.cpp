@@ -272,6 +272,13 @@ Account * Persistence::getAccount(const std::string & name)
     return 0;
 }
 
+void Persistence::lookupAccount(const std::string & name,
+                                const EntityDict & worldObjects,
+                                const std::function<void(Account *)> & done)
+{
+    done(0);
+}
+
 void Persistence::addCharacter(const Account &, const LocatedEntity &)
 {
 }
@@ -444,6 +451,13 @@ namespace consts {
 const char * const CYPHESIS = "cyphesis";
 int timeoffset = 0;
 
+int_config_register::int_config_register(int & var,
+                                         const char * section,
+                                         const char * setting,
+                                         const char * help)
+{
+}
+
 bool_config_register::bool_config_register(bool & var,
                                            const char * section,
                                            const char * setting,
@@ -426,6 +426,8 @@ LocatedEntity * TestWorld::addNewEntity(const std::string &,
 #include "stubs/server/stubExternalMindsManager.h"
 #include "stubs/server/stubExternalMindsConnection.h"
 #include "stubs/common/stubOperationsDispatcher.h"
+#include "stubs/common/stubOpTimingWheel.h"
+#include "stubs/common/stubWorkerPool.h"
 #include "stubs/modules/stubWorldTime.h"
 #include "stubs/common/stubCustom.h"
 #include "stubs/common/stubVariable.h"
@@ -557,6 +559,13 @@ Account * Persistence::getAccount(const std::string & name)
     return 0;
 }
 
+void Persistence::lookupAccount(const std::string & name,
+                                const EntityDict & worldObjects,
+                                const std::function<void(Account *)> & done)
+{
+    done(0);
+}
+
 void Persistence::putAccount(const Account & ac)
 {
 }
@@ -1178,6 +1187,13 @@ void Movement::reset()
 
 #include "stubs/rulesets/stubMotion.h"
 
+int_config_register::int_config_register(int & var,
+                                         const char * section,
+                                         const char * setting,
+                                         const char * help)
+{
+}
+
 bool_config_register::bool_config_register(bool & var,
                                            const char * section,
                                            const char * setting,
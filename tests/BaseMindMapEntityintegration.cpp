@@ -458,6 +458,11 @@ std::vector<Atlas::Objects::Root> LocatedEntity::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges LocatedEntity::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
 Router::Router(const std::string & id, long intId) : m_id(id), m_intId(intId)
 {
 }
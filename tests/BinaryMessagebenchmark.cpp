@@ -0,0 +1,165 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Compares the XML codec and the binary encoding for the data stored in
+// the world tables. Each kind of data is encoded and decoded repeatedly,
+// the way the storage manager does when persisting and restoring.
+
+#include "common/BinaryMessage.h"
+
+#include <Atlas/Message/DecoderBase.h>
+#include <Atlas/Message/MEncoder.h>
+#include <Atlas/Codecs/XML.h>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using Atlas::Message::ListType;
+using Atlas::Message::MapType;
+
+static const int ITERATIONS = 100000;
+
+class MessageDecoder : public Atlas::Message::DecoderBase {
+  private:
+    virtual void messageArrived(const MapType & msg) {
+        m_msg = msg;
+    }
+  public:
+    MapType m_msg;
+};
+
+struct Sample {
+    const char * name;
+    MapType msg;
+};
+
+struct Result {
+    double encode;
+    double decode;
+    size_t size;
+};
+
+static double elapsed(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void encodeXML(const MapType & msg, std::string & data)
+{
+    MessageDecoder decoder;
+    std::stringstream str;
+    Atlas::Codecs::XML codec(str, decoder);
+    Atlas::Message::Encoder enc(codec);
+    codec.streamBegin();
+    enc.streamMessageElement(msg);
+    codec.streamEnd();
+    data = str.str();
+}
+
+static void decodeXML(const std::string & data, MapType & msg)
+{
+    MessageDecoder decoder;
+    std::stringstream str(data, std::ios::in);
+    Atlas::Codecs::XML codec(str, decoder);
+    codec.poll();
+    msg = decoder.m_msg;
+}
+
+static Result runXML(const MapType & msg)
+{
+    Result result{0, 0, 0};
+    std::string data;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        encodeXML(msg, data);
+    }
+    result.encode = elapsed(start);
+    result.size = data.size();
+
+    MapType decoded;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        decodeXML(data, decoded);
+    }
+    result.decode = elapsed(start);
+    return result;
+}
+
+static Result runBinary(const MapType & msg)
+{
+    Result result{0, 0, 0};
+    std::string data;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        data.clear();
+        BinaryMessage::encode(msg, data);
+    }
+    result.encode = elapsed(start);
+    result.size = data.size();
+
+    MapType decoded;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        BinaryMessage::decode(data.data(), data.size(), decoded);
+    }
+    result.decode = elapsed(start);
+    return result;
+}
+
+int main()
+{
+    std::vector<Sample> samples;
+    samples.push_back(Sample{"location", MapType{
+        {"pos", ListType{124.53, -1034.2, 12.0}},
+        {"orientation", ListType{0.0, 0.0, 0.38268, 0.92388}}}});
+    samples.push_back(Sample{"float property", MapType{{"val", 43.75}}});
+    samples.push_back(Sample{"string property", MapType{
+        {"val", "A weathered sign, pointing towards the village."}}});
+    ListType contains;
+    for (int i = 0; i < 50; ++i) {
+        contains.push_back(std::to_string(40000 + i));
+    }
+    samples.push_back(Sample{"list property", MapType{{"val", contains}}});
+    samples.push_back(Sample{"thought", MapType{
+        {"objtype", "op"}, {"parents", ListType{"set"}},
+        {"args", ListType{MapType{{"id", "knowledge"},
+                                  {"predicate", "location"},
+                                  {"subject", "home"},
+                                  {"object", ListType{MapType{
+                                      {"loc", "0"},
+                                      {"pos", ListType{20.0, 30.0, 0.0}}}}}}}}}});
+
+    std::cout << "data\tcodec\tsize (bytes)\tencode (ns/op)\tdecode (ns/op)"
+              << std::endl;
+    for (auto& sample : samples) {
+        Result xml = runXML(sample.msg);
+        Result binary = runBinary(sample.msg);
+        std::cout << sample.name << "\txml\t" << xml.size
+                  << "\t" << xml.encode * 1e9 / ITERATIONS
+                  << "\t" << xml.decode * 1e9 / ITERATIONS
+                  << std::endl;
+        std::cout << sample.name << "\tbinary\t" << binary.size
+                  << "\t" << binary.encode * 1e9 / ITERATIONS
+                  << "\t" << binary.decode * 1e9 / ITERATIONS
+                  << std::endl;
+    }
+    return 0;
+}
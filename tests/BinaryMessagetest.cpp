@@ -0,0 +1,115 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "common/BinaryMessage.h"
+
+#include <limits>
+
+#include <cassert>
+
+using Atlas::Message::ListType;
+using Atlas::Message::MapType;
+
+static MapType roundTrip(const MapType & msg)
+{
+    std::string data;
+    BinaryMessage::encode(msg, data);
+    assert(BinaryMessage::isEncoded(data.data(), data.size()));
+    MapType result;
+    assert(BinaryMessage::decode(data.data(), data.size(), result) == 0);
+    return result;
+}
+
+int main()
+{
+    {
+        MapType msg;
+        assert(roundTrip(msg) == msg);
+    }
+
+    {
+        // All kinds of elements survive unchanged
+        MapType msg;
+        msg["zero"] = 0;
+        msg["small"] = -3;
+        msg["max"] = std::numeric_limits<Atlas::Message::IntType>::max();
+        msg["min"] = std::numeric_limits<Atlas::Message::IntType>::min();
+        msg["float"] = 1.5;
+        msg["negative float"] = -0.1;
+        msg["string"] = "some text";
+        msg["binary string"] = std::string("\0\x01\xff<", 4);
+        msg["empty"] = "";
+        msg["none"] = Atlas::Message::Element();
+        msg["pos"] = ListType{1.0, 2.0, 3.0};
+        msg["nested"] = MapType{{"val", ListType{MapType{{"a", 1}}, "b"}}};
+        assert(roundTrip(msg) == msg);
+    }
+
+    {
+        // The encoding is smaller than the XML one for typical positions
+        MapType msg;
+        msg["pos"] = ListType{12.5, -3.25, 0.0};
+        msg["orientation"] = ListType{0.0, 0.0, 0.707, 0.707};
+        std::string data;
+        BinaryMessage::encode(msg, data);
+        assert(data.size() < 100);
+    }
+
+    {
+        // XML is not taken for the encoding
+        std::string xml("<atlas><map><int name=\"a\">1</int></map></atlas>");
+        assert(!BinaryMessage::isEncoded(xml.data(), xml.size()));
+        MapType result;
+        assert(BinaryMessage::decode(xml.data(), xml.size(), result) == -1);
+    }
+
+    {
+        // Truncated or padded data is rejected
+        MapType msg;
+        msg["name"] = "a long enough string";
+        msg["list"] = ListType{1, 2, 3};
+        std::string data;
+        BinaryMessage::encode(msg, data);
+        MapType result;
+        for (size_t size = 0; size < data.size(); ++size) {
+            assert(BinaryMessage::decode(data.data(), size, result) == -1);
+        }
+        data.push_back('\0');
+        assert(BinaryMessage::decode(data.data(), data.size(), result) == -1);
+    }
+
+    {
+        // Lists claiming more elements than there is data are rejected
+        // without allocating them
+        std::string data;
+        BinaryMessage::encode(MapType(), data);
+        data.resize(2);
+        data += std::string("\x01\x01" "a" "\x05\xff\xff\xff\xff\x0f", 10);
+        MapType result;
+        assert(BinaryMessage::decode(data.data(), data.size(), result) == -1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "server/BroadcastCache.h"
+
+#include "Sink.h"
+
+#include <Atlas/Codecs/Bach.h>
+#include <Atlas/Codecs/Packed.h>
+#include <Atlas/Codecs/XML.h>
+#include <Atlas/Objects/Anonymous.h>
+#include <Atlas/Objects/Encoder.h>
+#include <Atlas/Objects/Operation.h>
+
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <cassert>
+
+using Atlas::Objects::Entity::Anonymous;
+using Atlas::Objects::Operation::Move;
+using Atlas::Objects::Operation::RootOperation;
+using Atlas::Objects::Operation::Sight;
+using Atlas::Objects::Operation::Talk;
+
+static Atlas::Codec * createCodec(const std::string & name,
+                                  std::iostream & stream,
+                                  Atlas::Bridge & bridge)
+{
+    if (name == "Bach") {
+        return new Atlas::Codecs::Bach(stream, bridge);
+    } else if (name == "Packed") {
+        return new Atlas::Codecs::Packed(stream, bridge);
+    }
+    return new Atlas::Codecs::XML(stream, bridge);
+}
+
+/// \brief Sends operations to a client stream the way CommAsioClient does,
+/// with broadcasts spliced in, and compares the stream byte for byte with
+/// one written only by the encoder of the client.
+static void checkSplice(const std::string & name)
+{
+    Anonymous arg;
+    arg->setId("7");
+    arg->setLoc("0");
+    arg->setPosAsList({3., -1.25, 0.});
+    Move move;
+    move->setFrom("7");
+    move->setArgs1(arg);
+    RootOperation broadcast = Sight();
+    broadcast->setFrom("7");
+    broadcast->setArgs1(move);
+
+    Anonymous say;
+    say->setAttr("say", "hello");
+    RootOperation direct = Talk();
+    direct->setFrom("7");
+    direct->setTo("1");
+    direct->setArgs1(say);
+
+    BroadcastCache::Encoding encoding{nullptr, 0, 0};
+    assert(BroadcastCache::encode(name, broadcast, encoding));
+    assert(encoding.data);
+
+    Sink bridge;
+    std::stringstream plainStream, splicedStream;
+    std::unique_ptr<Atlas::Codec> plainCodec(createCodec(name, plainStream, bridge));
+    std::unique_ptr<Atlas::Codec> splicedCodec(createCodec(name, splicedStream, bridge));
+    Atlas::Objects::ObjectsEncoder plainEncoder(*plainCodec);
+    Atlas::Objects::ObjectsEncoder splicedEncoder(*splicedCodec);
+    plainCodec->streamBegin();
+    splicedCodec->streamBegin();
+
+    // Ops sent the normal way, and broadcasts back to back in between
+    std::vector<std::string> sends = {"", "12", "13", "", "", "14", "", "15"};
+    for (auto & to : sends) {
+        if (to.empty()) {
+            splicedEncoder.streamObjectsMessage(direct);
+            plainEncoder.streamObjectsMessage(direct);
+        } else {
+            splicedStream << encoding.splice(to);
+            broadcast->setTo(to);
+            plainEncoder.streamObjectsMessage(broadcast);
+        }
+    }
+
+    // Clients only splice broadcasts with codecs for which this holds
+    bool same = splicedStream.str() == plainStream.str();
+    assert(same == BroadcastCache::canSplice(name));
+}
+
+int main()
+{
+    BroadcastCache & cache = BroadcastCache::instance();
+    RootOperation op;
+    RootOperation other;
+
+    assert(!cache.isBroadcast(op));
+
+    {
+        BroadcastCache::Scope scope(op);
+        assert(cache.isBroadcast(op));
+        assert(!cache.isBroadcast(other));
+        assert(cache.find("Bach") == nullptr);
+
+        auto data = std::make_shared<const std::string>("{to=marker}");
+        const BroadcastCache::Encoding & encoding =
+                cache.insert("Bach", BroadcastCache::Encoding{data, 4, 6});
+        assert(encoding.data == data);
+        assert(cache.find("Bach") == &encoding);
+        assert(cache.find("XML") == nullptr);
+
+        {
+            // Nested broadcasts leave the outer one in place
+            BroadcastCache::Scope inner(other);
+            assert(cache.isBroadcast(op));
+            assert(!cache.isBroadcast(other));
+            assert(cache.find("Bach") != nullptr);
+        }
+        assert(cache.isBroadcast(op));
+        assert(cache.find("Bach") != nullptr);
+    }
+
+    // Encodings are discarded when the broadcast is done
+    assert(!cache.isBroadcast(op));
+    assert(cache.find("Bach") == nullptr);
+
+    {
+        BroadcastCache::Scope scope(other);
+        assert(cache.isBroadcast(other));
+        assert(!cache.isBroadcast(op));
+        assert(cache.find("Bach") == nullptr);
+    }
+
+    checkSplice("Bach");
+    checkSplice("Packed");
+    checkSplice("XML");
+    assert(!BroadcastCache::canSplice("Unknown"));
+
+    return 0;
+}
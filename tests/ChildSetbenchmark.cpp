@@ -0,0 +1,123 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Compares the std::set previously used for the children of an entity
+// with ChildSet. The world has many children, some of which move to
+// another parent and back between passes, and each pass iterates over
+// all of them reading their position, as broadcasts and domain updates
+// do. Entities are created in random order, like a world which has been
+// running for a while.
+
+#include "rulesets/ChildSet.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+class LocatedEntity
+{
+  private:
+    ChildPosition m_childPosition;
+
+    template <typename> friend class ChildSet;
+  public:
+    float m_pos[3] = {0.f, 0.f, 0.f};
+    /// Stands in for the rest of the members of an entity.
+    char m_rest[200];
+};
+
+static const int CHILDREN = 20000;
+static const int PASSES = 1000;
+/// Number of children moved to another parent and back between passes.
+static const int MOVES = 200;
+
+static double elapsed(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Set>
+static void run(const std::vector<LocatedEntity *> & entities,
+                const std::vector<LocatedEntity *> & moves,
+                double & iterateTime, double & moveTime, double & sum)
+{
+    Set world, other;
+    for (LocatedEntity * entity : entities) {
+        world.insert(entity);
+    }
+    iterateTime = 0;
+    moveTime = 0;
+    sum = 0;
+    for (int i = 0; i < PASSES; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        for (LocatedEntity * child : world) {
+            sum += child->m_pos[0];
+        }
+        iterateTime += elapsed(start);
+
+        start = std::chrono::steady_clock::now();
+        auto I = moves.begin() + (i * MOVES) % (moves.size() - MOVES);
+        for (auto J = I; J != I + MOVES; ++J) {
+            world.erase(*J);
+            other.insert(*J);
+        }
+        for (auto J = I; J != I + MOVES; ++J) {
+            other.erase(*J);
+            world.insert(*J);
+        }
+        moveTime += elapsed(start);
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(1);
+    std::vector<std::unique_ptr<LocatedEntity>> storage;
+    for (int i = 0; i < CHILDREN; ++i) {
+        storage.emplace_back(new LocatedEntity);
+        storage.back()->m_pos[0] = (float)i;
+    }
+    std::vector<LocatedEntity *> entities;
+    for (auto& entity : storage) {
+        entities.push_back(entity.get());
+    }
+    std::shuffle(entities.begin(), entities.end(), rng);
+    std::vector<LocatedEntity *> moves(entities);
+    std::shuffle(moves.begin(), moves.end(), rng);
+
+    double setIterate, setMove, setSum;
+    double childIterate, childMove, childSum;
+    run<std::set<LocatedEntity *>>(entities, moves, setIterate, setMove, setSum);
+    run<ChildSet<LocatedEntity>>(entities, moves, childIterate, childMove, childSum);
+    if (setSum != childSum) {
+        std::cerr << "Iterations differ" << std::endl;
+        return 1;
+    }
+
+    double children = (double)PASSES * CHILDREN;
+    double moved = (double)PASSES * MOVES * 2;
+    std::cout << "container\titerate (ns/child)\tmove (ns/child)" << std::endl;
+    std::cout << "std::set\t" << setIterate * 1e9 / children << "\t"
+              << setMove * 1e9 / moved << std::endl;
+    std::cout << "ChildSet\t" << childIterate * 1e9 / children << "\t"
+              << childMove * 1e9 / moved << std::endl;
+    return 0;
+}
@@ -0,0 +1,178 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "rulesets/ChildSet.h"
+
+#include <vector>
+
+#include <cassert>
+
+class LocatedEntity
+{
+  private:
+    ChildPosition m_childPosition;
+
+    template <typename> friend class ChildSet;
+};
+
+typedef ChildSet<LocatedEntity> LocatedEntitySet;
+
+static std::vector<LocatedEntity *> children(const LocatedEntitySet & set)
+{
+    return std::vector<LocatedEntity *>(set.begin(), set.end());
+}
+
+int main()
+{
+    LocatedEntity e[4];
+
+    {
+        LocatedEntitySet set;
+        assert(set.empty());
+        assert(set.size() == 0);
+        assert(set.find(&e[0]) == set.end());
+        assert(set.count(&e[0]) == 0);
+        assert(set.erase(&e[0]) == 0);
+    }
+
+    {
+        // Children are kept in the order they were added, once each
+        LocatedEntitySet set;
+        assert(set.insert(&e[2]).second);
+        assert(set.insert(&e[0]).second);
+        assert(set.insert(&e[1]).second);
+        assert(!set.insert(&e[0]).second);
+        assert(*set.insert(&e[0]).first == &e[0]);
+        assert(set.size() == 3);
+        assert(children(set) == std::vector<LocatedEntity *>({&e[2], &e[0], &e[1]}));
+        assert(set.find(&e[1]) != set.end() && *set.find(&e[1]) == &e[1]);
+        assert(set.count(&e[3]) == 0);
+    }
+
+    {
+        // Removing a child moves the last one into its place
+        LocatedEntitySet set;
+        for (LocatedEntity & child : e) {
+            set.insert(&child);
+        }
+        assert(set.erase(&e[1]) == 1);
+        assert(children(set) == std::vector<LocatedEntity *>({&e[0], &e[3], &e[2]}));
+        assert(set.count(&e[1]) == 0);
+        assert(set.count(&e[3]) == 1);
+        assert(set.erase(&e[1]) == 0);
+
+        // The moved child can still be found and removed by its position
+        assert(set.erase(&e[3]) == 1);
+        assert(children(set) == std::vector<LocatedEntity *>({&e[0], &e[2]}));
+        assert(set.erase(&e[2]) == 1);
+        assert(set.erase(&e[0]) == 1);
+        assert(set.empty());
+    }
+
+    {
+        // Moving a child from one set to another
+        LocatedEntitySet from, to;
+        from.insert(&e[0]);
+        from.insert(&e[1]);
+        to.insert(&e[2]);
+        from.erase(&e[0]);
+        assert(to.insert(&e[0]).second);
+        assert(from.count(&e[0]) == 0);
+        assert(to.count(&e[0]) == 1);
+        assert(children(to) == std::vector<LocatedEntity *>({&e[2], &e[0]}));
+        to.clear();
+        from.clear();
+    }
+
+    {
+        // The children of a destroyed entity are added to its parent while
+        // still in its own set, and are found in both.
+        LocatedEntitySet parent, destroyed;
+        parent.insert(&e[0]);
+        destroyed.insert(&e[1]);
+        destroyed.insert(&e[2]);
+        for (LocatedEntity * child : destroyed) {
+            parent.insert(child);
+        }
+        assert(children(parent) == std::vector<LocatedEntity *>({&e[0], &e[1], &e[2]}));
+        assert(destroyed.count(&e[1]) == 1);
+        assert(destroyed.count(&e[2]) == 1);
+        assert(destroyed.erase(&e[1]) == 1);
+        assert(children(destroyed) == std::vector<LocatedEntity *>({&e[2]}));
+        assert(parent.erase(&e[2]) == 1);
+        assert(children(parent) == std::vector<LocatedEntity *>({&e[0], &e[1]}));
+        assert(parent.erase(&e[1]) == 1);
+        assert(parent.erase(&e[0]) == 1);
+        destroyed.clear();
+    }
+
+    {
+        // Reparenting many children into a large set, as when destroying
+        // an entity, keeps every child where its position says.
+        const std::size_t large = 20000;
+        std::vector<LocatedEntity> many(2 * large);
+        LocatedEntitySet parent, destroyed;
+        for (std::size_t i = 0; i < large; ++i) {
+            parent.insert(&many[i]);
+            destroyed.insert(&many[large + i]);
+        }
+        for (LocatedEntity * child : destroyed) {
+            assert(parent.insert(child).second);
+        }
+        assert(parent.size() == 2 * large);
+        for (std::size_t i = 0; i < 2 * large; ++i) {
+            assert(*parent.find(&many[i]) == &many[i]);
+            assert(!parent.insert(&many[i]).second);
+        }
+        assert(parent.size() == 2 * large);
+
+        // Removing the original children keeps the reparented ones found
+        for (std::size_t i = 0; i < large; ++i) {
+            assert(parent.erase(&many[i]) == 1);
+        }
+        assert(parent.size() == large);
+        for (std::size_t i = large; i < 2 * large; ++i) {
+            assert(parent.count(&many[i]) == 1);
+        }
+        destroyed.clear();
+        parent.clear();
+    }
+
+    {
+        // Clearing a set leaves the children untouched, and they can be
+        // added again.
+        LocatedEntitySet set;
+        set.insert(&e[0]);
+        set.insert(&e[1]);
+        set.clear();
+        assert(set.empty());
+        assert(set.count(&e[1]) == 0);
+        assert(set.insert(&e[1]).second);
+        assert(!set.insert(&e[1]).second);
+        assert(set.size() == 1);
+    }
+
+    return 0;
+}
@@ -319,6 +319,7 @@ bool restricted_flag;
 #include "stubs/server/stubExternalMindsManager.h"
 #include "stubs/server/stubExternalMindsConnection.h"
 #include "stubs/common/stubOperationsDispatcher.h"
+#include "stubs/common/stubOpTimingWheel.h"
 #include "stubs/modules/stubDateTime.h"
 #include "stubs/modules/stubWorldTime.h"
 
@@ -560,6 +561,14 @@ Account * ServerRouting::getAccountByName(const std::string & username)
     return 0;
 }
 
+int ServerRouting::lookupAccountByName(const std::string & username,
+                                       Account *& account,
+                                       const sigc::slot<void, Account *> & done)
+{
+    account = 0;
+    return 0;
+}
+
 void ServerRouting::addAccount(Account * a)
 {
 }
@@ -781,7 +790,7 @@ PropertyBase * Entity::modProperty(const std::string & name)
 PropertyBase * Entity::setProperty(const std::string & name,
                                    PropertyBase * prop)
 {
-    return m_properties[name] = prop;
+    return insertProperty(name, prop);
 }
 
 void Entity::installDelegate(int class_no, const std::string & delegate)
@@ -303,6 +303,14 @@ Account * ServerRouting::getAccountByName(const std::string & username)
     return 0;
 }
 
+int ServerRouting::lookupAccountByName(const std::string & username,
+                                       Account *& account,
+                                       const sigc::slot<void, Account *> & done)
+{
+    account = 0;
+    return 0;
+}
+
 void ServerRouting::addAccount(Account * a)
 {
 }
@@ -404,6 +412,7 @@ void ExternalMind::linkUp(Link * c)
 #include "stubs/server/stubExternalMindsManager.h"
 #include "stubs/server/stubExternalMindsConnection.h"
 #include "stubs/common/stubOperationsDispatcher.h"
+#include "stubs/common/stubOpTimingWheel.h"
 
 Link::Link(CommSocket & socket, const std::string & id, long iid) :
             Router(id, iid), m_encoder(0), m_commSocket(socket)
@@ -726,6 +726,14 @@ Account * ServerRouting::getAccountByName(const std::string & username)
     return 0;
 }
 
+int ServerRouting::lookupAccountByName(const std::string & username,
+                                       Account *& account,
+                                       const sigc::slot<void, Account *> & done)
+{
+    account = 0;
+    return 0;
+}
+
 void ServerRouting::addAccount(Account * a)
 {
 }
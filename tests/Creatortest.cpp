@@ -319,6 +319,11 @@ std::vector<Atlas::Objects::Root> Character::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges Character::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
 
 long int Character::s_serialNumberNext = 0L;
 
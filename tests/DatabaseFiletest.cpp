@@ -0,0 +1,345 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "common/DatabaseFile.h"
+
+#include "common/const.h"
+#include "common/id.h"
+#include "common/compose.hpp"
+#include "common/log.h"
+
+#include <fstream>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <cassert>
+
+using Atlas::Message::ListType;
+using Atlas::Message::MapType;
+
+static const char * STORE_PATH = "DatabaseFiletest.store";
+
+static DatabaseFile * openStore()
+{
+    // Waiting for the disk would only slow the tests down.
+    DatabaseFile::install(STORE_PATH, false);
+    Database * db = Database::instance();
+    assert(db->initConnection() == 0);
+    assert(db->registerEntityIdGenerator() == 0);
+    assert(db->registerSchemaVersion() == 0);
+    std::map<std::string, int> chunks;
+    chunks["location"] = 0;
+    assert(db->registerEntityTable(chunks) == 0);
+    assert(db->registerPropertyTable() == 0);
+    assert(db->registerThoughtsTable() == 0);
+    assert(db->prepareStatements() == 0);
+    assert(db->initRule(true) == 0);
+    MapType tableDesc;
+    tableDesc["username"] = "                    ";
+    tableDesc["password"] = "                    ";
+    tableDesc["type"] = "          ";
+    assert(db->registerSimpleTable("accounts", tableDesc) == 0);
+    std::string relation;
+    assert(db->registerRelation(relation, "accounts", "entities") == 0);
+    assert(relation == "accounts_entities");
+    return static_cast<DatabaseFile *>(db);
+}
+
+static void closeStore()
+{
+    Database::instance()->shutdownConnection();
+    Database::cleanup();
+}
+
+static std::string encode(Database * db, const MapType & map)
+{
+    std::string data;
+    db->encodeWorldObject(map, data);
+    return data;
+}
+
+static MapType decode(Database * db, const char * data)
+{
+    MapType map;
+    assert(db->decodeMessage(data, map) == 0);
+    return map;
+}
+
+int main()
+{
+    std::remove(STORE_PATH);
+
+    MapType location;
+    location["pos"] = ListType{1.0, 2.0, 3.0};
+    std::string entity_id;
+    {
+        // A new file starts out with just the world
+        DatabaseFile * db = openStore();
+        assert(db->selectAllEntities().size() == 1);
+        assert(db->schemaVersion() == Database::SCHEMA_BINARY);
+
+        long int_id = db->newId(entity_id);
+        assert(int_id > 0);
+        assert(entity_id == String::compose("%1", int_id));
+
+        db->insertEntities({Database::EntityRow{entity_id, "0", "thing", 1,
+                                                encode(db, location)}});
+        db->insertProperties({Database::PropertyRow{entity_id, "mass",
+                encode(db, MapType{{"val", 10.0}})}});
+        db->replaceThoughts(entity_id,
+                {Database::ThoughtRow{"", encode(db, MapType{{"n", 1}})},
+                 Database::ThoughtRow{"", encode(db, MapType{{"n", 2}})}});
+        db->createSimpleRow("accounts", "100", "username, type, password",
+                            "'bob', 'player', 'it''s secret'");
+        db->createRelationRow("accounts_entities", "100", entity_id);
+        closeStore();
+    }
+
+    std::string second_id;
+    {
+        // Everything written is there after opening the file again
+        DatabaseFile * db = openStore();
+        DatabaseResult entities = db->selectEntities("0");
+        assert(entities.size() == 1);
+        assert(entities.field("id") == entity_id);
+        assert(entities.field("type") == std::string("thing"));
+        assert(entities.field("seq") == std::string("1"));
+        assert(decode(db, entities.field("location")) == location);
+
+        DatabaseResult properties = db->selectProperties(entity_id);
+        assert(properties.size() == 1);
+        assert(properties.field("name") == std::string("mass"));
+        assert(decode(db, properties.field("value"))["val"] == 10.0);
+
+        DatabaseResult thoughts = db->selectThoughts(entity_id);
+        assert(thoughts.size() == 2);
+        assert(decode(db, thoughts.field("thought", 0))["n"] == 1);
+        assert(decode(db, thoughts.field("thought", 1))["n"] == 2);
+
+        // Thoughts are changed one at a time
+        db->updateThoughts(entity_id,
+                {Database::ThoughtRow{"a", encode(db, MapType{{"n", 3}})},
+                 Database::ThoughtRow{"b", encode(db, MapType{{"n", 4}})},
+                 Database::ThoughtRow{"", encode(db, MapType{{"n", 5}})}},
+                {});
+        db->updateThoughts(entity_id,
+                {Database::ThoughtRow{"a", encode(db, MapType{{"n", 6}})}},
+                {"b"});
+        thoughts = db->selectThoughts(entity_id);
+        assert(thoughts.size() == 4);
+        assert(thoughts.field("tid", 0) == std::string("a"));
+        assert(decode(db, thoughts.field("thought", 0))["n"] == 6);
+        assert(decode(db, thoughts.field("thought", 1))["n"] == 1);
+        assert(decode(db, thoughts.field("thought", 3))["n"] == 5);
+        assert(*thoughts.field("tid", 3) == 0);
+
+        DatabaseResult account = db->selectSimpleRowBy("accounts", "username",
+                                                       "'bob'");
+        assert(account.size() == 1);
+        assert(account.field("id") == std::string("100"));
+        assert(account.field("password") == std::string("it's secret"));
+
+        DatabaseResult characters = db->selectRelation("accounts_entities",
+                                                       "100");
+        assert(characters.size() == 1);
+        assert(characters.field(0) == entity_id);
+
+        // Lookups which don't wait are answered straight away
+        int answered = 0;
+        db->selectSimpleRowByAsync("accounts", "username", "'bob'",
+                                   [&](const DatabaseResult & result) {
+            assert(!result.error());
+            assert(result.field("id") == std::string("100"));
+            ++answered;
+        });
+        db->selectRelationAsync("accounts_entities", "100",
+                                [&](const DatabaseResult & result) {
+            assert(result.size() == 1);
+            ++answered;
+        });
+        assert(answered == 2);
+
+        // Ids are not handed out again
+        assert(db->newId(second_id) > integerId(entity_id));
+
+        // Updates without a location keep it
+        db->updateEntities({Database::EntityRow{entity_id, "", "", 2,
+                                                encode(db, location)}});
+        db->updateSimpleRow("accounts", "username", "bob",
+                            "password = 'new'");
+        closeStore();
+    }
+
+    {
+        DatabaseFile * db = openStore();
+        DatabaseResult entities = db->selectAllEntities();
+        assert(entities.size() == 2);
+        assert(db->selectEntities("0").field("seq") == std::string("2"));
+        assert(db->selectSimpleRowBy("accounts", "username", "'bob'")
+                   .field("password") == std::string("new"));
+
+        // Dropping an entity drops its properties, thoughts and relations
+        db->dropEntity(integerId(entity_id));
+        assert(db->selectAllEntities().size() == 1);
+        assert(db->selectAllProperties().empty());
+        assert(db->selectAllThoughts().empty());
+        assert(db->selectRelation("accounts_entities", "100").empty());
+        closeStore();
+    }
+
+    {
+        // An incomplete record at the end is dropped
+        std::ofstream file(STORE_PATH, std::ios::out | std::ios::binary |
+                                       std::ios::app);
+        file.write("\x40\x00\x00\x00\x01", 5);
+        file.close();
+
+        DatabaseFile * db = openStore();
+        assert(db->selectAllEntities().size() == 1);
+        assert(db->selectSimpleRowBy("accounts", "username", "'bob'")
+                   .size() == 1);
+        assert(db->logSize() == db->liveSize());
+        closeStore();
+    }
+
+    {
+        // Rewriting the same rows compacts the file
+        DatabaseFile * db = openStore();
+        MapType value;
+        value["val"] = std::string(1000, 'x');
+        for (int i = 0; i < 5000; ++i) {
+            db->insertProperties({Database::PropertyRow{"0", "description",
+                                                        encode(db, value)}});
+        }
+        // Five megabytes have been written.
+        assert(db->logSize() < 2000000);
+        closeStore();
+
+        db = openStore();
+        DatabaseResult properties = db->selectProperties("0");
+        assert(properties.size() == 1);
+        assert(decode(db, properties.field("value")) == value);
+        closeStore();
+    }
+
+    {
+        // A large file is compacted a step at a time, keeping changes
+        // made meanwhile
+        DatabaseFile * db = openStore();
+        MapType value;
+        value["val"] = std::string(1000, 'x');
+        std::string data = encode(db, value);
+        for (int i = 1; i <= 3000; ++i) {
+            db->insertProperties({Database::PropertyRow{
+                    std::to_string(i), "description", data}});
+        }
+        int writes = 0;
+        while (!db->compacting()) {
+            db->insertProperties({Database::PropertyRow{"0", "description",
+                                                        data}});
+            assert(++writes < 10000);
+        }
+        MapType changed;
+        changed["val"] = std::string("changed");
+        db->insertProperties({Database::PropertyRow{"1", "description",
+                                                    encode(db, changed)}});
+        db->insertProperties({Database::PropertyRow{"3000", "description",
+                                                    encode(db, changed)}});
+        assert(db->compacting());
+        writes = 0;
+        while (db->compacting()) {
+            db->insertProperties({Database::PropertyRow{"0", "description",
+                                                        data}});
+            ++writes;
+        }
+        assert(writes > 1);
+        assert(db->logSize() < 2 * db->liveSize());
+        closeStore();
+
+        db = openStore();
+        assert(db->selectAllProperties().size() == 3001);
+        assert(decode(db, db->selectProperties("1").field("value")) ==
+               changed);
+        assert(decode(db, db->selectProperties("3000").field("value")) ==
+               changed);
+        assert(decode(db, db->selectProperties("2").field("value")) == value);
+        closeStore();
+    }
+
+    std::remove(STORE_PATH);
+
+    return 0;
+}
+
+// stubs
+
+const char * CYPHESIS = "cyphesis";
+std::string instance("test_instance");
+
+namespace consts {
+  const long rootWorldIntId = 0L;
+}
+
+void log(LogLevel lvl, const std::string & msg)
+{
+}
+
+void log_formatted(LogLevel lvl, const std::string & msg)
+{
+}
+
+long integerId(const std::string & id)
+{
+    long intId = strtol(id.c_str(), 0, 10);
+    if (intId == 0 && id != "0") {
+        intId = -1L;
+    }
+
+    return intId;
+}
+
+long forceIntegerId(const std::string & id)
+{
+    long intId = strtol(id.c_str(), 0, 10);
+    if (intId == 0 && id != "0") {
+        log(CRITICAL, String::compose("Unable to convert ID \"%1\" to an integer", id));
+        abort();
+    }
+
+    return intId;
+}
+
+template <typename T>
+int readConfigItem(const std::string & section, const std::string & key, T & storage)
+{
+    return -1;
+}
+
+template<>
+int readConfigItem<std::string>(const std::string & section, const std::string & key, std::string & storage)
+{
+    return -1;
+}
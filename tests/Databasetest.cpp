@@ -25,6 +25,7 @@
 
 #include "common/Database.h"
 
+#include "common/BinaryMessage.h"
 #include "common/const.h"
 #include "common/compose.hpp"
 #include "common/log.h"
@@ -33,8 +34,248 @@
 
 #include <cassert>
 
+/// \brief Database which pretends to be connected, with a write in flight,
+/// so that queueing can be checked without a server.
+class TestDatabase : public Database {
+  public:
+    /// Number of times ids were fetched on their own, waiting for them.
+    int m_fetches;
+    /// Number of commands queued when ids were last fetched.
+    size_t m_queuedAtFetch;
+
+    TestDatabase() : m_fetches(0), m_queuedAtFetch(0) {
+        m_connection = reinterpret_cast<PGconn *>(this);
+        m_queryInProgress = true;
+        m_queriesInFlight = 1;
+        pendingQueries.push_back(DatabaseQuery{"in flight", PGRES_COMMAND_OK,
+                                               false});
+    }
+
+    ~TestDatabase() {
+        m_connection = 0;
+        pendingQueries.clear();
+    }
+
+    void reserve(long first, long count) {
+        for (long id = first; id < first + count; ++id) {
+            m_reservedIds.push_back(id);
+        }
+    }
+
+    const QueryQue & queue() const { return pendingQueries; }
+
+    /// \brief Finish the commands in flight, as if their results had
+    /// arrived. A request for ids among them reserves 100 onwards.
+    virtual int clearPendingQuery() {
+        for (size_t i = 0; i < m_queriesInFlight; ++i) {
+            if (pendingQueries[i].query.find("nextval") != std::string::npos) {
+                m_idRequestPending = false;
+                reserve(100, m_idBlockSize);
+            }
+        }
+        pendingQueries.erase(pendingQueries.begin(),
+                             pendingQueries.begin() + m_queriesInFlight);
+        m_queriesInFlight = 0;
+        return 0;
+    }
+
+    /// \brief Reserves 200 onwards.
+    virtual int fetchIds() {
+        ++m_fetches;
+        m_queuedAtFetch = pendingQueries.size();
+        reserve(200, m_idBlockSize);
+        return 0;
+    }
+
+    /// \brief Send what's next in the queue, as launchNewQuery() would.
+    void sendNext() {
+        clearPendingQuery();
+        m_queriesInFlight = nextBatchSize();
+    }
+
+    /// \brief Drop what would be sent in the next round trip.
+    /// @return The number of commands dropped.
+    size_t sendBatch() {
+        if (m_queriesInFlight != 0) {
+            // The command in flight is done.
+            pendingQueries.pop_front();
+            m_queriesInFlight = 0;
+        }
+        size_t count = nextBatchSize();
+        pendingQueries.erase(pendingQueries.begin(),
+                             pendingQueries.begin() + count);
+        return count;
+    }
+};
+
+/// \brief Database which connects without a server, and counts how often
+/// the write statements are prepared.
+class ReconnectDatabase : public Database {
+  public:
+    int m_prepared;
+    int m_prepareResult;
+
+    ReconnectDatabase() : m_prepared(0), m_prepareResult(0) { }
+
+    virtual int connect(const std::string & context, std::string & error_msg) {
+        return 0;
+    }
+
+    virtual int prepareStatements() {
+        ++m_prepared;
+        if (m_prepareResult == 0) {
+            m_statementsPrepared = true;
+        }
+        return m_prepareResult;
+    }
+};
+
 int main()
 {
+    {
+        // Requests for more ids go ahead of the writes waiting to be sent,
+        // behind only the commands in flight.
+        TestDatabase db;
+        db.setIdBlockSize(4);
+        db.reserve(1, 4);
+        for (int i = 0; i < 10; ++i) {
+            db.scheduleCommand(String::compose("write %1", i));
+        }
+        assert(db.queryQueueSize() == 11);
+
+        std::string id;
+        assert(db.newId(id) == 1);
+        assert(id == "1");
+        assert(db.queryQueueSize() == 11);
+        assert(db.newId(id) == 2);
+        assert(db.queryQueueSize() == 12);
+        assert(db.queue()[0].query == "in flight");
+        assert(db.queue()[1].query.find("nextval") != std::string::npos);
+        assert(db.queue()[2].query == "write 0");
+        assert(db.queue().back().query == "write 9");
+
+        // Only one request is queued while it's outstanding.
+        assert(db.newId(id) == 3);
+        assert(db.newId(id) == 4);
+        assert(db.queryQueueSize() == 12);
+    }
+
+    {
+        // When the ids run out before a request for more has been sent,
+        // only the commands in flight are waited for. The request is
+        // replaced by one sent on its own, and the queued writes stay.
+        TestDatabase db;
+        db.setIdBlockSize(4);
+        db.reserve(1, 2);
+        for (int i = 0; i < 10; ++i) {
+            db.scheduleCommand(String::compose("write %1", i));
+        }
+        std::string id;
+        assert(db.newId(id) == 1);
+        assert(db.queryQueueSize() == 12);
+        assert(db.newId(id) == 2);
+        assert(db.newId(id) == 200);
+        assert(db.m_fetches == 1);
+        assert(db.m_queuedAtFetch == 10);
+        assert(db.queryQueueSize() == 10);
+        assert(db.queue().front().query == "write 0");
+        assert(db.queue().back().query == "write 9");
+
+        // The next request is queued as usual
+        assert(db.newId(id) == 201);
+        assert(db.newId(id) == 202);
+        assert(db.queryQueueSize() == 11);
+        assert(db.queue().front().query.find("nextval") != std::string::npos);
+    }
+
+    {
+        // A request for ids in flight is waited for, and nothing more
+        TestDatabase db;
+        db.setIdBlockSize(4);
+        db.reserve(1, 1);
+        for (int i = 0; i < 10; ++i) {
+            db.scheduleCommand(String::compose("write %1", i));
+        }
+        std::string id;
+        assert(db.newId(id) == 1);
+        db.sendNext();
+        assert(db.queue().front().query.find("nextval") != std::string::npos);
+        assert(db.newId(id) == 100);
+        assert(db.m_fetches == 0);
+        assert(db.queryQueueSize() == 10);
+    }
+
+    {
+        // Prepared statements are sent together in pipeline mode, where
+        // libpq supports it, but never together with other commands.
+        TestDatabase db;
+        db.insertEntity("1", "0", "thing", 0, "");
+        db.updateEntity("2", 1, "", "0");
+        db.scheduleCommand("write 0");
+        db.scheduleCommand("write 1");
+        db.dropEntity(3);
+        assert(db.queryQueueSize() == 6);
+#ifdef LIBPQ_HAS_PIPELINING
+        assert(!db.queue()[1].standalone);
+        assert(db.sendBatch() == 2);
+        assert(db.queue().front().query == "write 0");
+        assert(db.sendBatch() == 2);
+        assert(db.sendBatch() == 1);
+#else
+        assert(db.queue()[1].standalone);
+        assert(db.sendBatch() == 1);
+        assert(db.sendBatch() == 1);
+        assert(db.sendBatch() == 2);
+        assert(db.sendBatch() == 1);
+#endif
+        assert(db.queryQueueSize() == 0);
+    }
+
+    {
+        // Prepared statements only last as long as the connection, so
+        // they are prepared again when reconnecting.
+        ReconnectDatabase db;
+        assert(db.initConnection() == 0);
+        assert(db.m_prepared == 0);
+        assert(db.prepareStatements() == 0);
+        assert(db.m_prepared == 1);
+
+        // As done by CommPSQLSocket when the connection is lost.
+        assert(db.initConnection() == 0);
+        assert(db.m_prepared == 2);
+
+        // The connection isn't used if they can't be.
+        db.m_prepareResult = -1;
+        assert(db.initConnection() == -1);
+        assert(db.m_prepared == 3);
+    }
+
+    {
+        // Values fetched in binary format are decoded without being
+        // copied, even if they contain null bytes, and escaped values
+        // are still understood.
+        Atlas::Message::MapType msg{{"val", 0}, {"name", "thing"}};
+        std::string data;
+        BinaryMessage::encode(msg, data);
+        assert(data.find('\0') != std::string::npos);
+
+        Atlas::Message::MapType decoded;
+        assert(Database::instance()->decodeMessage(data.data(), data.size(),
+                                                   decoded) == 0);
+        assert(decoded == msg);
+
+        std::string escaped("\\x");
+        for (unsigned char c : data) {
+            escaped += "0123456789abcdef"[c >> 4];
+            escaped += "0123456789abcdef"[c & 0xf];
+        }
+        decoded.clear();
+        assert(Database::instance()->decodeMessage(escaped, decoded) == 0);
+        assert(decoded == msg);
+
+        Database::cleanup();
+    }
+
     {
         assert(Database::instance() != 0);
 
@@ -617,6 +617,11 @@ std::vector<Atlas::Objects::Root> LocatedEntity::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges LocatedEntity::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
 
 void log(LogLevel lvl, const std::string & msg)
 {
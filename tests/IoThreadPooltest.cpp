@@ -0,0 +1,104 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "server/IoThreadPool.h"
+
+#include <atomic>
+#include <vector>
+
+#include <cassert>
+
+int main()
+{
+    {
+        boost::asio::io_service world;
+        IoThreadPool pool(3, world);
+        assert(pool.size() == 3);
+    }
+
+    {
+        // Handlers of the pool run in its threads, and handlers posted to
+        // the world run in the thread running the world io_service
+        boost::asio::io_service world;
+        boost::asio::io_service::work work(world);
+        IoThreadPool pool(2, world);
+        std::thread::id main = std::this_thread::get_id();
+        std::atomic<bool> ranInPool(false);
+        bool ranInWorld = false;
+        pool.getIoService().post([&]() {
+            assert(std::this_thread::get_id() != main);
+            ranInPool = true;
+            pool.postToWorld([&]() {
+                assert(std::this_thread::get_id() == main);
+                ranInWorld = true;
+            });
+        });
+        while (!ranInWorld) {
+            world.run_one();
+        }
+        assert(ranInPool);
+    }
+
+    {
+        // Everything posted to the world is run once, in order for each
+        // posting thread
+        boost::asio::io_service world;
+        boost::asio::io_service::work work(world);
+        IoThreadPool pool(1, world);
+        const int producers = 4;
+        const int count = 10000;
+        std::vector<int> next(producers, 0);
+        int received = 0;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p]() {
+                for (int i = 0; i < count; ++i) {
+                    pool.postToWorld([&, p, i]() {
+                        assert(next[p] == i);
+                        ++next[p];
+                        ++received;
+                    });
+                }
+            });
+        }
+        while (received < producers * count) {
+            world.run_one();
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        assert(world.poll() == 0);
+    }
+
+    return 0;
+}
+
+// stubs
+
+#include "common/log.h"
+
+void log(LogLevel lvl, const std::string & msg)
+{
+}
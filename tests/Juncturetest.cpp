@@ -636,6 +636,10 @@ void Link::disconnect()
 {
 }
 
+#include "stubs/common/stubMonitors.h"
+#include "stubs/server/stubIoThreadPool.h"
+#include "stubs/server/stubBroadcastCache.h"
+
 Router::Router(const std::string & id, long intId) : m_id(id),
                                                              m_intId(intId)
 {
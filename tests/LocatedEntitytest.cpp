@@ -50,6 +50,7 @@ class LocatedEntitytest : public Cyphesis::TestBase
 
     void test_setProperty();
     void test_removeAttr();
+    void test_propertySlots();
     void test_coverage();
 
     class TestProperty : public PropertyBase
@@ -94,6 +95,7 @@ LocatedEntitytest::LocatedEntitytest()
 {
     ADD_TEST(LocatedEntitytest::test_setProperty);
     ADD_TEST(LocatedEntitytest::test_removeAttr);
+    ADD_TEST(LocatedEntitytest::test_propertySlots);
     ADD_TEST(LocatedEntitytest::test_coverage);
 }
 
@@ -137,6 +139,35 @@ void LocatedEntitytest::test_removeAttr()
     ASSERT_TRUE(m_TestProperty_remove_called);
 }
 
+void LocatedEntitytest::test_propertySlots()
+{
+    ASSERT_NULL(m_entity->getPropertyClass<ModeSlot>());
+
+    // Installing a property is seen by a slot already resolved
+    PropertyBase * mode = m_entity->setAttr("mode", "standing");
+    ASSERT_EQUAL(m_entity->getPropertyClass<ModeSlot>(), mode);
+    ASSERT_EQUAL(m_entity->modPropertyClass<ModeSlot>(), mode);
+
+    PropertyBase * new_mode = new SoftProperty;
+    m_entity->setProperty("mode", new_mode);
+    ASSERT_EQUAL(m_entity->getPropertyClass<ModeSlot>(), new_mode);
+
+    // A property of the wrong class isn't returned
+    m_entity->setAttr("mass", 1.);
+    ASSERT_NULL(m_entity->getPropertyClass<MassSlot>());
+
+    // Slots resolved before a type changed are no longer resolved, and
+    // are cleared once another slot is resolved
+    PropertySlotCache cache;
+    cache.set(PropertySlots::MODE, mode);
+    ASSERT_TRUE(cache.isResolved(PropertySlots::MODE));
+    ++PropertySlots::typeGeneration();
+    ASSERT_TRUE(!cache.isResolved(PropertySlots::MODE));
+    cache.set(PropertySlots::MASS, 0);
+    ASSERT_TRUE(cache.isResolved(PropertySlots::MASS));
+    ASSERT_TRUE(!cache.isResolved(PropertySlots::MODE));
+}
+
 void LocatedEntitytest::test_coverage()
 {
     m_entity->setScript(new Script());
@@ -518,6 +518,11 @@ std::vector<Atlas::Objects::Root> LocatedEntity::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges LocatedEntity::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
 #include "stubs/common/stubRouter.h"
 #include "stubs/modules/stubLocation.h"
 #include "stubs/common/stubTypeNode.h"
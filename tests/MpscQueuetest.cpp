@@ -0,0 +1,101 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "common/MpscQueue.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <cassert>
+
+int main()
+{
+    {
+        MpscQueue<int> queue;
+        int value = -1;
+        assert(!queue.pop(value));
+        assert(value == -1);
+    }
+
+    {
+        // Values come out in the order they were pushed
+        MpscQueue<int> queue;
+        for (int i = 0; i < 100; ++i) {
+            queue.push(i);
+        }
+        int value;
+        for (int i = 0; i < 100; ++i) {
+            assert(queue.pop(value));
+            assert(value == i);
+        }
+        assert(!queue.pop(value));
+    }
+
+    {
+        // Values which are left are destroyed with the queue
+        auto shared = std::make_shared<int>(1);
+        {
+            MpscQueue<std::shared_ptr<int>> queue;
+            queue.push(shared);
+            queue.push(shared);
+            assert(shared.use_count() == 3);
+        }
+        assert(shared.use_count() == 1);
+    }
+
+    {
+        // Every value pushed from many threads comes out once, and in
+        // order for each thread
+        const int producers = 4;
+        const int count = 100000;
+        MpscQueue<std::pair<int, int>> queue;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&queue, p, count]() {
+                for (int i = 0; i < count; ++i) {
+                    queue.push(std::make_pair(p, i));
+                }
+            });
+        }
+
+        std::vector<int> next(producers, 0);
+        int received = 0;
+        std::pair<int, int> value;
+        while (received < producers * count) {
+            if (queue.pop(value)) {
+                assert(value.second == next[value.first]);
+                ++next[value.first];
+                ++received;
+            }
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        assert(!queue.pop(value));
+    }
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Compares finding the observers of a perception broadcast by checking
+// the distance to every perceptive entity, as WorldRouter does without an
+// index, with looking them up in the observer grid of PhysicalDomain.
+// Between broadcasts a part of the entities move, which is what keeps
+// the index busy in a running world. The linear scan only calculates the
+// distance, so it's a lower bound of the real cost, which also includes
+// walking the location hierarchy of each entity.
+
+#include "rulesets/ObserverGrid.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+class LocatedEntity
+{
+};
+
+struct Observer {
+    LocatedEntity entity;
+    float x;
+    float y;
+};
+
+/// Size of the world, in meters along each side.
+static const float WORLD_SIZE = 4000.f;
+/// The distance from which a character sized entity can be seen.
+static const float SIGHT_RADIUS = 58.f;
+static const int BROADCASTS = 20000;
+/// Number of entities moving between each broadcast.
+static const int MOVES = 2;
+
+static double elapsed(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    std::cout << "perceptives\tmethod\tbroadcast (ns)\tobservers found"
+              << std::endl;
+    for (std::size_t count : {1000, 10000, 50000}) {
+        std::mt19937 generator(4711);
+        std::uniform_real_distribution<float> position(0.f, WORLD_SIZE);
+        std::uniform_real_distribution<float> step(-2.f, 2.f);
+        std::uniform_int_distribution<std::size_t> pick(0, count - 1);
+
+        std::vector<Observer> observers(count);
+        for (auto& observer : observers) {
+            observer.x = position(generator);
+            observer.y = position(generator);
+        }
+        std::vector<std::size_t> broadcasters(BROADCASTS);
+        std::vector<std::size_t> movers(BROADCASTS * MOVES);
+        std::vector<float> steps(BROADCASTS * MOVES * 2);
+        for (auto& b : broadcasters) {
+            b = pick(generator);
+        }
+        for (auto& m : movers) {
+            m = pick(generator);
+        }
+        for (auto& s : steps) {
+            s = step(generator);
+        }
+
+        const float squareRadius = SIGHT_RADIUS * SIGHT_RADIUS;
+
+        {
+            auto state = observers;
+            std::size_t found = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < BROADCASTS; ++i) {
+                for (int j = 0; j < MOVES; ++j) {
+                    Observer & mover = state[movers[i * MOVES + j]];
+                    mover.x += steps[(i * MOVES + j) * 2];
+                    mover.y += steps[(i * MOVES + j) * 2 + 1];
+                }
+                const Observer & from = state[broadcasters[i]];
+                for (auto& observer : state) {
+                    float dx = observer.x - from.x, dy = observer.y - from.y;
+                    if (dx * dx + dy * dy < squareRadius) {
+                        ++found;
+                    }
+                }
+            }
+            double time = elapsed(start);
+            std::cout << count << "\tlinear\t" << time * 1e9 / BROADCASTS
+                      << "\t" << found << std::endl;
+        }
+
+        {
+            auto state = observers;
+            ObserverGrid grid(64.f);
+            for (auto& observer : state) {
+                grid.update(&observer.entity, observer.x, observer.y);
+            }
+            std::vector<const LocatedEntity *> candidates;
+            std::size_t found = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < BROADCASTS; ++i) {
+                for (int j = 0; j < MOVES; ++j) {
+                    Observer & mover = state[movers[i * MOVES + j]];
+                    mover.x += steps[(i * MOVES + j) * 2];
+                    mover.y += steps[(i * MOVES + j) * 2 + 1];
+                    grid.update(&mover.entity, mover.x, mover.y);
+                }
+                const Observer & from = state[broadcasters[i]];
+                candidates.clear();
+                grid.query(from.x, from.y, SIGHT_RADIUS, candidates);
+                for (auto candidate : candidates) {
+                    // The exact check done on every candidate.
+                    const Observer & observer =
+                          *reinterpret_cast<const Observer *>(candidate);
+                    float dx = observer.x - from.x, dy = observer.y - from.y;
+                    if (dx * dx + dy * dy < squareRadius) {
+                        ++found;
+                    }
+                }
+            }
+            double time = elapsed(start);
+            std::cout << count << "\tgrid\t" << time * 1e9 / BROADCASTS
+                      << "\t" << found << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "rulesets/ObserverGrid.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <cassert>
+
+class LocatedEntity
+{
+};
+
+static std::vector<const LocatedEntity *> query(const ObserverGrid & grid,
+                                                float x, float y, float radius)
+{
+    std::vector<const LocatedEntity *> result;
+    grid.query(x, y, radius, result);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+int main()
+{
+    LocatedEntity e[4];
+
+    {
+        ObserverGrid grid(10.f);
+        assert(grid.empty());
+        assert(query(grid, 0.f, 0.f, 1000.f).empty());
+    }
+
+    {
+        // Only entities within the radius are found
+        ObserverGrid grid(10.f);
+        grid.update(&e[0], 0.f, 0.f);
+        grid.update(&e[1], 5.f, 5.f);
+        grid.update(&e[2], 25.f, 0.f);
+        grid.update(&e[3], -100.f, -100.f);
+        assert(grid.size() == 4);
+        assert(grid.contains(&e[3]));
+
+        auto result = query(grid, 0.f, 0.f, 10.f);
+        assert(result.size() == 2);
+        assert(result[0] == &e[0]);
+        assert(result[1] == &e[1]);
+
+        result = query(grid, 20.f, 0.f, 6.f);
+        assert(result.size() == 1);
+        assert(result[0] == &e[2]);
+
+        // Big enough to cover every cell
+        assert(query(grid, 0.f, 0.f, 1000.f).size() == 4);
+    }
+
+    {
+        // Moving an entity moves it between cells
+        ObserverGrid grid(10.f);
+        grid.update(&e[0], 0.f, 0.f);
+        grid.update(&e[1], 1.f, 1.f);
+        grid.update(&e[0], 100.f, 100.f);
+        assert(grid.size() == 2);
+
+        auto result = query(grid, 0.f, 0.f, 5.f);
+        assert(result.size() == 1);
+        assert(result[0] == &e[1]);
+
+        result = query(grid, 100.f, 100.f, 5.f);
+        assert(result.size() == 1);
+        assert(result[0] == &e[0]);
+
+        // Moving within a cell updates the position
+        grid.update(&e[0], 105.f, 105.f);
+        assert(query(grid, 100.f, 100.f, 1.f).empty());
+        assert(query(grid, 105.f, 105.f, 1.f).size() == 1);
+    }
+
+    {
+        // Removing keeps the other entities of the cell intact
+        ObserverGrid grid(10.f);
+        grid.update(&e[0], 1.f, 1.f);
+        grid.update(&e[1], 2.f, 2.f);
+        grid.update(&e[2], 3.f, 3.f);
+        assert(grid.remove(&e[0]));
+        assert(!grid.remove(&e[0]));
+        assert(!grid.contains(&e[0]));
+
+        auto result = query(grid, 0.f, 0.f, 10.f);
+        assert(result.size() == 2);
+        assert(result[0] == &e[1]);
+        assert(result[1] == &e[2]);
+
+        assert(grid.remove(&e[2]));
+        assert(grid.remove(&e[1]));
+        assert(grid.empty());
+        assert(query(grid, 0.f, 0.f, 10.f).empty());
+    }
+
+    {
+        // Huge coordinates don't overflow
+        ObserverGrid grid(10.f);
+        grid.update(&e[0], 1e30f, -1e30f);
+        assert(query(grid, 1e30f, -1e30f, 1.f).size() == 1);
+        assert(query(grid, 0.f, 0.f, 1e38f).size() == 1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Compares the priority queue and the timing wheel as schedulers for
+// future operations. Each run keeps a fixed number of operations pending,
+// and re-schedules every dispatched operation, the way Tick ops from
+// plants and characters behave in a running world.
+
+#include "common/OpTimingWheel.h"
+
+#include <Atlas/Objects/RootOperation.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+class LocatedEntity
+{
+};
+
+static const double ROUND_LENGTH = 0.01;
+static const int ROUNDS = 2000;
+
+struct Result {
+    double insert;
+    double dispatch;
+    size_t dispatched;
+};
+
+static double elapsed(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Operation makeOp(double seconds)
+{
+    Atlas::Objects::Operation::RootOperation op;
+    op->setSeconds(seconds);
+    return op;
+}
+
+static Result runHeap(const std::vector<double> & delays)
+{
+    LocatedEntity ent;
+    OpPriorityQueue queue;
+    Result result{0, 0, 0};
+
+    auto start = std::chrono::steady_clock::now();
+    for (double delay : delays) {
+        queue.push(OpQueEntry(makeOp(delay), ent));
+    }
+    result.insert = elapsed(start);
+
+    size_t next = 0;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        double now = round * ROUND_LENGTH;
+        while (!queue.empty() && queue.top()->getSeconds() <= now) {
+            OpQueEntry entry = queue.top();
+            queue.pop();
+            entry->setSeconds(now + delays[next++ % delays.size()]);
+            queue.push(entry);
+            ++result.dispatched;
+        }
+    }
+    result.dispatch = elapsed(start);
+    return result;
+}
+
+static Result runWheel(const std::vector<double> & delays)
+{
+    LocatedEntity ent;
+    OpTimingWheel wheel(0.01, 0.);
+    Result result{0, 0, 0};
+
+    auto start = std::chrono::steady_clock::now();
+    for (double delay : delays) {
+        wheel.push(OpQueEntry(makeOp(delay), ent));
+    }
+    result.insert = elapsed(start);
+
+    size_t next = 0;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        double now = round * ROUND_LENGTH;
+        wheel.advance(now);
+        while (wheel.isDue(now)) {
+            OpQueEntry entry = wheel.pop();
+            entry->setSeconds(now + delays[next++ % delays.size()]);
+            wheel.push(entry);
+            ++result.dispatched;
+        }
+    }
+    result.dispatch = elapsed(start);
+    return result;
+}
+
+int main()
+{
+    std::mt19937 generator(4711);
+    // Most ticks are a few seconds away, some are minutes away.
+    std::exponential_distribution<double> distribution(1. / 30.);
+
+    std::cout << "pending\tscheduler\tinsert (ns/op)\tdispatch (ns/op)"
+              << std::endl;
+    for (size_t count : {10000, 100000, 1000000}) {
+        std::vector<double> delays(count);
+        for (auto& delay : delays) {
+            delay = distribution(generator);
+        }
+        Result heap = runHeap(delays);
+        Result wheel = runWheel(delays);
+        std::cout << count << "\theap\t" << heap.insert * 1e9 / count
+                  << "\t" << heap.dispatch * 1e9 / heap.dispatched
+                  << std::endl;
+        std::cout << count << "\twheel\t" << wheel.insert * 1e9 / count
+                  << "\t" << wheel.dispatch * 1e9 / wheel.dispatched
+                  << std::endl;
+    }
+    return 0;
+}
+
+// stubs
+
+OpQueEntry::OpQueEntry(const Operation & o, LocatedEntity & f) : op(o),
+                                                                 from(&f)
+{
+}
+
+OpQueEntry::OpQueEntry(const OpQueEntry & o) : op(o.op), from(o.from),
+                                               handle(o.handle)
+{
+}
+
+OpQueEntry::OpQueEntry(OpQueEntry && o) : op(std::move(o.op)), from(o.from),
+                                          handle(std::move(o.handle))
+{
+}
+
+OpQueEntry::~OpQueEntry()
+{
+}
+
+OpQueEntry & OpQueEntry::operator=(const OpQueEntry & o)
+{
+    op = o.op;
+    from = o.from;
+    handle = o.handle;
+    return *this;
+}
+
+OpQueEntry & OpQueEntry::operator=(OpQueEntry && o)
+{
+    op = std::move(o.op);
+    from = o.from;
+    handle = std::move(o.handle);
+    return *this;
+}
@@ -0,0 +1,213 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "common/OpTimingWheel.h"
+
+#include <Atlas/Objects/RootOperation.h>
+
+#include <vector>
+
+#include <cassert>
+
+class LocatedEntity
+{
+};
+
+static Operation makeOp(double seconds)
+{
+    Atlas::Objects::Operation::RootOperation op;
+    op->setSeconds(seconds);
+    return op;
+}
+
+/// Advances the wheel and pops all ops which are due.
+static std::vector<double> popDue(OpTimingWheel & wheel, double time)
+{
+    std::vector<double> result;
+    wheel.advance(time);
+    while (wheel.isDue(time)) {
+        result.push_back(wheel.pop()->getSeconds());
+    }
+    return result;
+}
+
+int main()
+{
+    LocatedEntity ent;
+
+    {
+        OpTimingWheel wheel(0.01, 0.);
+        assert(wheel.empty());
+        assert(wheel.size() == 0);
+    }
+
+    {
+        // Ops in the lowest wheel come out in order, and only when due
+        OpTimingWheel wheel(0.01, 0.);
+        wheel.push(OpQueEntry(makeOp(1.0), ent));
+        wheel.push(OpQueEntry(makeOp(0.5), ent));
+        wheel.push(OpQueEntry(makeOp(0.505), ent));
+        assert(wheel.size() == 3);
+        assert(wheel.nextOpTime() == 0.5);
+
+        assert(popDue(wheel, 0.4).empty());
+        auto due = popDue(wheel, 0.502);
+        assert(due.size() == 1);
+        assert(due[0] == 0.5);
+
+        due = popDue(wheel, 2.0);
+        assert(due.size() == 2);
+        assert(due[0] == 0.505);
+        assert(due[1] == 1.0);
+        assert(wheel.empty());
+    }
+
+    {
+        // Ops are cascaded from the higher wheels in order
+        OpTimingWheel wheel(0.01, 0.);
+        std::vector<double> times{3600., 5., 60., 0.1, 86400., 59.999, 7200.};
+        for (double time : times) {
+            wheel.push(OpQueEntry(makeOp(time), ent));
+        }
+        // The next time is never later than the actual time
+        assert(wheel.nextOpTime() <= 0.1);
+
+        std::vector<double> result;
+        for (double time = 0.; time < 90000.; time += 0.7) {
+            for (double t : popDue(wheel, time)) {
+                assert(t <= time);
+                result.push_back(t);
+            }
+            assert(wheel.empty() || wheel.nextOpTime() > time);
+        }
+        assert(result.size() == times.size());
+        for (size_t i = 1; i < result.size(); ++i) {
+            assert(result[i - 1] <= result[i]);
+        }
+    }
+
+    {
+        // Ops too far in the future for the wheels are held in overflow
+        OpTimingWheel wheel(0.0001, 0.);
+        wheel.push(OpQueEntry(makeOp(1000000.), ent));
+        wheel.push(OpQueEntry(makeOp(10.), ent));
+        assert(wheel.size() == 2);
+
+        auto due = popDue(wheel, 500000.);
+        assert(due.size() == 1);
+        assert(wheel.size() == 1);
+        assert(wheel.nextOpTime() <= 1000000.);
+
+        due = popDue(wheel, 1000000.);
+        assert(due.size() == 1);
+        assert(due[0] == 1000000.);
+        assert(wheel.empty());
+    }
+
+    {
+        // Ops in the past are due immediately
+        OpTimingWheel wheel(0.01, 100.);
+        popDue(wheel, 200.);
+        wheel.push(OpQueEntry(makeOp(150.), ent));
+        assert(wheel.isDue(200.));
+        assert(wheel.nextOpTime() == 150.);
+        assert(popDue(wheel, 200.).size() == 1);
+    }
+
+    {
+        // Clearing removes everything
+        OpTimingWheel wheel(0.01, 0.);
+        wheel.push(OpQueEntry(makeOp(1.), ent));
+        wheel.push(OpQueEntry(makeOp(100.), ent));
+        wheel.clear();
+        assert(wheel.empty());
+        assert(popDue(wheel, 200.).empty());
+    }
+
+    {
+        // Cancelled ops are removed from every part of the wheel
+        OpTimingWheel wheel(0.01, 0.);
+        std::vector<OpHandle> handles;
+        for (double time : {0.5, 0.6, 100., 200., 1000000.}) {
+            OpQueEntry entry(makeOp(time), ent);
+            entry.handle = OpHandle::create();
+            handles.push_back(entry.handle);
+            wheel.push(std::move(entry));
+        }
+        wheel.advance(0.55);
+        assert(wheel.size() == 5);
+
+        handles[0].dequeue();
+        handles[2].dequeue();
+        handles[4].dequeue();
+        assert(wheel.removeCancelled() == 3);
+        assert(wheel.size() == 2);
+
+        auto due = popDue(wheel, 1000.);
+        assert(due.size() == 2);
+        assert(due[0] == 0.6);
+        assert(due[1] == 200.);
+        assert(wheel.empty());
+    }
+
+    return 0;
+}
+
+// stubs
+
+OpQueEntry::OpQueEntry(const Operation & o, LocatedEntity & f) : op(o),
+                                                                 from(&f)
+{
+}
+
+OpQueEntry::OpQueEntry(const OpQueEntry & o) : op(o.op), from(o.from),
+                                               handle(o.handle)
+{
+}
+
+OpQueEntry::OpQueEntry(OpQueEntry && o) : op(std::move(o.op)), from(o.from),
+                                          handle(std::move(o.handle))
+{
+}
+
+OpQueEntry::~OpQueEntry()
+{
+}
+
+OpQueEntry & OpQueEntry::operator=(const OpQueEntry & o)
+{
+    op = o.op;
+    from = o.from;
+    handle = o.handle;
+    return *this;
+}
+
+OpQueEntry & OpQueEntry::operator=(OpQueEntry && o)
+{
+    op = std::move(o.op);
+    from = o.from;
+    handle = std::move(o.handle);
+    return *this;
+}
@@ -0,0 +1,203 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "common/OperationsDispatcher.h"
+
+#include "rulesets/LocatedEntity.h"
+
+#include <Atlas/Objects/Operation.h>
+
+#include <cassert>
+#include <cmath>
+
+/// The wall clock seen by the dispatcher, advanced by each operation.
+static double s_wallTime = 0.;
+/// Wall clock time each operation takes to dispatch.
+static double s_opCost = 0.;
+/// Number of operations dispatched.
+static int s_dispatched = 0;
+
+class TestEntity : public LocatedEntity {
+  public:
+    explicit TestEntity(const std::string & id, long intId) :
+        LocatedEntity(id, intId) { }
+
+    virtual void externalOperation(const Operation & op, Link &) { }
+    virtual void operation(const Operation &, OpVector &) { }
+    virtual void destroy() { }
+};
+
+class TestOperationsDispatcher : public OperationsDispatcher {
+  public:
+    TestOperationsDispatcher() : OperationsDispatcher(
+        [](const Operation &, LocatedEntity &) {
+            s_wallTime += s_opCost;
+            ++s_dispatched;
+        },
+        []() { return 0.; }) { }
+
+    virtual double wallTime() const { return s_wallTime; }
+
+    double currentSlice() const { return m_currentSlice; }
+
+    long sliceOverruns() const { return m_sliceOverruns; }
+};
+
+static bool closeTo(double a, double b)
+{
+    return std::fabs(a - b) < 1e-12;
+}
+
+static void queueOps(TestOperationsDispatcher & dispatcher,
+                     LocatedEntity & ent, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        Atlas::Objects::Operation::Tick op;
+        dispatcher.addOperationToQueue(op, ent);
+    }
+}
+
+int main()
+{
+    TestEntity * ent = new TestEntity("1", 1);
+    ent->incRef();
+
+    {
+        // Operations are dispatched until the slice is used up, and idle()
+        // asks to be called again while more are due.
+        TestOperationsDispatcher dispatcher;
+        dispatcher.setSliceBudget(0.005);
+        s_opCost = 0.002;
+        s_dispatched = 0;
+        queueOps(dispatcher, *ent, 10);
+
+        assert(dispatcher.idle());
+        assert(s_dispatched == 3);
+        assert(dispatcher.idle());
+        assert(s_dispatched == 6);
+        assert(dispatcher.idle());
+        assert(s_dispatched == 9);
+        assert(!dispatcher.idle());
+        assert(s_dispatched == 10);
+        assert(dispatcher.sliceOverruns() == 0);
+
+        // Nothing is left to dispatch
+        assert(!dispatcher.idle());
+        assert(s_dispatched == 10);
+    }
+
+    {
+        // At least one operation is dispatched in each slice, and one
+        // which takes longer than the whole slice is counted.
+        TestOperationsDispatcher dispatcher;
+        dispatcher.setSliceBudget(0.005);
+        s_opCost = 0.01;
+        s_dispatched = 0;
+        queueOps(dispatcher, *ent, 3);
+
+        assert(dispatcher.idle());
+        assert(s_dispatched == 1);
+        assert(dispatcher.sliceOverruns() == 1);
+        assert(dispatcher.idle());
+        assert(!dispatcher.idle());
+        assert(s_dispatched == 3);
+        assert(dispatcher.sliceOverruns() == 3);
+    }
+
+    {
+        // Slices are fixed unless adaptive slices are enabled
+        TestOperationsDispatcher dispatcher;
+        dispatcher.setSliceBudget(0.004);
+        dispatcher.reportIoHandlers(2);
+        dispatcher.idle();
+        assert(closeTo(dispatcher.currentSlice(), 0.004));
+    }
+
+    {
+        // Adaptive slices shrink while there is IO waiting, down to a
+        // minimum, and grow back to the budget when there is none.
+        TestOperationsDispatcher dispatcher;
+        dispatcher.setSliceBudget(0.004);
+        dispatcher.setAdaptiveSlices(true);
+        s_opCost = 0.00001;
+
+        dispatcher.reportIoHandlers(2);
+        dispatcher.idle();
+        assert(closeTo(dispatcher.currentSlice(), 0.003));
+        dispatcher.reportIoHandlers(1);
+        dispatcher.idle();
+        assert(closeTo(dispatcher.currentSlice(), 0.00225));
+
+        for (int i = 0; i < 50; ++i) {
+            dispatcher.reportIoHandlers(1);
+            queueOps(dispatcher, *ent, 1);
+            dispatcher.idle();
+        }
+        assert(closeTo(dispatcher.currentSlice(), 0.0004));
+
+        // IO handled since the last slice is only counted once
+        dispatcher.idle();
+        assert(closeTo(dispatcher.currentSlice(), 0.0005));
+
+        for (int i = 0; i < 50; ++i) {
+            dispatcher.idle();
+        }
+        assert(dispatcher.currentSlice() == 0.004);
+    }
+
+    {
+        // Adaptive slices never get too short to dispatch a couple of
+        // operations of average cost.
+        TestOperationsDispatcher dispatcher;
+        dispatcher.setSliceBudget(0.004);
+        dispatcher.setAdaptiveSlices(true);
+        s_opCost = 0.003;
+        s_dispatched = 0;
+        queueOps(dispatcher, *ent, 100);
+        while (dispatcher.idle()) {
+        }
+        assert(s_dispatched == 100);
+
+        dispatcher.reportIoHandlers(1);
+        dispatcher.idle();
+        assert(dispatcher.currentSlice() == 0.004);
+    }
+
+    return 0;
+}
+
+// stubs
+
+#include "common/log.h"
+#include "common/Monitors.h"
+
+#include "stubs/common/stubMonitors.h"
+#include "stubs/common/stubRouter.h"
+#include "stubs/rulesets/stubLocatedEntity.h"
+#include "stubs/modules/stubLocation.h"
+
+void log(LogLevel lvl, const std::string & msg)
+{
+}
@@ -547,6 +547,9 @@ void ExternalMind::linkUp(Link * c)
 #include "stubs/rulesets/stubEntity.h"
 #include "stubs/rulesets/stubLocatedEntity.h"
 #include "stubs/common/stubRouter.h"
+#include "stubs/common/stubMonitors.h"
+#include "stubs/server/stubIoThreadPool.h"
+#include "stubs/server/stubBroadcastCache.h"
 
 Link::Link(CommSocket & socket, const std::string & id, long iid) :
             Router(id, iid), m_encoder(0), m_commSocket(socket)
@@ -349,6 +349,13 @@ const DatabaseResult Database::selectSimpleRowBy(const std::string & name,
     return DatabaseResult(0);
 }
 
+void Database::selectSimpleRowByAsync(const std::string & name,
+                                      const std::string & column,
+                                      const std::string & value,
+                                      const ResultHandler & handler)
+{
+}
+
 Database * Database::instance()
 {
     if (m_instance == NULL) {
@@ -362,6 +369,16 @@ int Database::createInstanceDatabase()
     return 0;
 }
 
+int Database::registerSchemaVersion()
+{
+    return 0;
+}
+
+int Database::prepareStatements()
+{
+    return 0;
+}
+
 int Database::registerEntityIdGenerator()
 {
     return 0;
@@ -402,6 +419,12 @@ const DatabaseResult Database::selectRelation(const std::string & name,
     return DatabaseResult(0);
 }
 
+void Database::selectRelationAsync(const std::string & name,
+                                   const std::string & id,
+                                   const ResultHandler & handler)
+{
+}
+
 int Database::createRelationRow(const std::string & name,
                                 const std::string & id,
                                 const std::string & other)
@@ -445,6 +468,11 @@ int Database::clearPendingQuery()
     return 0;
 }
 
+int Database::fetchIds()
+{
+    return 0;
+}
+
 int Database::updateObject(const std::string & table,
                            const std::string & key,
                            const MapType & o)
@@ -476,6 +504,97 @@ int Database::registerThoughtsTable()
     return 0;
 }
 
+int Database::updateSimpleRow(const std::string & name,
+                              const std::string & key,
+                              const std::string & value,
+                              const std::string & columns)
+{
+    return 0;
+}
+
+const DatabaseResult Database::selectProperties(const std::string & id)
+{
+    return DatabaseResult(0);
+}
+
+const DatabaseResult Database::selectEntities(const std::string & loc)
+{
+    return DatabaseResult(0);
+}
+
+const DatabaseResult Database::selectAllEntities()
+{
+    return DatabaseResult(0);
+}
+
+const DatabaseResult Database::selectAllProperties()
+{
+    return DatabaseResult(0);
+}
+
+const DatabaseResult Database::selectAllThoughts()
+{
+    return DatabaseResult(0);
+}
+
+int Database::insertEntities(const std::vector<EntityRow> & rows)
+{
+    return 0;
+}
+
+int Database::updateEntities(const std::vector<EntityRow> & rows)
+{
+    return 0;
+}
+
+int Database::dropEntity(long id)
+{
+    return 0;
+}
+
+int Database::dropEntities(const std::vector<long> & ids)
+{
+    return 0;
+}
+
+int Database::insertProperties(const std::vector<PropertyRow> & rows)
+{
+    return 0;
+}
+
+int Database::updateProperties(const std::vector<PropertyRow> & rows)
+{
+    return 0;
+}
+
+const DatabaseResult Database::selectThoughts(const std::string & loc)
+{
+    return DatabaseResult(0);
+}
+
+int Database::replaceThoughts(const std::string & id,
+                              const std::vector<ThoughtRow> & thoughts)
+{
+    return 0;
+}
+
+int Database::updateThoughts(const std::string & id,
+                             const std::vector<ThoughtRow> & thoughts,
+                             const std::vector<std::string> & deleted)
+{
+    return 0;
+}
+
+int Database::writeThoughts(const std::vector<ThoughtWrite> & changes)
+{
+    return 0;
+}
+
+int Database::launchNewQuery()
+{
+    return 0;
+}
+
 const char * DatabaseResult::field(const char * column, int row) const
 {
     return "";
@@ -0,0 +1,190 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "rulesets/PhysicalDomain.h"
+
+#include "rulesets/Entity.h"
+
+#include <Atlas/Objects/Anonymous.h>
+#include <Atlas/Objects/Operation.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <cassert>
+
+using Atlas::Objects::Root;
+
+/// \brief A domain entity with a few children, perceptive or not.
+struct TestWorld {
+    Entity * tlve;
+    PhysicalDomain * domain;
+    std::map<std::string, Entity *> children;
+
+    TestWorld() : tlve(new Entity("0", 0)), domain(new PhysicalDomain(*tlve))
+    {
+        tlve->incRef();
+        tlve->m_location.m_pos = Point3D(0, 0, 0);
+        tlve->makeContainer();
+    }
+
+    Entity * add(const std::string & id, const Point3D & pos,
+                 float size, bool perceptive)
+    {
+        Entity * e = new Entity(id, std::stol(id));
+        e->incRef();
+        e->m_location.m_loc = tlve;
+        e->m_location.m_pos = pos;
+        e->m_location.setBBox(BBox(WFMath::Point<3>(0, 0, 0),
+                                   WFMath::Point<3>(size, size, size)));
+        if (perceptive) {
+            e->setFlags(entity_perceptive);
+        }
+        tlve->m_contains->insert(e);
+        children[id] = e;
+        return e;
+    }
+
+    /// \brief Switch to the observer index, as WorldRouter does with the
+    /// perceptionindex option.
+    void index()
+    {
+        for (auto & entry : children) {
+            if (entry.second->isPerceptive()) {
+                domain->addObserver(*entry.second);
+            }
+        }
+    }
+
+    /// \brief Move an entity, returning a description of each op sent.
+    std::vector<std::string> move(const std::string & id, const Point3D & pos)
+    {
+        Entity * e = children[id];
+        Location old_loc(e->m_location);
+        e->m_location.m_pos = pos;
+        OpVector res;
+        domain->processVisibilityForMovedEntity(*e, old_loc, res);
+
+        std::vector<std::string> ops;
+        for (auto & op : res) {
+            std::vector<std::string> args;
+            for (auto & arg : op->getArgs()) {
+                args.push_back(arg->getId());
+            }
+            std::sort(args.begin(), args.end());
+            std::string desc = op->getParents().front() + " to " + op->getTo() + ":";
+            for (auto & arg : args) {
+                desc += " " + arg;
+            }
+            ops.push_back(desc);
+        }
+        std::sort(ops.begin(), ops.end());
+        return ops;
+    }
+};
+
+/// \brief Set up the same world twice, with and without the observer index.
+static void populate(TestWorld & world)
+{
+    // Two observers far apart, a perceptive entity which moves between
+    // them, and a small rock which can only be seen from close by.
+    world.add("1", Point3D(0, 0, 0), 1.f, true);
+    world.add("2", Point3D(50, 0, 0), 1.f, true);
+    world.add("3", Point3D(10, 0, 0), 1.f, true);
+    world.add("4", Point3D(12, 0, 0), 0.1f, false);
+}
+
+int main()
+{
+    // Each move, in order, made in both worlds.
+    std::vector<std::pair<std::string, Point3D>> moves = {
+        // The mover walks from the first observer to the second
+        {"3", Point3D(45, 0, 0)},
+        // A rock which isn't perceptive is thrown near the second observer
+        {"4", Point3D(48, 0, 0)},
+        // The mover walks up to the rock
+        {"3", Point3D(49, 0, 0)},
+        // The mover walks back, past where the rock used to be
+        {"3", Point3D(11, 0, 0)},
+        // An observer walks over to the mover
+        {"2", Point3D(12, 0, 0)},
+    };
+
+    TestWorld legacy, indexed;
+    populate(legacy);
+    populate(indexed);
+    indexed.index();
+
+    bool anyOps = false;
+    for (auto & move : moves) {
+        std::vector<std::string> legacyOps = legacy.move(move.first, move.second);
+        std::vector<std::string> indexedOps = indexed.move(move.first, move.second);
+        // Both paths send exactly the same perception ops
+        assert(legacyOps == indexedOps);
+        anyOps = anyOps || !legacyOps.empty();
+    }
+    // The moves do change what can be seen
+    assert(anyOps);
+
+    {
+        // The first move tells the first observer it lost sight of the
+        // mover, and the mover what it gained and lost sight of. The
+        // second observer learns of the mover through the broadcast.
+        TestWorld world;
+        populate(world);
+        world.index();
+        std::vector<std::string> ops = world.move("3", Point3D(45, 0, 0));
+        assert(ops == std::vector<std::string>({
+            "appearance to 3: 2",
+            "disappearance to 1: 3",
+            "disappearance to 3: 1 4"}));
+    }
+
+    return 0;
+}
+
+// stubs
+
+#include "common/const.h"
+#include "common/log.h"
+#include "common/Property_impl.h"
+
+#include "stubs/rulesets/stubEntity.h"
+#include "stubs/rulesets/stubDomain.h"
+#include "stubs/rulesets/stubTerrainProperty.h"
+#include "stubs/rulesets/stubOutfitProperty.h"
+#include "stubs/rulesets/stubLocatedEntity.h"
+#include "stubs/common/stubCustom.h"
+#include "stubs/common/stubRouter.h"
+#include "stubs/common/stubTypeNode.h"
+#include "stubs/common/stubProperty.h"
+#include "rulesets/EntityProperty.h"
+#include "stubs/rulesets/stubEntityProperty.h"
+
+void log(LogLevel lvl, const std::string & msg)
+{
+}
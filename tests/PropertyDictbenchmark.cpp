@@ -0,0 +1,182 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// Compares the std::map previously used for properties with PropertyDict,
+// looking properties up the way Entity::getPropertyClass() does. The
+// entity has 40 properties, some set on the instance and the rest class
+// defaults, and is asked for instance properties, class properties and
+// properties it doesn't have. Lookups by atom show what callers which keep
+// the atoms of the names they use would get.
+
+#include "common/PropertyDict.h"
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+class PropertyBase
+{
+  public:
+    virtual ~PropertyBase() { }
+};
+
+class ModProperty : public PropertyBase
+{
+};
+
+static const int ITERATIONS = 1000000;
+static const int INSTANCE_PROPERTIES = 15;
+static const int CLASS_PROPERTIES = 25;
+
+static const char * const NAMES[] = {
+    "id", "name", "mass", "bbox", "status", "solid", "simple", "visibility",
+    "mode", "planted_on", "outfit", "right_hand_wield", "tasks", "mind",
+    "stamina", "description", "decays", "transient", "statistics", "food",
+    "biomass", "maxmass", "sizeAdult", "fruits", "fruitName", "fruitChance",
+    "radius", "area", "terrainmod", "geometry", "mode_data", "speed_ground",
+    "speed_water", "speed_flight", "density", "friction", "attached",
+    "entity_filter", "guise", "nourishment"
+};
+
+/// \brief Lookups, taken from the instance, the class and neither.
+static const char * const LOOKUPS[] = {
+    "mass", "bbox", "terrainmod", "geometry", "tasks", "attached",
+    "perceptive", "status", "density", "burn_speed"
+};
+
+static double elapsed(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+typedef std::map<std::string, PropertyBase *> MapDict;
+
+/// \brief Lookup as done with std::map, searching the instance properties
+/// and then the class ones by name.
+static const ModProperty * getPropertyClass(const MapDict & instance,
+                                            const MapDict & defaults,
+                                            const std::string & name)
+{
+    const PropertyBase * p = 0;
+    MapDict::const_iterator I = instance.find(name);
+    if (I != instance.end()) {
+        p = I->second;
+    } else {
+        I = defaults.find(name);
+        if (I != defaults.end()) {
+            p = I->second;
+        }
+    }
+    return p != 0 ? dynamic_cast<const ModProperty *>(p) : 0;
+}
+
+/// \brief Lookup with PropertyDict by atom.
+static const ModProperty * getPropertyClass(const PropertyDict & instance,
+                                            const PropertyDict & defaults,
+                                            PropertyAtom atom)
+{
+    const PropertyBase * p = 0;
+    PropertyDict::const_iterator I = instance.find(atom);
+    if (I != instance.end()) {
+        p = I->second;
+    } else {
+        I = defaults.find(atom);
+        if (I != defaults.end()) {
+            p = I->second;
+        }
+    }
+    return p != 0 ? dynamic_cast<const ModProperty *>(p) : 0;
+}
+
+/// \brief Lookup as done with PropertyDict, finding the atom once.
+static const ModProperty * getPropertyClass(const PropertyDict & instance,
+                                            const PropertyDict & defaults,
+                                            const std::string & name)
+{
+    PropertyAtom atom = PropertyAtoms::find(name);
+    const PropertyBase * p = 0;
+    PropertyDict::const_iterator I = instance.find(name, atom);
+    if (I != instance.end()) {
+        p = I->second;
+    } else if (atom != PropertyAtoms::NONE) {
+        I = defaults.find(atom);
+        if (I != defaults.end()) {
+            p = I->second;
+        }
+    }
+    return p != 0 ? dynamic_cast<const ModProperty *>(p) : 0;
+}
+
+template <typename Dict, typename Key>
+static double run(const Dict & instance, const Dict & defaults,
+                  const std::vector<Key> & lookups, size_t & found)
+{
+    found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        for (auto& name : lookups) {
+            if (getPropertyClass(instance, defaults, name) != 0) {
+                ++found;
+            }
+        }
+    }
+    return elapsed(start);
+}
+
+int main()
+{
+    // The names are interned as rules are loaded, including those of
+    // properties not on this entity.
+    PropertyAtoms::intern("perceptive");
+
+    std::vector<ModProperty> properties(INSTANCE_PROPERTIES + CLASS_PROPERTIES);
+    MapDict mapInstance, mapDefaults;
+    PropertyDict dictInstance, dictDefaults;
+    for (int i = 0; i < INSTANCE_PROPERTIES + CLASS_PROPERTIES; ++i) {
+        if (i < INSTANCE_PROPERTIES) {
+            mapInstance[NAMES[i]] = &properties[i];
+            dictInstance[PropertyAtoms::intern(NAMES[i])] = &properties[i];
+        } else {
+            mapDefaults[NAMES[i]] = &properties[i];
+            dictDefaults[PropertyAtoms::intern(NAMES[i])] = &properties[i];
+        }
+    }
+    std::vector<std::string> lookups(std::begin(LOOKUPS), std::end(LOOKUPS));
+    std::vector<PropertyAtom> atoms;
+    for (auto& name : lookups) {
+        atoms.push_back(PropertyAtoms::intern(name));
+    }
+
+    size_t mapFound, dictFound, atomFound;
+    double mapTime = run(mapInstance, mapDefaults, lookups, mapFound);
+    double dictTime = run(dictInstance, dictDefaults, lookups, dictFound);
+    double atomTime = run(dictInstance, dictDefaults, atoms, atomFound);
+    if (mapFound != dictFound || mapFound != atomFound) {
+        std::cerr << "Lookups differ" << std::endl;
+        return 1;
+    }
+
+    double count = (double)ITERATIONS * lookups.size();
+    std::cout << "storage\tgetPropertyClass (ns/op)" << std::endl;
+    std::cout << "std::map\t" << mapTime * 1e9 / count << std::endl;
+    std::cout << "PropertyDict\t" << dictTime * 1e9 / count << std::endl;
+    std::cout << "PropertyDict by atom\t" << atomTime * 1e9 / count
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "common/PropertyDict.h"
+
+#include <set>
+
+#include <cassert>
+
+static PropertyBase * const A = reinterpret_cast<PropertyBase *>(0x10);
+static PropertyBase * const B = reinterpret_cast<PropertyBase *>(0x20);
+static PropertyBase * const C = reinterpret_cast<PropertyBase *>(0x30);
+
+int main()
+{
+    {
+        // Names keep their atoms
+        PropertyAtom mass = PropertyAtoms::intern("mass");
+        assert(PropertyAtoms::intern("mass") == mass);
+        assert(PropertyAtoms::find("mass") == mass);
+        assert(PropertyAtoms::name(mass) == "mass");
+        assert(PropertyAtoms::intern("status") != mass);
+        assert(PropertyAtoms::find("not interned") == PropertyAtoms::NONE);
+    }
+
+    {
+        PropertyDict dict;
+        assert(dict.empty());
+        assert(dict.find("mass") == dict.end());
+
+        // Insertion doesn't replace an existing entry
+        assert(dict.insert("mass", A).second);
+        assert(!dict.insert("mass", B).second);
+        assert(dict.find("mass")->second == A);
+
+        dict["bbox"] = B;
+        dict[PropertyAtoms::intern("status")] = C;
+        assert(dict.size() == 3);
+        assert(dict.count("bbox") == 1);
+        assert(dict.count("solid") == 0);
+        assert(dict.find(PropertyAtoms::find("status"))->second == C);
+        assert(dict.find("mass")->first == PropertyAtoms::find("mass"));
+
+        // Looking up a name not yet interned doesn't intern it
+        assert(dict.find("unheard of") == dict.end());
+        assert(PropertyAtoms::find("unheard of") == PropertyAtoms::NONE);
+
+        std::set<std::string> names;
+        for (auto& entry : dict) {
+            names.insert(dict.name(entry.first));
+        }
+        assert(names == std::set<std::string>({"bbox", "mass", "status"}));
+
+        assert(dict.erase("mass") == 1);
+        assert(dict.erase("mass") == 0);
+        assert(dict.find("mass") == dict.end());
+        assert(dict.find("bbox")->second == B);
+        assert(dict.find("status")->second == C);
+
+        dict.erase(dict.find("bbox"));
+        assert(dict.size() == 1);
+        assert(dict.name(dict.begin()->first) == "status");
+    }
+
+    {
+        // Names which aren't interned get atoms of their own in each
+        // dictionary, and are never added to the table of atoms
+        PropertyDict dict;
+        dict["mass"] = A;
+        assert(dict.insert("client attribute", B).second);
+        assert(PropertyAtoms::find("client attribute") == PropertyAtoms::NONE);
+        assert(!dict.insert("client attribute", C).second);
+        PropertyDict::const_iterator I = dict.find("client attribute");
+        assert(I != dict.end());
+        assert(I->second == B);
+        assert(I->first & PropertyDict::LOCAL);
+        assert(dict.name(I->first) == "client attribute");
+        const std::string * name = &dict.name(I->first);
+
+        // Local atoms sort after interned ones
+        assert(dict.name(dict.begin()->first) == "mass");
+
+        // The names of erased entries are reused, and stay put
+        dict.erase(I);
+        assert(dict.find("client attribute") == dict.end());
+        dict["another"] = C;
+        assert(&dict.name(dict.find("another")->first) == name);
+        assert(dict.size() == 2);
+
+        // An entry is still found by name if its name is interned later
+        PropertyAtoms::intern("another");
+        assert(dict.find("another")->second == C);
+        assert(!dict.insert("another", A).second);
+        assert(dict.size() == 2);
+        assert(dict.erase("another") == 1);
+        assert(dict.size() == 1);
+    }
+
+    {
+        // Lookups still work after many entries are added in any order
+        PropertyDict dict;
+        for (int i = 99; i >= 0; --i) {
+            dict[std::to_string(i * 7 % 100)] = A;
+        }
+        assert(dict.size() == 100);
+        for (int i = 0; i < 100; ++i) {
+            auto I = dict.find(std::to_string(i));
+            assert(I != dict.end());
+            assert(dict.name(I->first) == std::to_string(i));
+        }
+    }
+
+    return 0;
+}
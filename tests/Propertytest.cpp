@@ -73,6 +73,48 @@ int main()
 
     assert((vis_mask & per_mask) == 0);
 
+    {
+    // Tracked properties are listed once when marked unsent or unclean
+    PropertyChanges changes;
+    std::string name("test_prop");
+    PropertyBase * pb = new MinimalProperty;
+    pb->setFlags(per_clean);
+    pb->track(&changes, &name);
+    assert(changes.unsent.empty());
+    assert(changes.unclean.empty());
+    assert(&pb->name() == &name);
+
+    pb->setFlags(flag_unsent);
+    pb->setFlags(flag_unsent);
+    assert(changes.unsent.size() == 1);
+    assert(changes.unsent.front() == pb);
+
+    pb->resetFlags(per_clean);
+    pb->resetFlags(per_clean);
+    assert(changes.unclean.size() == 1);
+    assert(pb->flags() & per_changed);
+
+    // Destroyed properties are no longer listed
+    delete pb;
+    assert(changes.unsent.empty());
+    assert(changes.unclean.empty());
+    }
+
+    {
+    // Ephemeral properties are never listed as unclean
+    PropertyChanges changes;
+    std::string name("test_prop");
+    PropertyBase * pb = new MinimalProperty;
+    pb->setFlags(per_ephem);
+    pb->track(&changes, &name);
+    pb->resetFlags(per_clean);
+    assert(changes.unclean.empty());
+    pb->untrack();
+    pb->setFlags(flag_unsent);
+    assert(changes.unsent.empty());
+    delete pb;
+    }
+
     Element val;
 
     {
@@ -37,6 +37,8 @@
 #include "rulesets/Entity.h"
 #include "rulesets/Character.h"
 
+#include "common/TypeNode.h"
+
 #include <cassert>
 
 void check_union()
@@ -152,6 +154,35 @@ int main()
     assert(le != 0);
     PyObject * wrap_le = wrapEntity(le);
     assert(wrap_le != 0);
+
+    {
+        // Reading a class property doesn't copy it to the entity
+        TypeNode * type = new TypeNode("class_property_type");
+        Atlas::Message::MapType defaults;
+        defaults["mass"] = 10.;
+        type->addProperties(defaults);
+        Entity * cpe = new Entity("4", 4);
+        cpe->setType(type);
+        PyObject * wrap_cpe = wrapEntity(cpe);
+        assert(wrap_cpe != 0);
+
+        int reads = python_class_property_reads;
+        PyObject * mass = PyObject_GetAttrString(wrap_cpe, "mass");
+        assert(mass != 0);
+        assert(PyFloat_AsDouble(mass) == 10.);
+        Py_DECREF(mass);
+        assert(cpe->getProperties().find("mass") ==
+               cpe->getProperties().end());
+        assert(python_class_property_reads == reads + 1);
+
+        // Setting it does
+        PyObject * new_mass = PyFloat_FromDouble(20.);
+        assert(PyObject_SetAttrString(wrap_cpe, "mass", new_mass) == 0);
+        Py_DECREF(new_mass);
+        assert(cpe->getProperties().find("mass") !=
+               cpe->getProperties().end());
+        assert(type->defaults().find("mass") != type->defaults().end());
+    }
     
 
     run_python_string("from server import *");
@@ -289,6 +289,11 @@ std::vector<Atlas::Objects::Root> LocatedEntity::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges LocatedEntity::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
 #include "stubs/common/stubRouter.h"
 
 void log(LogLevel lvl, const std::string & msg)
@@ -107,6 +107,15 @@ int main()
                       "  return Operation('sight') + Operation('move')\n"
                       " def test_hook(self, ent): pass\n");
     run_python_string("testmod.TestEntity=TestEntity");
+    run_python_string("handle_sound = False");
+    run_python_string("class DynamicEntity(server.Thing):\n"
+                      " def __getattr__(self, name):\n"
+                      "  if name == 'look_operation':\n"
+                      "   return lambda op: None\n"
+                      "  if name == 'sound_operation' and handle_sound:\n"
+                      "   return lambda op: None\n"
+                      "  raise AttributeError, name\n");
+    run_python_string("testmod.DynamicEntity=DynamicEntity");
 
     // PyObject * package_name = PyString_FromString("testmod");
     // PyObject * testmod = PyImport_Import(package_name);
@@ -149,6 +158,42 @@ int main()
     script->hook("nohookfunction", e);
     script->hook("test_hook", e);
 
+    // Handlers are found the same way when they have been cached
+    assert(script->operation("look", op1, res));
+    assert(!script->operation("create", op2, res));
+    assert(script->operation("look", op1, res));
+    assert(!script->operation("create", op2, res));
+
+    // Event names which differ from the type of the op are found by name
+    assert(script->operation("set", op2, res));
+    assert(!script->operation("sight_create", op2, res));
+    assert(!script->operation("create", op2, res));
+
+    // Scripts created by the same factory share the handler lookups
+    Entity * e2 = new Entity("2", 2);
+    ret = psf.addScript(e2);
+    assert(ret == 0);
+    assert(e2->script() != 0);
+    assert(e2->script()->operation("look", op1, res));
+    assert(!e2->script()->operation("create", op2, res));
+
+    // Handlers provided by __getattr__ are found, and a missing handler
+    // isn't remembered for a class which defines it
+    PythonScriptFactory<LocatedEntity> dynamic_psf("testmod", "DynamicEntity");
+    ret = dynamic_psf.setup();
+    assert(ret == 0);
+    Entity * e3 = new Entity("3", 3);
+    ret = dynamic_psf.addScript(e3);
+    assert(ret == 0);
+    assert(e3->script() != 0);
+    Atlas::Objects::Operation::Sound op8;
+    assert(e3->script()->operation("look", op1, res));
+    assert(!e3->script()->operation("sound", op8, res));
+    run_python_string("handle_sound = True");
+    assert(e3->script()->operation("sound", op8, res));
+
+    delete e3;
+    delete e2;
     delete e;
 
     shutdown_python_api();
@@ -1114,7 +1114,7 @@ const PropertyBase * Entity::getProperty(const std::string & name) const
 PropertyBase * Entity::setProperty(const std::string & name,
                                    PropertyBase * prop)
 {
-    return m_properties[name] = prop;
+    return insertProperty(name, prop);
 }
 
 PropertyBase * Entity::modProperty(const std::string & name)
@@ -1263,6 +1263,11 @@ std::vector<Atlas::Objects::Root> LocatedEntity::getThoughts() const
 {
     return std::vector<Atlas::Objects::Root>();
 }
+
+ThoughtChanges LocatedEntity::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
 PythonClass::PythonClass(const std::string & package,
                          const std::string & type,
                          struct _typeobject * base) : m_package(package),
@@ -1598,6 +1603,11 @@ std::vector<Atlas::Objects::Root> Character::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges Character::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
 bool Character::w2mAppearanceOperation(const Operation & op)
 {
     return true;
@@ -33,6 +33,7 @@
 
 #include <Atlas/Objects/Anonymous.h>
 
+#include <functional>
 #include <iostream>
 
 #include <cassert>
@@ -41,6 +42,7 @@ class Entity;
 
 static bool stub_deny_newid = false;
 static bool stub_generate_accounts = false;
+static std::vector<std::function<void()>> stub_account_lookups;
 
 class TestWorld : public BaseWorld {
   public:
@@ -252,6 +254,68 @@ int main()
         database_flag = false;
     }
 
+    {
+        // Accounts in memory are found without a lookup
+        ServerRouting server(world, ruleset, server_name,
+                             server_id, int_id,
+                             lobby_id, lobby_int_id);
+
+        std::string id;
+        int iid = newId(id);
+        assert(iid >= 0);
+
+        Account * ac = new TestAccount(0, "bob", "", id, iid);
+        server.addAccount(ac);
+        Account * rac = 0;
+        assert(server.lookupAccountByName("bob", rac, [](Account *) {
+            assert(false);
+        }) == 0);
+        assert(rac == ac);
+        assert(server.lookupAccountByName("alice", rac, [](Account *) {
+            assert(false);
+        }) == 0);
+        assert(rac == 0);
+    }
+
+    {
+        // Logins for the same account share a lookup, and too many
+        // waiting logins are turned away
+        database_flag = true;
+        max_pending_logins = 3;
+        ServerRouting server(world, ruleset, server_name,
+                             server_id, int_id,
+                             lobby_id, lobby_int_id);
+
+        Account * rac = 0;
+        std::vector<Account *> found;
+        auto done = [&found](Account * account) {
+            found.push_back(account);
+        };
+        assert(server.lookupAccountByName("alice", rac, done) == 1);
+        assert(server.lookupAccountByName("alice", rac, done) == 1);
+        assert(server.lookupAccountByName("bob", rac, done) == 1);
+        assert(server.lookupAccountByName("carol", rac, done) == -1);
+        assert(stub_account_lookups.size() == 2);
+        assert(found.empty());
+
+        stub_account_lookups.front()();
+        assert(found.size() == 2);
+        assert(found[0] != 0);
+        assert(found[0] == found[1]);
+        assert(found[0]->username() == "alice");
+        assert(server.getAccountByName("alice") == found[0]);
+        assert(server.getObject(found[0]->getId()) == found[0]);
+
+        // There is room for another login now
+        assert(server.lookupAccountByName("carol", rac, done) == 1);
+        assert(server.lookupAccountByName("alice", rac, done) == 0);
+        assert(rac == found[0]);
+
+        stub_account_lookups.clear();
+        max_pending_logins = 64;
+        database_flag = false;
+    }
+
     {
         ServerRouting server(world, ruleset, server_name,
                              server_id, int_id,
@@ -420,6 +484,19 @@ Account * Persistence::getAccount(const std::string & name)
     return new TestAccount(0, name, "", id, iid);
 }
 
+void Persistence::lookupAccount(const std::string & name,
+                                const EntityDict & worldObjects,
+                                const std::function<void(Account *)> & done)
+{
+    stub_account_lookups.push_back([name, done]() {
+        std::string id;
+        int iid = newId(id);
+        assert(iid >= 0);
+
+        done(new TestAccount(0, name, "", id, iid));
+    });
+}
+
 void Persistence::registerCharacters(Account & ac,
                                      const EntityDict & worldObjects)
 {
@@ -454,6 +531,13 @@ void Lobby::addToEntity(const Atlas::Objects::Entity::RootEntity & ent) const
 #include "stubs/common/stubVariable.h"
 #include "stubs/common/stubMonitors.h"
 
+int_config_register::int_config_register(int & var,
+                                         const char * section,
+                                         const char * setting,
+                                         const char * help)
+{
+}
+
 bool_config_register::bool_config_register(bool & var,
                                            const char * section,
                                            const char * setting,
@@ -0,0 +1,163 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "common/SlabPool.h"
+
+#include <map>
+#include <set>
+
+#include <cassert>
+
+class Pooled {
+  public:
+    virtual ~Pooled() { }
+
+    SLAB_POOLED(entities, "Pooled")
+
+    long m_value = 0;
+};
+
+class LargerPooled : public Pooled {
+  public:
+    SLAB_POOLED(entities, "LargerPooled")
+
+    char m_data[200];
+};
+
+class SamePooled : public Pooled {
+  public:
+    SLAB_POOLED(entities, "SamePooled")
+};
+
+class HugePooled : public Pooled {
+  public:
+    char m_data[10000];
+};
+
+static std::map<std::size_t, const std::int64_t *> watched;
+static std::map<std::string, const SlabClass *> watchedClasses;
+
+static void watch(const std::string & kind, SlabPool & pool)
+{
+    assert(kind == "entities");
+    watched[pool.size()] = &pool.objects();
+}
+
+static void watchClass(const std::string & kind, SlabClass & cls)
+{
+    assert(kind == "entities");
+    watchedClasses[cls.name()] = &cls;
+}
+
+int main()
+{
+    {
+        SlabPool pool(32);
+        assert(pool.objects() == 0);
+        assert(pool.bytes() == 0);
+
+        // Blocks are handed out from a slab, and don't overlap
+        std::set<char *> blocks;
+        for (int i = 0; i < 100; ++i) {
+            char * block = static_cast<char *>(pool.allocate());
+            for (char * other : blocks) {
+                assert(block + 32 <= other || other + 32 <= block);
+            }
+            blocks.insert(block);
+        }
+        assert(pool.objects() == 100);
+        assert(pool.bytes() >= 100 * 32);
+
+        // Freed blocks are used again
+        char * block = *blocks.begin();
+        std::int64_t bytes = pool.bytes();
+        pool.deallocate(block);
+        assert(pool.objects() == 99);
+        assert(pool.allocate() == block);
+        assert(pool.bytes() == bytes);
+    }
+
+    {
+        SlabPools::setWatcher(&watch, &watchClass);
+
+        // Classes are pooled by their own size, and go back to that pool
+        // when deleted through the base class.
+        Pooled * small = new Pooled;
+        Pooled * larger = new LargerPooled;
+        assert(watched.size() == 2);
+        auto I = watched.lower_bound(sizeof(Pooled));
+        assert(I != watched.end() && *I->second == 1);
+        I = watched.lower_bound(sizeof(LargerPooled));
+        assert(I != watched.end() && *I->second == 1);
+
+        delete larger;
+        assert(*I->second == 0);
+        Pooled * again = new LargerPooled;
+        assert(again == larger);
+        delete again;
+        delete small;
+
+        // Large objects aren't pooled
+        Pooled * huge = new HugePooled;
+        huge->m_value = 1;
+        assert(watched.size() == 2);
+        delete huge;
+    }
+
+    {
+        // Classes of the same size share a pool, but are counted apart.
+        // A class without its own counts is counted with its base class.
+        assert(sizeof(SamePooled) == sizeof(Pooled));
+        Pooled * small = new Pooled;
+        Pooled * same = new SamePooled;
+        Pooled * same2 = new SamePooled;
+        Pooled * huge = new HugePooled;
+        assert(watchedClasses.size() == 3);
+        const SlabClass & pooled = *watchedClasses["Pooled"];
+        const SlabClass & samePooled = *watchedClasses["SamePooled"];
+        const SlabClass & largerPooled = *watchedClasses["LargerPooled"];
+        assert(*watched.lower_bound(sizeof(Pooled))->second == 3);
+        assert(pooled.objects() == 2);
+        assert(pooled.bytes() ==
+               (std::int64_t)(sizeof(Pooled) + sizeof(HugePooled)));
+        assert(samePooled.objects() == 2);
+        assert(samePooled.bytes() == (std::int64_t)(2 * sizeof(SamePooled)));
+        assert(largerPooled.objects() == 0);
+        assert(largerPooled.bytes() == 0);
+
+        delete same;
+        delete huge;
+        assert(pooled.objects() == 1);
+        assert(pooled.bytes() == (std::int64_t)sizeof(Pooled));
+        assert(samePooled.objects() == 1);
+        delete same2;
+        delete small;
+        assert(pooled.objects() == 0);
+        assert(samePooled.objects() == 0);
+        assert(samePooled.bytes() == 0);
+    }
+
+    return 0;
+}
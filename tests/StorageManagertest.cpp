@@ -49,6 +49,15 @@ class TestStorageManager : public StorageManager
     void test_entityUpdated(LocatedEntity * e) {
         entityUpdated(e);
     }
+    void test_entityContainered(LocatedEntity * e) {
+        entityContainered(nullptr, e);
+    }
+    int test_rowsAvoided() const {
+        return m_rowsAvoided;
+    }
+    int test_checkpoints() const {
+        return m_checkpoints;
+    }
 
     void test_encodeProperty(PropertyBase * p, std::string & s) {
         encodeProperty(p, s);
@@ -97,6 +106,16 @@ int main()
         store.restoreWorld();
     }
 
+    {
+        SystemTime time;
+        WorldRouter world(time);
+
+        StorageManager store(world);
+
+        store.setBulkRestore(true);
+        store.restoreWorld();
+    }
+
     {
         SystemTime time;
         WorldRouter world(time);
@@ -171,6 +190,62 @@ int main()
         store.test_restoreChildren(new Entity("1", 1));
     }
 
+    {
+        SystemTime time;
+        WorldRouter world(time);
+
+        TestStorageManager store(world);
+        store.setRewriteInterval(3600);
+
+        Entity * ent = new Entity("1", 1);
+
+        // An entity never written before is written at the next tick
+        store.test_entityUpdated(ent);
+        assert(ent->getFlags() & entity_queued);
+        store.tick();
+        assert((ent->getFlags() & entity_queued) == 0);
+
+        // Further modifications wait for the rewrite interval, and are
+        // written together
+        store.test_entityUpdated(ent);
+        store.test_entityUpdated(ent);
+        store.tick();
+        assert(ent->getFlags() & entity_queued);
+        assert(store.test_rowsAvoided() == 1);
+
+        // A change of location is written straight away
+        store.test_entityContainered(ent);
+        store.tick();
+        assert((ent->getFlags() & entity_queued) == 0);
+
+        // Shutting down writes everything left waiting
+        store.test_entityUpdated(ent);
+        store.tick();
+        assert(ent->getFlags() & entity_queued);
+        bool exit_flag = false;
+        store.shutdown(exit_flag, std::map<long, LocatedEntity *>());
+        assert((ent->getFlags() & entity_queued) == 0);
+        assert(store.test_checkpoints() >= 1);
+    }
+
+    {
+        SystemTime time;
+        WorldRouter world(time);
+
+        TestStorageManager store(world);
+        store.setRewriteInterval(3600);
+        store.setStructuralPriority(false);
+
+        Entity * ent = new Entity("1", 1);
+        store.test_entityUpdated(ent);
+        store.tick();
+
+        // Without priority a change of location waits like any other
+        store.test_entityContainered(ent);
+        store.tick();
+        assert(ent->getFlags() & entity_queued);
+    }
+
 
 
     return 0;
@@ -308,6 +383,11 @@ const char * DatabaseResult::const_iterator::column(const char * column) const
     return "";
 }
 
+const char * DatabaseResult::field(const char * column, int row) const
+{
+    return "";
+}
+
 VariableBase::~VariableBase()
 {
 }
@@ -340,6 +420,8 @@ template class Variable<std::string>;
 
 #include "stubs/common/stubMonitors.h"
 #include "stubs/common/stubOperationsDispatcher.h"
+#include "stubs/common/stubOpTimingWheel.h"
+#include "stubs/common/stubWorkerPool.h"
 
 
 MindInspector::MindInspector() :
@@ -29,10 +29,33 @@
 
 #include <cassert>
 
-bool test_newid_fail = false;
+class TestDatabase : public Database
+{
+  public:
+    bool m_newIdFail;
+
+    TestDatabase() : m_newIdFail(false) { }
+
+    static TestDatabase * install()
+    {
+        TestDatabase * db = new TestDatabase;
+        m_instance = db;
+        return db;
+    }
+
+    long newId(std::string & id) override
+    {
+        if (m_newIdFail) {
+            return -1;
+        }
+        return 1;
+    }
+};
 
 int main()
 {
+    TestDatabase * db = TestDatabase::install();
+
     {
         Storage a;
     }
@@ -114,7 +137,7 @@ int main()
         delete a;
     }
 
-    test_newid_fail = true;
+    db->m_newIdFail = true;
     {
         Storage * a = new Storage;
 
@@ -125,7 +148,7 @@ int main()
 
         delete a;
     }
-    test_newid_fail = false;
+    db->m_newIdFail = false;
 
     {
         Storage * a = new Storage;
@@ -214,89 +237,9 @@ void log(LogLevel lvl, const std::string & msg)
 {
 }
 
-Database * Database::m_instance = NULL;
-
-Database * Database::instance()
-{
-    if (m_instance == NULL) {
-        m_instance = new Database();
-    }
-    return m_instance;
-}
-
-Database::Database() : m_rule_db("rules"),
-                       m_queryInProgress(false),
-                       m_connection(NULL)
-{
-}
-
-int Database::initConnection()
-{
-    return 0;
-}
-
-int Database::initRule(bool)
-{
-    return 0;
-}
-
-void Database::shutdownConnection()
-{
-}
-
-long Database::newId(std::string & id)
-{
-    if (test_newid_fail) {
-        return -1;
-    }
-    return 1;
-}
-
-const DatabaseResult Database::selectSimpleRowBy(const std::string & name,
-                                                 const std::string & column,
-                                                 const std::string & value)
-{
-    return DatabaseResult(0);
-}
-
-int Database::updateSimpleRow(const std::string & name,
-                               const std::string & key,
-                               const std::string & value,
-                               const std::string & columns)
-{
-    return 0;
-}
-
-int Database::createSimpleRow(const std::string & name,
-                               const std::string & id,
-                               const std::string & columns,
-                               const std::string & values)
-{
-    return 0;
-}
+using Atlas::Message::MapType;
 
-int Database::clearTable(const std::string & table)
-{
-    return 0;
-}
-
-int Database::clearPendingQuery()
-{
-    return 0;
-}
-
-bool Database::hasKey(const std::string & table, const std::string & key)
-{
-    return false;
-}
-
-int Database::putObject(const std::string & table,
-                         const std::string & key,
-                         const Atlas::Message::MapType & o,
-                         const StringVector & c)
-{
-    return 0;
-}
+#include "stubs/common/stubDatabase.h"
 
 const char * DatabaseResult::field(const char * column, int row) const
 {
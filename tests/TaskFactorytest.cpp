@@ -315,6 +315,11 @@ std::vector<Atlas::Objects::Root> LocatedEntity::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges LocatedEntity::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
 #include "stubs/common/stubRouter.h"
 
 TypeNode::TypeNode(const std::string & name) : m_name(name), m_parent(0)
@@ -292,7 +292,7 @@ void Entity::sendWorld(const Operation & op)
 PropertyBase * Entity::setProperty(const std::string & name,
                                    PropertyBase * prop)
 {
-    return m_properties[name] = prop;
+    return insertProperty(name, prop);
 }
 
 void Entity::onContainered(const LocatedEntity*)
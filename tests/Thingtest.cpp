@@ -236,7 +236,7 @@ const PropertyBase * Entity::getProperty(const std::string & name) const
 PropertyBase * Entity::setProperty(const std::string & name,
                                    PropertyBase * prop)
 {
-    return m_properties[name] = prop;
+    return insertProperty(name, prop);
 }
 
 void Entity::installDelegate(int class_no, const std::string & delegate)
@@ -413,6 +413,11 @@ std::vector<Atlas::Objects::Root> LocatedEntity::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges LocatedEntity::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
 
 void addToEntity(const Point3D & p, std::vector<double> & vd)
 {
@@ -62,11 +62,13 @@ class ThingupdatePropertiestest : public Cyphesis::TestBase
     void teardown();
 
     void test_update();
+    void test_update_changed();
 };
 
 ThingupdatePropertiestest::ThingupdatePropertiestest()
 {
     ADD_TEST(ThingupdatePropertiestest::test_update);
+    ADD_TEST(ThingupdatePropertiestest::test_update_changed);
 }
 
 void ThingupdatePropertiestest::setup()
@@ -124,6 +126,37 @@ void ThingupdatePropertiestest::test_update()
     ASSERT_EQUAL(set_arg->getName(), testName);
 }
 
+void ThingupdatePropertiestest::test_update_changed()
+{
+    Property<std::string> * description = new Property<std::string>;
+    description->data() = "tall";
+    m_thing->setProperty("description", description);
+
+    Update u;
+    OpVector res;
+
+    m_thing->updateProperties(u, res);
+
+    // Properties which are not marked unsent are left out
+    ASSERT_EQUAL(res.size(), 1u);
+    auto set = smart_dynamic_cast<Operation>(res.front()->getArgs().front());
+    auto set_arg = smart_dynamic_cast<RootEntity>(set->getArgs().front());
+    ASSERT_TRUE(!set_arg->isDefaultName());
+    ASSERT_TRUE(!set_arg->hasAttr("description"));
+
+    // Properties marked after the last update are sent in the next one
+    description->setFlags(flag_unsent);
+    res.clear();
+    m_thing->updateProperties(u, res);
+
+    ASSERT_EQUAL(res.size(), 1u);
+    set = smart_dynamic_cast<Operation>(res.front()->getArgs().front());
+    set_arg = smart_dynamic_cast<RootEntity>(set->getArgs().front());
+    ASSERT_TRUE(set_arg->isDefaultName());
+    ASSERT_TRUE(set_arg->hasAttr("description"));
+    ASSERT_EQUAL(description->flags() & flag_unsent, 0u);
+}
+
 int main()
 {
     ThingupdatePropertiestest t;
@@ -283,6 +316,11 @@ std::vector<Atlas::Objects::Root> LocatedEntity::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges LocatedEntity::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
 void addToEntity(const Point3D & p, std::vector<double> & vd)
 {
     vd.resize(3);
@@ -0,0 +1,64 @@
+// Cyphesis Online RPG Server and AI Engine
+// Copyright (C) 2015 Erik Ogenvik
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include "common/WorkerPool.h"
+
+#include <vector>
+
+#include <cassert>
+
+int main()
+{
+    {
+        // A pool without threads does all the work in the caller
+        WorkerPool pool(0);
+        assert(pool.size() == 0);
+        std::vector<int> done(10, 0);
+        pool.run(done.size(), [&](std::size_t i) {++done[i];});
+        for (int d : done) {
+            assert(d == 1);
+        }
+    }
+
+    {
+        // Every part is run exactly once, over many batches
+        WorkerPool pool(4);
+        assert(pool.size() == 4);
+        for (std::size_t parts = 0; parts < 200; ++parts) {
+            std::vector<int> done(parts, 0);
+            pool.run(parts, [&](std::size_t i) {++done[i];});
+            for (int d : done) {
+                assert(d == 1);
+            }
+        }
+    }
+
+    {
+        // Destroying an idle pool stops the threads
+        WorkerPool pool(2);
+    }
+
+    return 0;
+}
@@ -255,6 +255,8 @@ int main()
 #include "stubs/server/stubExternalMindsManager.h"
 #include "stubs/server/stubExternalMindsConnection.h"
 #include "stubs/common/stubOperationsDispatcher.h"
+#include "stubs/common/stubOpTimingWheel.h"
+#include "stubs/common/stubWorkerPool.h"
 
 #include <Atlas/Objects/Operation.h>
 
@@ -295,6 +295,8 @@ int TICK_NO = -1;
 #include "stubs/rulesets/stubEntity.h"
 #include "stubs/rulesets/stubDomain.h"
 #include "stubs/common/stubOperationsDispatcher.h"
+#include "stubs/common/stubOpTimingWheel.h"
+#include "stubs/common/stubWorkerPool.h"
 
 LocatedEntity::LocatedEntity(const std::string & id, long intId) :
                Router(id, intId),
@@ -403,6 +405,11 @@ std::vector<Atlas::Objects::Root> LocatedEntity::getThoughts() const
 {
     return std::vector<Atlas::Objects::Root>();
 }
+
+ThoughtChanges LocatedEntity::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
 #include "stubs/common/stubRouter.h"
 
 
@@ -31,8 +31,25 @@
 
 #include <cassert>
 
+class TestDatabase : public Database
+{
+  public:
+    static void install()
+    {
+        m_instance = new TestDatabase;
+    }
+
+    long newId(std::string & id) override
+    {
+        id = "1";
+        return 1;
+    }
+};
+
 int main()
 {
+    TestDatabase::install();
+
     database_flag = false;
 
     std::string id;
@@ -60,23 +77,6 @@ void log(LogLevel lvl, const std::string & msg)
 {
 }
 
-Database * Database::m_instance = NULL;
+using Atlas::Message::MapType;
 
-Database * Database::instance()
-{
-    if (m_instance == NULL) {
-        m_instance = new Database();
-    }
-    return m_instance;
-}
-
-Database::Database() : m_rule_db("rules"),
-                       m_queryInProgress(false),
-                       m_connection(NULL)
-{
-}
-
-long Database::newId(std::string & id)
-{
-    return 1;
-}
+#include "stubs/common/stubDatabase.h"
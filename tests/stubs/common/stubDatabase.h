@@ -26,8 +26,25 @@ int Database::initConnection()
     return 0;
 }
 
+int Database::connect(const std::string & context, std::string & error_msg)
+{
+    return 0;
+}
+
 Database::Database() : m_rule_db("rules"),
                        m_queryInProgress(false),
+                       m_queriesInFlight(0),
+                       m_resultsReceived(0),
+                       m_batchFailed(false),
+                       m_retryOnFailure(false),
+                       m_pipelined(false),
+                       m_pipelineSynced(false),
+                       m_batchLimit(64),
+                       m_batchLatency(0),
+                       m_batchSize(0),
+                       m_idBlockSize(1),
+                       m_idRequestPending(false),
+                       m_schemaVersion(SCHEMA_TEXT),
                        m_connection(NULL)
 {
 }
@@ -55,6 +72,13 @@ const DatabaseResult Database::selectSimpleRowBy(const std::string & name,
     return DatabaseResult(0);
 }
 
+void Database::selectSimpleRowByAsync(const std::string & name,
+                                      const std::string & column,
+                                      const std::string & value,
+                                      const ResultHandler & handler)
+{
+}
+
 Database * Database::instance()
 {
     if (m_instance == NULL) {
@@ -68,6 +92,22 @@ int Database::createInstanceDatabase()
     return 0;
 }
 
+int Database::registerSchemaVersion()
+{
+    return 0;
+}
+
+int Database::prepareStatements()
+{
+    return 0;
+}
+
+int Database::setSchemaVersion(int version)
+{
+    m_schemaVersion = version;
+    return 0;
+}
+
 int Database::registerEntityIdGenerator()
 {
     return 0;
@@ -102,12 +142,26 @@ int Database::createSimpleRow(const std::string & name,
     return 0;
 }
 
+int Database::updateSimpleRow(const std::string & name,
+                              const std::string & key,
+                              const std::string & value,
+                              const std::string & columns)
+{
+    return 0;
+}
+
 const DatabaseResult Database::selectRelation(const std::string & name,
                                               const std::string & id)
 {
     return DatabaseResult(0);
 }
 
+void Database::selectRelationAsync(const std::string & name,
+                                   const std::string & id,
+                                   const ResultHandler & handler)
+{
+}
+
 int Database::createRelationRow(const std::string & name,
                                 const std::string & id,
                                 const std::string & other)
@@ -151,6 +205,11 @@ int Database::clearPendingQuery()
     return 0;
 }
 
+int Database::fetchIds()
+{
+    return 0;
+}
+
 int Database::updateObject(const std::string & table,
                            const std::string & key,
                            const MapType & o)
@@ -193,18 +252,44 @@ const DatabaseResult Database::selectEntities(const std::string & loc)
     return DatabaseResult(0);
 }
 
+const DatabaseResult Database::selectAllEntities()
+{
+    return DatabaseResult(0);
+}
+
+const DatabaseResult Database::selectAllProperties()
+{
+    return DatabaseResult(0);
+}
+
+const DatabaseResult Database::selectAllThoughts()
+{
+    return DatabaseResult(0);
+}
+
 int Database::encodeObject(const MapType & o,
                            std::string & data)
 {
     return 0;
 }
 
+int Database::encodeWorldObject(const MapType & o,
+                                std::string & data)
+{
+    return 0;
+}
+
 int Database::decodeMessage(const std::string & data,
                             MapType &o)
 {
     return 0;
 }
 
+int Database::decodeMessage(const char * data, size_t size, MapType &o)
+{
+    return 0;
+}
+
 int Database::insertEntity(const std::string & id,
                            const std::string & loc,
                            const std::string & type,
@@ -229,11 +314,26 @@ int Database::updateEntityWithoutLoc(const std::string & id,
     return 0;
 }
 
+int Database::insertEntities(const std::vector<EntityRow> & rows)
+{
+    return 0;
+}
+
+int Database::updateEntities(const std::vector<EntityRow> & rows)
+{
+    return 0;
+}
+
 int Database::dropEntity(long id)
 {
     return 0;
 }
 
+int Database::dropEntities(const std::vector<long> & ids)
+{
+    return 0;
+}
+
 int Database::insertProperties(const std::string & id,
                                const KeyValues & tuples)
 {
@@ -246,12 +346,34 @@ int Database::updateProperties(const std::string & id,
     return 0;
 }
 
+int Database::insertProperties(const std::vector<PropertyRow> & rows)
+{
+    return 0;
+}
+
+int Database::updateProperties(const std::vector<PropertyRow> & rows)
+{
+    return 0;
+}
+
 const DatabaseResult Database::selectThoughts(const std::string & loc)
 {
     return DatabaseResult(0);
 }
 int Database::replaceThoughts(const std::string & id,
-                     const std::vector<std::string>& thoughts)
+                              const std::vector<ThoughtRow> & thoughts)
+{
+    return 0;
+}
+
+int Database::updateThoughts(const std::string & id,
+                             const std::vector<ThoughtRow> & thoughts,
+                             const std::vector<std::string> & deleted)
+{
+    return 0;
+}
+
+int Database::writeThoughts(const std::vector<ThoughtWrite> & changes)
 {
     return 0;
 }
@@ -52,6 +52,10 @@ void Monitors::insert(const std::string & key, const Element & val)
 {
 }
 
+void Monitors::erase(const std::string & key)
+{
+}
+
 void Monitors::watch(const::std::string & name, VariableBase * monitor)
 {
 }
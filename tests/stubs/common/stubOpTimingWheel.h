@@ -0,0 +1,71 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "common/OpTimingWheel.h"
+
+OpTimingWheel::OpTimingWheel(double resolution, double startTime) :
+    m_resolution(resolution), m_currentTick(0), m_wheelCount(0)
+{
+}
+
+OpTimingWheel::~OpTimingWheel()
+{
+}
+
+void OpTimingWheel::push(OpQueEntry entry)
+{
+}
+
+void OpTimingWheel::advance(double time)
+{
+}
+
+bool OpTimingWheel::isDue(double time) const
+{
+    return false;
+}
+
+OpQueEntry OpTimingWheel::pop()
+{
+    return m_ready.top();
+}
+
+double OpTimingWheel::nextOpTime() const
+{
+    return 0.0;
+}
+
+bool OpTimingWheel::empty() const
+{
+    return true;
+}
+
+std::size_t OpTimingWheel::size() const
+{
+    return 0;
+}
+
+void OpTimingWheel::clear()
+{
+}
+
+std::size_t OpTimingWheel::removeCancelled()
+{
+    return 0;
+}
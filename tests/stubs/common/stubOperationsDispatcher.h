@@ -24,7 +24,13 @@ OpQueEntry::OpQueEntry(const Operation & o, LocatedEntity & f) : op(o),
 {
 }
 
-OpQueEntry::OpQueEntry(const OpQueEntry & o) : op(o.op), from(o.from)
+OpQueEntry::OpQueEntry(const OpQueEntry & o) : op(o.op), from(o.from),
+                                               handle(o.handle)
+{
+}
+
+OpQueEntry::OpQueEntry(OpQueEntry && o) : op(o.op), from(o.from),
+                                          handle(o.handle)
 {
 }
 
@@ -32,6 +38,16 @@ OpQueEntry::~OpQueEntry()
 {
 }
 
+OpQueEntry & OpQueEntry::operator=(const OpQueEntry & o)
+{
+    return *this;
+}
+
+OpQueEntry & OpQueEntry::operator=(OpQueEntry && o)
+{
+    return *this;
+}
+
 
 OperationsDispatcher::OperationsDispatcher(const std::function<void(const Operation&, LocatedEntity&)>& operationProcessor, const std::function<double()>& timeProviderFn)
 : m_operationProcessor(operationProcessor), m_timeProviderFn(timeProviderFn)
@@ -55,6 +71,59 @@ void OperationsDispatcher::addOperationToQueue(const Operation & op, LocatedEnti
 
 }
 
+OpHandle OperationsDispatcher::scheduleOperation(const Operation & op, LocatedEntity & ent)
+{
+    return OpHandle();
+}
+
+void OperationsDispatcher::cancelOperation(OpHandle & handle)
+{
+}
+
+void OperationsDispatcher::queueOperation(const Operation & op, LocatedEntity & ent,
+                                          const OpHandle & handle)
+{
+}
+
+void OperationsDispatcher::compactQueues()
+{
+}
+
+void OperationsDispatcher::useTimingWheel(double resolution)
+{
+}
+
+void OperationsDispatcher::setSliceBudget(double seconds)
+{
+}
+
+void OperationsDispatcher::setAdaptiveSlices(bool adaptive)
+{
+}
+
+void OperationsDispatcher::reportIoHandlers(size_t handlers)
+{
+}
+
+void OperationsDispatcher::adaptSlice()
+{
+}
+
+size_t OperationsDispatcher::futureQueueSize() const
+{
+    return 0;
+}
+
+bool OperationsDispatcher::isFutureOpDue(double time) const
+{
+    return false;
+}
+
+OpQueEntry OperationsDispatcher::popFutureOp()
+{
+    return m_operationQueue.top();
+}
+
 bool OperationsDispatcher::idle()
 {
     return false;
@@ -75,6 +144,11 @@ double OperationsDispatcher::getTime() const
     return 0.0f;
 }
 
+double OperationsDispatcher::wallTime() const
+{
+    return 0.0;
+}
+
 double OperationsDispatcher::secondsUntilNextOp() const {
     return 0.0f;
 }
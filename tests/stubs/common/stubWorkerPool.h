@@ -0,0 +1,39 @@
+/*
+ Copyright (C) 2015 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "common/WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned int threads) :
+    m_job(nullptr), m_parts(0), m_nextPart(0), m_busyThreads(0), m_batch(0),
+    m_stopping(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+}
+
+unsigned int WorkerPool::size() const
+{
+    return 0;
+}
+
+void WorkerPool::run(std::size_t parts, const std::function<void(std::size_t)> & job)
+{
+}
@@ -183,6 +183,15 @@ std::vector<Atlas::Objects::Root> Character::getThoughts() const
     return std::vector<Atlas::Objects::Root>();
 }
 
+ThoughtChanges Character::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
+void Character::restoreThoughts(const std::vector<Atlas::Objects::Root> & thoughts)
+{
+}
+
 void Character::mindThinkOperation(const Operation & op, OpVector & res)
 {
 }
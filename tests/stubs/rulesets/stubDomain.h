@@ -39,5 +39,33 @@ void Domain::tick(double t)
 
 }
 
+bool Domain::addObserver(const LocatedEntity& observer)
+{
+    return false;
+}
+
+void Domain::removeObserver(const LocatedEntity& observer)
+{
+}
+
+std::function<bool(const LocatedEntity&)> Domain::getConcurrentVisibilityCheck(const LocatedEntity& observedEntity) const
+{
+    return std::function<bool(const LocatedEntity&)>();
+}
+
+bool Domain::getObserverCandidates(const LocatedEntity& observedEntity,
+        std::vector<const LocatedEntity*>& candidates) const
+{
+    return false;
+}
+
+void Domain::addEntity(const LocatedEntity& entity)
+{
+}
+
+void Domain::removeEntity(const LocatedEntity& entity)
+{
+}
+
 
 #endif /* STUBDOMAIN_H_ */
@@ -62,6 +62,15 @@ std::vector<Atlas::Objects::Root> ProxyMind::getThoughts() const
     return thoughts;
 }
 
+ThoughtChanges ProxyMind::takeThoughtChanges()
+{
+    return ThoughtChanges();
+}
+
+void ProxyMind::restoreThoughts(const std::vector<Atlas::Objects::Root> & thoughts)
+{
+}
+
 void ProxyMind::clearThoughts()
 {
 }
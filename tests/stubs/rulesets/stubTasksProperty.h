@@ -37,6 +37,14 @@ TasksProperty * TasksProperty::copy() const
     return 0;
 }
 
+void TasksProperty::scheduleTick(LocatedEntity *, OpVector &)
+{
+}
+
+void TasksProperty::cancelTick()
+{
+}
+
 int TasksProperty::startTask(Task *, LocatedEntity *, const Operation &, OpVector &)
 {
     return 0;
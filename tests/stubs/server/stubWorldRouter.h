@@ -91,6 +91,46 @@ void WorldRouter::message(const Operation & op, LocatedEntity & ent)
 {
 }
 
+void WorldRouter::setPerceptionThreads(unsigned int threads)
+{
+}
+
+void WorldRouter::setPerceptionIndex(bool enabled)
+{
+}
+
+bool WorldRouter::broadcastIndexed(const Operation & op,
+                                   const Domain & fromDomain,
+                                   const LocatedEntity & from)
+{
+    return false;
+}
+
+void WorldRouter::deliverToRecipients(const Operation & op,
+                                      const std::vector<LocatedEntity *> & recipients)
+{
+}
+
+void WorldRouter::registerObserver(LocatedEntity * perceptive)
+{
+}
+
+bool WorldRouter::broadcastParallel(const Operation & op,
+                                    const Domain & fromDomain,
+                                    const LocatedEntity & from)
+{
+    return false;
+}
+
+OpHandle WorldRouter::scheduleOperation(const Operation & op, LocatedEntity & ent)
+{
+    return OpHandle();
+}
+
+void WorldRouter::cancelOperation(OpHandle & handle)
+{
+}
+
 bool WorldRouter::idle()
 {
     return false;
@@ -103,6 +103,117 @@ static int world_purge(Storage & ab, struct dbsys * system,
     return 0;
 }
 
+/// \brief A column of the world tables holding encoded data.
+struct WorldColumn {
+    const char * table;
+    const char * column;
+};
+
+static const WorldColumn world_columns[] = {
+    { "entities", "location" },
+    { "properties", "value" },
+    { "thoughts", "thought" },
+};
+
+/// Number of rows rewritten in each round trip to the database.
+static const int MIGRATE_ROWS_PER_COMMAND = 256;
+
+/// \brief Convert a column of a world table to bytea, and re-encode its
+/// data in the compact binary encoding.
+static int migrate_column(Database & db, const WorldColumn & wc)
+{
+    std::string cmd = String::compose("ALTER TABLE %1 ALTER COLUMN %2 "
+                                      "TYPE bytea USING convert_to(%2, 'UTF8')",
+                                      wc.table, wc.column);
+    if (db.runCommandQuery(cmd) != 0) {
+        return -1;
+    }
+    cmd = String::compose("SELECT ctid, %2 FROM %1 WHERE %2 IS NOT NULL",
+                          wc.table, wc.column);
+    DatabaseResult res = db.runSimpleSelectQuery(cmd);
+    if (res.error()) {
+        return -1;
+    }
+
+    std::string updates;
+    int count = 0;
+    DatabaseResult::const_iterator I = res.begin();
+    DatabaseResult::const_iterator Iend = res.end();
+    for (; I != Iend; ++I) {
+        Atlas::Message::MapType data;
+        if (db.decodeMessage(I.column(1), data) != 0) {
+            std::cout << "Could not decode row " << I.column(0) << " of "
+                      << wc.table << std::endl << std::flush;
+            return -1;
+        }
+        std::string encoded;
+        if (db.encodeWorldObject(data, encoded) != 0) {
+            return -1;
+        }
+        size_t size;
+        unsigned char * escaped = PQescapeByteaConn(db.getConnection(),
+                (const unsigned char *)encoded.data(), encoded.size(), &size);
+        if (escaped == 0) {
+            return -1;
+        }
+        updates += String::compose("UPDATE %1 SET %2 = '%3' "
+                                   "WHERE ctid = '%4';",
+                                   wc.table, wc.column, (const char *)escaped,
+                                   I.column(0));
+        PQfreemem(escaped);
+        if (++count % MIGRATE_ROWS_PER_COMMAND == 0) {
+            if (db.runCommandQuery(updates) != 0) {
+                return -1;
+            }
+            updates.clear();
+        }
+    }
+    if (!updates.empty() && db.runCommandQuery(updates) != 0) {
+        return -1;
+    }
+    std::cout << "Converted " << count << " rows of " << wc.table
+              << std::endl << std::flush;
+    return 0;
+}
+
+static int world_migrate(Storage & ab, struct dbsys * system,
+                         int argc, char ** argv)
+{
+    Database & db = *Database::instance();
+    if (db.registerSchemaVersion() != 0) {
+        std::cout << "Could not read schema version" << std::endl << std::flush;
+        return 1;
+    }
+    if (db.schemaVersion() >= Database::SCHEMA_BINARY) {
+        std::cout << "World tables already use the binary encoding"
+                  << std::endl << std::flush;
+        return 0;
+    }
+
+    // Everything is done in one transaction, so that a failure leaves
+    // the tables as they were.
+    if (db.runCommandQuery("BEGIN") != 0) {
+        return 1;
+    }
+    bool ok = db.setSchemaVersion(Database::SCHEMA_BINARY) == 0;
+    for (auto& wc : world_columns) {
+        if (!ok || migrate_column(db, wc) != 0) {
+            ok = false;
+            break;
+        }
+    }
+    if (!ok) {
+        std::cout << "World migration fail" << std::endl << std::flush;
+        db.runCommandQuery("ROLLBACK");
+        return 1;
+    }
+    if (db.runCommandQuery("COMMIT") != 0) {
+        std::cout << "World migration fail" << std::endl << std::flush;
+        return 1;
+    }
+    return 0;
+}
+
 static int users_purge(Storage & ab, struct dbsys * system,
                       int argc, char ** argv)
 {
@@ -293,6 +404,7 @@ int dbs_generic(Storage & ab, struct dbsys * system,
 
 struct dbsys world_cmds[] = {
     { "purge", "Purge world data", &world_purge, 0 },
+    { "migrate", "Convert world data to the binary encoding", &world_migrate, 0 },
     { "help",  "Show world help", &dbs_help, &world_cmds[0] },
     { NULL,    "Guard", }
 };